@@ -52,3 +52,21 @@ if not exist bin\shaders md bin\shaders
 set glslc=%vulkan_sdk%\bin\glslc.exe
 %glslc% shaders/default.vert -o bin/shaders/default.vert.spv
 %glslc% shaders/default.frag -o bin/shaders/default.frag.spv
+%glslc% shaders/quantized.vert -o bin/shaders/quantized.vert.spv
+%glslc% shaders/cull.comp -o bin/shaders/cull.comp.spv
+%glslc% shaders/depthpyramid.comp -o bin/shaders/depthpyramid.comp.spv
+%glslc% -DSINGLE_SAMPLED shaders/depthpyramid.comp -o bin/shaders/depthpyramid_single.comp.spv
+%glslc% shaders/lightbin.comp -o bin/shaders/lightbin.comp.spv
+
+
+:: NOTE(blackedout): Build the mesh cooker and cook all source meshes
+cl /nologo /O2 cook.c /Fe:bin\cook.exe
+bin\cook.exe -quantize assets\plane.obj bin\plane.mesh
+bin\cook.exe -quantize assets\cube.obj bin\cube.mesh
+
+:: NOTE(blackedout): Build the asset packer and pack everything the program loads at runtime into one file that is mapped at startup
+cl /nologo /O2 pack.c /Fe:bin\pack.exe
+:: KTX2 textures (e.g. made with toktx) are packed as they are, the program picks the first one in a format the device supports.
+set textures=
+for %%f in (assets\*.ktx2) do call set "textures=%%textures%% %%f"
+bin\pack.exe bin\assets.pack bin\shaders\default.vert.spv bin\shaders\default.frag.spv bin\shaders\quantized.vert.spv bin\shaders\cull.comp.spv bin\shaders\depthpyramid.comp.spv bin\shaders\depthpyramid_single.comp.spv bin\shaders\lightbin.comp.spv bin\plane.mesh bin\cube.mesh %textures%
\ No newline at end of file
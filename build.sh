@@ -33,13 +33,16 @@ else
     is_macos=false
     vulkan_sdk_platform="$vulkan_sdk/x86_64"
     vma_libcpp=-lstdc++
-    libraries="-lm -lvulkan"
+    libraries="-lm -lvulkan -lpthread"
 fi
 
 # NOTE(blackedout): Compile the program
+glslc="$vulkan_sdk_platform/bin/glslc"
+
 include_paths="-I$vulkan_sdk_platform/include -Iglfw/include"
 library_paths="-L$vulkan_sdk_platform/lib"
 defines="-DGLFW_INCLUDE_VULKAN"
+shader_compiler_define="-DSHADER_COMPILER_PATH=\"$glslc\""
 explicit_layer_define="-DVULKAN_EXPLICIT_LAYERS_PATH=\"$vulkan_sdk_platform/share/vulkan/explicit_layer.d\""
 shared_a=bin/glfw.a
 
@@ -51,6 +54,7 @@ if [ -e "bin/vma.a" ]; then
 fi
 
 shaders_dst=bin/shaders
+assets_dst=bin
 if [ "$is_macos" = true ]; then
 
     # NOTE(blackedout): Create independent bundled application if the first argument to calling this script is bundle.
@@ -93,6 +97,7 @@ if [ "$is_macos" = true ]; then
         # NOTE(blackedout): Change compiler outputs to point into the bundle and have the bundle's name in case of the executable itself
         compiler_output=$bundle_contents/MacOS/$bundle_name
         shaders_dst=$bundle_contents/Resources/$shaders_dst
+        assets_dst=$bundle_contents/Resources/$assets_dst
     else
         rpath=$vulkan_sdk_platform/lib
         moltenvk_driver="$vulkan_sdk_platform/share/vulkan/icd.d/MoltenVK_icd.json"
@@ -101,16 +106,34 @@ if [ "$is_macos" = true ]; then
         compiler_output=a.out
     fi
     
+    host_cc=clang
     clang -g -O0 -Wall $include_paths $library_paths $defines main.c $shared_a $libraries -Wl,-rpath,$rpath -o$compiler_output
 else
     # -Wno-missing-braces is to avoid console spamming (for a compiler bug?)
-    defines="$defines $explicit_layer_define"
+    host_cc=gcc
+    defines="$defines $explicit_layer_define $shader_compiler_define"
     gcc -g -O0 -Wall -Wno-missing-braces $include_paths $library_paths $defines main.c $shared_a -lm $libraries -Wl,--disable-new-dtags,-rpath=$vulkan_sdk_platform/lib
 fi
 
 # NOTE(blackedout): Compile shaders
 mkdir -p $shaders_dst
 
-glslc="$vulkan_sdk_platform/bin/glslc"
 $glslc shaders/default.vert -o $shaders_dst/default.vert.spv
-$glslc shaders/default.frag -o $shaders_dst/default.frag.spv
\ No newline at end of file
+$glslc shaders/default.frag -o $shaders_dst/default.frag.spv
+$glslc shaders/quantized.vert -o $shaders_dst/quantized.vert.spv
+$glslc shaders/cull.comp -o $shaders_dst/cull.comp.spv
+$glslc shaders/depthpyramid.comp -o $shaders_dst/depthpyramid.comp.spv
+$glslc -DSINGLE_SAMPLED shaders/depthpyramid.comp -o $shaders_dst/depthpyramid_single.comp.spv
+$glslc shaders/lightbin.comp -o $shaders_dst/lightbin.comp.spv
+
+# NOTE(blackedout): Build the mesh cooker and cook all source meshes
+$host_cc -O2 -Wall -Wno-missing-braces -Wno-unused-function cook.c -o bin/cook -lm
+bin/cook -quantize assets/plane.obj bin/plane.mesh
+bin/cook -quantize assets/cube.obj bin/cube.mesh
+
+# NOTE(blackedout): Build the asset packer and pack everything the program loads at runtime into one file that is mapped at startup
+# -Wno-unused-function because the tools include all of util.c but only use some of it
+$host_cc -O2 -Wall -Wno-missing-braces -Wno-unused-function pack.c -o bin/pack
+# KTX2 textures (e.g. made with toktx) are packed as they are, the program picks the first one in a format the device supports.
+textures=$(ls assets/*.ktx2 2>/dev/null)
+bin/pack $assets_dst/assets.pack $shaders_dst/default.vert.spv $shaders_dst/default.frag.spv $shaders_dst/quantized.vert.spv $shaders_dst/cull.comp.spv $shaders_dst/depthpyramid.comp.spv $shaders_dst/depthpyramid_single.comp.spv $shaders_dst/lightbin.comp.spv bin/plane.mesh bin/cube.mesh $textures
\ No newline at end of file
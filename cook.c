@@ -0,0 +1,2033 @@
+// Original source in https://github.com/blackedout01/glfw-vk-template
+//
+// This is free and unencumbered software released into the public domain.
+// Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+// this software, either in source code form or as a compiled binary, for any
+// purpose, commercial or non-commercial, and by any means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors of
+// this software dedicate any and all copyright interest in the software to the
+// public domain. We make this dedication for the benefit of the public at
+// large and to the detriment of our heirs and successors. We intend this
+// dedication to be an overt act of relinquishment in perpetuity of all present
+// and future rights to this software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to https://unlicense.org
+
+// NOTE(blackedout): Offline mesh cooker, converts OBJ and glTF 2.0 (.gltf and .glb) files into cooked meshes (see mesh.c), which the program
+// loads without any parsing.
+// Usage: cook [-quantize] <input.obj|input.gltf|input.glb> <output.mesh>
+// With -quantize, vertices are written as vertex_quantized (16 instead of 32 bytes), otherwise as vertex.
+// Triangles and vertices are reordered for the vertex cache, overdraw and vertex fetch (see MARK: Optimization), indices are 16 bit if possible.
+// Level 0 is split into meshlets for cluster culling (see MARK: Meshlets).
+// Submeshes get up to MESH_MAX_LOD_COUNT levels of detail with about half the triangles each (see MARK: Levels of Detail).
+// OBJ objects, groups and materials as well as glTF primitives become submeshes. glTF node transforms are not applied.
+// Both formats use counterclockwise front faces, the program uses clockwise ones (see VulkanDefaultGraphicsPipelineDescription),
+// so all triangles are flipped. OBJ texture coordinates are flipped vertically, because OBJ has its origin at the bottom left.
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.c"
+#include "mesh.c"
+
+// MARK: Cooked Mesh Building
+typedef struct {
+    uint32_t VertexCount;
+    uint32_t VertexCapacity;
+    vertex *Vertices;
+    uint8_t *HasNormal; // NOTE(blackedout): Per vertex, normals of vertices without one are computed from the faces
+
+    uint32_t IndexCount;
+    uint32_t IndexCapacity;
+    uint32_t *Indices;
+
+    uint32_t SubmeshCount;
+    uint32_t SubmeshCapacity;
+    mesh_submesh *Submeshes;
+
+    uint32_t MeshletCount;
+    uint32_t MeshletCapacity;
+    mesh_meshlet *Meshlets;
+} cook_mesh;
+
+static int CookGrow(void **Items, uint32_t *Capacity, uint32_t Count, uint32_t ItemByteCount) {
+    // NOTE(blackedout): Makes room for at least Count items.
+    if(Count <= *Capacity) {
+        return 0;
+    }
+    uint32_t NewCapacity = Max(Max(*Capacity*2, Count), 64);
+    void *NewItems = realloc(*Items, (size_t)NewCapacity*ItemByteCount);
+    AssertMessageGoto(NewItems, label_Error, "Out of memory.\n");
+    *Items = NewItems;
+    *Capacity = NewCapacity;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void CookDestroyMesh(cook_mesh *Mesh) {
+    free(Mesh->Vertices);
+    free(Mesh->HasNormal);
+    free(Mesh->Indices);
+    free(Mesh->Submeshes);
+    free(Mesh->Meshlets);
+    memset(Mesh, 0, sizeof(*Mesh));
+}
+
+static int CookBeginSubmesh(cook_mesh *Mesh, const char *Name, uint32_t NameLength) {
+    CheckGoto(CookGrow((void **)&Mesh->Submeshes, &Mesh->SubmeshCapacity, Mesh->SubmeshCount + 1, sizeof(mesh_submesh)), label_Error);
+    mesh_submesh Submesh;
+    SetZero(Submesh);
+    NameLength = Min(NameLength, MESH_MAX_NAME_LENGTH - 1);
+    memcpy(Submesh.Name, Name, NameLength);
+    Submesh.IndexOffset = Mesh->IndexCount;
+    Submesh.VertexOffset = Mesh->VertexCount;
+    Mesh->Submeshes[Mesh->SubmeshCount++] = Submesh;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookPushVertex(cook_mesh *Mesh, vertex Vertex, int HasNormal) {
+    uint32_t Capacity = Mesh->VertexCapacity;
+    CheckGoto(CookGrow((void **)&Mesh->Vertices, &Mesh->VertexCapacity, Mesh->VertexCount + 1, sizeof(vertex)), label_Error);
+    CheckGoto(CookGrow((void **)&Mesh->HasNormal, &Capacity, Mesh->VertexCount + 1, sizeof(uint8_t)), label_Error);
+    Mesh->Vertices[Mesh->VertexCount] = Vertex;
+    Mesh->HasNormal[Mesh->VertexCount] = (uint8_t)(HasNormal != 0);
+    ++Mesh->VertexCount;
+    ++Mesh->Submeshes[Mesh->SubmeshCount - 1].VertexCount;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookPushTriangle(cook_mesh *Mesh, uint32_t A, uint32_t B, uint32_t C) {
+    // NOTE(blackedout): Indices are relative to the current submesh. The winding is flipped here (see top of file).
+    CheckGoto(CookGrow((void **)&Mesh->Indices, &Mesh->IndexCapacity, Mesh->IndexCount + 3, sizeof(uint32_t)), label_Error);
+    Mesh->Indices[Mesh->IndexCount++] = A;
+    Mesh->Indices[Mesh->IndexCount++] = C;
+    Mesh->Indices[Mesh->IndexCount++] = B;
+    Mesh->Submeshes[Mesh->SubmeshCount - 1].IndexCount += 3;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static v3 CookSubV3(v3 A, v3 B) {
+    v3 Result = {{ A.E[0] - B.E[0], A.E[1] - B.E[1], A.E[2] - B.E[2] }};
+    return Result;
+}
+
+static v3 CookCrossV3(v3 A, v3 B) {
+    v3 Result = {{ A.E[1]*B.E[2] - A.E[2]*B.E[1], A.E[2]*B.E[0] - A.E[0]*B.E[2], A.E[0]*B.E[1] - A.E[1]*B.E[0] }};
+    return Result;
+}
+
+static void CookComputeMissingNormals(cook_mesh *Mesh) {
+    // NOTE(blackedout): Area weighted face normals are accumulated into all vertices of a face that don't have a normal yet.
+    // Triangles are stored clockwise at this point, hence the order of the cross product.
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        mesh_submesh *Submesh = Mesh->Submeshes + I;
+        vertex *Vertices = Mesh->Vertices + Submesh->VertexOffset;
+        uint8_t *HasNormal = Mesh->HasNormal + Submesh->VertexOffset;
+        uint32_t *Indices = Mesh->Indices + Submesh->IndexOffset;
+        for(uint32_t J = 0; J + 2 < Submesh->IndexCount; J += 3) {
+            v3 P0 = Vertices[Indices[J]].Position, P1 = Vertices[Indices[J + 1]].Position, P2 = Vertices[Indices[J + 2]].Position;
+            v3 FaceNormal = CookCrossV3(CookSubV3(P2, P0), CookSubV3(P1, P0));
+            for(uint32_t K = 0; K < 3; ++K) {
+                uint32_t Index = Indices[J + K];
+                if(HasNormal[Index] == 0) {
+                    for(uint32_t L = 0; L < 3; ++L) {
+                        Vertices[Index].Normal.E[L] += FaceNormal.E[L];
+                    }
+                }
+            }
+        }
+        for(uint32_t J = 0; J < Submesh->VertexCount; ++J) {
+            if(HasNormal[J] == 0) {
+                v3 *Normal = &Vertices[J].Normal;
+                float Length = sqrtf(Normal->E[0]*Normal->E[0] + Normal->E[1]*Normal->E[1] + Normal->E[2]*Normal->E[2]);
+                for(uint32_t L = 0; L < 3; ++L) {
+                    Normal->E[L] = (Length > 0.0f)? Normal->E[L]/Length : ((L == 1)? 1.0f : 0.0f);
+                }
+                HasNormal[J] = 1;
+            }
+        }
+    }
+}
+
+static mesh_bounds CookComputeBounds(const vertex *Vertices, uint32_t VertexCount) {
+    mesh_bounds Bounds;
+    SetZero(Bounds);
+    if(VertexCount == 0) {
+        return Bounds;
+    }
+    Bounds.Min = Bounds.Max = Vertices[0].Position;
+    for(uint32_t I = 1; I < VertexCount; ++I) {
+        for(uint32_t L = 0; L < 3; ++L) {
+            Bounds.Min.E[L] = Min(Bounds.Min.E[L], Vertices[I].Position.E[L]);
+            Bounds.Max.E[L] = Max(Bounds.Max.E[L], Vertices[I].Position.E[L]);
+        }
+    }
+    float RadiusSquared = 0.0f;
+    for(uint32_t L = 0; L < 3; ++L) {
+        Bounds.Center.E[L] = 0.5f*(Bounds.Min.E[L] + Bounds.Max.E[L]);
+    }
+    for(uint32_t I = 0; I < VertexCount; ++I) {
+        v3 D = CookSubV3(Vertices[I].Position, Bounds.Center);
+        RadiusSquared = Max(RadiusSquared, D.E[0]*D.E[0] + D.E[1]*D.E[1] + D.E[2]*D.E[2]);
+    }
+    Bounds.Radius = sqrtf(RadiusSquared);
+    return Bounds;
+}
+
+static int CookQuantizeVertices(cook_mesh *Mesh, mesh_bounds Bounds, v3 *OutPositionOffset, v3 *OutPositionScale, vertex_quantized **OutVertices) {
+    // NOTE(blackedout): Positions are quantized relative to the mesh's bounding box, so the precision is a 65535th of its extent per axis.
+    v3 PositionOffset = Bounds.Center;
+    v3 PositionScale;
+    for(uint32_t L = 0; L < 3; ++L) {
+        PositionScale.E[L] = Max(0.5f*(Bounds.Max.E[L] - Bounds.Min.E[L]), 1e-6f);
+    }
+
+    vertex_quantized *Vertices = (vertex_quantized *)malloc((size_t)Max(Mesh->VertexCount, 1)*sizeof(vertex_quantized));
+    AssertMessageGoto(Vertices, label_Error, "Out of memory.\n");
+    float MaxPositionError = 0.0f, MinNormalDot = 1.0f;
+    for(uint32_t I = 0; I < Mesh->VertexCount; ++I) {
+        vertex Vertex = Mesh->Vertices[I];
+        vertex_quantized Quantized = QuantizeVertex(Vertex, PositionOffset, PositionScale);
+        Vertices[I] = Quantized;
+
+        // NOTE(blackedout): Decode like the vertex shader to report the error
+        float Decoded[3];
+        for(uint32_t L = 0; L < 3; ++L) {
+            float Position = PositionOffset.E[L] + PositionScale.E[L]*Max((float)Quantized.Position[L]/32767.0f, -1.0f);
+            MaxPositionError = Max(MaxPositionError, fabsf(Position - Vertex.Position.E[L]));
+            Decoded[L] = (L < 2)? Max((float)Quantized.Normal[L]/32767.0f, -1.0f) : 0.0f;
+        }
+        Decoded[2] = 1.0f - fabsf(Decoded[0]) - fabsf(Decoded[1]);
+        float T = Max(-Decoded[2], 0.0f);
+        Decoded[0] += (Decoded[0] >= 0.0f)? -T : T;
+        Decoded[1] += (Decoded[1] >= 0.0f)? -T : T;
+        float Length = sqrtf(Decoded[0]*Decoded[0] + Decoded[1]*Decoded[1] + Decoded[2]*Decoded[2]);
+        MinNormalDot = Min(MinNormalDot, (Decoded[0]*Vertex.Normal.E[0] + Decoded[1]*Vertex.Normal.E[1] + Decoded[2]*Vertex.Normal.E[2])/Length);
+    }
+    printf("Quantized %d vertices: %d -> %d bytes, max position error %g, max normal error %g degrees.\n", Mesh->VertexCount,
+           (int)(Mesh->VertexCount*sizeof(vertex)), (int)(Mesh->VertexCount*sizeof(vertex_quantized)), MaxPositionError, acos(Clamp(MinNormalDot, -1.0f, 1.0f))*180.0/3.14159265358979);
+
+    *OutPositionOffset = PositionOffset;
+    *OutPositionScale = PositionScale;
+    *OutVertices = Vertices;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookWriteMesh(cook_mesh *Mesh, mesh_vertex_format VertexFormat, const char *Filepath) {
+    int Result = 1;
+    FILE *File = 0;
+    vertex_quantized *QuantizedVertices = 0;
+    uint16_t *ShortIndices = 0;
+    {
+        mesh_header Header;
+        SetZero(Header);
+        Header.Magic = MESH_MAGIC;
+        Header.Version = MESH_VERSION;
+        Header.VertexFormat = VertexFormat;
+        Header.VertexByteCount = MeshVertexByteCount(VertexFormat);
+        Header.SubmeshCount = Mesh->SubmeshCount;
+        Header.VertexCount = Mesh->VertexCount;
+        Header.IndexCount = Mesh->IndexCount;
+        Header.IndexByteCount = sizeof(uint16_t);
+        Header.MeshletCount = Mesh->MeshletCount;
+        for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+            if(Mesh->Submeshes[I].VertexCount > 65536) {
+                Header.IndexByteCount = sizeof(uint32_t);
+            }
+        }
+        Header.SubmeshesOffset = AlignAny(sizeof(mesh_header), uint64_t, MESH_ALIGNMENT);
+        Header.VerticesOffset = AlignAny(Header.SubmeshesOffset + (uint64_t)Mesh->SubmeshCount*sizeof(mesh_submesh), uint64_t, MESH_ALIGNMENT);
+        Header.IndicesOffset = AlignAny(Header.VerticesOffset + (uint64_t)Mesh->VertexCount*Header.VertexByteCount, uint64_t, MESH_ALIGNMENT);
+        Header.MeshletsOffset = AlignAny(Header.IndicesOffset + (uint64_t)Mesh->IndexCount*Header.IndexByteCount, uint64_t, MESH_ALIGNMENT);
+        Header.Bounds = CookComputeBounds(Mesh->Vertices, Mesh->VertexCount);
+
+        const void *Vertices = Mesh->Vertices;
+        if(VertexFormat == MESH_VERTEX_FORMAT_QUANTIZED) {
+            CheckGoto(CookQuantizeVertices(Mesh, Header.Bounds, &Header.PositionOffset, &Header.PositionScale, &QuantizedVertices), label_Exit);
+            Vertices = QuantizedVertices;
+        }
+        const void *Indices = Mesh->Indices;
+        if(Header.IndexByteCount == sizeof(uint16_t)) {
+            ShortIndices = (uint16_t *)malloc((size_t)Max(Mesh->IndexCount, 1)*sizeof(uint16_t));
+            AssertMessageGoto(ShortIndices, label_Exit, "Out of memory.\n");
+            for(uint32_t I = 0; I < Mesh->IndexCount; ++I) {
+                ShortIndices[I] = (uint16_t)Mesh->Indices[I];
+            }
+            Indices = ShortIndices;
+        }
+
+        File = fopen(Filepath, "wb");
+        AssertMessageGoto(File, label_Exit, "File '%s' could not be opened for writing (code %d).\n", Filepath, errno);
+
+        static const uint8_t Padding[MESH_ALIGNMENT] = {0};
+        struct {
+            const void *Bytes;
+            uint64_t ByteCount;
+            uint64_t Offset;
+        } Sections[] = {
+            { &Header, sizeof(Header), 0 },
+            { Mesh->Submeshes, (uint64_t)Mesh->SubmeshCount*sizeof(mesh_submesh), Header.SubmeshesOffset },
+            { Vertices, (uint64_t)Mesh->VertexCount*Header.VertexByteCount, Header.VerticesOffset },
+            { Indices, (uint64_t)Mesh->IndexCount*Header.IndexByteCount, Header.IndicesOffset },
+            { Mesh->Meshlets, (uint64_t)Mesh->MeshletCount*sizeof(mesh_meshlet), Header.MeshletsOffset },
+        };
+        uint64_t Position = 0;
+        for(uint32_t I = 0; I < ArrayCount(Sections); ++I) {
+            size_t PaddingByteCount = (size_t)(Sections[I].Offset - Position);
+            int IsWritten = fwrite(Padding, 1, PaddingByteCount, File) == PaddingByteCount &&
+                            (Sections[I].ByteCount == 0 || fwrite(Sections[I].Bytes, (size_t)Sections[I].ByteCount, 1, File) == 1);
+            AssertMessageGoto(IsWritten, label_Exit, "Writing '%s' failed.\n", Filepath);
+            Position = Sections[I].Offset + Sections[I].ByteCount;
+        }
+    }
+    Result = 0;
+
+label_Exit:
+    if(File) {
+        fclose(File);
+    }
+    free(QuantizedVertices);
+    free(ShortIndices);
+    return Result;
+}
+
+static int CookFinishMesh(cook_mesh *Mesh) {
+    // NOTE(blackedout): Drops empty submeshes (e.g. OBJ groups without faces), computes missing normals and the submesh bounds.
+    uint32_t SubmeshCount = 0;
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        if(Mesh->Submeshes[I].IndexCount > 0) {
+            Mesh->Submeshes[SubmeshCount++] = Mesh->Submeshes[I];
+        }
+    }
+    Mesh->SubmeshCount = SubmeshCount;
+    AssertMessageGoto(SubmeshCount > 0, label_Error, "Mesh has no triangles.\n");
+
+    CookComputeMissingNormals(Mesh);
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        mesh_submesh *Submesh = Mesh->Submeshes + I;
+        Submesh->Bounds = CookComputeBounds(Mesh->Vertices + Submesh->VertexOffset, Submesh->VertexCount);
+        mesh_lod Lod = { Submesh->IndexOffset, Submesh->IndexCount, 0.0f };
+        Submesh->LodCount = 1;
+        Submesh->Lods[0] = Lod;
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+// MARK: Optimization
+// NOTE(blackedout): Per submesh index and vertex reordering, all in place:
+// 1. Triangles are reordered for the post-transform vertex cache with Tipsify (Sander, Nehab, Barczak 2007, "Fast Triangle Reordering
+//    for Vertex Locality and Reduced Overdraw").
+// 2. The resulting fans are split into clusters, which are sorted front to back as seen from outside the mesh to reduce overdraw.
+// 3. Vertices are reordered by first use, so that vertex fetches walk through memory linearly.
+// ACMR (average cache miss ratio, transformed vertices per triangle) and ATVR (transformed vertices per vertex) are measured with a FIFO
+// cache of COOK_CACHE_SIZE entries, ACMR is at best about 0.5 for regular meshes and ATVR at best 1.
+#define COOK_CACHE_SIZE 16
+#define COOK_OVERDRAW_THRESHOLD 1.05f // NOTE(blackedout): How much worse than the whole mesh a cluster's ACMR may get by splitting it
+
+typedef struct {
+    uint32_t Entries[COOK_CACHE_SIZE];
+    uint32_t Count;
+    uint32_t Next;
+} cook_vertex_cache;
+
+static int CookCacheAccess(cook_vertex_cache *Cache, uint32_t Vertex) {
+    // NOTE(blackedout): Returns 1 on a miss, i.e. when the vertex has to be transformed
+    for(uint32_t I = 0; I < Cache->Count; ++I) {
+        if(Cache->Entries[I] == Vertex) {
+            return 0;
+        }
+    }
+    Cache->Entries[Cache->Next] = Vertex;
+    Cache->Next = (Cache->Next + 1) % COOK_CACHE_SIZE;
+    Cache->Count = Min(Cache->Count + 1, COOK_CACHE_SIZE);
+    return 1;
+}
+
+static uint32_t CookCountCacheMisses(const uint32_t *Indices, uint32_t IndexCount) {
+    cook_vertex_cache Cache;
+    SetZero(Cache);
+    uint32_t MissCount = 0;
+    for(uint32_t I = 0; I < IndexCount; ++I) {
+        MissCount += CookCacheAccess(&Cache, Indices[I]);
+    }
+    return MissCount;
+}
+
+static uint64_t CookCountMeshCacheMisses(cook_mesh *Mesh) {
+    uint64_t MissCount = 0;
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        mesh_submesh *Submesh = Mesh->Submeshes + I;
+        MissCount += CookCountCacheMisses(Mesh->Indices + Submesh->IndexOffset, Submesh->IndexCount);
+    }
+    return MissCount;
+}
+
+static void CookPrintCacheStats(const char *Label, cook_mesh *Mesh) {
+    uint64_t MissCount = CookCountMeshCacheMisses(Mesh);
+    printf("%s: ACMR %.3f, ATVR %.3f (FIFO cache of %d)\n", Label, (double)MissCount/Max(Mesh->IndexCount/3, 1), (double)MissCount/Max(Mesh->VertexCount, 1), COOK_CACHE_SIZE);
+}
+
+typedef struct {
+    uint32_t *TriangleOffsets; // NOTE(blackedout): Per vertex, into Triangles, VertexCount + 1 entries
+    uint32_t *Triangles;
+    uint32_t *LiveCounts; // NOTE(blackedout): Per vertex, number of triangles that weren't emitted yet
+    uint32_t *TimeStamps;
+    uint32_t *DeadEnds;
+    uint8_t *IsEmitted; // NOTE(blackedout): Per triangle
+} cook_tipsify;
+
+static uint32_t CookTipsifyNextVertex(cook_tipsify *Tipsify, const uint32_t *Candidates, uint32_t CandidateCount, uint32_t Time, uint32_t *DeadEndCount, uint32_t *Cursor, uint32_t VertexCount) {
+    // NOTE(blackedout): Prefers the candidate that stays in the cache longest while all its remaining triangles are emitted.
+    // Returns UINT32_MAX when every triangle was emitted.
+    uint32_t Best = UINT32_MAX;
+    int64_t BestPriority = -1;
+    for(uint32_t I = 0; I < CandidateCount; ++I) {
+        uint32_t Vertex = Candidates[I];
+        if(Tipsify->LiveCounts[Vertex] > 0) {
+            int64_t Priority = 0;
+            if((int64_t)Time - Tipsify->TimeStamps[Vertex] + 2*(int64_t)Tipsify->LiveCounts[Vertex] <= COOK_CACHE_SIZE) {
+                Priority = (int64_t)Time - Tipsify->TimeStamps[Vertex];
+            }
+            if(Priority > BestPriority) {
+                BestPriority = Priority;
+                Best = Vertex;
+            }
+        }
+    }
+    if(Best != UINT32_MAX) {
+        return Best;
+    }
+
+    // NOTE(blackedout): Dead end, continue with a recently used vertex or, if there is none, the next one in input order
+    while(*DeadEndCount > 0) {
+        uint32_t Vertex = Tipsify->DeadEnds[--*DeadEndCount];
+        if(Tipsify->LiveCounts[Vertex] > 0) {
+            return Vertex;
+        }
+    }
+    while(*Cursor < VertexCount) {
+        if(Tipsify->LiveCounts[*Cursor] > 0) {
+            return *Cursor;
+        }
+        ++*Cursor;
+    }
+    return UINT32_MAX;
+}
+
+static int CookOptimizeVertexCache(uint32_t *Indices, uint32_t IndexCount, uint32_t VertexCount, uint32_t *ClusterStarts, uint32_t *OutClusterCount) {
+    // NOTE(blackedout): Writes the reordered triangles back into Indices. A cluster starts wherever Tipsify hits a dead end, because the
+    // order of those fans doesn't matter for the cache and they can be sorted for overdraw afterwards. ClusterStarts has room for a cluster per triangle.
+    uint32_t TriangleCount = IndexCount/3;
+    uint32_t *Result = 0;
+    cook_tipsify Tipsify;
+    SetZero(Tipsify);
+    malloc_multiple_subbuf Subbufs[] = {
+        { &Tipsify.TriangleOffsets, (VertexCount + 1)*sizeof(uint32_t) },
+        { &Tipsify.Triangles, IndexCount*sizeof(uint32_t) },
+        { &Tipsify.LiveCounts, VertexCount*sizeof(uint32_t) },
+        { &Tipsify.TimeStamps, VertexCount*sizeof(uint32_t) },
+        { &Tipsify.DeadEnds, IndexCount*sizeof(uint32_t) },
+        { &Result, IndexCount*sizeof(uint32_t) },
+        { &Tipsify.IsEmitted, TriangleCount*sizeof(uint8_t) },
+    };
+    void *Memory = 0;
+    CheckGoto(MallocMultiple(ArrayCount(Subbufs), Subbufs, &Memory), label_Error);
+    {
+        // NOTE(blackedout): Vertex to triangle adjacency
+        memset(Tipsify.TriangleOffsets, 0, (VertexCount + 1)*sizeof(uint32_t));
+        memset(Tipsify.LiveCounts, 0, VertexCount*sizeof(uint32_t));
+        memset(Tipsify.TimeStamps, 0, VertexCount*sizeof(uint32_t));
+        memset(Tipsify.IsEmitted, 0, TriangleCount*sizeof(uint8_t));
+        for(uint32_t I = 0; I < TriangleCount*3; ++I) {
+            ++Tipsify.LiveCounts[Indices[I]];
+        }
+        for(uint32_t I = 0; I < VertexCount; ++I) {
+            Tipsify.TriangleOffsets[I + 1] = Tipsify.TriangleOffsets[I] + Tipsify.LiveCounts[I];
+        }
+        for(uint32_t I = 0; I < TriangleCount*3; ++I) {
+            uint32_t Vertex = Indices[I];
+            Tipsify.Triangles[Tipsify.TriangleOffsets[Vertex]++] = I/3;
+        }
+        for(uint32_t I = VertexCount; I > 0; --I) {
+            Tipsify.TriangleOffsets[I] = Tipsify.TriangleOffsets[I - 1];
+        }
+        Tipsify.TriangleOffsets[0] = 0;
+
+        uint32_t Time = COOK_CACHE_SIZE + 1;
+        uint32_t Cursor = 0, DeadEndCount = 0, ResultCount = 0, ClusterCount = 0;
+        uint32_t Fan = (TriangleCount > 0)? Indices[0] : UINT32_MAX;
+        while(Fan != UINT32_MAX) {
+            // NOTE(blackedout): The candidates of this fan are exactly the dead end stack entries pushed for it
+            uint32_t CandidatesStart = DeadEndCount;
+            for(uint32_t I = Tipsify.TriangleOffsets[Fan]; I < Tipsify.TriangleOffsets[Fan + 1]; ++I) {
+                uint32_t Triangle = Tipsify.Triangles[I];
+                if(Tipsify.IsEmitted[Triangle]) {
+                    continue;
+                }
+                for(uint32_t J = 0; J < 3; ++J) {
+                    uint32_t Vertex = Indices[3*Triangle + J];
+                    Result[ResultCount++] = Vertex;
+                    Tipsify.DeadEnds[DeadEndCount++] = Vertex;
+                    --Tipsify.LiveCounts[Vertex];
+                    if(Time - Tipsify.TimeStamps[Vertex] > COOK_CACHE_SIZE) {
+                        Tipsify.TimeStamps[Vertex] = Time++;
+                    }
+                }
+                Tipsify.IsEmitted[Triangle] = 1;
+            }
+
+            uint32_t CandidateCount = DeadEndCount - CandidatesStart;
+            int IsDeadEnd = 1;
+            for(uint32_t I = 0; I < CandidateCount && IsDeadEnd; ++I) {
+                IsDeadEnd = Tipsify.LiveCounts[Tipsify.DeadEnds[CandidatesStart + I]] == 0;
+            }
+            uint32_t NextFan = CookTipsifyNextVertex(&Tipsify, Tipsify.DeadEnds + CandidatesStart, CandidateCount, Time, &DeadEndCount, &Cursor, VertexCount);
+            if(IsDeadEnd && NextFan != UINT32_MAX) {
+                // NOTE(blackedout): None of the fan's vertices has triangles left, so the next fan doesn't share any vertex with this one
+                ClusterStarts[ClusterCount++] = ResultCount/3;
+            }
+            Fan = NextFan;
+        }
+        memcpy(Indices, Result, ResultCount*sizeof(uint32_t));
+
+        // NOTE(blackedout): The first cluster always starts at 0, cluster starts are in increasing order
+        memmove(ClusterStarts + 1, ClusterStarts, ClusterCount*sizeof(uint32_t));
+        ClusterStarts[0] = 0;
+        *OutClusterCount = ClusterCount + 1;
+    }
+    free(Memory);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+typedef struct {
+    float SortKey;
+    uint32_t Start;
+    uint32_t Count;
+} cook_cluster;
+
+static int CookCompareClusters(const void *A, const void *B) {
+    const cook_cluster *ClusterA = (const cook_cluster *)A;
+    const cook_cluster *ClusterB = (const cook_cluster *)B;
+    // NOTE(blackedout): Descending by key, ties keep the cache optimized order
+    if(ClusterA->SortKey != ClusterB->SortKey) {
+        return (ClusterA->SortKey > ClusterB->SortKey)? -1 : 1;
+    }
+    return (ClusterA->Start < ClusterB->Start)? -1 : 1;
+}
+
+static int CookOptimizeOverdraw(uint32_t *Indices, uint32_t IndexCount, const vertex *Vertices, uint32_t *ClusterStarts, uint32_t ClusterCount) {
+    // NOTE(blackedout): Clusters are split further wherever the ACMR of the triangles so far is close to the whole mesh's ACMR, so that
+    // sorting them costs little cache efficiency. Clusters facing away from the mesh center are drawn first, because they are most likely to
+    // occlude the rest (the key is the distance of the cluster's plane to the mesh's centroid).
+    uint32_t TriangleCount = IndexCount/3;
+    if(TriangleCount == 0) {
+        return 0;
+    }
+    cook_cluster *Clusters = 0;
+    uint32_t *Sorted = 0;
+    malloc_multiple_subbuf Subbufs[] = {
+        { &Clusters, TriangleCount*sizeof(cook_cluster) },
+        { &Sorted, IndexCount*sizeof(uint32_t) },
+    };
+    void *Memory = 0;
+    CheckGoto(MallocMultiple(ArrayCount(Subbufs), Subbufs, &Memory), label_Error);
+    {
+        float MeshACMR = (float)CookCountCacheMisses(Indices, IndexCount)/TriangleCount;
+        uint32_t SplitCount = 0;
+        for(uint32_t I = 0; I < ClusterCount; ++I) {
+            uint32_t End = (I + 1 < ClusterCount)? ClusterStarts[I + 1] : TriangleCount;
+            cook_vertex_cache Cache;
+            SetZero(Cache);
+            uint32_t Start = ClusterStarts[I], MissCount = 0;
+            for(uint32_t J = ClusterStarts[I]; J < End; ++J) {
+                for(uint32_t K = 0; K < 3; ++K) {
+                    MissCount += CookCacheAccess(&Cache, Indices[3*J + K]);
+                }
+                if(J + 1 == End || (float)MissCount/(J + 1 - Start) <= COOK_OVERDRAW_THRESHOLD*MeshACMR) {
+                    cook_cluster Cluster = { 0.0f, Start, J + 1 - Start };
+                    Clusters[SplitCount++] = Cluster;
+                    SetZero(Cache);
+                    Start = J + 1;
+                    MissCount = 0;
+                }
+            }
+        }
+
+        v3 MeshCentroid = {{ 0.0f, 0.0f, 0.0f }};
+        float MeshArea = 0.0f;
+        for(uint32_t I = 0; I < TriangleCount; ++I) {
+            v3 P0 = Vertices[Indices[3*I]].Position, P1 = Vertices[Indices[3*I + 1]].Position, P2 = Vertices[Indices[3*I + 2]].Position;
+            v3 Normal = CookCrossV3(CookSubV3(P2, P0), CookSubV3(P1, P0));
+            float Area = sqrtf(Normal.E[0]*Normal.E[0] + Normal.E[1]*Normal.E[1] + Normal.E[2]*Normal.E[2]);
+            for(uint32_t L = 0; L < 3; ++L) {
+                MeshCentroid.E[L] += Area*(P0.E[L] + P1.E[L] + P2.E[L])/3.0f;
+            }
+            MeshArea += Area;
+        }
+        for(uint32_t L = 0; L < 3; ++L) {
+            MeshCentroid.E[L] /= Max(MeshArea, 1e-20f);
+        }
+
+        for(uint32_t I = 0; I < SplitCount; ++I) {
+            cook_cluster *Cluster = Clusters + I;
+            v3 Centroid = {{ 0.0f, 0.0f, 0.0f }}, Normal = {{ 0.0f, 0.0f, 0.0f }};
+            float Area = 0.0f;
+            for(uint32_t J = Cluster->Start; J < Cluster->Start + Cluster->Count; ++J) {
+                v3 P0 = Vertices[Indices[3*J]].Position, P1 = Vertices[Indices[3*J + 1]].Position, P2 = Vertices[Indices[3*J + 2]].Position;
+                v3 TriangleNormal = CookCrossV3(CookSubV3(P2, P0), CookSubV3(P1, P0)); // NOTE(blackedout): Length is twice the area
+                float TriangleArea = sqrtf(TriangleNormal.E[0]*TriangleNormal.E[0] + TriangleNormal.E[1]*TriangleNormal.E[1] + TriangleNormal.E[2]*TriangleNormal.E[2]);
+                for(uint32_t L = 0; L < 3; ++L) {
+                    Centroid.E[L] += TriangleArea*(P0.E[L] + P1.E[L] + P2.E[L])/3.0f;
+                    Normal.E[L] += TriangleNormal.E[L];
+                }
+                Area += TriangleArea;
+            }
+            float NormalLength = sqrtf(Normal.E[0]*Normal.E[0] + Normal.E[1]*Normal.E[1] + Normal.E[2]*Normal.E[2]);
+            float Key = 0.0f;
+            for(uint32_t L = 0; L < 3; ++L) {
+                Key += (Centroid.E[L]/Max(Area, 1e-20f) - MeshCentroid.E[L])*Normal.E[L]/Max(NormalLength, 1e-20f);
+            }
+            Cluster->SortKey = Key;
+        }
+
+        qsort(Clusters, SplitCount, sizeof(cook_cluster), CookCompareClusters);
+        uint32_t SortedCount = 0;
+        for(uint32_t I = 0; I < SplitCount; ++I) {
+            memcpy(Sorted + SortedCount, Indices + 3*Clusters[I].Start, 3*Clusters[I].Count*sizeof(uint32_t));
+            SortedCount += 3*Clusters[I].Count;
+        }
+        memcpy(Indices, Sorted, SortedCount*sizeof(uint32_t));
+    }
+    free(Memory);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookOptimizeVertexFetch(uint32_t *Indices, uint32_t IndexCount, vertex *Vertices, uint32_t VertexCount) {
+    // NOTE(blackedout): Vertices are renumbered in order of first use. All vertices of a submesh are referenced after CookFinishMesh
+    // (OBJ only creates referenced ones), unreferenced glTF vertices are moved to the end.
+    uint32_t *Remap = 0;
+    vertex *Reordered = 0;
+    malloc_multiple_subbuf Subbufs[] = {
+        { &Remap, VertexCount*sizeof(uint32_t) },
+        { &Reordered, VertexCount*sizeof(vertex) },
+    };
+    void *Memory = 0;
+    CheckGoto(MallocMultiple(ArrayCount(Subbufs), Subbufs, &Memory), label_Error);
+    {
+        for(uint32_t I = 0; I < VertexCount; ++I) {
+            Remap[I] = UINT32_MAX;
+        }
+        uint32_t NextVertex = 0;
+        for(uint32_t I = 0; I < IndexCount; ++I) {
+            uint32_t Vertex = Indices[I];
+            if(Remap[Vertex] == UINT32_MAX) {
+                Remap[Vertex] = NextVertex++;
+            }
+            Indices[I] = Remap[Vertex];
+        }
+        for(uint32_t I = 0; I < VertexCount; ++I) {
+            if(Remap[I] == UINT32_MAX) {
+                Remap[I] = NextVertex++;
+            }
+            Reordered[Remap[I]] = Vertices[I];
+        }
+        memcpy(Vertices, Reordered, VertexCount*sizeof(vertex));
+    }
+    free(Memory);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookOptimizeMesh(cook_mesh *Mesh) {
+    uint32_t *ClusterStarts = (uint32_t *)malloc((size_t)Max(Mesh->IndexCount/3, 1)*sizeof(uint32_t));
+    AssertMessageGoto(ClusterStarts, label_Error, "Out of memory.\n");
+    CookPrintCacheStats("Before optimization", Mesh);
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        mesh_submesh *Submesh = Mesh->Submeshes + I;
+        uint32_t *Indices = Mesh->Indices + Submesh->IndexOffset;
+        vertex *Vertices = Mesh->Vertices + Submesh->VertexOffset;
+        uint32_t ClusterCount;
+        if(CookOptimizeVertexCache(Indices, Submesh->IndexCount, Submesh->VertexCount, ClusterStarts, &ClusterCount) ||
+           CookOptimizeOverdraw(Indices, Submesh->IndexCount, Vertices, ClusterStarts, ClusterCount) ||
+           CookOptimizeVertexFetch(Indices, Submesh->IndexCount, Vertices, Submesh->VertexCount)) {
+            free(ClusterStarts);
+            goto label_Error;
+        }
+    }
+    CookPrintCacheStats("After optimization", Mesh);
+    free(ClusterStarts);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+// MARK: Meshlets
+// NOTE(blackedout): Level 0 of every submesh is split into meshlets (see mesh_meshlet), which are culled individually at runtime.
+// Meshlets are grown greedily from the first remaining triangle in the optimized order, always adding the adjacent triangle that adds the
+// fewest new vertices, so they stay compact. Without an adjacent triangle (e.g. at seams), the next triangle in the optimized order is used.
+// The triangles are then stored meshlet by meshlet. Growing by fewest new vertices doesn't follow the Tipsify fans, so each meshlet's
+// triangles are run through Tipsify again (CookOptimizeMeshletVertexCache), otherwise splitting would undo most of the cache optimization.
+typedef struct {
+    uint32_t *TriangleOffsets;
+    uint32_t *Triangles;
+    uint32_t *VertexStamps; // NOTE(blackedout): Per vertex, meshlet index + 1 if the vertex is part of that meshlet
+    uint32_t *LocalVertices; // NOTE(blackedout): Per vertex, index into MeshletVertices, valid if the stamp matches
+    uint8_t *IsEmitted; // NOTE(blackedout): Per triangle
+    uint32_t *Result;
+} cook_meshlet_builder;
+
+static void CookFinishMeshlet(const vertex *Vertices, const uint32_t *Indices, const uint32_t *MeshletVertices, uint32_t VertexCount, mesh_meshlet *Meshlet) {
+    // NOTE(blackedout): Computes the bounding sphere and the normal cone, see Zeux 2016, "Meshoptimizer" (cone apex and cutoff).
+    mesh_bounds Bounds;
+    SetZero(Bounds);
+    Bounds.Min = Bounds.Max = Vertices[MeshletVertices[0]].Position;
+    for(uint32_t I = 1; I < VertexCount; ++I) {
+        for(uint32_t L = 0; L < 3; ++L) {
+            Bounds.Min.E[L] = Min(Bounds.Min.E[L], Vertices[MeshletVertices[I]].Position.E[L]);
+            Bounds.Max.E[L] = Max(Bounds.Max.E[L], Vertices[MeshletVertices[I]].Position.E[L]);
+        }
+    }
+    float RadiusSquared = 0.0f;
+    for(uint32_t L = 0; L < 3; ++L) {
+        Meshlet->Center.E[L] = 0.5f*(Bounds.Min.E[L] + Bounds.Max.E[L]);
+    }
+    for(uint32_t I = 0; I < VertexCount; ++I) {
+        v3 D = CookSubV3(Vertices[MeshletVertices[I]].Position, Meshlet->Center);
+        RadiusSquared = Max(RadiusSquared, D.E[0]*D.E[0] + D.E[1]*D.E[1] + D.E[2]*D.E[2]);
+    }
+    Meshlet->Radius = sqrtf(RadiusSquared);
+    Meshlet->VertexCount = VertexCount;
+
+    // NOTE(blackedout): Stored triangles are clockwise (see top of file), so the outward normal is (P2 - P0) x (P1 - P0).
+    v3 Normals[MESH_MESHLET_MAX_TRIANGLE_COUNT];
+    v3 Axis = {0};
+    uint32_t TriangleCount = Meshlet->IndexCount/3;
+    for(uint32_t I = 0; I < TriangleCount; ++I) {
+        const uint32_t *Corners = Indices + 3*I;
+        v3 P0 = Vertices[Corners[0]].Position, P1 = Vertices[Corners[1]].Position, P2 = Vertices[Corners[2]].Position;
+        v3 Normal = CookCrossV3(CookSubV3(P2, P0), CookSubV3(P1, P0));
+        float Length = sqrtf(Normal.E[0]*Normal.E[0] + Normal.E[1]*Normal.E[1] + Normal.E[2]*Normal.E[2]);
+        for(uint32_t L = 0; L < 3; ++L) {
+            Normals[I].E[L] = (Length > 0.0f)? Normal.E[L]/Length : 0.0f;
+            Axis.E[L] += Normals[I].E[L];
+        }
+    }
+    float AxisLength = sqrtf(Axis.E[0]*Axis.E[0] + Axis.E[1]*Axis.E[1] + Axis.E[2]*Axis.E[2]);
+    Meshlet->ConeApex = Meshlet->Center;
+    Meshlet->ConeCutoff = 2.0f;
+    if(AxisLength <= 0.0f) {
+        return;
+    }
+    for(uint32_t L = 0; L < 3; ++L) {
+        Meshlet->ConeAxis.E[L] = Axis.E[L]/AxisLength;
+    }
+    float MinDot = 1.0f;
+    for(uint32_t I = 0; I < TriangleCount; ++I) {
+        v3 N = Normals[I];
+        MinDot = Min(MinDot, N.E[0]*Meshlet->ConeAxis.E[0] + N.E[1]*Meshlet->ConeAxis.E[1] + N.E[2]*Meshlet->ConeAxis.E[2]);
+    }
+    if(MinDot <= 0.1f) {
+        // NOTE(blackedout): The normals span (almost) a hemisphere or more, so there is no view point from which all triangles face away.
+        return;
+    }
+
+    // NOTE(blackedout): Move the apex back along the axis until all triangle planes are in front of it
+    float MaxT = 0.0f;
+    for(uint32_t I = 0; I < TriangleCount; ++I) {
+        v3 N = Normals[I];
+        v3 D = CookSubV3(Meshlet->Center, Vertices[Indices[3*I]].Position);
+        float DistanceToPlane = D.E[0]*N.E[0] + D.E[1]*N.E[1] + D.E[2]*N.E[2];
+        float AxisDot = N.E[0]*Meshlet->ConeAxis.E[0] + N.E[1]*Meshlet->ConeAxis.E[1] + N.E[2]*Meshlet->ConeAxis.E[2];
+        MaxT = Max(MaxT, DistanceToPlane/AxisDot);
+    }
+    for(uint32_t L = 0; L < 3; ++L) {
+        Meshlet->ConeApex.E[L] = Meshlet->Center.E[L] - MaxT*Meshlet->ConeAxis.E[L];
+    }
+    Meshlet->ConeCutoff = sqrtf(1.0f - MinDot*MinDot);
+}
+
+static int CookOptimizeMeshletVertexCache(uint32_t *Indices, uint32_t IndexCount, const uint32_t *MeshletVertices, uint32_t MeshletVertexCount, const uint32_t *LocalVertices) {
+    // NOTE(blackedout): Tipsify works on the meshlet local vertex indices, so it only needs memory for the meshlet's vertices.
+    // The new order is only kept if it transforms fewer vertices than the one from growing the meshlet.
+    uint32_t Local[3*MESH_MESHLET_MAX_TRIANGLE_COUNT];
+    uint32_t ClusterStarts[MESH_MESHLET_MAX_TRIANGLE_COUNT];
+    uint32_t ClusterCount;
+    for(uint32_t I = 0; I < IndexCount; ++I) {
+        Local[I] = LocalVertices[Indices[I]];
+    }
+    uint32_t MissCount = CookCountCacheMisses(Local, IndexCount);
+    CheckGoto(CookOptimizeVertexCache(Local, IndexCount, MeshletVertexCount, ClusterStarts, &ClusterCount), label_Error);
+    if(CookCountCacheMisses(Local, IndexCount) < MissCount) {
+        for(uint32_t I = 0; I < IndexCount; ++I) {
+            Indices[I] = MeshletVertices[Local[I]];
+        }
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookBuildSubmeshMeshlets(cook_mesh *Mesh, mesh_submesh *Submesh) {
+    const vertex *Vertices = Mesh->Vertices + Submesh->VertexOffset;
+    uint32_t *Indices = Mesh->Indices + Submesh->IndexOffset;
+    uint32_t IndexCount = Submesh->IndexCount;
+    uint32_t VertexCount = Submesh->VertexCount;
+    uint32_t TriangleCount = IndexCount/3;
+    Submesh->MeshletOffset = Mesh->MeshletCount;
+    Submesh->MeshletCount = 0;
+
+    cook_meshlet_builder B;
+    SetZero(B);
+    malloc_multiple_subbuf Subbufs[] = {
+        { &B.TriangleOffsets, (VertexCount + 1)*sizeof(uint32_t) },
+        { &B.Triangles, IndexCount*sizeof(uint32_t) },
+        { &B.VertexStamps, VertexCount*sizeof(uint32_t) },
+        { &B.LocalVertices, VertexCount*sizeof(uint32_t) },
+        { &B.Result, IndexCount*sizeof(uint32_t) },
+        { &B.IsEmitted, TriangleCount*sizeof(uint8_t) },
+    };
+    void *Memory = 0;
+    CheckGoto(MallocMultiple(ArrayCount(Subbufs), Subbufs, &Memory), label_Error);
+    {
+        memset(B.TriangleOffsets, 0, (VertexCount + 1)*sizeof(uint32_t));
+        memset(B.VertexStamps, 0, VertexCount*sizeof(uint32_t));
+        memset(B.IsEmitted, 0, TriangleCount*sizeof(uint8_t));
+        for(uint32_t I = 0; I < IndexCount; ++I) {
+            ++B.TriangleOffsets[Indices[I] + 1];
+        }
+        for(uint32_t I = 0; I < VertexCount; ++I) {
+            B.TriangleOffsets[I + 1] += B.TriangleOffsets[I];
+        }
+        for(uint32_t I = 0; I < IndexCount; ++I) {
+            B.Triangles[B.TriangleOffsets[Indices[I]]++] = I/3;
+        }
+        for(uint32_t I = VertexCount; I > 0; --I) {
+            B.TriangleOffsets[I] = B.TriangleOffsets[I - 1];
+        }
+        B.TriangleOffsets[0] = 0;
+
+        uint32_t Cursor = 0;
+        uint32_t ResultCount = 0;
+        uint32_t MeshletVertices[MESH_MESHLET_MAX_VERTEX_COUNT];
+        while(ResultCount < IndexCount) {
+            uint32_t Stamp = Submesh->MeshletCount + 1;
+            uint32_t MeshletVertexCount = 0;
+            uint32_t MeshletTriangleCount = 0;
+            uint32_t MeshletStart = ResultCount;
+            for(;;) {
+                uint32_t Best = UINT32_MAX, BestNewCount = 4;
+                for(uint32_t I = 0; I < MeshletVertexCount && BestNewCount > 0; ++I) {
+                    uint32_t Vertex = MeshletVertices[I];
+                    for(uint32_t J = B.TriangleOffsets[Vertex]; J < B.TriangleOffsets[Vertex + 1]; ++J) {
+                        uint32_t Triangle = B.Triangles[J];
+                        if(B.IsEmitted[Triangle]) {
+                            continue;
+                        }
+                        const uint32_t *Corners = Indices + 3*Triangle;
+                        uint32_t NewCount = (B.VertexStamps[Corners[0]] != Stamp) + (B.VertexStamps[Corners[1]] != Stamp) + (B.VertexStamps[Corners[2]] != Stamp);
+                        if(NewCount < BestNewCount || (NewCount == BestNewCount && Triangle < Best)) {
+                            Best = Triangle;
+                            BestNewCount = NewCount;
+                        }
+                    }
+                }
+                if(Best == UINT32_MAX) {
+                    while(Cursor < TriangleCount && B.IsEmitted[Cursor]) {
+                        ++Cursor;
+                    }
+                    if(Cursor == TriangleCount) {
+                        break;
+                    }
+                    Best = Cursor;
+                    const uint32_t *Corners = Indices + 3*Best;
+                    BestNewCount = (B.VertexStamps[Corners[0]] != Stamp) + (B.VertexStamps[Corners[1]] != Stamp) + (B.VertexStamps[Corners[2]] != Stamp);
+                }
+                if(MeshletVertexCount + BestNewCount > MESH_MESHLET_MAX_VERTEX_COUNT || MeshletTriangleCount == MESH_MESHLET_MAX_TRIANGLE_COUNT) {
+                    break;
+                }
+
+                const uint32_t *Corners = Indices + 3*Best;
+                for(uint32_t J = 0; J < 3; ++J) {
+                    if(B.VertexStamps[Corners[J]] != Stamp) {
+                        B.VertexStamps[Corners[J]] = Stamp;
+                        B.LocalVertices[Corners[J]] = MeshletVertexCount;
+                        MeshletVertices[MeshletVertexCount++] = Corners[J];
+                    }
+                    B.Result[ResultCount++] = Corners[J];
+                }
+                B.IsEmitted[Best] = 1;
+                ++MeshletTriangleCount;
+            }
+
+            if(CookOptimizeMeshletVertexCache(B.Result + MeshletStart, ResultCount - MeshletStart, MeshletVertices, MeshletVertexCount, B.LocalVertices) ||
+               CookGrow((void **)&Mesh->Meshlets, &Mesh->MeshletCapacity, Mesh->MeshletCount + 1, sizeof(mesh_meshlet))) {
+                free(Memory);
+                goto label_Error;
+            }
+            mesh_meshlet *Meshlet = Mesh->Meshlets + Mesh->MeshletCount++;
+            SetZero(*Meshlet);
+            Meshlet->IndexOffset = Submesh->IndexOffset + MeshletStart;
+            Meshlet->IndexCount = ResultCount - MeshletStart;
+            Meshlet->VertexOffset = Submesh->VertexOffset;
+            CookFinishMeshlet(Vertices, B.Result + MeshletStart, MeshletVertices, MeshletVertexCount, Meshlet);
+            ++Submesh->MeshletCount;
+        }
+        memcpy(Indices, B.Result, IndexCount*sizeof(uint32_t));
+    }
+    free(Memory);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookBuildMeshlets(cook_mesh *Mesh) {
+    // NOTE(blackedout): Must run before the levels of detail are generated, because it reorders level 0 triangles.
+    uint32_t ConeCount = 0;
+    uint64_t VertexCount = 0;
+    uint64_t MissCountBefore = CookCountMeshCacheMisses(Mesh);
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        CheckGoto(CookBuildSubmeshMeshlets(Mesh, Mesh->Submeshes + I), label_Error);
+    }
+    for(uint32_t I = 0; I < Mesh->MeshletCount; ++I) {
+        ConeCount += Mesh->Meshlets[I].ConeCutoff <= 1.0f;
+        VertexCount += Mesh->Meshlets[I].VertexCount;
+    }
+    printf("Meshlets: %d, %.1f triangles and %.1f vertices on average, %d can be back face culled.\n", Mesh->MeshletCount,
+           (double)Mesh->IndexCount/(3.0*Mesh->MeshletCount), (double)VertexCount/Mesh->MeshletCount, ConeCount);
+    CookPrintCacheStats("After meshlets", Mesh);
+    // NOTE(blackedout): Vertices on meshlet borders are transformed once per meshlet, so some loss against the optimized order is expected
+    uint64_t MissCountAfter = CookCountMeshCacheMisses(Mesh);
+    double TriangleCount = (double)Max(Mesh->IndexCount/3, 1);
+    printf("Meshlets change ACMR from %.3f to %.3f (%+.1f%%).\n", MissCountBefore/TriangleCount, MissCountAfter/TriangleCount,
+           100.0*((double)MissCountAfter - (double)MissCountBefore)/Max((double)MissCountBefore, 1.0));
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+// MARK: OBJ
+// NOTE(blackedout): Vertices are deduplicated per submesh by their position/texcoord/normal index triple.
+typedef struct {
+    int32_t Key[3];
+    uint32_t Vertex;
+} cook_obj_vertex_slot;
+
+typedef struct {
+    uint32_t Count;
+    uint32_t Capacity; // NOTE(blackedout): Power of two, 0 if not allocated
+    cook_obj_vertex_slot *Slots;
+} cook_obj_vertex_map;
+
+static uint64_t CookObjHashKey(const int32_t *Key) {
+    return HashBytesFNV1a(Key, 3*sizeof(int32_t), HASH_FNV1A_BASIS);
+}
+
+static int CookObjFindOrAddVertex(cook_obj_vertex_map *Map, const int32_t *Key, uint32_t NewVertex, uint32_t *OutVertex, int *OutIsNew) {
+    if(2*(Map->Count + 1) > Map->Capacity) {
+        // NOTE(blackedout): Keep the load factor below one half, reinsert everything into the larger table.
+        uint32_t NewCapacity = Max(Map->Capacity*2, 1024);
+        cook_obj_vertex_slot *NewSlots = (cook_obj_vertex_slot *)malloc((size_t)NewCapacity*sizeof(cook_obj_vertex_slot));
+        AssertMessageGoto(NewSlots, label_Error, "Out of memory.\n");
+        for(uint32_t I = 0; I < NewCapacity; ++I) {
+            NewSlots[I].Vertex = UINT32_MAX;
+        }
+        for(uint32_t I = 0; I < Map->Capacity; ++I) {
+            cook_obj_vertex_slot Slot = Map->Slots[I];
+            if(Slot.Vertex != UINT32_MAX) {
+                uint64_t Index = CookObjHashKey(Slot.Key);
+                while(NewSlots[Index & (NewCapacity - 1)].Vertex != UINT32_MAX) {
+                    ++Index;
+                }
+                NewSlots[Index & (NewCapacity - 1)] = Slot;
+            }
+        }
+        free(Map->Slots);
+        Map->Slots = NewSlots;
+        Map->Capacity = NewCapacity;
+    }
+
+    uint64_t Index = CookObjHashKey(Key);
+    for(;; ++Index) {
+        cook_obj_vertex_slot *Slot = Map->Slots + (Index & (Map->Capacity - 1));
+        if(Slot->Vertex == UINT32_MAX) {
+            memcpy(Slot->Key, Key, sizeof(Slot->Key));
+            Slot->Vertex = NewVertex;
+            ++Map->Count;
+            *OutVertex = NewVertex;
+            *OutIsNew = 1;
+            return 0;
+        }
+        if(memcmp(Slot->Key, Key, sizeof(Slot->Key)) == 0) {
+            *OutVertex = Slot->Vertex;
+            *OutIsNew = 0;
+            return 0;
+        }
+    }
+
+label_Error:
+    return 1;
+}
+
+static void CookObjClearVertexMap(cook_obj_vertex_map *Map) {
+    for(uint32_t I = 0; I < Map->Capacity; ++I) {
+        Map->Slots[I].Vertex = UINT32_MAX;
+    }
+    Map->Count = 0;
+}
+
+static const char *CookSkipSpaces(const char *At) {
+    while(*At == ' ' || *At == '\t') {
+        ++At;
+    }
+    return At;
+}
+
+static int CookObjResolveIndex(long Index, uint32_t Count, int32_t *OutIndex) {
+    // NOTE(blackedout): OBJ indices start at 1, negative ones are relative to the end. 0 is used for "not present" here.
+    long Resolved = (Index < 0)? ((long)Count + Index + 1) : Index;
+    AssertMessageGoto(Resolved >= 1 && Resolved <= (long)Count, label_Error, "OBJ index %ld is out of range.\n", Index);
+    *OutIndex = (int32_t)Resolved;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookLoadObj(const char *Filepath, cook_mesh *Mesh) {
+    int Result = 1;
+    uint8_t *FileBytes = 0;
+    uint64_t FileByteCount;
+    v3 *Positions = 0, *Normals = 0;
+    v2 *TexCoords = 0;
+    uint32_t PositionCount = 0, PositionCapacity = 0, NormalCount = 0, NormalCapacity = 0, TexCoordCount = 0, TexCoordCapacity = 0;
+    cook_obj_vertex_map VertexMap;
+    SetZero(VertexMap);
+    {
+        CheckGoto(LoadFileContentsCStd(Filepath, &FileBytes, &FileByteCount), label_Exit);
+        CheckGoto(CookBeginSubmesh(Mesh, "default", 7), label_Exit);
+
+        uint32_t LineNumber = 0;
+        for(const char *Line = (const char *)FileBytes; *Line;) {
+            const char *LineEnd = Line;
+            while(*LineEnd && *LineEnd != '\n') {
+                ++LineEnd;
+            }
+            ++LineNumber;
+            const char *At = CookSkipSpaces(Line);
+            uint32_t KeywordLength = 0;
+            while(At + KeywordLength < LineEnd && At[KeywordLength] != ' ' && At[KeywordLength] != '\t' && At[KeywordLength] != '\r') {
+                ++KeywordLength;
+            }
+            const char *Arguments = CookSkipSpaces(At + KeywordLength);
+
+            if(KeywordLength == 1 && At[0] == 'v') {
+                v3 Position;
+                SetZero(Position);
+                char *End = (char *)Arguments;
+                for(uint32_t I = 0; I < 3; ++I) {
+                    Position.E[I] = strtof(End, &End);
+                }
+                CheckGoto(CookGrow((void **)&Positions, &PositionCapacity, PositionCount + 1, sizeof(v3)), label_Exit);
+                Positions[PositionCount++] = Position;
+            } else if(KeywordLength == 2 && At[0] == 'v' && At[1] == 'n') {
+                v3 Normal;
+                SetZero(Normal);
+                char *End = (char *)Arguments;
+                for(uint32_t I = 0; I < 3; ++I) {
+                    Normal.E[I] = strtof(End, &End);
+                }
+                CheckGoto(CookGrow((void **)&Normals, &NormalCapacity, NormalCount + 1, sizeof(v3)), label_Exit);
+                Normals[NormalCount++] = Normal;
+            } else if(KeywordLength == 2 && At[0] == 'v' && At[1] == 't') {
+                v2 TexCoord;
+                SetZero(TexCoord);
+                char *End = (char *)Arguments;
+                TexCoord.E[0] = strtof(End, &End);
+                TexCoord.E[1] = 1.0f - strtof(End, &End);
+                CheckGoto(CookGrow((void **)&TexCoords, &TexCoordCapacity, TexCoordCount + 1, sizeof(v2)), label_Exit);
+                TexCoords[TexCoordCount++] = TexCoord;
+            } else if(KeywordLength == 1 && At[0] == 'f') {
+                // NOTE(blackedout): Polygons are triangulated as fans around their first corner.
+                uint32_t CornerCount = 0;
+                uint32_t FirstVertex = 0, PreviousVertex = 0;
+                const char *Corner = Arguments;
+                while(Corner < LineEnd && *Corner != '\r') {
+                    int32_t Key[3] = { 0, 0, 0 };
+                    char *End = (char *)Corner;
+                    CheckGoto(CookObjResolveIndex(strtol(Corner, &End, 10), PositionCount, Key + 0), label_Exit);
+                    AssertMessageGoto(End != Corner, label_Exit, "%s:%d: Invalid face.\n", Filepath, LineNumber);
+                    if(*End == '/') {
+                        ++End;
+                        if(*End != '/') {
+                            CheckGoto(CookObjResolveIndex(strtol(End, &End, 10), TexCoordCount, Key + 1), label_Exit);
+                        }
+                        if(*End == '/') {
+                            ++End;
+                            CheckGoto(CookObjResolveIndex(strtol(End, &End, 10), NormalCount, Key + 2), label_Exit);
+                        }
+                    }
+
+                    uint32_t Vertex;
+                    int IsNew;
+                    mesh_submesh *Submesh = Mesh->Submeshes + Mesh->SubmeshCount - 1;
+                    CheckGoto(CookObjFindOrAddVertex(&VertexMap, Key, Submesh->VertexCount, &Vertex, &IsNew), label_Exit);
+                    if(IsNew) {
+                        vertex NewVertex;
+                        SetZero(NewVertex);
+                        NewVertex.Position = Positions[Key[0] - 1];
+                        if(Key[1]) {
+                            NewVertex.TexCoord = TexCoords[Key[1] - 1];
+                        }
+                        if(Key[2]) {
+                            NewVertex.Normal = Normals[Key[2] - 1];
+                        }
+                        CheckGoto(CookPushVertex(Mesh, NewVertex, Key[2] != 0), label_Exit);
+                    }
+
+                    if(CornerCount == 0) {
+                        FirstVertex = Vertex;
+                    } else if(CornerCount >= 2) {
+                        CheckGoto(CookPushTriangle(Mesh, FirstVertex, PreviousVertex, Vertex), label_Exit);
+                    }
+                    PreviousVertex = Vertex;
+                    ++CornerCount;
+                    Corner = CookSkipSpaces(End);
+                }
+                AssertMessageGoto(CornerCount >= 3, label_Exit, "%s:%d: Face with less than three corners.\n", Filepath, LineNumber);
+            } else if((KeywordLength == 1 && (At[0] == 'o' || At[0] == 'g')) || (KeywordLength == 6 && strncmp(At, "usemtl", 6) == 0)) {
+                uint32_t NameLength = 0;
+                while(Arguments + NameLength < LineEnd && Arguments[NameLength] != '\r') {
+                    ++NameLength;
+                }
+                mesh_submesh *Submesh = Mesh->Submeshes + Mesh->SubmeshCount - 1;
+                if(Submesh->IndexCount > 0) {
+                    CheckGoto(CookBeginSubmesh(Mesh, Arguments, NameLength), label_Exit);
+                    CookObjClearVertexMap(&VertexMap);
+                } else {
+                    // NOTE(blackedout): Nothing was added to the current submesh yet, so it is just renamed.
+                    memset(Submesh->Name, 0, sizeof(Submesh->Name));
+                    memcpy(Submesh->Name, Arguments, Min(NameLength, MESH_MAX_NAME_LENGTH - 1));
+                }
+            }
+
+            Line = *LineEnd? LineEnd + 1 : LineEnd;
+        }
+    }
+    Result = 0;
+
+label_Exit:
+    free(VertexMap.Slots);
+    free(Positions);
+    free(Normals);
+    free(TexCoords);
+    free(FileBytes);
+    return Result;
+}
+
+// MARK: JSON
+// NOTE(blackedout): Minimal JSON parser for glTF. Values are stored as a flat token array in document order, each token knows where its
+// subtree ends, which is where its next sibling starts. String escapes are not decoded, glTF only needs them for names and URIs.
+typedef enum {
+    JSON_NULL,
+    JSON_FALSE,
+    JSON_TRUE,
+    JSON_NUMBER,
+    JSON_STRING,
+    JSON_ARRAY,
+    JSON_OBJECT,
+} json_type;
+
+typedef struct {
+    json_type Type;
+    const char *Start;
+    uint32_t Length;
+    uint32_t ChildCount; // NOTE(blackedout): Objects count keys and values
+    uint32_t End;
+} json_token;
+
+typedef struct {
+    const char *At;
+    const char *End;
+    uint32_t TokenCount;
+    uint32_t TokenCapacity;
+    json_token *Tokens;
+} json_parser;
+
+static void JsonSkipWhitespace(json_parser *Parser) {
+    while(Parser->At < Parser->End && (*Parser->At == ' ' || *Parser->At == '\t' || *Parser->At == '\n' || *Parser->At == '\r')) {
+        ++Parser->At;
+    }
+}
+
+static int JsonParseValue(json_parser *Parser, uint32_t Depth) {
+    JsonSkipWhitespace(Parser);
+    AssertMessageGoto(Parser->At < Parser->End && Depth < 64, label_Error, "JSON ended unexpectedly or is nested too deeply.\n");
+    CheckGoto(CookGrow((void **)&Parser->Tokens, &Parser->TokenCapacity, Parser->TokenCount + 1, sizeof(json_token)), label_Error);
+    uint32_t Index = Parser->TokenCount++;
+    json_token Token;
+    SetZero(Token);
+    Token.Start = Parser->At;
+
+    char First = *Parser->At;
+    if(First == '{' || First == '[') {
+        Token.Type = (First == '{')? JSON_OBJECT : JSON_ARRAY;
+        char Close = (First == '{')? '}' : ']';
+        ++Parser->At;
+        JsonSkipWhitespace(Parser);
+        if(Parser->At < Parser->End && *Parser->At == Close) {
+            ++Parser->At;
+        } else {
+            for(;;) {
+                if(Token.Type == JSON_OBJECT) {
+                    JsonSkipWhitespace(Parser);
+                    AssertMessageGoto(Parser->At < Parser->End && *Parser->At == '"', label_Error, "JSON object key expected.\n");
+                    CheckGoto(JsonParseValue(Parser, Depth + 1), label_Error);
+                    JsonSkipWhitespace(Parser);
+                    AssertMessageGoto(Parser->At < Parser->End && *Parser->At == ':', label_Error, "JSON ':' expected.\n");
+                    ++Parser->At;
+                    ++Token.ChildCount;
+                }
+                CheckGoto(JsonParseValue(Parser, Depth + 1), label_Error);
+                ++Token.ChildCount;
+                JsonSkipWhitespace(Parser);
+                AssertMessageGoto(Parser->At < Parser->End, label_Error, "JSON ended unexpectedly.\n");
+                if(*Parser->At == ',') {
+                    ++Parser->At;
+                    continue;
+                }
+                AssertMessageGoto(*Parser->At == Close, label_Error, "JSON '%c' expected.\n", Close);
+                ++Parser->At;
+                break;
+            }
+        }
+    } else if(First == '"') {
+        Token.Type = JSON_STRING;
+        ++Parser->At;
+        Token.Start = Parser->At;
+        while(Parser->At < Parser->End && *Parser->At != '"') {
+            Parser->At += (*Parser->At == '\\')? 2 : 1;
+        }
+        AssertMessageGoto(Parser->At < Parser->End, label_Error, "JSON string is not terminated.\n");
+        Token.Length = (uint32_t)(Parser->At - Token.Start);
+        ++Parser->At;
+    } else if(First == '-' || (First >= '0' && First <= '9')) {
+        Token.Type = JSON_NUMBER;
+        while(Parser->At < Parser->End && strchr("+-0123456789.eE", *Parser->At)) {
+            ++Parser->At;
+        }
+    } else if(Parser->End - Parser->At >= 4 && strncmp(Parser->At, "true", 4) == 0) {
+        Token.Type = JSON_TRUE;
+        Parser->At += 4;
+    } else if(Parser->End - Parser->At >= 5 && strncmp(Parser->At, "false", 5) == 0) {
+        Token.Type = JSON_FALSE;
+        Parser->At += 5;
+    } else if(Parser->End - Parser->At >= 4 && strncmp(Parser->At, "null", 4) == 0) {
+        Token.Type = JSON_NULL;
+        Parser->At += 4;
+    } else {
+        printfc(CODE_RED, "Unexpected character '%c' in JSON.\n", First);
+        goto label_Error;
+    }
+
+    if(Token.Type != JSON_STRING) {
+        Token.Length = (uint32_t)(Parser->At - Token.Start);
+    }
+    Token.End = Parser->TokenCount;
+    Parser->Tokens[Index] = Token;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static uint32_t JsonGet(json_token *Tokens, uint32_t Object, const char *Key) {
+    // NOTE(blackedout): Returns the value for the key, 0 if there is none (the root can never be a value).
+    if(Object == 0 && Tokens[0].Type != JSON_OBJECT) {
+        return 0;
+    }
+    if(Tokens[Object].Type != JSON_OBJECT) {
+        return 0;
+    }
+    size_t KeyLength = strlen(Key);
+    uint32_t Child = Object + 1;
+    for(uint32_t I = 0; I + 1 < Tokens[Object].ChildCount; I += 2) {
+        uint32_t Value = Tokens[Child].End;
+        if(Tokens[Child].Length == KeyLength && strncmp(Tokens[Child].Start, Key, KeyLength) == 0) {
+            return Value;
+        }
+        Child = Tokens[Value].End;
+    }
+    return 0;
+}
+
+static uint32_t JsonAt(json_token *Tokens, uint32_t Array, uint32_t ElementIndex) {
+    if(Array == 0 || Tokens[Array].Type != JSON_ARRAY || ElementIndex >= Tokens[Array].ChildCount) {
+        return 0;
+    }
+    uint32_t Child = Array + 1;
+    for(uint32_t I = 0; I < ElementIndex; ++I) {
+        Child = Tokens[Child].End;
+    }
+    return Child;
+}
+
+static double JsonNumber(json_token *Tokens, uint32_t Token, double Default) {
+    if(Token == 0 || Tokens[Token].Type != JSON_NUMBER) {
+        return Default;
+    }
+    char Buffer[64];
+    uint32_t Length = Min(Tokens[Token].Length, (uint32_t)sizeof(Buffer) - 1);
+    memcpy(Buffer, Tokens[Token].Start, Length);
+    Buffer[Length] = 0;
+    return strtod(Buffer, 0);
+}
+
+static int JsonStringEquals(json_token *Tokens, uint32_t Token, const char *String) {
+    return Token && Tokens[Token].Type == JSON_STRING && Tokens[Token].Length == strlen(String) && strncmp(Tokens[Token].Start, String, Tokens[Token].Length) == 0;
+}
+
+// MARK: glTF
+#define GLTF_MAX_BUFFER_COUNT 64
+
+enum {
+    GLTF_COMPONENT_UNSIGNED_BYTE = 5121,
+    GLTF_COMPONENT_UNSIGNED_SHORT = 5123,
+    GLTF_COMPONENT_UNSIGNED_INT = 5125,
+    GLTF_COMPONENT_FLOAT = 5126,
+};
+
+typedef struct {
+    const uint8_t *Bytes;
+    uint64_t ByteCount;
+} gltf_buffer;
+
+typedef struct {
+    json_token *Tokens;
+    uint32_t BufferCount;
+    gltf_buffer Buffers[GLTF_MAX_BUFFER_COUNT];
+    uint8_t *OwnedBuffers[GLTF_MAX_BUFFER_COUNT]; // NOTE(blackedout): Loaded or decoded buffers that have to be freed
+} gltf_file;
+
+static int CookDecodeBase64(const char *Text, uint32_t Length, uint8_t **OutBytes, uint64_t *OutByteCount) {
+    uint8_t *Bytes = (uint8_t *)malloc((size_t)Length/4*3 + 3);
+    AssertMessageGoto(Bytes, label_Error, "Out of memory.\n");
+    uint64_t ByteCount = 0;
+    uint32_t Bits = 0, BitCount = 0;
+    for(uint32_t I = 0; I < Length && Text[I] != '='; ++I) {
+        char C = Text[I];
+        int Value = (C >= 'A' && C <= 'Z')? (C - 'A') : (C >= 'a' && C <= 'z')? (C - 'a' + 26) : (C >= '0' && C <= '9')? (C - '0' + 52) : (C == '+')? 62 : (C == '/')? 63 : -1;
+        if(Value < 0) {
+            free(Bytes);
+            printfc(CODE_RED, "Invalid base64 data.\n");
+            goto label_Error;
+        }
+        Bits = (Bits << 6) | (uint32_t)Value;
+        BitCount += 6;
+        if(BitCount >= 8) {
+            BitCount -= 8;
+            Bytes[ByteCount++] = (uint8_t)(Bits >> BitCount);
+        }
+    }
+    *OutBytes = Bytes;
+    *OutByteCount = ByteCount;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookLoadGltfBuffers(gltf_file *Gltf, const char *Filepath, const uint8_t *BinaryChunk, uint64_t BinaryChunkByteCount) {
+    json_token *Tokens = Gltf->Tokens;
+    uint32_t Buffers = JsonGet(Tokens, 0, "buffers");
+    uint32_t BufferCount = Buffers? Tokens[Buffers].ChildCount : 0;
+    AssertMessageGoto(BufferCount <= GLTF_MAX_BUFFER_COUNT, label_Error, "glTF has too many buffers (max %d).\n", GLTF_MAX_BUFFER_COUNT);
+
+    for(uint32_t I = 0; I < BufferCount; ++I) {
+        uint32_t Uri = JsonGet(Tokens, JsonAt(Tokens, Buffers, I), "uri");
+        gltf_buffer Buffer;
+        SetZero(Buffer);
+        if(Uri == 0) {
+            // NOTE(blackedout): Only the first buffer of a .glb file may omit the URI, it refers to the binary chunk.
+            AssertMessageGoto(I == 0 && BinaryChunk, label_Error, "glTF buffer %d has no URI.\n", I);
+            Buffer.Bytes = BinaryChunk;
+            Buffer.ByteCount = BinaryChunkByteCount;
+        } else {
+            json_token UriToken = Tokens[Uri];
+            uint8_t *Bytes = 0;
+            uint64_t ByteCount = 0;
+            const char *DataPrefix = "data:";
+            if(UriToken.Length > 5 && strncmp(UriToken.Start, DataPrefix, 5) == 0) {
+                const char *Comma = (const char *)memchr(UriToken.Start, ',', UriToken.Length);
+                AssertMessageGoto(Comma && Comma - UriToken.Start >= 7 && strncmp(Comma - 7, ";base64", 7) == 0, label_Error, "glTF buffer %d has an unsupported data URI.\n", I);
+                uint32_t Offset = (uint32_t)(Comma + 1 - UriToken.Start);
+                CheckGoto(CookDecodeBase64(Comma + 1, UriToken.Length - Offset, &Bytes, &ByteCount), label_Error);
+            } else {
+                // NOTE(blackedout): Relative to the directory of the glTF file, percent encoding is not supported.
+                char Path[1024];
+                const char *Slash = strrchr(Filepath, '/');
+                const char *Backslash = strrchr(Filepath, '\\');
+                if(Backslash > Slash) {
+                    Slash = Backslash;
+                }
+                int DirectoryLength = Slash? (int)(Slash + 1 - Filepath) : 0;
+                snprintf(Path, sizeof(Path), "%.*s%.*s", DirectoryLength, Filepath, (int)UriToken.Length, UriToken.Start);
+                CheckGoto(LoadFileContentsCStd(Path, &Bytes, &ByteCount), label_Error);
+            }
+            Gltf->OwnedBuffers[I] = Bytes;
+            Buffer.Bytes = Bytes;
+            Buffer.ByteCount = ByteCount;
+        }
+        Gltf->Buffers[I] = Buffer;
+        Gltf->BufferCount = I + 1;
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookGltfAccessor(gltf_file *Gltf, uint32_t AccessorIndex, uint32_t *OutCount, uint32_t *OutComponentType, uint32_t *OutComponentCount, int *OutIsNormalized,
+                            const uint8_t **OutBytes, uint64_t *OutStride) {
+    // NOTE(blackedout): Resolves an accessor into a pointer to its first element and the stride between elements, everything is bounds checked.
+    json_token *Tokens = Gltf->Tokens;
+    uint32_t Accessor = JsonAt(Tokens, JsonGet(Tokens, 0, "accessors"), AccessorIndex);
+    AssertMessageGoto(Accessor, label_Error, "glTF accessor %d doesn't exist.\n", AccessorIndex);
+    AssertMessageGoto(JsonGet(Tokens, Accessor, "sparse") == 0, label_Error, "glTF sparse accessors are not supported.\n");
+
+    uint32_t Count = (uint32_t)JsonNumber(Tokens, JsonGet(Tokens, Accessor, "count"), 0);
+    uint32_t ComponentType = (uint32_t)JsonNumber(Tokens, JsonGet(Tokens, Accessor, "componentType"), 0);
+    uint32_t Type = JsonGet(Tokens, Accessor, "type");
+    uint32_t ComponentCount = JsonStringEquals(Tokens, Type, "SCALAR")? 1 : JsonStringEquals(Tokens, Type, "VEC2")? 2 : JsonStringEquals(Tokens, Type, "VEC3")? 3 : JsonStringEquals(Tokens, Type, "VEC4")? 4 : 0;
+    uint32_t ComponentByteCount = (ComponentType == GLTF_COMPONENT_UNSIGNED_BYTE)? 1 : (ComponentType == GLTF_COMPONENT_UNSIGNED_SHORT)? 2 : (ComponentType == GLTF_COMPONENT_UNSIGNED_INT || ComponentType == GLTF_COMPONENT_FLOAT)? 4 : 0;
+    AssertMessageGoto(ComponentCount && ComponentByteCount, label_Error, "glTF accessor %d has an unsupported type.\n", AccessorIndex);
+
+    uint32_t BufferView = JsonAt(Tokens, JsonGet(Tokens, 0, "bufferViews"), (uint32_t)JsonNumber(Tokens, JsonGet(Tokens, Accessor, "bufferView"), -1));
+    AssertMessageGoto(BufferView, label_Error, "glTF accessor %d has no buffer view.\n", AccessorIndex);
+    uint32_t BufferIndex = (uint32_t)JsonNumber(Tokens, JsonGet(Tokens, BufferView, "buffer"), -1);
+    AssertMessageGoto(BufferIndex < Gltf->BufferCount, label_Error, "glTF buffer view refers to a missing buffer.\n");
+    gltf_buffer Buffer = Gltf->Buffers[BufferIndex];
+
+    uint64_t ElementByteCount = (uint64_t)ComponentCount*ComponentByteCount;
+    uint64_t ViewOffset = (uint64_t)JsonNumber(Tokens, JsonGet(Tokens, BufferView, "byteOffset"), 0);
+    uint64_t ViewByteCount = (uint64_t)JsonNumber(Tokens, JsonGet(Tokens, BufferView, "byteLength"), 0);
+    uint64_t Stride = (uint64_t)JsonNumber(Tokens, JsonGet(Tokens, BufferView, "byteStride"), (double)ElementByteCount);
+    uint64_t AccessorOffset = (uint64_t)JsonNumber(Tokens, JsonGet(Tokens, Accessor, "byteOffset"), 0);
+    uint64_t LastByte = AccessorOffset + (Count? (uint64_t)(Count - 1)*Stride + ElementByteCount : 0);
+    int IsInBounds = ViewOffset <= Buffer.ByteCount && ViewByteCount <= Buffer.ByteCount - ViewOffset && LastByte <= ViewByteCount && Stride >= ElementByteCount;
+    AssertMessageGoto(IsInBounds, label_Error, "glTF accessor %d is out of bounds.\n", AccessorIndex);
+
+    *OutCount = Count;
+    *OutComponentType = ComponentType;
+    *OutComponentCount = ComponentCount;
+    *OutIsNormalized = JsonGet(Tokens, Accessor, "normalized") && Tokens[JsonGet(Tokens, Accessor, "normalized")].Type == JSON_TRUE;
+    *OutBytes = Buffer.Bytes + ViewOffset + AccessorOffset;
+    *OutStride = Stride;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static float CookGltfComponent(const uint8_t *Element, uint32_t ComponentType, uint32_t ComponentIndex) {
+    // NOTE(blackedout): Integer components are only used by normalized attributes (texture coordinates) here.
+    switch(ComponentType) {
+    case GLTF_COMPONENT_FLOAT: {
+        float Value;
+        memcpy(&Value, Element + 4*ComponentIndex, sizeof(Value));
+        return Value;
+    }
+    case GLTF_COMPONENT_UNSIGNED_SHORT: {
+        uint16_t Value;
+        memcpy(&Value, Element + 2*ComponentIndex, sizeof(Value));
+        return (float)Value/65535.0f;
+    }
+    case GLTF_COMPONENT_UNSIGNED_BYTE:
+        return (float)Element[ComponentIndex]/255.0f;
+    default:
+        return 0.0f;
+    }
+}
+
+static int CookGltfAttribute(gltf_file *Gltf, uint32_t Attributes, const char *Name, uint32_t ComponentCount, uint32_t VertexCount, cook_mesh *Mesh, uint32_t FirstVertex, uint64_t MemberOffset) {
+    // NOTE(blackedout): Copies an attribute into the given vertex member, returns 0 without doing anything if the attribute doesn't exist.
+    uint32_t Attribute = JsonGet(Gltf->Tokens, Attributes, Name);
+    if(Attribute == 0) {
+        return 0;
+    }
+
+    uint32_t Count, ComponentType, AccessorComponentCount;
+    int IsNormalized;
+    const uint8_t *Bytes;
+    uint64_t Stride;
+    CheckGoto(CookGltfAccessor(Gltf, (uint32_t)JsonNumber(Gltf->Tokens, Attribute, -1), &Count, &ComponentType, &AccessorComponentCount, &IsNormalized, &Bytes, &Stride), label_Error);
+    int IsSupported = Count == VertexCount && AccessorComponentCount == ComponentCount && (ComponentType == GLTF_COMPONENT_FLOAT || IsNormalized);
+    AssertMessageGoto(IsSupported, label_Error, "glTF attribute %s has an unsupported format or count.\n", Name);
+
+    for(uint32_t I = 0; I < VertexCount; ++I) {
+        float *Member = (float *)((uint8_t *)(Mesh->Vertices + FirstVertex + I) + MemberOffset);
+        for(uint32_t J = 0; J < ComponentCount; ++J) {
+            Member[J] = CookGltfComponent(Bytes + I*Stride, ComponentType, J);
+        }
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int CookLoadGltf(const char *Filepath, cook_mesh *Mesh) {
+    int Result = 1;
+    uint8_t *FileBytes = 0;
+    uint64_t FileByteCount;
+    json_parser Parser;
+    SetZero(Parser);
+    gltf_file Gltf;
+    SetZero(Gltf);
+    {
+        CheckGoto(LoadFileContentsCStd(Filepath, &FileBytes, &FileByteCount), label_Exit);
+
+        // NOTE(blackedout): A .glb file is a 12 byte header followed by a JSON chunk and an optional binary chunk.
+        const char *Json = (const char *)FileBytes;
+        uint64_t JsonByteCount = FileByteCount;
+        const uint8_t *BinaryChunk = 0;
+        uint64_t BinaryChunkByteCount = 0;
+        if(FileByteCount >= 20 && memcmp(FileBytes, "glTF", 4) == 0) {
+            uint32_t ChunkHeader[2];
+            memcpy(ChunkHeader, FileBytes + 12, sizeof(ChunkHeader));
+            AssertMessageGoto(ChunkHeader[1] == 0x4e4f534a && 20 + (uint64_t)ChunkHeader[0] <= FileByteCount, label_Exit, "'%s' is not a valid binary glTF file.\n", Filepath);
+            Json = (const char *)FileBytes + 20;
+            JsonByteCount = ChunkHeader[0];
+            uint64_t BinaryOffset = 20 + AlignAny(JsonByteCount, uint64_t, 4);
+            if(BinaryOffset + 8 <= FileByteCount) {
+                memcpy(ChunkHeader, FileBytes + BinaryOffset, sizeof(ChunkHeader));
+                if(ChunkHeader[1] == 0x004e4942 && BinaryOffset + 8 + ChunkHeader[0] <= FileByteCount) {
+                    BinaryChunk = FileBytes + BinaryOffset + 8;
+                    BinaryChunkByteCount = ChunkHeader[0];
+                }
+            }
+        }
+
+        Parser.At = Json;
+        Parser.End = Json + JsonByteCount;
+        CheckGoto(JsonParseValue(&Parser, 0), label_Exit);
+        json_token *Tokens = Parser.Tokens;
+        Gltf.Tokens = Tokens;
+        CheckGoto(CookLoadGltfBuffers(&Gltf, Filepath, BinaryChunk, BinaryChunkByteCount), label_Exit);
+
+        uint32_t Meshes = JsonGet(Tokens, 0, "meshes");
+        uint32_t MeshCount = Meshes? Tokens[Meshes].ChildCount : 0;
+        for(uint32_t I = 0; I < MeshCount; ++I) {
+            uint32_t GltfMesh = JsonAt(Tokens, Meshes, I);
+            uint32_t Name = JsonGet(Tokens, GltfMesh, "name");
+            uint32_t Primitives = JsonGet(Tokens, GltfMesh, "primitives");
+            uint32_t PrimitiveCount = Primitives? Tokens[Primitives].ChildCount : 0;
+            for(uint32_t J = 0; J < PrimitiveCount; ++J) {
+                uint32_t Primitive = JsonAt(Tokens, Primitives, J);
+                uint32_t Mode = (uint32_t)JsonNumber(Tokens, JsonGet(Tokens, Primitive, "mode"), 4);
+                if(Mode != 4) {
+                    printfc(CODE_YELLOW, "Skipping glTF primitive %d of mesh %d, only triangle lists are supported.\n", J, I);
+                    continue;
+                }
+
+                uint32_t Attributes = JsonGet(Tokens, Primitive, "attributes");
+                uint32_t Position = JsonGet(Tokens, Attributes, "POSITION");
+                AssertMessageGoto(Position, label_Exit, "glTF primitive %d of mesh %d has no positions.\n", J, I);
+                uint32_t VertexCount, ComponentType, ComponentCount;
+                int IsNormalized;
+                const uint8_t *Bytes;
+                uint64_t Stride;
+                CheckGoto(CookGltfAccessor(&Gltf, (uint32_t)JsonNumber(Tokens, Position, -1), &VertexCount, &ComponentType, &ComponentCount, &IsNormalized, &Bytes, &Stride), label_Exit);
+
+                if(Name) {
+                    CheckGoto(CookBeginSubmesh(Mesh, Tokens[Name].Start, Tokens[Name].Length), label_Exit);
+                } else {
+                    CheckGoto(CookBeginSubmesh(Mesh, "mesh", 4), label_Exit);
+                }
+                uint32_t FirstVertex = Mesh->VertexCount;
+                int HasNormals = JsonGet(Tokens, Attributes, "NORMAL") != 0;
+                vertex ZeroVertex;
+                SetZero(ZeroVertex);
+                for(uint32_t K = 0; K < VertexCount; ++K) {
+                    CheckGoto(CookPushVertex(Mesh, ZeroVertex, HasNormals), label_Exit);
+                }
+                CheckGoto(CookGltfAttribute(&Gltf, Attributes, "POSITION", 3, VertexCount, Mesh, FirstVertex, offsetof(vertex, Position)), label_Exit);
+                CheckGoto(CookGltfAttribute(&Gltf, Attributes, "NORMAL", 3, VertexCount, Mesh, FirstVertex, offsetof(vertex, Normal)), label_Exit);
+                CheckGoto(CookGltfAttribute(&Gltf, Attributes, "TEXCOORD_0", 2, VertexCount, Mesh, FirstVertex, offsetof(vertex, TexCoord)), label_Exit);
+
+                uint32_t Indices = JsonGet(Tokens, Primitive, "indices");
+                if(Indices) {
+                    uint32_t IndexCount;
+                    CheckGoto(CookGltfAccessor(&Gltf, (uint32_t)JsonNumber(Tokens, Indices, -1), &IndexCount, &ComponentType, &ComponentCount, &IsNormalized, &Bytes, &Stride), label_Exit);
+                    AssertMessageGoto(ComponentCount == 1 && ComponentType != GLTF_COMPONENT_FLOAT, label_Exit, "glTF indices of primitive %d of mesh %d have an unsupported format.\n", J, I);
+                    for(uint32_t K = 0; K + 2 < IndexCount; K += 3) {
+                        uint32_t Triangle[3];
+                        for(uint32_t L = 0; L < 3; ++L) {
+                            const uint8_t *Element = Bytes + (K + L)*Stride;
+                            if(ComponentType == GLTF_COMPONENT_UNSIGNED_BYTE) {
+                                Triangle[L] = Element[0];
+                            } else if(ComponentType == GLTF_COMPONENT_UNSIGNED_SHORT) {
+                                uint16_t Index;
+                                memcpy(&Index, Element, sizeof(Index));
+                                Triangle[L] = Index;
+                            } else {
+                                memcpy(Triangle + L, Element, sizeof(uint32_t));
+                            }
+                            AssertMessageGoto(Triangle[L] < VertexCount, label_Exit, "glTF index out of range in primitive %d of mesh %d.\n", J, I);
+                        }
+                        CheckGoto(CookPushTriangle(Mesh, Triangle[0], Triangle[1], Triangle[2]), label_Exit);
+                    }
+                } else {
+                    for(uint32_t K = 0; K + 2 < VertexCount; K += 3) {
+                        CheckGoto(CookPushTriangle(Mesh, K, K + 1, K + 2), label_Exit);
+                    }
+                }
+            }
+        }
+    }
+    Result = 0;
+
+label_Exit:
+    for(uint32_t I = 0; I < Gltf.BufferCount; ++I) {
+        free(Gltf.OwnedBuffers[I]);
+    }
+    free(Parser.Tokens);
+    free(FileBytes);
+    return Result;
+}
+
+// MARK: Levels of Detail
+// NOTE(blackedout): Quadric error simplification (Garland, Heckbert 1997, "Surface Simplification Using Quadric Error Metrics") by collapsing
+// edges into one of their end points, so every level reuses the submesh's vertices. Vertices with the same position are treated as one
+// (their attributes differ at seams). Vertices on borders and attribute seams are never removed, which keeps silhouettes of open meshes and
+// texture seams intact. Collapses are done in passes over all edges sorted by cost, every vertex is part of at most one collapse per pass.
+#define COOK_LOD_MIN_TRIANGLE_COUNT 64 // NOTE(blackedout): Submeshes with fewer triangles only get a single level
+#define COOK_LOD_MIN_NORMAL_COS 0.25f // NOTE(blackedout): Collapses that rotate a triangle's normal by more than about 75 degrees are rejected
+#define COOK_LOD_MIN_REDUCTION 0.9f // NOTE(blackedout): A level is only kept if it has at most this fraction of the previous level's triangles
+
+typedef struct {
+    double E[10]; // NOTE(blackedout): Symmetric 4x4 matrix, upper triangle in row order
+    double Weight;
+} cook_quadric;
+
+typedef struct {
+    float Cost;
+    uint32_t From;
+    uint32_t To;
+} cook_collapse;
+
+static void CookAddPlaneQuadric(cook_quadric *Quadric, double A, double B, double C, double D, double Weight) {
+    double Plane[4] = { A, B, C, D };
+    uint32_t K = 0;
+    for(uint32_t I = 0; I < 4; ++I) {
+        for(uint32_t J = I; J < 4; ++J) {
+            Quadric->E[K++] += Weight*Plane[I]*Plane[J];
+        }
+    }
+    Quadric->Weight += Weight;
+}
+
+static double CookEvaluateQuadric(const cook_quadric *Quadric, v3 Position) {
+    double P[4] = { Position.E[0], Position.E[1], Position.E[2], 1.0 };
+    double Result = 0.0;
+    uint32_t K = 0;
+    for(uint32_t I = 0; I < 4; ++I) {
+        for(uint32_t J = I; J < 4; ++J) {
+            Result += ((I == J)? 1.0 : 2.0)*Quadric->E[K++]*P[I]*P[J];
+        }
+    }
+    return Result;
+}
+
+static float CookCollapseCost(const cook_quadric *Quadrics, const vertex *Vertices, uint32_t From, uint32_t To) {
+    // NOTE(blackedout): Area weighted mean squared distance of To's position to the planes of both vertices
+    cook_quadric Sum = Quadrics[From];
+    for(uint32_t I = 0; I < ArrayCount(Sum.E); ++I) {
+        Sum.E[I] += Quadrics[To].E[I];
+    }
+    double Cost = CookEvaluateQuadric(&Sum, Vertices[To].Position)/Max(Quadrics[From].Weight + Quadrics[To].Weight, 1e-30);
+    return (float)Max(Cost, 0.0);
+}
+
+static int CookCompareCollapses(const void *A, const void *B) {
+    float CostA = ((const cook_collapse *)A)->Cost, CostB = ((const cook_collapse *)B)->Cost;
+    return (CostA < CostB)? -1 : (CostA > CostB)? 1 : 0;
+}
+
+static int CookTryCollapse(uint32_t *Indices, uint8_t *IsRemoved, const uint32_t *TriangleOffsets, const uint32_t *Triangles, const uint32_t *Canonical, const vertex *Vertices,
+                           uint32_t From, uint32_t To, uint32_t *InOutTriangleCount) {
+    // NOTE(blackedout): From is a canonical vertex without seams, so it is the only vertex at its position. Returns 0 if the collapse was
+    // rejected because it would flip a triangle or because it is ambiguous which vertex at To's position the triangles should use.
+    uint32_t Target = UINT32_MAX;
+    for(uint32_t I = TriangleOffsets[From]; I < TriangleOffsets[From + 1]; ++I) {
+        uint32_t Triangle = Triangles[I];
+        if(IsRemoved[Triangle]) {
+            continue;
+        }
+        for(uint32_t J = 0; J < 3; ++J) {
+            uint32_t Vertex = Indices[3*Triangle + J];
+            if(Canonical[Vertex] == To) {
+                if(Target != UINT32_MAX && Target != Vertex) {
+                    return 0;
+                }
+                Target = Vertex;
+            }
+        }
+    }
+    if(Target == UINT32_MAX) {
+        return 0;
+    }
+
+    for(uint32_t I = TriangleOffsets[From]; I < TriangleOffsets[From + 1]; ++I) {
+        uint32_t Triangle = Triangles[I];
+        uint32_t *Corners = Indices + 3*Triangle;
+        if(IsRemoved[Triangle] || Canonical[Corners[0]] == To || Canonical[Corners[1]] == To || Canonical[Corners[2]] == To) {
+            continue;
+        }
+        v3 Before[3], After[3];
+        for(uint32_t J = 0; J < 3; ++J) {
+            Before[J] = Vertices[Corners[J]].Position;
+            After[J] = (Corners[J] == From)? Vertices[Target].Position : Before[J];
+        }
+        v3 NormalBefore = CookCrossV3(CookSubV3(Before[1], Before[0]), CookSubV3(Before[2], Before[0]));
+        v3 NormalAfter = CookCrossV3(CookSubV3(After[1], After[0]), CookSubV3(After[2], After[0]));
+        // NOTE(blackedout): Also rejects large rotations, because many small ones over several passes can flip a triangle too
+        float Dot = NormalBefore.E[0]*NormalAfter.E[0] + NormalBefore.E[1]*NormalAfter.E[1] + NormalBefore.E[2]*NormalAfter.E[2];
+        float LengthBefore = sqrtf(NormalBefore.E[0]*NormalBefore.E[0] + NormalBefore.E[1]*NormalBefore.E[1] + NormalBefore.E[2]*NormalBefore.E[2]);
+        float LengthAfter = sqrtf(NormalAfter.E[0]*NormalAfter.E[0] + NormalAfter.E[1]*NormalAfter.E[1] + NormalAfter.E[2]*NormalAfter.E[2]);
+        if(Dot <= COOK_LOD_MIN_NORMAL_COS*LengthBefore*LengthAfter) {
+            return 0;
+        }
+    }
+
+    for(uint32_t I = TriangleOffsets[From]; I < TriangleOffsets[From + 1]; ++I) {
+        uint32_t Triangle = Triangles[I];
+        uint32_t *Corners = Indices + 3*Triangle;
+        if(IsRemoved[Triangle]) {
+            continue;
+        }
+        if(Canonical[Corners[0]] == To || Canonical[Corners[1]] == To || Canonical[Corners[2]] == To) {
+            IsRemoved[Triangle] = 1;
+            --*InOutTriangleCount;
+            continue;
+        }
+        for(uint32_t J = 0; J < 3; ++J) {
+            if(Corners[J] == From) {
+                Corners[J] = Target;
+            }
+        }
+    }
+    return 1;
+}
+
+typedef struct {
+    uint32_t *Indices;
+    uint8_t *IsRemoved; // NOTE(blackedout): Per triangle
+    uint32_t *Canonical; // NOTE(blackedout): Per vertex, the first vertex with the same position
+    uint8_t *IsLocked; // NOTE(blackedout): Per vertex, border or seam vertices, only meaningful for canonical vertices
+    uint8_t *IsCollapsed; // NOTE(blackedout): Per vertex, part of a collapse in the current pass
+    uint32_t *TriangleOffsets;
+    uint32_t *Triangles;
+    cook_quadric *Quadrics;
+    cook_collapse *Collapses;
+    uint32_t *EdgeCounts; // NOTE(blackedout): Scratch for the border detection
+} cook_simplifier;
+
+static int CookGenerateLods(cook_mesh *Mesh, mesh_submesh *Submesh, uint32_t *ClusterStarts) {
+    const vertex *Vertices = Mesh->Vertices + Submesh->VertexOffset;
+    uint32_t VertexCount = Submesh->VertexCount;
+    uint32_t IndexCount = Submesh->IndexCount;
+    uint32_t TriangleCount = IndexCount/3;
+    if(TriangleCount < COOK_LOD_MIN_TRIANGLE_COUNT) {
+        return 0;
+    }
+
+    cook_simplifier S;
+    SetZero(S);
+    cook_obj_vertex_map PositionMap;
+    SetZero(PositionMap);
+    malloc_multiple_subbuf Subbufs[] = {
+        { &S.Indices, IndexCount*sizeof(uint32_t) },
+        { &S.Canonical, VertexCount*sizeof(uint32_t) },
+        { &S.TriangleOffsets, (VertexCount + 1)*sizeof(uint32_t) },
+        { &S.Triangles, IndexCount*sizeof(uint32_t) },
+        { &S.Quadrics, VertexCount*sizeof(cook_quadric) },
+        { &S.Collapses, 2*IndexCount*sizeof(cook_collapse) },
+        { &S.EdgeCounts, VertexCount*sizeof(uint32_t) },
+        { &S.IsRemoved, TriangleCount*sizeof(uint8_t) },
+        { &S.IsLocked, VertexCount*sizeof(uint8_t) },
+        { &S.IsCollapsed, VertexCount*sizeof(uint8_t) },
+    };
+    void *Memory = 0;
+    CheckGoto(MallocMultiple(ArrayCount(Subbufs), Subbufs, &Memory), label_Error);
+    {
+        memcpy(S.Indices, Mesh->Indices + Submesh->IndexOffset, IndexCount*sizeof(uint32_t));
+        memset(S.IsRemoved, 0, TriangleCount*sizeof(uint8_t));
+        memset(S.IsLocked, 0, VertexCount*sizeof(uint8_t));
+        memset(S.Quadrics, 0, VertexCount*sizeof(cook_quadric));
+
+        // NOTE(blackedout): Weld vertices by position, positions that are shared by multiple vertices are seams
+        for(uint32_t I = 0; I < VertexCount; ++I) {
+            // NOTE(blackedout): Adding zero turns -0 into 0, so both hash equally
+            float Position[3] = { Vertices[I].Position.E[0] + 0.0f, Vertices[I].Position.E[1] + 0.0f, Vertices[I].Position.E[2] + 0.0f };
+            int32_t Key[3];
+            memcpy(Key, Position, sizeof(Key));
+            int IsNew;
+            if(CookObjFindOrAddVertex(&PositionMap, Key, I, S.Canonical + I, &IsNew)) {
+                free(Memory);
+                goto label_Error;
+            }
+            if(!IsNew) {
+                S.IsLocked[S.Canonical[I]] = 1;
+            }
+        }
+        // NOTE(blackedout): Face quadrics, weighted by area
+        for(uint32_t I = 0; I < TriangleCount; ++I) {
+            uint32_t *Corners = S.Indices + 3*I;
+            v3 P0 = Vertices[Corners[0]].Position, P1 = Vertices[Corners[1]].Position, P2 = Vertices[Corners[2]].Position;
+            v3 Normal = CookCrossV3(CookSubV3(P1, P0), CookSubV3(P2, P0));
+            double Length = sqrt((double)Normal.E[0]*Normal.E[0] + (double)Normal.E[1]*Normal.E[1] + (double)Normal.E[2]*Normal.E[2]);
+            if(Length <= 0.0) {
+                continue;
+            }
+            double A = Normal.E[0]/Length, B = Normal.E[1]/Length, C = Normal.E[2]/Length;
+            double D = -(A*P0.E[0] + B*P0.E[1] + C*P0.E[2]);
+            for(uint32_t J = 0; J < 3; ++J) {
+                CookAddPlaneQuadric(S.Quadrics + S.Canonical[Corners[J]], A, B, C, D, 0.5*Length);
+            }
+        }
+
+        // NOTE(blackedout): Border vertices are on an edge that only one triangle uses. Edges are counted per canonical vertex pair by
+        // walking the triangles of the smaller vertex.
+        memset(S.TriangleOffsets, 0, (VertexCount + 1)*sizeof(uint32_t));
+        for(uint32_t I = 0; I < IndexCount; ++I) {
+            ++S.TriangleOffsets[S.Canonical[S.Indices[I]] + 1];
+        }
+        for(uint32_t I = 0; I < VertexCount; ++I) {
+            S.TriangleOffsets[I + 1] += S.TriangleOffsets[I];
+        }
+        memcpy(S.EdgeCounts, S.TriangleOffsets, VertexCount*sizeof(uint32_t));
+        for(uint32_t I = 0; I < IndexCount; ++I) {
+            S.Triangles[S.EdgeCounts[S.Canonical[S.Indices[I]]]++] = I/3;
+        }
+        for(uint32_t I = 0; I < IndexCount; ++I) {
+            uint32_t A = S.Canonical[S.Indices[I]];
+            uint32_t B = S.Canonical[S.Indices[3*(I/3) + (I + 1)%3]];
+            uint32_t UseCount = 0;
+            for(uint32_t J = S.TriangleOffsets[A]; J < S.TriangleOffsets[A + 1]; ++J) {
+                uint32_t *Corners = S.Indices + 3*S.Triangles[J];
+                UseCount += S.Canonical[Corners[0]] == B || S.Canonical[Corners[1]] == B || S.Canonical[Corners[2]] == B;
+            }
+            if(UseCount < 2) {
+                S.IsLocked[A] = 1;
+                S.IsLocked[B] = 1;
+            }
+        }
+
+        uint32_t CurrentCount = TriangleCount;
+        float MaxCost = 0.0f;
+        while(Submesh->LodCount < MESH_MAX_LOD_COUNT) {
+            uint32_t PreviousCount = Submesh->Lods[Submesh->LodCount - 1].IndexCount/3;
+            uint32_t TargetCount = PreviousCount/2;
+            while(CurrentCount > TargetCount) {
+                // NOTE(blackedout): One pass, triangles are only ever added to the lists of collapse targets, which are then excluded for
+                // the rest of the pass, so the adjacency of the vertices that can still collapse stays valid.
+                uint32_t CollapseCount = 0;
+                for(uint32_t I = 0; I < IndexCount; ++I) {
+                    if(S.IsRemoved[I/3]) {
+                        continue;
+                    }
+                    uint32_t A = S.Canonical[S.Indices[I]];
+                    uint32_t B = S.Canonical[S.Indices[3*(I/3) + (I + 1)%3]];
+                    if(A == B) {
+                        continue;
+                    }
+                    if(!S.IsLocked[A]) {
+                        cook_collapse Collapse = { CookCollapseCost(S.Quadrics, Vertices, A, B), A, B };
+                        S.Collapses[CollapseCount++] = Collapse;
+                    }
+                    if(!S.IsLocked[B]) {
+                        cook_collapse Collapse = { CookCollapseCost(S.Quadrics, Vertices, B, A), B, A };
+                        S.Collapses[CollapseCount++] = Collapse;
+                    }
+                }
+                qsort(S.Collapses, CollapseCount, sizeof(cook_collapse), CookCompareCollapses);
+
+                memset(S.IsCollapsed, 0, VertexCount*sizeof(uint8_t));
+                uint32_t AppliedCount = 0;
+                for(uint32_t I = 0; I < CollapseCount && CurrentCount > TargetCount; ++I) {
+                    cook_collapse Collapse = S.Collapses[I];
+                    if(S.IsCollapsed[Collapse.From] || S.IsCollapsed[Collapse.To]) {
+                        continue;
+                    }
+                    if(CookTryCollapse(S.Indices, S.IsRemoved, S.TriangleOffsets, S.Triangles, S.Canonical, Vertices, Collapse.From, Collapse.To, &CurrentCount)) {
+                        S.IsCollapsed[Collapse.From] = 1;
+                        S.IsCollapsed[Collapse.To] = 1;
+                        for(uint32_t J = 0; J < ArrayCount(S.Quadrics[0].E); ++J) {
+                            S.Quadrics[Collapse.To].E[J] += S.Quadrics[Collapse.From].E[J];
+                        }
+                        S.Quadrics[Collapse.To].Weight += S.Quadrics[Collapse.From].Weight;
+                        MaxCost = Max(MaxCost, Collapse.Cost);
+                        ++AppliedCount;
+                    }
+                }
+                if(AppliedCount == 0) {
+                    break;
+                }
+
+                // NOTE(blackedout): Rebuild the adjacency of the collapse targets for the next pass
+                memset(S.TriangleOffsets, 0, (VertexCount + 1)*sizeof(uint32_t));
+                for(uint32_t I = 0; I < IndexCount; ++I) {
+                    if(!S.IsRemoved[I/3]) {
+                        ++S.TriangleOffsets[S.Canonical[S.Indices[I]] + 1];
+                    }
+                }
+                for(uint32_t I = 0; I < VertexCount; ++I) {
+                    S.TriangleOffsets[I + 1] += S.TriangleOffsets[I];
+                }
+                memcpy(S.EdgeCounts, S.TriangleOffsets, VertexCount*sizeof(uint32_t));
+                for(uint32_t I = 0; I < IndexCount; ++I) {
+                    if(!S.IsRemoved[I/3]) {
+                        S.Triangles[S.EdgeCounts[S.Canonical[S.Indices[I]]]++] = I/3;
+                    }
+                }
+            }
+            if(CurrentCount == 0 || (float)CurrentCount > COOK_LOD_MIN_REDUCTION*PreviousCount) {
+                break;
+            }
+
+            // NOTE(blackedout): Append the level's remaining triangles to the index buffer, optimized for the vertex cache like level 0
+            uint32_t LodOffset = Mesh->IndexCount;
+            if(CookGrow((void **)&Mesh->Indices, &Mesh->IndexCapacity, Mesh->IndexCount + 3*CurrentCount, sizeof(uint32_t))) {
+                free(Memory);
+                goto label_Error;
+            }
+            uint32_t *LodIndices = Mesh->Indices + LodOffset;
+            uint32_t LodIndexCount = 0;
+            for(uint32_t I = 0; I < TriangleCount; ++I) {
+                if(!S.IsRemoved[I]) {
+                    memcpy(LodIndices + LodIndexCount, S.Indices + 3*I, 3*sizeof(uint32_t));
+                    LodIndexCount += 3;
+                }
+            }
+            uint32_t ClusterCount;
+            if(CookOptimizeVertexCache(LodIndices, LodIndexCount, VertexCount, ClusterStarts, &ClusterCount)) {
+                free(Memory);
+                goto label_Error;
+            }
+            Mesh->IndexCount += LodIndexCount;
+
+            mesh_lod Lod = { LodOffset, LodIndexCount, sqrtf(MaxCost) };
+            Submesh->Lods[Submesh->LodCount++] = Lod;
+        }
+    }
+    free(PositionMap.Slots);
+    free(Memory);
+    return 0;
+
+label_Error:
+    free(PositionMap.Slots);
+    return 1;
+}
+
+static int CookGenerateMeshLods(cook_mesh *Mesh) {
+    // NOTE(blackedout): Level 0 indices of all submeshes stay in front, the other levels are appended in submesh order.
+    uint32_t *ClusterStarts = (uint32_t *)malloc((size_t)Max(Mesh->IndexCount/3, 1)*sizeof(uint32_t));
+    AssertMessageGoto(ClusterStarts, label_Error, "Out of memory.\n");
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        mesh_submesh *Submesh = Mesh->Submeshes + I;
+        if(CookGenerateLods(Mesh, Submesh, ClusterStarts)) {
+            free(ClusterStarts);
+            goto label_Error;
+        }
+        printf("Submesh '%s':", Submesh->Name);
+        for(uint32_t J = 0; J < Submesh->LodCount; ++J) {
+            printf(" LOD %d %d triangles (error %g)%s", J, Submesh->Lods[J].IndexCount/3, Submesh->Lods[J].Error, (J + 1 < Submesh->LodCount)? "," : "\n");
+        }
+    }
+    free(ClusterStarts);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+// MARK: Main
+int main(int ArgumentCount, char **Arguments) {
+    int Result = 1;
+    cook_mesh Mesh;
+    SetZero(Mesh);
+    {
+        mesh_vertex_format VertexFormat = MESH_VERTEX_FORMAT_FLOAT;
+        int FirstPath = 1;
+        if(ArgumentCount == 4 && strcmp(Arguments[1], "-quantize") == 0) {
+            VertexFormat = MESH_VERTEX_FORMAT_QUANTIZED;
+            FirstPath = 2;
+        }
+        AssertMessageGoto(ArgumentCount == FirstPath + 2, label_Exit, "Usage: %s [-quantize] <input.obj|input.gltf|input.glb> <output.mesh>\n", Arguments[0]);
+        const char *InputPath = Arguments[FirstPath];
+        const char *OutputPath = Arguments[FirstPath + 1];
+        const char *Extension = strrchr(InputPath, '.');
+        Extension = Extension? Extension : "";
+        if(strcmp(Extension, ".obj") == 0) {
+            CheckGoto(CookLoadObj(InputPath, &Mesh), label_Exit);
+        } else if(strcmp(Extension, ".gltf") == 0 || strcmp(Extension, ".glb") == 0) {
+            CheckGoto(CookLoadGltf(InputPath, &Mesh), label_Exit);
+        } else {
+            printfc(CODE_RED, "Unsupported input file '%s', expected .obj, .gltf or .glb.\n", InputPath);
+            goto label_Exit;
+        }
+
+        CheckGoto(CookFinishMesh(&Mesh), label_Exit);
+        CheckGoto(CookOptimizeMesh(&Mesh), label_Exit);
+        CheckGoto(CookBuildMeshlets(&Mesh), label_Exit);
+        CheckGoto(CookGenerateMeshLods(&Mesh), label_Exit);
+        CheckGoto(CookWriteMesh(&Mesh, VertexFormat, OutputPath), label_Exit);
+        printf("Cooked '%s' into '%s': %d submeshes, %d vertices, %d indices.\n", InputPath, OutputPath, Mesh.SubmeshCount, Mesh.VertexCount, Mesh.IndexCount);
+    }
+    Result = 0;
+
+label_Exit:
+    CookDestroyMesh(&Mesh);
+    return Result;
+}
\ No newline at end of file
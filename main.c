@@ -31,6 +31,8 @@
 #include "GLFW/glfw3.h"
 
 #include "vulkan_helpers.c"
+#include "mesh.c"
+#include "texture.c"
 
 #include "program.c"
 
@@ -152,8 +154,9 @@ int main() {
 
             vulkan_acquired_image AcquiredImage;
             CheckGoto(VulkanAcquireNextImage(&VulkanSurfaceDevice, &VulkanSwapchainHandler, Context.FramebufferExtent, &AcquiredImage), label_IdleDestroyAndExit);
-            CheckGoto(ProgramRender(&Context.ProgramContext, &VulkanSurfaceDevice, AcquiredImage), label_IdleDestroyAndExit);
-            CheckGoto(VulkanSubmitFinalAndPresent(&VulkanSurfaceDevice, &VulkanSwapchainHandler, VulkanGraphicsQueue, GraphicsCommandBuffer, Context.FramebufferExtent), label_IdleDestroyAndExit);
+            vulkan_semaphore_wait AsyncComputeWait;
+            CheckGoto(ProgramRender(&Context.ProgramContext, &VulkanSurfaceDevice, AcquiredImage, &AsyncComputeWait), label_IdleDestroyAndExit);
+            CheckGoto(VulkanSubmitFinalAndPresent(&VulkanSurfaceDevice, &VulkanSwapchainHandler, VulkanGraphicsQueue, GraphicsCommandBuffer, AsyncComputeWait, Context.FramebufferExtent), label_IdleDestroyAndExit);
             
             //SleepMilliseconds(1000);
 
@@ -0,0 +1,277 @@
+// Original source in https://github.com/blackedout01/glfw-vk-template
+//
+// zlib License
+//
+// (C) 2024 blackedout01
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+// NOTE(blackedout): Vertex formats and the cooked mesh format. Shared by the program and the offline tools (cook.c), so it only depends on util.c.
+
+typedef struct {
+    v3 Position;
+    v3 Normal;
+    v2 TexCoord;
+} vertex;
+
+// NOTE(blackedout): Compressed vertex, half the size of vertex. Positions are R16G16B16A16_SNORM relative to the mesh's quantization
+// box (see mesh_header), normals are octahedral encoded R16G16_SNORM and texture coordinates are R16G16_SFLOAT.
+typedef struct {
+    int16_t Position[4]; // NOTE(blackedout): W is padding, three component 16 bit formats are rarely supported as vertex input
+    int16_t Normal[2];
+    uint16_t TexCoord[2];
+} vertex_quantized;
+
+typedef enum {
+    MESH_VERTEX_FORMAT_FLOAT, // NOTE(blackedout): vertex
+    MESH_VERTEX_FORMAT_QUANTIZED, // NOTE(blackedout): vertex_quantized
+
+    MESH_VERTEX_FORMAT_COUNT
+} mesh_vertex_format;
+
+static uint32_t MeshVertexByteCount(mesh_vertex_format Format) {
+    switch(Format) {
+    case MESH_VERTEX_FORMAT_FLOAT: return sizeof(vertex);
+    case MESH_VERTEX_FORMAT_QUANTIZED: return sizeof(vertex_quantized);
+    default: return 0;
+    }
+}
+
+static int16_t QuantizeSnorm16(float Value) {
+    float Clamped = Clamp(Value, -1.0f, 1.0f);
+    return (int16_t)floorf(Clamped*32767.0f + 0.5f);
+}
+
+static uint16_t FloatToHalf(float Value) {
+    // NOTE(blackedout): Rounds to nearest even, overflows to infinity and keeps NaNs.
+    uint32_t Bits;
+    memcpy(&Bits, &Value, sizeof(Bits));
+    uint32_t Sign = (Bits >> 16) & 0x8000;
+    uint32_t Exponent = (Bits >> 23) & 0xff;
+    uint32_t Mantissa = Bits & 0x7fffff;
+    if(Exponent == 0xff) {
+        return (uint16_t)(Sign | 0x7c00 | (Mantissa? 0x200 : 0));
+    }
+    int32_t HalfExponent = (int32_t)Exponent - 127 + 15;
+    if(HalfExponent >= 31) {
+        return (uint16_t)(Sign | 0x7c00);
+    }
+    if(HalfExponent <= 0) {
+        // NOTE(blackedout): Subnormal half (or zero), the implicit leading one is shifted into the mantissa
+        if(HalfExponent < -10) {
+            return (uint16_t)Sign;
+        }
+        Mantissa |= 0x800000;
+        uint32_t Shift = (uint32_t)(14 - HalfExponent);
+        uint32_t Half = Mantissa >> Shift;
+        uint32_t Remainder = Mantissa & ((1u << Shift) - 1);
+        uint32_t HalfwayPoint = 1u << (Shift - 1);
+        if(Remainder > HalfwayPoint || (Remainder == HalfwayPoint && (Half & 1))) {
+            ++Half;
+        }
+        return (uint16_t)(Sign | Half);
+    }
+    uint32_t Half = ((uint32_t)HalfExponent << 10) | (Mantissa >> 13);
+    uint32_t Remainder = Mantissa & 0x1fff;
+    if(Remainder > 0x1000 || (Remainder == 0x1000 && (Half & 1))) {
+        ++Half; // NOTE(blackedout): May carry into the exponent, which correctly rounds up to the next power of two or infinity
+    }
+    return (uint16_t)(Sign | Half);
+}
+
+static void OctahedralEncode(v3 Normal, int16_t *Out) {
+    // NOTE(blackedout): Projects the unit vector onto the octahedron |x| + |y| + |z| = 1 and folds the lower half over the diagonals.
+    // Decoded by OctahedralDecode in shaders/quantized.vert.
+    float L1 = fabsf(Normal.E[0]) + fabsf(Normal.E[1]) + fabsf(Normal.E[2]);
+    float X = (L1 > 0.0f)? Normal.E[0]/L1 : 0.0f;
+    float Y = (L1 > 0.0f)? Normal.E[1]/L1 : 0.0f;
+    if(L1 > 0.0f && Normal.E[2] < 0.0f) {
+        float FoldedX = (1.0f - fabsf(Y))*((X >= 0.0f)? 1.0f : -1.0f);
+        float FoldedY = (1.0f - fabsf(X))*((Y >= 0.0f)? 1.0f : -1.0f);
+        X = FoldedX;
+        Y = FoldedY;
+    }
+    Out[0] = QuantizeSnorm16(X);
+    Out[1] = QuantizeSnorm16(Y);
+}
+
+static vertex_quantized QuantizeVertex(vertex Vertex, v3 PositionOffset, v3 PositionScale) {
+    vertex_quantized Result;
+    SetZero(Result);
+    for(uint32_t I = 0; I < 3; ++I) {
+        Result.Position[I] = QuantizeSnorm16((Vertex.Position.E[I] - PositionOffset.E[I])/PositionScale.E[I]);
+    }
+    OctahedralEncode(Vertex.Normal, Result.Normal);
+    Result.TexCoord[0] = FloatToHalf(Vertex.TexCoord.E[0]);
+    Result.TexCoord[1] = FloatToHalf(Vertex.TexCoord.E[1]);
+    return Result;
+}
+
+// MARK: Cooked Meshes
+// NOTE(blackedout): A cooked mesh is a single blob written by cook.c: header, submesh table, vertices, indices and meshlets, each section aligned to
+// MESH_ALIGNMENT relative to the start of the blob. Vertices are already in the runtime vertex format, so loading a mesh is just pointing
+// into the blob (e.g. inside the mapped asset pack) and copying the vertex and index sections into GPU memory.
+// Indices of a submesh are relative to its first vertex (use VertexOffset as vertexOffset when drawing), which lets meshes with up to
+// 65536 vertices per submesh use 16 bit indices.
+#define MESH_MAGIC 0x4853454d // NOTE(blackedout): "MESH" in little endian
+#define MESH_VERSION 5
+#define MESH_ALIGNMENT 16
+#define MESH_MAX_NAME_LENGTH 32
+#define MESH_MAX_LOD_COUNT 5
+#define MESH_MESHLET_MAX_VERTEX_COUNT 64
+#define MESH_MESHLET_MAX_TRIANGLE_COUNT 124
+
+typedef struct {
+    v3 Min;
+    v3 Max;
+    v3 Center;
+    float Radius; // NOTE(blackedout): Bounding sphere around Center that contains all vertices
+} mesh_bounds;
+
+// NOTE(blackedout): Levels of detail of a submesh share its vertices and only differ in their indices. The indices of all levels are stored
+// contiguously after the full detail indices of all submeshes.
+typedef struct {
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    float Error; // NOTE(blackedout): Geometric deviation from the full detail mesh in object space units, 0 for level 0
+} mesh_lod;
+
+// NOTE(blackedout): A meshlet is a cluster of at most MESH_MESHLET_MAX_TRIANGLE_COUNT neighboring triangles of the full detail level that
+// use at most MESH_MESHLET_MAX_VERTEX_COUNT vertices. Its triangles are a contiguous range of the submesh's level 0 indices, so it can be
+// drawn like a submesh. The layout matches the std430 struct in cull.comp.
+// The meshlet is entirely back facing if dot(normalize(ConeApex - CameraPosition), ConeAxis) >= ConeCutoff.
+typedef struct {
+    v3 Center;
+    float Radius; // NOTE(blackedout): Bounding sphere around Center that contains all vertices of the meshlet
+    v3 ConeApex;
+    float ConeCutoff; // NOTE(blackedout): Sine of the cone's half angle, larger than 1 if the meshlet can't be back face culled
+    v3 ConeAxis; // NOTE(blackedout): Normalized, average of the triangle normals
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    uint32_t VertexOffset; // NOTE(blackedout): Same as the submesh's VertexOffset
+    uint32_t VertexCount; // NOTE(blackedout): Distinct vertices used by the meshlet's triangles
+    uint32_t Reserved;
+} mesh_meshlet;
+
+typedef struct {
+    char Name[MESH_MAX_NAME_LENGTH]; // NOTE(blackedout): Zero terminated, e.g. the material or object name
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+    uint32_t VertexOffset;
+    uint32_t VertexCount;
+    mesh_bounds Bounds;
+    uint32_t LodCount; // NOTE(blackedout): At least 1, Lods[0] is the full detail mesh (IndexOffset and IndexCount)
+    mesh_lod Lods[MESH_MAX_LOD_COUNT]; // NOTE(blackedout): Increasing error, decreasing index count
+    uint32_t MeshletOffset;
+    uint32_t MeshletCount; // NOTE(blackedout): Meshlets of level 0, together they cover all its triangles
+} mesh_submesh;
+
+typedef struct {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t VertexFormat; // NOTE(blackedout): mesh_vertex_format
+    uint32_t VertexByteCount; // NOTE(blackedout): Size of a single vertex, checked against the runtime format
+    uint32_t SubmeshCount;
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+    uint32_t IndexByteCount; // NOTE(blackedout): 2 or 4
+    uint32_t MeshletCount;
+    uint32_t Reserved;
+    uint64_t SubmeshesOffset;
+    uint64_t VerticesOffset;
+    uint64_t IndicesOffset;
+    uint64_t MeshletsOffset;
+    mesh_bounds Bounds;
+    // NOTE(blackedout): Quantized positions decode to PositionOffset + PositionScale*Position, which can be folded into the model matrix.
+    // Unused for float vertices.
+    v3 PositionOffset;
+    v3 PositionScale;
+} mesh_header;
+
+typedef struct {
+    const mesh_header *Header;
+    const mesh_submesh *Submeshes;
+    const mesh_meshlet *Meshlets;
+    const void *Vertices; // NOTE(blackedout): In Header->VertexFormat
+    const void *Indices; // NOTE(blackedout): uint16_t or uint32_t, see Header->IndexByteCount
+    uint64_t VerticesByteCount;
+    uint64_t IndicesByteCount;
+    uint64_t MeshletsByteCount;
+} mesh_view;
+
+static int MeshViewFromBytes(const uint8_t *Bytes, uint64_t ByteCount, mesh_view *OutView) {
+    // NOTE(blackedout): Validates the blob and points into it, nothing is copied.
+    mesh_view View;
+    SetZero(View);
+    {
+        AssertMessageGoto(ByteCount >= sizeof(mesh_header) && ((uintptr_t)Bytes % MESH_ALIGNMENT) == 0, label_Error, "Mesh is too small or misaligned.\n");
+        const mesh_header *Header = (const mesh_header *)Bytes;
+        AssertMessageGoto(Header->Magic == MESH_MAGIC && Header->Version == MESH_VERSION, label_Error, "Mesh is not a cooked mesh of version %d.\n", MESH_VERSION);
+        AssertMessageGoto(Header->VertexFormat < MESH_VERTEX_FORMAT_COUNT, label_Error, "Mesh has an unknown vertex format %d.\n", Header->VertexFormat);
+        uint32_t VertexByteCount = MeshVertexByteCount((mesh_vertex_format)Header->VertexFormat);
+        AssertMessageGoto(Header->VertexByteCount == VertexByteCount, label_Error, "Mesh vertex size %d doesn't match the runtime vertex size %d.\n", Header->VertexByteCount, VertexByteCount);
+
+        AssertMessageGoto(Header->IndexByteCount == 2 || Header->IndexByteCount == 4, label_Error, "Mesh has an invalid index size %d.\n", Header->IndexByteCount);
+
+        uint64_t SubmeshesByteCount = (uint64_t)Header->SubmeshCount*sizeof(mesh_submesh);
+        uint64_t VerticesByteCount = (uint64_t)Header->VertexCount*VertexByteCount;
+        uint64_t IndicesByteCount = (uint64_t)Header->IndexCount*Header->IndexByteCount;
+        uint64_t MeshletsByteCount = (uint64_t)Header->MeshletCount*sizeof(mesh_meshlet);
+        int IsInBounds = Header->SubmeshesOffset <= ByteCount && SubmeshesByteCount <= ByteCount - Header->SubmeshesOffset &&
+                         Header->VerticesOffset <= ByteCount && VerticesByteCount <= ByteCount - Header->VerticesOffset &&
+                         Header->IndicesOffset <= ByteCount && IndicesByteCount <= ByteCount - Header->IndicesOffset &&
+                         Header->MeshletsOffset <= ByteCount && MeshletsByteCount <= ByteCount - Header->MeshletsOffset;
+        int IsAligned = (Header->SubmeshesOffset % MESH_ALIGNMENT) == 0 && (Header->VerticesOffset % MESH_ALIGNMENT) == 0 &&
+                        (Header->IndicesOffset % MESH_ALIGNMENT) == 0 && (Header->MeshletsOffset % MESH_ALIGNMENT) == 0;
+        AssertMessageGoto(IsInBounds && IsAligned, label_Error, "Mesh sections are out of bounds or misaligned.\n");
+
+        const mesh_submesh *Submeshes = (const mesh_submesh *)(Bytes + Header->SubmeshesOffset);
+        const mesh_meshlet *Meshlets = (const mesh_meshlet *)(Bytes + Header->MeshletsOffset);
+        for(uint32_t I = 0; I < Header->SubmeshCount; ++I) {
+            const mesh_submesh *Submesh = Submeshes + I;
+            int IsValid = (uint64_t)Submesh->IndexOffset + Submesh->IndexCount <= Header->IndexCount &&
+                          (uint64_t)Submesh->VertexOffset + Submesh->VertexCount <= Header->VertexCount &&
+                          Submesh->LodCount >= 1 && Submesh->LodCount <= MESH_MAX_LOD_COUNT;
+            for(uint32_t J = 0; J < Submesh->LodCount && IsValid; ++J) {
+                IsValid = (uint64_t)Submesh->Lods[J].IndexOffset + Submesh->Lods[J].IndexCount <= Header->IndexCount;
+            }
+            IsValid = IsValid && (uint64_t)Submesh->MeshletOffset + Submesh->MeshletCount <= Header->MeshletCount;
+            for(uint32_t J = 0; J < Submesh->MeshletCount && IsValid; ++J) {
+                const mesh_meshlet *Meshlet = Meshlets + Submesh->MeshletOffset + J;
+                IsValid = Meshlet->IndexOffset >= Submesh->IndexOffset && (uint64_t)Meshlet->IndexOffset + Meshlet->IndexCount <= (uint64_t)Submesh->IndexOffset + Submesh->IndexCount &&
+                          Meshlet->VertexOffset == Submesh->VertexOffset;
+            }
+            AssertMessageGoto(IsValid, label_Error, "Mesh submesh %d is out of bounds.\n", I);
+        }
+
+        View.Header = Header;
+        View.Submeshes = Submeshes;
+        View.Meshlets = Meshlets;
+        View.Vertices = Bytes + Header->VerticesOffset;
+        View.Indices = Bytes + Header->IndicesOffset;
+        View.VerticesByteCount = VerticesByteCount;
+        View.IndicesByteCount = IndicesByteCount;
+        View.MeshletsByteCount = MeshletsByteCount;
+    }
+
+    *OutView = View;
+    return 0;
+
+label_Error:
+    return 1;
+}
\ No newline at end of file
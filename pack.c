@@ -0,0 +1,135 @@
+// Original source in https://github.com/blackedout01/glfw-vk-template
+//
+// This is free and unencumbered software released into the public domain.
+// Anyone is free to copy, modify, publish, use, compile, sell, or distribute
+// this software, either in source code form or as a compiled binary, for any
+// purpose, commercial or non-commercial, and by any means.
+//
+// In jurisdictions that recognize copyright laws, the author or authors of
+// this software dedicate any and all copyright interest in the software to the
+// public domain. We make this dedication for the benefit of the public at
+// large and to the detriment of our heirs and successors. We intend this
+// dedication to be an overt act of relinquishment in perpetuity of all present
+// and future rights to this software under copyright law.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// For more information, please refer to https://unlicense.org
+
+// NOTE(blackedout): Offline asset packer, writes all input files into one asset pack (see util.c) that the program maps at runtime.
+// Usage: pack <output> <input>...
+// Entries are named after the input file names without directories, their type is derived from the extension.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.c"
+
+static const char *PackBaseName(const char *Path) {
+    const char *Result = Path;
+    for(const char *At = Path; *At; ++At) {
+        if(*At == '/' || *At == '\\') {
+            Result = At + 1;
+        }
+    }
+    return Result;
+}
+
+static asset_type PackAssetType(const char *Name) {
+    const char *Extension = strrchr(Name, '.');
+    if(Extension == 0) {
+        return ASSET_TYPE_BLOB;
+    }
+    if(strcmp(Extension, ".spv") == 0) {
+        return ASSET_TYPE_SPIRV;
+    }
+    if(strcmp(Extension, ".vertices") == 0) {
+        return ASSET_TYPE_VERTICES;
+    }
+    if(strcmp(Extension, ".indices") == 0) {
+        return ASSET_TYPE_INDICES;
+    }
+    if(strcmp(Extension, ".image") == 0) {
+        return ASSET_TYPE_IMAGE;
+    }
+    if(strcmp(Extension, ".mesh") == 0) {
+        return ASSET_TYPE_MESH;
+    }
+    if(strcmp(Extension, ".ktx2") == 0) {
+        return ASSET_TYPE_TEXTURE;
+    }
+    return ASSET_TYPE_BLOB;
+}
+
+int main(int ArgumentCount, char **Arguments) {
+    int Result = 1;
+    FILE *File = 0;
+    asset_pack_entry *Entries = 0;
+    uint32_t EntryCount = 0;
+    {
+        AssertMessageGoto(ArgumentCount >= 2, label_Exit, "Usage: %s <output> <input>...\n", Arguments[0]);
+        EntryCount = (uint32_t)(ArgumentCount - 2);
+        Entries = (asset_pack_entry *)calloc(Max(EntryCount, 1), sizeof(asset_pack_entry));
+        AssertMessageGoto(Entries, label_Exit, "Out of memory.\n");
+
+        uint64_t Offset = AlignAny(sizeof(asset_pack_header) + EntryCount*sizeof(asset_pack_entry), uint64_t, ASSET_PACK_ALIGNMENT);
+        for(uint32_t I = 0; I < EntryCount; ++I) {
+            const char *Name = PackBaseName(Arguments[2 + I]);
+            AssertMessageGoto(strlen(Name) < ASSET_PACK_MAX_NAME_LENGTH, label_Exit, "Asset name '%s' is too long (max %d characters).\n", Name, ASSET_PACK_MAX_NAME_LENGTH - 1);
+            for(uint32_t J = 0; J < I; ++J) {
+                AssertMessageGoto(strcmp(Entries[J].Name, Name) != 0, label_Exit, "Asset name '%s' is used twice.\n", Name);
+            }
+
+            FILE *Input = fopen(Arguments[2 + I], "rb");
+            AssertMessageGoto(Input, label_Exit, "File '%s' could not be opened (code %d).\n", Arguments[2 + I], errno);
+            fseek(Input, 0, SEEK_END);
+            long int InputByteCount = ftell(Input);
+            fclose(Input);
+            AssertMessageGoto(InputByteCount >= 0, label_Exit, "Size of '%s' could not be read.\n", Arguments[2 + I]);
+
+            strcpy(Entries[I].Name, Name);
+            Entries[I].Type = PackAssetType(Name);
+            Entries[I].Offset = Offset;
+            Entries[I].ByteCount = (uint64_t)InputByteCount;
+            Offset = AlignAny(Offset + (uint64_t)InputByteCount, uint64_t, ASSET_PACK_ALIGNMENT);
+        }
+
+        File = fopen(Arguments[1], "wb");
+        AssertMessageGoto(File, label_Exit, "File '%s' could not be opened for writing (code %d).\n", Arguments[1], errno);
+
+        asset_pack_header Header = { .Magic = ASSET_PACK_MAGIC, .Version = ASSET_PACK_VERSION, .EntryCount = EntryCount, .Reserved = 0 };
+        AssertMessageGoto(fwrite(&Header, sizeof(Header), 1, File) == 1, label_Exit, "Writing '%s' failed.\n", Arguments[1]);
+        AssertMessageGoto(fwrite(Entries, sizeof(asset_pack_entry), EntryCount, File) == EntryCount, label_Exit, "Writing '%s' failed.\n", Arguments[1]);
+
+        for(uint32_t I = 0; I < EntryCount; ++I) {
+            uint8_t *Bytes = 0;
+            uint64_t ByteCount = 0;
+            CheckGoto(LoadFileContentsCStd(Arguments[2 + I], &Bytes, &ByteCount), label_Exit);
+            // NOTE(blackedout): Pad up to the entry offset, the file position is always in front of it.
+            static const uint8_t Padding[ASSET_PACK_ALIGNMENT] = {0};
+            long int Position = ftell(File);
+            size_t PaddingByteCount = (size_t)(Entries[I].Offset - (uint64_t)Position);
+            int WriteResult = fwrite(Padding, 1, PaddingByteCount, File) == PaddingByteCount && fwrite(Bytes, 1, (size_t)ByteCount, File) == (size_t)ByteCount;
+            free(Bytes);
+            AssertMessageGoto(WriteResult && ByteCount == Entries[I].ByteCount, label_Exit, "Writing '%s' into '%s' failed.\n", Arguments[2 + I], Arguments[1]);
+        }
+
+        printf("Packed %d assets into '%s'.\n", EntryCount, Arguments[1]);
+    }
+    Result = 0;
+
+label_Exit:
+    if(File) {
+        fclose(File);
+    }
+    free(Entries);
+    return Result;
+}
@@ -20,30 +20,65 @@
 //    misrepresented as being the original software.
 // 3. This notice may not be removed or altered from any source distribution.
 
-typedef struct {
-    v3 Position;
-    v3 Normal;
-    v2 TexCoord;
-} vertex;
-
 typedef struct {
     m4 V, P;
     v4 L;
+    v4 FrustumPlanes[6]; // NOTE(blackedout): World space, normalized, pointing inwards (left, right, bottom, top, near, far)
+    v4 CameraPosition;
+    v4 ClusterScale; // NOTE(blackedout): xy clusters per pixel, zw depth slice scale and bias (slice = log(depth)*z + w), see default.frag
 } default_uniform_buffer1;
 
 typedef struct {
     m4 M;
     m2 TexM;
     v2 TexT;
+    uint32_t TextureIndex; // NOTE(blackedout): Into the texture tables (see shaders.TextureTableSets)
 } default_push_constants;
 
+typedef struct {
+    m4 M; // NOTE(blackedout): Column major like default_push_constants.M, but without the dequantization of quantized positions
+    uint32_t MeshletOffset; // NOTE(blackedout): In meshlets from the start of the static storage buffer
+    uint32_t MeshletCount;
+    uint32_t CommandOffset; // NOTE(blackedout): In commands from the start of the frame's command buffer
+    float MaxScale;
+    uint32_t IsConeCullingEnabled; // NOTE(blackedout): Normal cones can't be transformed by non-uniform scales
+    uint32_t Phase; // NOTE(blackedout): cluster_culling_phase
+    uint32_t VisibilityOffset; // NOTE(blackedout): In meshlets from the start of the visibility buffer, the same for both phases
+} cluster_culling_push_constants;
+
+typedef struct {
+    int32_t SourceSize[2];
+    int32_t Size[2];
+    int32_t LevelIndex;
+    int32_t SampleCount;
+} depth_pyramid_push_constants;
+
+// NOTE(blackedout): Point or spot light of the clustered lighting, same layout as light in lightbin.comp and default.frag
+typedef struct {
+    v3 Position; // NOTE(blackedout): World space
+    float Range; // NOTE(blackedout): The light has no effect beyond this distance
+    v3 Color;
+    float SpotOuterCos; // NOTE(blackedout): Cosine of the cone's half angle, -2 for point lights
+    v3 Direction; // NOTE(blackedout): Normalized cone axis, only used by spot lights
+    float SpotInnerCos; // NOTE(blackedout): Where the falloff towards the cone's edge starts, -1 for point lights
+} clustered_light;
+
+typedef struct {
+    uint32_t LightCount;
+    uint32_t LightIndexCapacity;
+} light_binning_push_constants;
+
+#define TEXTURE_TABLE_CAPACITY 1024 // NOTE(blackedout): Upper bound of the texture table size, which default.frag gets as a specialization constant
+
 enum {
     DESCRIPTOR_SET_LAYOUT_DEFAULT_UNIFORM,
-    DESCRIPTOR_SET_LAYOUT_DEFAULT_SAMPLER_IMAGE,
+    DESCRIPTOR_SET_LAYOUT_DEFAULT_SAMPLER_IMAGE, // NOTE(blackedout): The sampler and the texture table
+    DESCRIPTOR_SET_LAYOUT_CLUSTERED_LIGHTS, // NOTE(blackedout): Lights, clusters and light indices (see clustered_lighting)
 
     DESCRIPTOR_SET_LAYOUT_COUNT
 };
 
+// NOTE(blackedout): Static images are added to the texture table first, so these are also their texture indices
 enum {
     STATIC_IMAGE_COLOR,
     STATIC_IMAGE_TILE,
@@ -53,26 +88,159 @@ enum {
 
 typedef struct {
     vulkan_shader Default;
+    VkShaderModule QuantizedVert; // NOTE(blackedout): Replaces Default.Vert for quantized vertices
+    VkShaderModule CullComp;
+    VkShaderModule DepthPyramidComp;
+    VkShaderModule DepthPyramidSingleSampledComp; // NOTE(blackedout): Replaces DepthPyramidComp without multisampling
+    VkShaderModule LightBinComp;
     VkDescriptorSetLayout DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_COUNT];
-    VkDeviceMemory UniformBufferMemory;
     
     VkBuffer UniformMatsBuffers[MAX_ACQUIRED_IMAGE_COUNT];
+    vulkan_allocation UniformMatsAllocations[MAX_ACQUIRED_IMAGE_COUNT];
     default_uniform_buffer1 *UniformMats[MAX_ACQUIRED_IMAGE_COUNT];
     VkDescriptorSet UniformMatsSets[MAX_ACQUIRED_IMAGE_COUNT];
 
     VkSampler DefaultSampler;
 
-    VkDescriptorPool DefaultDescriptorPool;
-    VkDescriptorPool UniformDescriptorPool;
+    VkDescriptorPool DefaultDescriptorPool; // NOTE(blackedout): Only for the texture table, which needs update after bind
 
-    VkDescriptorSet DefaultImageTileSet;
-    VkDescriptorSet DefaultImageColorSet;
+    // NOTE(blackedout): All textures in one array, bound once per frame. Materials select theirs with default_push_constants.TextureIndex.
+    // Without dynamic indexing, each texture is in a table of its own instead, which is bound per draw (see LoadShaders).
+    VkDescriptorSet TextureTableSets[STATIC_IMAGE_COUNT];
+    uint32_t TextureTableCount;
+    uint32_t TextureTableSize; // NOTE(blackedout): Textures per table, texture I is entry I%TextureTableSize of table I/TextureTableSize
+    uint32_t TextureCount;
 } shaders;
 
 #include "vulkan_custom.c"
 
+typedef enum {
+    PIPELINE_VARIANT_DEFAULT,
+    PIPELINE_VARIANT_WIREFRAME,
+    PIPELINE_VARIANT_ALPHA_BLEND,
+    PIPELINE_VARIANT_NO_CULL,
+    PIPELINE_VARIANT_DEPTH_ONLY,
+    PIPELINE_VARIANT_COUNT,
+} pipeline_variant;
+
+#define CAMERA_FOV_Y 1.1f
+#define CAMERA_NEAR 0.01f
+#define CAMERA_FAR 1000.0f
+#define LOD_MAX_PIXEL_ERROR 1.0f // NOTE(blackedout): The coarsest level of detail whose projected error is at most this many pixels is drawn
+
+// NOTE(blackedout): A mesh in the static buffers. Submeshes either point into the mapped asset pack (cooked mesh) or to DefaultSubmesh.
+typedef struct {
+    mesh_vertex_format VertexFormat;
+    v3 PositionOffset; // NOTE(blackedout): Dequantization of quantized positions, see mesh_header
+    v3 PositionScale;
+    uint64_t VerticesByteOffset;
+    uint64_t IndicesByteOffset;
+    uint64_t MeshletsByteOffset; // NOTE(blackedout): In the storage arena of the mesh registry
+    VkIndexType IndexType;
+    uint32_t MeshletCount;
+    uint32_t SubmeshCount;
+    const mesh_submesh *Submeshes;
+    mesh_submesh DefaultSubmesh;
+    vulkan_mesh_handle Handle; // NOTE(blackedout): The offsets above are only valid while the mesh is resident
+    vulkan_mesh_subbuf Subbuf; // NOTE(blackedout): What was added to the mesh registry, the registry clears its sources once the mesh is resident
+} static_mesh;
+
+// NOTE(blackedout): A static mesh drawn in the current frame. Draws are collected first, so that the cluster culling pass can run for all
+// of them before the render pass begins.
+typedef struct {
+    static_mesh *Mesh;
+    default_push_constants PushConstants;
+    uint32_t FirstClusterCommand; // NOTE(blackedout): Commands of the mesh's meshlets, UINT32_MAX if they aren't culled this frame
+} static_mesh_draw;
+
+// NOTE(blackedout): With occlusion culling, meshlets are culled and drawn in two phases around building the depth pyramid (see cull.comp)
+typedef enum {
+    CLUSTER_CULLING_PHASE_ONLY, // NOTE(blackedout): Without occlusion culling
+    CLUSTER_CULLING_PHASE_FIRST,
+    CLUSTER_CULLING_PHASE_SECOND, // NOTE(blackedout): Only meshlets are drawn, everything else was drawn in the first phase
+} cluster_culling_phase;
+
+// NOTE(blackedout): State shared by all static mesh draws of a frame
+typedef struct {
+    VkCommandBuffer CommandBuffer;
+    VkPipelineLayout Layout;
+    vulkan_mesh_registry *MeshRegistry;
+    VkPipeline *Pipelines; // NOTE(blackedout): Indexed by mesh_vertex_format
+    VkPipeline BoundPipeline;
+    VkDescriptorSet *TextureTableSets;
+    uint32_t TextureTableSize;
+    VkDescriptorSet BoundTextureTableSet;
+    m4 View; // NOTE(blackedout): Row major
+    float PixelsPerUnit; // NOTE(blackedout): Size of a unit at distance 1, for projecting LOD errors
+    VkBuffer ClusterCommands; // NOTE(blackedout): Of the current culling phase
+    uint32_t MaxDrawIndirectCount; // NOTE(blackedout): 1 without the multiDrawIndirect feature
+    cluster_culling_phase CullingPhase;
+} static_mesh_frame;
+
+#define CLUSTER_CULLING_GROUP_SIZE 64 // NOTE(blackedout): local_size_x in cull.comp
+#define CLUSTER_CULLING_MAX_COMMAND_COUNT 65536 // NOTE(blackedout): Per phase, meshes whose meshlets don't fit anymore are drawn without culling
+
+typedef struct {
+    VkDescriptorSetLayout SetLayout;
+    VkPipelineLayout PipelineLayout;
+    VkPipeline Pipeline;
+    VkShaderModule PipelineModule; // NOTE(blackedout): The module Pipeline was created with, to notice reloads of cull.comp
+    // NOTE(blackedout): The VkDrawIndexedIndirectCommand per meshlet are frame graph buffers, one per phase
+    uint32_t CommandCount; // NOTE(blackedout): Reserved in the current frame
+    // NOTE(blackedout): Whether each reserved command's meshlet was visible in the last frame's second phase. Indexed by command, so it
+    // is only accurate while the same meshes are drawn in the same order, which costs efficiency but never correctness otherwise.
+    vulkan_buffer Visibility;
+    int IsVisibilityCleared;
+} cluster_culler;
+
+#define DEPTH_PYRAMID_GROUP_SIZE 8 // NOTE(blackedout): local_size_x and local_size_y in depthpyramid.comp
+#define DEPTH_PYRAMID_MAX_LEVEL_COUNT 16
+
+// NOTE(blackedout): A frame graph image, which the graph recreates when the extent of the depth attachment changes. The descriptor sets
+// refer to its views, so they are allocated after the graph was compiled.
+typedef struct {
+    uint32_t Width, Height;
+    uint32_t LevelCount;
+    VkImageView View; // NOTE(blackedout): All levels, for cull.comp and reading previous levels
+    const VkImageView *LevelViews; // NOTE(blackedout): For writing single levels
+    VkDescriptorSet Sets[DEPTH_PYRAMID_MAX_LEVEL_COUNT]; // NOTE(blackedout): Per level
+} depth_pyramid;
+
+// NOTE(blackedout): Occlusion culling needs to sample the depth attachment, without support all meshlets are drawn in one phase
+typedef struct {
+    int IsSupported;
+    VkDescriptorSetLayout SetLayout;
+    VkPipelineLayout PipelineLayout;
+    VkPipeline Pipeline;
+    VkShaderModule PipelineModule; // NOTE(blackedout): The module Pipeline was created with, to notice reloads of depthpyramid.comp
+    VkSampler Sampler;
+} occlusion_culler;
+
+#define CLUSTERED_LIGHTING_GROUP_SIZE 64 // NOTE(blackedout): local_size_x in lightbin.comp
+#define CLUSTERED_LIGHTING_GRID_X 16 // NOTE(blackedout): Same as CLUSTERED_LIGHTING_GRID_SIZE in default.frag
+#define CLUSTERED_LIGHTING_GRID_Y 9
+#define CLUSTERED_LIGHTING_GRID_Z 24
+#define CLUSTERED_LIGHTING_CLUSTER_COUNT (CLUSTERED_LIGHTING_GRID_X*CLUSTERED_LIGHTING_GRID_Y*CLUSTERED_LIGHTING_GRID_Z)
+#define CLUSTERED_LIGHTING_MAX_LIGHT_COUNT 4096
+#define CLUSTERED_LIGHTING_LIGHT_INDEX_CAPACITY (64*CLUSTERED_LIGHTING_CLUSTER_COUNT) // NOTE(blackedout): For all clusters together
+
+#define CLUSTERED_LIGHTING_CLUSTERS_BYTE_COUNT (CLUSTERED_LIGHTING_CLUSTER_COUNT*2*sizeof(uint32_t)) // NOTE(blackedout): Offset into the light indices and light count
+#define CLUSTERED_LIGHTING_LIGHT_INDICES_BYTE_COUNT ((1 + CLUSTERED_LIGHTING_LIGHT_INDEX_CAPACITY)*sizeof(uint32_t)) // NOTE(blackedout): Count followed by the indices
+
+// NOTE(blackedout): The lights are written by the CPU every frame. The clusters and light indices are frame graph buffers written by
+// lightbin.comp.
+typedef struct {
+    VkPipelineLayout PipelineLayout;
+    VkPipeline Pipeline;
+    VkShaderModule PipelineModule; // NOTE(blackedout): The module Pipeline was created with, to notice reloads of lightbin.comp
+    vulkan_buffer Lights[MAX_ACQUIRED_IMAGE_COUNT]; // NOTE(blackedout): clustered_light, host visible, shared with the async compute queue
+} clustered_lighting;
+
 typedef struct {
     int IsSuperDown;
+    // NOTE(blackedout): The key callback has no device, so the next render prints or writes them
+    int ShouldPrintMemoryStats;
+    int ShouldWriteMemoryStats;
 
     int IsDragging;
     double LastCursorX, LastCursorY;
@@ -82,24 +250,41 @@ typedef struct {
 
     int ImagesInitialized;
 
+    asset_pack Assets;
     shaders Shaders;
+    shader_reloader ShaderReloader;
     VkCommandPool GraphicsCommandPool;
     VkCommandBuffer GraphicsCommandBuffer;
     VkQueue GraphicsQueue;
-
-    vulkan_static_buffers StaticBuffers;
-
+    // NOTE(blackedout): Only created if the device has an async compute queue
+    VkCommandPool ComputeCommandPool;
+    VkCommandBuffer ComputeCommandBuffer;
+    VkQueue ComputeQueue;
+    VkSemaphore ComputeSemaphores[MAX_ACQUIRED_IMAGE_COUNT];
+
+    work_pool Workers;
+    vulkan_mesh_registry MeshRegistry;
+    vulkan_descriptor_allocator Descriptors;
+
+    vulkan_pipeline_compiler PipelineCompiler;
+    vulkan_pipeline_state_cache PipelineStates;
+    vulkan_graphics_pipeline_description DefaultPipelineDescription;
+    pipeline_variant PipelineVariant;
     VkPipelineLayout GraphicsPipelineLayout;
     VkRenderPass RenderPass;
-    VkPipeline GraphicsPipeline;
     VkSampleCountFlagBits SampleCount;
 
     vulkan_image Images[STATIC_IMAGE_COUNT];
 
-    uint64_t PlaneVerticesByteOffset;
-    uint64_t PlaneIndicesByteOffset;
-    uint64_t CubeVerticesByteOffset;
-    uint64_t CubeIndicesByteOffset;
+    static_mesh PlaneMesh;
+    static_mesh CubeMesh;
+    cluster_culler ClusterCuller;
+    occlusion_culler OcclusionCuller;
+    int IsOcclusionCullingDisabled;
+    clustered_lighting ClusteredLighting;
+    uint32_t LightCount;
+    float Time;
+    vulkan_frame_graph FrameGraphs[MAX_ACQUIRED_IMAGE_COUNT];
 } context;
 
 static void ProgramCursorPositionCallback(context *Context, double PosX, double PosY) {
@@ -125,6 +310,40 @@ static void ProgramKeyCallback(context *Context, int Key, int Scancode, int Acti
     if(Key == GLFW_KEY_LEFT_SUPER) {
         Context->IsSuperDown = Action != GLFW_RELEASE;
     }
+    if(Key == GLFW_KEY_V && Action == GLFW_PRESS) {
+        Context->PipelineVariant = (Context->PipelineVariant + 1) % PIPELINE_VARIANT_COUNT;
+    }
+    if(Key == GLFW_KEY_P && Action == GLFW_PRESS) {
+        VulkanPrintPipelineStateCacheStats(&Context->PipelineStates);
+        VulkanPrintDescriptorAllocatorStats(&Context->Descriptors);
+        VulkanPrintMeshRegistryStats(&Context->MeshRegistry);
+        for(uint32_t I = 0; I < ArrayCount(Context->FrameGraphs); ++I) {
+            VulkanPrintFrameGraphStats(Context->FrameGraphs + I);
+        }
+        Context->ShouldPrintMemoryStats = 1;
+    }
+    if(Key == GLFW_KEY_M && Action == GLFW_PRESS) {
+        Context->ShouldWriteMemoryStats = 1;
+    }
+    if(Key == GLFW_KEY_O && Action == GLFW_PRESS) {
+        Context->IsOcclusionCullingDisabled = !Context->IsOcclusionCullingDisabled;
+    }
+    if(Key == GLFW_KEY_L && Action == GLFW_PRESS) {
+        // NOTE(blackedout): Cycles through 0, 64, 256, 1024 and 4096 lights
+        Context->LightCount = (Context->LightCount == 0)? 64 : 4*Context->LightCount;
+        if(Context->LightCount > CLUSTERED_LIGHTING_MAX_LIGHT_COUNT) {
+            Context->LightCount = 0;
+        }
+        printf("Drawing %u lights.\n", Context->LightCount);
+    }
+    if(Key == GLFW_KEY_R && Action == GLFW_PRESS) {
+        // NOTE(blackedout): Removes the cube from the mesh registry and adds it again. Its ranges are retired and it is uploaded again with
+        // the next frame, until then it isn't drawn.
+        VulkanRemoveMesh(&Context->MeshRegistry, Context->CubeMesh.Handle);
+        if(VulkanAddMesh(&Context->MeshRegistry, Context->CubeMesh.Subbuf, &Context->CubeMesh.Handle) == 0) {
+            printf("Re-adding the cube mesh.\n");
+        }
+    }
 }
 
 static void ProgramScrollCallback(context *Context, double OffsetX, double OffsetY) {
@@ -194,15 +413,718 @@ static uint32_t CubeIndices[] = {
     12, 13, 14, 14, 15, 12,
     16, 17, 18, 18, 19, 16,
     20, 21, 22, 22, 23, 20,
-    24, 25, 26, 26, 27, 24
 };
 
+static vulkan_mesh_subbuf LoadStaticMesh(asset_pack *Assets, const char *AssetName, const vertex *FallbackVertices, uint32_t FallbackVertexCount, const uint32_t *FallbackIndices, uint32_t FallbackIndexCount, static_mesh *Mesh) {
+    // NOTE(blackedout): Cooked meshes are copied straight from the mapped asset pack into staging memory. Without the pack (or if the mesh
+    // is invalid), the built-in vertices and indices are used as a single submesh.
+    const uint8_t *Bytes;
+    uint64_t ByteCount;
+    mesh_view View;
+    vulkan_mesh_subbuf Subbuf;
+    SetZero(Subbuf);
+    Subbuf.Vertices.OffsetPointer = &Mesh->VerticesByteOffset;
+    Subbuf.Indices.OffsetPointer = &Mesh->IndicesByteOffset;
+    Subbuf.Storage.OffsetPointer = &Mesh->MeshletsByteOffset;
+    Subbuf.StorageStride = sizeof(mesh_meshlet);
+    if(AssetPackFind(Assets, AssetName, &Bytes, &ByteCount) == 0 && MeshViewFromBytes(Bytes, ByteCount, &View) == 0) {
+        Mesh->VertexFormat = (mesh_vertex_format)View.Header->VertexFormat;
+        Mesh->PositionOffset = View.Header->PositionOffset;
+        Mesh->PositionScale = View.Header->PositionScale;
+        Mesh->IndexType = (View.Header->IndexByteCount == sizeof(uint16_t))? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        Mesh->MeshletCount = View.Header->MeshletCount;
+        Mesh->SubmeshCount = View.Header->SubmeshCount;
+        Mesh->Submeshes = View.Submeshes;
+        Subbuf.Vertices.Source = View.Vertices;
+        Subbuf.Vertices.ByteCount = View.VerticesByteCount;
+        Subbuf.Indices.Source = View.Indices;
+        Subbuf.Indices.ByteCount = View.IndicesByteCount;
+        Subbuf.IndexType = Mesh->IndexType;
+        Subbuf.Storage.Source = View.Meshlets;
+        Subbuf.Storage.ByteCount = View.MeshletsByteCount;
+        return Subbuf;
+    }
+
+    Mesh->VertexFormat = MESH_VERTEX_FORMAT_FLOAT;
+    Mesh->IndexType = VK_INDEX_TYPE_UINT32;
+    Mesh->MeshletCount = 0;
+    SetZero(Mesh->DefaultSubmesh);
+    Mesh->DefaultSubmesh.IndexCount = FallbackIndexCount;
+    Mesh->DefaultSubmesh.VertexCount = FallbackVertexCount;
+    Mesh->DefaultSubmesh.LodCount = 1;
+    Mesh->DefaultSubmesh.Lods[0].IndexCount = FallbackIndexCount;
+    Mesh->SubmeshCount = 1;
+    Mesh->Submeshes = &Mesh->DefaultSubmesh;
+    Subbuf.Vertices.Source = FallbackVertices;
+    Subbuf.Vertices.ByteCount = FallbackVertexCount*sizeof(vertex);
+    Subbuf.Indices.Source = FallbackIndices;
+    Subbuf.Indices.ByteCount = FallbackIndexCount*sizeof(uint32_t);
+    Subbuf.IndexType = VK_INDEX_TYPE_UINT32;
+    return Subbuf;
+}
+
+static vulkan_image_description LoadStaticImage(vulkan_surface_device *Device, asset_pack *Assets, const char **AssetNames, uint32_t AssetNameCount, vulkan_image_description Fallback) {
+    // NOTE(blackedout): The first KTX2 texture whose format the device can sample is uploaded straight from the mapped asset pack, so the
+    // same texture can be packed in several block formats (e.g. BC7 and ASTC) and the device picks. Without any, Fallback is used.
+    for(uint32_t I = 0; I < AssetNameCount; ++I) {
+        const uint8_t *Bytes;
+        uint64_t ByteCount;
+        texture_view View;
+        if(AssetPackFind(Assets, AssetNames[I], &Bytes, &ByteCount) || TextureViewFromKtx2(Bytes, ByteCount, &View)) {
+            continue;
+        }
+        VkFormatProperties FormatProperties;
+        vkGetPhysicalDeviceFormatProperties(Device->PhysicalDevice, View.Format, &FormatProperties);
+        VkFormatFeatureFlags RequiredFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if((FormatProperties.optimalTilingFeatures & RequiredFeatures) != RequiredFeatures) {
+            continue;
+        }
+
+        vulkan_image_description Description = Fallback;
+        Description.Format = View.Format;
+        Description.Width = View.Width;
+        Description.Height = View.Height;
+        Description.Depth = 1;
+        Description.BlockWidth = View.Block.Width;
+        Description.BlockHeight = View.Block.Height;
+        Description.BlockByteCount = View.Block.ByteCount;
+        Description.Source = View.Bytes;
+        Description.ByteCount = View.ByteCount;
+        Description.LevelCount = View.LevelCount;
+        memcpy(Description.LevelOffsets, View.LevelOffsets, sizeof(Description.LevelOffsets));
+        return Description;
+    }
+    return Fallback;
+}
+
+static void SetPipelineVertexFormat(vulkan_graphics_pipeline_description *Description, mesh_vertex_format Format, shaders *Shaders) {
+    VkVertexInputBindingDescription Binding = {
+        .binding = 0,
+        .stride = MeshVertexByteCount(Format),
+        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+    };
+    VkVertexInputAttributeDescription FloatAttributes[] = {
+        { .location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(vertex, Position) },
+        { .location = 1, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(vertex, Normal) },
+        { .location = 2, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(vertex, TexCoord) },
+    };
+    VkVertexInputAttributeDescription QuantizedAttributes[] = {
+        { .location = 0, .binding = 0, .format = VK_FORMAT_R16G16B16A16_SNORM, .offset = offsetof(vertex_quantized, Position) },
+        { .location = 1, .binding = 0, .format = VK_FORMAT_R16G16_SNORM, .offset = offsetof(vertex_quantized, Normal) },
+        { .location = 2, .binding = 0, .format = VK_FORMAT_R16G16_SFLOAT, .offset = offsetof(vertex_quantized, TexCoord) },
+    };
+
+    Description->VertexBindingCount = 1;
+    Description->VertexBindings[0] = Binding;
+    if(Format == MESH_VERTEX_FORMAT_QUANTIZED) {
+        Description->ModuleVS = Shaders->QuantizedVert;
+        Description->VertexAttributeCount = ArrayCount(QuantizedAttributes);
+        memcpy(Description->VertexAttributes, QuantizedAttributes, sizeof(QuantizedAttributes));
+    } else {
+        Description->ModuleVS = Shaders->Default.Vert;
+        Description->VertexAttributeCount = ArrayCount(FloatAttributes);
+        memcpy(Description->VertexAttributes, FloatAttributes, sizeof(FloatAttributes));
+    }
+}
+
+static uint32_t SelectSubmeshLod(const mesh_submesh *Submesh, const m4 *M, const m4 *View, float PixelsPerUnit) {
+    // NOTE(blackedout): M is column major, View row major. The submesh's bounding sphere is transformed to view space and its nearest point
+    // to the camera is used to project the level errors (object space units) to pixels. PixelsPerUnit is the size of a unit at distance 1.
+    const float *Center = Submesh->Bounds.Center.E;
+    float WorldCenter[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    float MaxScaleSquared = 0.0f;
+    for(uint32_t Row = 0; Row < 3; ++Row) {
+        WorldCenter[Row] = M->E[Row]*Center[0] + M->E[4 + Row]*Center[1] + M->E[8 + Row]*Center[2] + M->E[12 + Row];
+        float ScaleSquared = M->E[4*Row]*M->E[4*Row] + M->E[4*Row + 1]*M->E[4*Row + 1] + M->E[4*Row + 2]*M->E[4*Row + 2];
+        MaxScaleSquared = Max(MaxScaleSquared, ScaleSquared);
+    }
+    float DistanceSquared = 0.0f;
+    for(uint32_t Row = 0; Row < 3; ++Row) {
+        float ViewCenter = View->E[4*Row]*WorldCenter[0] + View->E[4*Row + 1]*WorldCenter[1] + View->E[4*Row + 2]*WorldCenter[2] + View->E[4*Row + 3];
+        DistanceSquared += ViewCenter*ViewCenter;
+    }
+    float MaxScale = sqrtf(MaxScaleSquared);
+    float Distance = Max(sqrtf(DistanceSquared) - Submesh->Bounds.Radius*MaxScale, CAMERA_NEAR);
+    float ErrorToPixels = PixelsPerUnit*MaxScale/Distance;
+
+    uint32_t Lod = 0;
+    while(Lod + 1 < Submesh->LodCount && Submesh->Lods[Lod + 1].Error*ErrorToPixels <= LOD_MAX_PIXEL_ERROR) {
+        ++Lod;
+    }
+    return Lod;
+}
+
+static void DrawStaticMesh(static_mesh_frame *Frame, const static_mesh_draw *Draw) {
+    static_mesh *Mesh = Draw->Mesh;
+    default_push_constants PushConstants = Draw->PushConstants;
+    if(Mesh->VertexFormat == MESH_VERTEX_FORMAT_QUANTIZED) {
+        // NOTE(blackedout): M is column major, so this is M*Translation(PositionOffset)*Scale(PositionScale)
+        float *M = PushConstants.M.E;
+        for(uint32_t Row = 0; Row < 4; ++Row) {
+            M[12 + Row] += M[Row]*Mesh->PositionOffset.E[0] + M[4 + Row]*Mesh->PositionOffset.E[1] + M[8 + Row]*Mesh->PositionOffset.E[2];
+            M[Row] *= Mesh->PositionScale.E[0];
+            M[4 + Row] *= Mesh->PositionScale.E[1];
+            M[8 + Row] *= Mesh->PositionScale.E[2];
+        }
+    }
+    VkCommandBuffer CommandBuffer = Frame->CommandBuffer;
+    if(Frame->BoundPipeline != Frame->Pipelines[Mesh->VertexFormat]) {
+        Frame->BoundPipeline = Frame->Pipelines[Mesh->VertexFormat];
+        vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Frame->BoundPipeline);
+    }
+    VkDescriptorSet TextureTableSet = Frame->TextureTableSets[PushConstants.TextureIndex/Frame->TextureTableSize];
+    if(Frame->BoundTextureTableSet != TextureTableSet) {
+        Frame->BoundTextureTableSet = TextureTableSet;
+        vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Frame->Layout, 1, 1, &TextureTableSet, 0, 0);
+    }
+    vkCmdPushConstants(CommandBuffer, Frame->Layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushConstants), &PushConstants);
+    vkCmdBindVertexBuffers(CommandBuffer, 0, 1, &Frame->MeshRegistry->Arenas[VULKAN_MESH_ARENA_VERTICES].Buffer.Handle, &Mesh->VerticesByteOffset);
+    vkCmdBindIndexBuffer(CommandBuffer, Frame->MeshRegistry->Arenas[VULKAN_MESH_ARENA_INDICES].Buffer.Handle, Mesh->IndicesByteOffset, Mesh->IndexType);
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        const mesh_submesh *Submesh = Mesh->Submeshes + I;
+        uint32_t Lod = SelectSubmeshLod(Submesh, &Draw->PushConstants.M, &Frame->View, Frame->PixelsPerUnit);
+        if(Lod == 0 && Submesh->MeshletCount > 0 && Draw->FirstClusterCommand != UINT32_MAX) {
+            // NOTE(blackedout): Same decision as in CullStaticMesh, so the commands of these meshlets were written this frame
+            uint32_t Stride = sizeof(VkDrawIndexedIndirectCommand);
+            uint64_t ByteOffset = (uint64_t)(Draw->FirstClusterCommand + Submesh->MeshletOffset)*Stride;
+            for(uint32_t J = 0; J < Submesh->MeshletCount; J += Frame->MaxDrawIndirectCount) {
+                uint32_t DrawCount = Min(Submesh->MeshletCount - J, Frame->MaxDrawIndirectCount);
+                vkCmdDrawIndexedIndirect(CommandBuffer, Frame->ClusterCommands, ByteOffset + (uint64_t)J*Stride, DrawCount, Stride);
+            }
+        } else if(Frame->CullingPhase != CLUSTER_CULLING_PHASE_SECOND) {
+            vkCmdDrawIndexed(CommandBuffer, Submesh->Lods[Lod].IndexCount, 1, Submesh->Lods[Lod].IndexOffset, (int32_t)Submesh->VertexOffset, 0);
+        }
+    }
+}
+
+// MARK: Cluster Culling
+// NOTE(blackedout): Meshlets (see mesh_meshlet) of submeshes drawn at level 0 are culled against the view frustum and their normal cones by
+// cull.comp before the render pass. It writes an indexed indirect draw command per meshlet, culled ones with an instance count of 0, and
+// DrawStaticMesh draws these commands instead of the whole submesh.
+static int CreateComputePipeline(vulkan_surface_device *Device, VkPipelineLayout Layout, VkShaderModule Module, VkPipeline *OutPipeline) {
+    VkComputePipelineCreateInfo CreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = 0,
+        .flags = 0,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = Module,
+            .pName = "main",
+            .pSpecializationInfo = 0,
+        },
+        .layout = Layout,
+        .basePipelineHandle = VULKAN_NULL_HANDLE,
+        .basePipelineIndex = -1,
+    };
+    VulkanCheckGoto(vkCreateComputePipelines(Device->Handle, VULKAN_NULL_HANDLE, 1, &CreateInfo, 0, OutPipeline), label_Error);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void DestroyClusterCuller(vulkan_surface_device *Device, cluster_culler *Culler) {
+    VkDevice DeviceHandle = Device->Handle;
+    vkDestroyPipeline(DeviceHandle, Culler->Pipeline, 0);
+    VulkanDestroyBuffer(Device, &Culler->Visibility);
+    vkDestroyPipelineLayout(DeviceHandle, Culler->PipelineLayout, 0);
+    VulkanDestroyDescriptorSetLayouts(Device, &Culler->SetLayout, 1);
+    memset(Culler, 0, sizeof(*Culler));
+}
+
+static int CreateClusterCuller(vulkan_surface_device *Device, shaders *Shaders, cluster_culler *Culler) {
+    // NOTE(blackedout): Everything that was created is destroyed on failure, DestroyClusterCuller ignores null handles.
+    VkDevice DeviceHandle = Device->Handle;
+    memset(Culler, 0, sizeof(*Culler));
+    {
+        VkDescriptorSetLayoutBinding Bindings[] = {
+            { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+            { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+            { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+            { .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+        };
+        vulkan_descriptor_set_layout_description SetDescription = { .Flags = 0, .Bindings = Bindings, .BindingsCount = ArrayCount(Bindings) };
+        CheckGoto(VulkanCreateDescriptorSetLayouts(Device, &SetDescription, 1, &Culler->SetLayout), label_Error);
+
+        VkDescriptorSetLayout SetLayouts[] = { Shaders->DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_UNIFORM], Culler->SetLayout };
+        VkPushConstantRange PushConstantRange = {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(cluster_culling_push_constants),
+        };
+        VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .setLayoutCount = ArrayCount(SetLayouts),
+            .pSetLayouts = SetLayouts,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &PushConstantRange,
+        };
+        VulkanCheckGoto(vkCreatePipelineLayout(DeviceHandle, &PipelineLayoutCreateInfo, 0, &Culler->PipelineLayout), label_Error);
+        CheckGoto(CreateComputePipeline(Device, Culler->PipelineLayout, Shaders->CullComp, &Culler->Pipeline), label_Error);
+        Culler->PipelineModule = Shaders->CullComp;
+
+        // NOTE(blackedout): Shared by all frames, it is imported into every frame graph
+        uint64_t VisibilityByteCount = CLUSTER_CULLING_MAX_COMMAND_COUNT*sizeof(uint32_t);
+        CheckGoto(VulkanCreateExclusiveBufferWithMemory(Device, VisibilityByteCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VULKAN_MEMORY_SUBSYSTEM_OTHER, &Culler->Visibility), label_Error);
+    }
+    return 0;
+
+label_Error:
+    DestroyClusterCuller(Device, Culler);
+    return 1;
+}
+
+static void UpdateComputePipeline(vulkan_surface_device *Device, vulkan_pipeline_compiler *Compiler, VkPipelineLayout Layout, VkShaderModule Module, VkPipeline *Pipeline, VkShaderModule *PipelineModule) {
+    // NOTE(blackedout): Recreates the pipeline after its shader was reloaded. The old one may still be used by a frame in flight, so it is
+    // retired like replaced graphics pipelines. If the new one can't be created, the old one is kept.
+    if(*PipelineModule == Module || *Pipeline == VULKAN_NULL_HANDLE) {
+        return;
+    }
+    VkPipeline NewPipeline;
+    if(CreateComputePipeline(Device, Layout, Module, &NewPipeline) == 0) {
+        VulkanRetirePipeline(Compiler, *Pipeline);
+        *Pipeline = NewPipeline;
+    }
+    *PipelineModule = Module;
+}
+
+static void CullStaticMesh(static_mesh_frame *Frame, cluster_culler *Culler, static_mesh_draw *Draw) {
+    // NOTE(blackedout): Commands are reserved for all meshlets of the mesh, but only written for submeshes that are drawn at level 0.
+    // The second phase uses the commands reserved by the first. Expects the culling pipeline and descriptor sets to be bound.
+    static_mesh *Mesh = Draw->Mesh;
+    if(Frame->CullingPhase != CLUSTER_CULLING_PHASE_SECOND) {
+        Draw->FirstClusterCommand = UINT32_MAX;
+        if(Mesh->MeshletCount == 0 || Culler->CommandCount + Mesh->MeshletCount > CLUSTER_CULLING_MAX_COMMAND_COUNT) {
+            return;
+        }
+        Draw->FirstClusterCommand = Culler->CommandCount;
+        Culler->CommandCount += Mesh->MeshletCount;
+    } else if(Draw->FirstClusterCommand == UINT32_MAX) {
+        return;
+    }
+    const float *M = Draw->PushConstants.M.E;
+    float MinScaleSquared = 0.0f, MaxScaleSquared = 0.0f;
+    for(uint32_t Column = 0; Column < 3; ++Column) {
+        float ScaleSquared = M[4*Column]*M[4*Column] + M[4*Column + 1]*M[4*Column + 1] + M[4*Column + 2]*M[4*Column + 2];
+        MinScaleSquared = (Column == 0)? ScaleSquared : Min(MinScaleSquared, ScaleSquared);
+        MaxScaleSquared = Max(MaxScaleSquared, ScaleSquared);
+    }
+    cluster_culling_push_constants PushConstants = {
+        .M = Draw->PushConstants.M,
+        .MaxScale = sqrtf(MaxScaleSquared),
+        .IsConeCullingEnabled = MaxScaleSquared <= 1.002f*MinScaleSquared,
+        .Phase = Frame->CullingPhase,
+    };
+    for(uint32_t I = 0; I < Mesh->SubmeshCount; ++I) {
+        const mesh_submesh *Submesh = Mesh->Submeshes + I;
+        if(Submesh->MeshletCount == 0 || SelectSubmeshLod(Submesh, &Draw->PushConstants.M, &Frame->View, Frame->PixelsPerUnit) != 0) {
+            continue;
+        }
+        PushConstants.MeshletOffset = (uint32_t)(Mesh->MeshletsByteOffset/sizeof(mesh_meshlet)) + Submesh->MeshletOffset;
+        PushConstants.MeshletCount = Submesh->MeshletCount;
+        PushConstants.VisibilityOffset = Draw->FirstClusterCommand + Submesh->MeshletOffset;
+        PushConstants.CommandOffset = PushConstants.VisibilityOffset;
+        vkCmdPushConstants(Frame->CommandBuffer, Culler->PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &PushConstants);
+        vkCmdDispatch(Frame->CommandBuffer, (Submesh->MeshletCount + CLUSTER_CULLING_GROUP_SIZE - 1)/CLUSTER_CULLING_GROUP_SIZE, 1, 1);
+    }
+}
+
+static void CullStaticMeshes(static_mesh_frame *Frame, cluster_culler *Culler, VkDescriptorSet *Sets, static_mesh_draw *Draws, uint32_t DrawCount) {
+    // NOTE(blackedout): Sets are the uniform set and the culling set. The commands written here are read by the next render pass.
+    vkCmdBindPipeline(Frame->CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Culler->Pipeline);
+    vkCmdBindDescriptorSets(Frame->CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Culler->PipelineLayout, 0, 2, Sets, 0, 0);
+    if(Frame->CullingPhase != CLUSTER_CULLING_PHASE_SECOND) {
+        Culler->CommandCount = 0;
+    }
+    for(uint32_t I = 0; I < DrawCount; ++I) {
+        CullStaticMesh(Frame, Culler, Draws + I);
+    }
+}
+
+// MARK: Occlusion Culling
+// NOTE(blackedout): Two phase occlusion culling of meshlets, see cull.comp. The first render pass draws everything that isn't culled per
+// meshlet and the meshlets that were visible last frame. Its depth is reduced into a pyramid of farthest depths by depthpyramid.comp, which
+// the second culling phase tests the remaining meshlets against before the second render pass draws the newly visible ones.
+static void GetDepthPyramidSize(VkExtent2D SourceExtent, depth_pyramid *Pyramid) {
+    // NOTE(blackedout): Level 0 is the largest power of two that fits into the source in each dimension, so that every level halves exactly
+    uint32_t Width = 1, Height = 1;
+    while(2*Width <= SourceExtent.width) {
+        Width *= 2;
+    }
+    while(2*Height <= SourceExtent.height) {
+        Height *= 2;
+    }
+    uint32_t LevelCount = 1;
+    while(LevelCount < DEPTH_PYRAMID_MAX_LEVEL_COUNT && (Max(Width, Height) >> LevelCount) > 0) {
+        ++LevelCount;
+    }
+    Pyramid->Width = Width;
+    Pyramid->Height = Height;
+    Pyramid->LevelCount = LevelCount;
+}
+
+static VkShaderModule GetDepthPyramidModule(shaders *Shaders, VkSampleCountFlagBits SampleCount) {
+    // NOTE(blackedout): A depth attachment without multisampling can't be bound as a sampler2DMS, so it uses the variant that fetches from a sampler2D
+    return (SampleCount == VK_SAMPLE_COUNT_1_BIT)? Shaders->DepthPyramidSingleSampledComp : Shaders->DepthPyramidComp;
+}
+
+static void DestroyOcclusionCuller(vulkan_surface_device *Device, occlusion_culler *Culler) {
+    VkDevice DeviceHandle = Device->Handle;
+    vkDestroySampler(DeviceHandle, Culler->Sampler, 0);
+    vkDestroyPipeline(DeviceHandle, Culler->Pipeline, 0);
+    vkDestroyPipelineLayout(DeviceHandle, Culler->PipelineLayout, 0);
+    VulkanDestroyDescriptorSetLayouts(Device, &Culler->SetLayout, 1);
+    memset(Culler, 0, sizeof(*Culler));
+}
+
+static int CreateOcclusionCuller(vulkan_surface_device *Device, shaders *Shaders, VkSampleCountFlagBits SampleCount, occlusion_culler *Culler) {
+    // NOTE(blackedout): Not being supported isn't an error. Everything that was created is destroyed on failure.
+    VkDevice DeviceHandle = Device->Handle;
+    memset(Culler, 0, sizeof(*Culler));
+    if(VulkanIsDepthSampleable(Device) == 0) {
+        printfc(CODE_YELLOW, "Occlusion culling is not supported, the depth format can't be sampled.\n");
+        return 0;
+    }
+    {
+        VkDescriptorSetLayoutBinding Bindings[] = {
+            { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+            { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+            { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+        };
+        vulkan_descriptor_set_layout_description SetDescription = { .Flags = 0, .Bindings = Bindings, .BindingsCount = ArrayCount(Bindings) };
+        CheckGoto(VulkanCreateDescriptorSetLayouts(Device, &SetDescription, 1, &Culler->SetLayout), label_Error);
+
+        VkPushConstantRange PushConstantRange = {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(depth_pyramid_push_constants),
+        };
+        VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .setLayoutCount = 1,
+            .pSetLayouts = &Culler->SetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &PushConstantRange,
+        };
+        VulkanCheckGoto(vkCreatePipelineLayout(DeviceHandle, &PipelineLayoutCreateInfo, 0, &Culler->PipelineLayout), label_Error);
+        VkShaderModule Module = GetDepthPyramidModule(Shaders, SampleCount);
+        CheckGoto(CreateComputePipeline(Device, Culler->PipelineLayout, Module, &Culler->Pipeline), label_Error);
+        Culler->PipelineModule = Module;
+
+        // NOTE(blackedout): Only read with texelFetch
+        VkSamplerCreateInfo SamplerCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .magFilter = VK_FILTER_NEAREST,
+            .minFilter = VK_FILTER_NEAREST,
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .mipLodBias = 0.0f,
+            .anisotropyEnable = VK_FALSE,
+            .maxAnisotropy = 1.0f,
+            .compareEnable = VK_FALSE,
+            .compareOp = VK_COMPARE_OP_ALWAYS,
+            .minLod = 0.0f,
+            .maxLod = VK_LOD_CLAMP_NONE,
+            .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE,
+            .unnormalizedCoordinates = VK_FALSE
+        };
+        VulkanCheckGoto(vkCreateSampler(DeviceHandle, &SamplerCreateInfo, 0, &Culler->Sampler), label_Error);
+        Culler->IsSupported = 1;
+    }
+    return 0;
+
+label_Error:
+    DestroyOcclusionCuller(Device, Culler);
+    return 1;
+}
+
+static int AllocateDepthPyramidSets(occlusion_culler *Culler, vulkan_descriptor_allocator *Descriptors, vulkan_acquired_image AcquiredImage, depth_pyramid *Pyramid) {
+    // NOTE(blackedout): Every level reads the depth attachment or the levels before, and writes its own level
+    for(uint32_t Level = 0; Level < Pyramid->LevelCount; ++Level) {
+        vulkan_descriptor_binding Bindings[] = {
+            { .Type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .Binding = 0, .ImageView = AcquiredImage.DepthImageView, .Sampler = Culler->Sampler, .ImageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL },
+            { .Type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .Binding = 1, .ImageView = Pyramid->View, .Sampler = Culler->Sampler, .ImageLayout = VK_IMAGE_LAYOUT_GENERAL },
+            { .Type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .Binding = 2, .ImageView = Pyramid->LevelViews[Level], .ImageLayout = VK_IMAGE_LAYOUT_GENERAL },
+        };
+        CheckGoto(VulkanAllocateTransientDescriptorSet(Descriptors, AcquiredImage.DataIndex, Culler->SetLayout, Bindings, ArrayCount(Bindings), Pyramid->Sets + Level), label_Error);
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void BuildDepthPyramid(occlusion_culler *Culler, depth_pyramid *Pyramid, VkExtent2D SourceExtent, VkSampleCountFlagBits SampleCount, VkCommandBuffer CommandBuffer) {
+    // NOTE(blackedout): Expects the depth attachment in VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL after the first render pass and the
+    // pyramid in VK_IMAGE_LAYOUT_GENERAL. Every level waits for the one before, the frame graph makes the last one visible to cull.comp.
+    vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Culler->Pipeline);
+    for(uint32_t Level = 0; Level < Pyramid->LevelCount; ++Level) {
+        vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Culler->PipelineLayout, 0, 1, Pyramid->Sets + Level, 0, 0);
+
+        uint32_t Width = Max(Pyramid->Width >> Level, 1);
+        uint32_t Height = Max(Pyramid->Height >> Level, 1);
+        depth_pyramid_push_constants PushConstants = {
+            .SourceSize = { (int32_t)SourceExtent.width, (int32_t)SourceExtent.height },
+            .Size = { (int32_t)Width, (int32_t)Height },
+            .LevelIndex = (int32_t)Level,
+            .SampleCount = (int32_t)SampleCount,
+        };
+        if(Level > 0) {
+            PushConstants.SourceSize[0] = (int32_t)Max(Pyramid->Width >> (Level - 1), 1);
+            PushConstants.SourceSize[1] = (int32_t)Max(Pyramid->Height >> (Level - 1), 1);
+        }
+        vkCmdPushConstants(CommandBuffer, Culler->PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &PushConstants);
+        vkCmdDispatch(CommandBuffer, (Width + DEPTH_PYRAMID_GROUP_SIZE - 1)/DEPTH_PYRAMID_GROUP_SIZE, (Height + DEPTH_PYRAMID_GROUP_SIZE - 1)/DEPTH_PYRAMID_GROUP_SIZE, 1);
+
+        if(Level + 1 < Pyramid->LevelCount) {
+            VkMemoryBarrier Barrier = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext = 0,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            };
+            vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &Barrier, 0, 0, 0, 0);
+        }
+    }
+}
+
+// MARK: Clustered Lighting
+// NOTE(blackedout): Point and spot lights are binned into a grid of clusters (CLUSTERED_LIGHTING_GRID_X*CLUSTERED_LIGHTING_GRID_Y screen space
+// tiles times CLUSTERED_LIGHTING_GRID_Z exponential depth slices) by lightbin.comp before the render pass. default.frag only loops over the
+// lights of its fragment's cluster, so the cost per pixel depends on how many lights overlap there, not on how many lights there are.
+static void DestroyClusteredLighting(vulkan_surface_device *Device, clustered_lighting *Lighting) {
+    VkDevice DeviceHandle = Device->Handle;
+    vkDestroyPipeline(DeviceHandle, Lighting->Pipeline, 0);
+    for(uint32_t I = 0; I < MAX_ACQUIRED_IMAGE_COUNT; ++I) {
+        VulkanDestroyBuffer(Device, Lighting->Lights + I);
+    }
+    vkDestroyPipelineLayout(DeviceHandle, Lighting->PipelineLayout, 0);
+    memset(Lighting, 0, sizeof(*Lighting));
+}
+
+static int CreateClusteredLighting(vulkan_surface_device *Device, shaders *Shaders, clustered_lighting *Lighting) {
+    // NOTE(blackedout): Everything that was created is destroyed on failure, DestroyClusteredLighting ignores null handles.
+    VkDevice DeviceHandle = Device->Handle;
+    memset(Lighting, 0, sizeof(*Lighting));
+    {
+        VkDescriptorSetLayout SetLayouts[] = { Shaders->DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_UNIFORM], Shaders->DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_CLUSTERED_LIGHTS] };
+        VkPushConstantRange PushConstantRange = {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(light_binning_push_constants),
+        };
+        VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .setLayoutCount = ArrayCount(SetLayouts),
+            .pSetLayouts = SetLayouts,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &PushConstantRange,
+        };
+        VulkanCheckGoto(vkCreatePipelineLayout(DeviceHandle, &PipelineLayoutCreateInfo, 0, &Lighting->PipelineLayout), label_Error);
+        CheckGoto(CreateComputePipeline(Device, Lighting->PipelineLayout, Shaders->LightBinComp, &Lighting->Pipeline), label_Error);
+        Lighting->PipelineModule = Shaders->LightBinComp;
+
+        uint64_t LightsByteCount = CLUSTERED_LIGHTING_MAX_LIGHT_COUNT*sizeof(clustered_light);
+        for(uint32_t I = 0; I < MAX_ACQUIRED_IMAGE_COUNT; ++I) {
+            CheckGoto(VulkanCreateSharedBufferWithMemory(Device, LightsByteCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_SUBSYSTEM_UNIFORMS, Lighting->Lights + I), label_Error);
+        }
+    }
+    return 0;
+
+label_Error:
+    DestroyClusteredLighting(Device, Lighting);
+    return 1;
+}
+
+static void PlaceSceneLights(float Time, uint32_t LightCount, clustered_light *Lights) {
+    // NOTE(blackedout): Lights on a slowly turning spiral over the plane. Their range shrinks with their density, so that about the same
+    // number of lights overlaps at every point, whatever the count. Every fourth light is a spot light pointing down.
+    float Spacing = sqrtf(16.0f*16.0f/(float)Max(LightCount, 1));
+    for(uint32_t I = 0; I < LightCount; ++I) {
+        float T = ((float)I + 0.5f)/(float)LightCount;
+        float Radius = 8.0f*sqrtf(T);
+        float Angle = 2.3999632f*(float)I + 0.1f*Time; // NOTE(blackedout): Golden angle
+        float Hue = 6.2831853f*T*7.0f;
+        clustered_light Light = {
+            .Position = { Radius*cosf(Angle), -0.3f + 0.15f*sinf(Time + (float)I), Radius*sinf(Angle) },
+            .Range = 3.0f*Spacing,
+            .Color = { 0.5f + 0.5f*cosf(Hue), 0.5f + 0.5f*cosf(Hue - 2.0943951f), 0.5f + 0.5f*cosf(Hue - 4.1887902f) },
+            .SpotOuterCos = -2.0f,
+            .Direction = { 0.0f, -1.0f, 0.0f },
+            .SpotInnerCos = -1.0f,
+        };
+        if(I % 4 == 3) {
+            Light.Position.E[1] += 0.5f;
+            Light.Range *= 1.5f;
+            Light.SpotOuterCos = cosf(0.6f);
+            Light.SpotInnerCos = cosf(0.4f);
+        }
+        Lights[I] = Light;
+    }
+}
+
+static void BinClusteredLights(clustered_lighting *Lighting, VkCommandBuffer CommandBuffer, VkDescriptorSet *Sets, uint32_t LightCount) {
+    // NOTE(blackedout): Sets are the uniform set and the clustered lights set. The lights have to be written already and the light index
+    // count has to be cleared.
+    light_binning_push_constants PushConstants = {
+        .LightCount = LightCount,
+        .LightIndexCapacity = CLUSTERED_LIGHTING_LIGHT_INDEX_CAPACITY,
+    };
+    vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Lighting->Pipeline);
+    vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Lighting->PipelineLayout, 0, 2, Sets, 0, 0);
+    vkCmdPushConstants(CommandBuffer, Lighting->PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &PushConstants);
+    vkCmdDispatch(CommandBuffer, CLUSTERED_LIGHTING_GRID_X, CLUSTERED_LIGHTING_GRID_Y, CLUSTERED_LIGHTING_GRID_Z);
+}
+
+static void ComputeFrustumPlanes(m4 ViewProjection, v4 *OutPlanes) {
+    // NOTE(blackedout): Gribb, Hartmann 2001, "Fast Extraction of Viewing Frustum Planes from the World-View-Projection Matrix".
+    // ViewProjection is row major, clip space depth is 0 to 1.
+    const float *R = ViewProjection.E;
+    float Signs[] = { 1.0f, -1.0f };
+    for(uint32_t I = 0; I < 6; ++I) {
+        uint32_t Row = I/2;
+        float Sign = Signs[I % 2];
+        float Length = 0.0f;
+        for(uint32_t L = 0; L < 4; ++L) {
+            // NOTE(blackedout): The near plane is just the z row, because depth isn't negative
+            OutPlanes[I].E[L] = (I == 4)? R[8 + L] : R[12 + L] + Sign*R[4*Row + L];
+            Length += (L < 3)? OutPlanes[I].E[L]*OutPlanes[I].E[L] : 0.0f;
+        }
+        Length = sqrtf(Length);
+        for(uint32_t L = 0; L < 4; ++L) {
+            OutPlanes[I].E[L] /= Length;
+        }
+    }
+}
+
+// MARK: Frame Passes
+// NOTE(blackedout): The passes of a frame record their commands from this, in the order of the frame graph. Frame graph resources only
+// exist after the graph was compiled, so the descriptor sets that refer to them are allocated before it is executed.
+typedef struct {
+    context *Context;
+    vulkan_frame_graph *Graph;
+    vulkan_acquired_image AcquiredImage;
+    static_mesh_frame Frame;
+    static_mesh_draw *Draws;
+    uint32_t DrawCount;
+    int ArePipelinesReady;
+    int IsLit; // NOTE(blackedout): Whether the fragment shader reads the clustered lights
+    VkRenderPassBeginInfo RenderPassBeginInfo;
+    VkViewport Viewport;
+    VkRect2D Scissors;
+    uint32_t ClusterCommands[2]; // NOTE(blackedout): Frame graph resources, per phase
+    uint32_t Clusters;
+    uint32_t LightIndices;
+    VkDescriptorSet CullingSets[2][2]; // NOTE(blackedout): Per phase, the uniform set and the culling set
+    VkDescriptorSet LightingSets[2];
+    depth_pyramid Pyramid;
+} frame_render;
+
+typedef struct {
+    frame_render *Render;
+    uint32_t Index;
+    cluster_culling_phase Phase;
+    VkRenderPass RenderPass;
+} frame_render_phase;
+
+static void RecordClearVisibility(void *Data, VkCommandBuffer CommandBuffer) {
+    frame_render *Render = (frame_render *)Data;
+    vkCmdFillBuffer(CommandBuffer, Render->Context->ClusterCuller.Visibility.Handle, 0, VK_WHOLE_SIZE, 0);
+}
+
+static void RecordClearLightCount(void *Data, VkCommandBuffer CommandBuffer) {
+    frame_render *Render = (frame_render *)Data;
+    vkCmdFillBuffer(CommandBuffer, Render->Graph->Resources[Render->LightIndices].Buffer, 0, sizeof(uint32_t), 0);
+}
+
+static void RecordBinLights(void *Data, VkCommandBuffer CommandBuffer) {
+    frame_render *Render = (frame_render *)Data;
+    BinClusteredLights(&Render->Context->ClusteredLighting, CommandBuffer, Render->LightingSets, Render->Context->LightCount);
+}
+
+static void RecordCull(void *Data, VkCommandBuffer CommandBuffer) {
+    frame_render_phase *Phase = (frame_render_phase *)Data;
+    frame_render *Render = Phase->Render;
+    Render->Frame.CommandBuffer = CommandBuffer;
+    Render->Frame.CullingPhase = Phase->Phase;
+    Render->Frame.ClusterCommands = Render->Graph->Resources[Render->ClusterCommands[Phase->Index]].Buffer;
+    CullStaticMeshes(&Render->Frame, &Render->Context->ClusterCuller, Render->CullingSets[Phase->Index], Render->Draws, Render->DrawCount);
+}
+
+static void RecordDraw(void *Data, VkCommandBuffer CommandBuffer) {
+    // NOTE(blackedout): Until the pipelines are ready, the frame is only cleared
+    frame_render_phase *Phase = (frame_render_phase *)Data;
+    frame_render *Render = Phase->Render;
+    context *Context = Render->Context;
+    Render->Frame.CommandBuffer = CommandBuffer;
+    Render->Frame.CullingPhase = Phase->Phase;
+    Render->Frame.ClusterCommands = Render->Graph->Resources[Render->ClusterCommands[Phase->Index]].Buffer;
+    Render->Frame.BoundPipeline = VULKAN_NULL_HANDLE;
+    Render->Frame.BoundTextureTableSet = Context->Shaders.TextureTableSets[0];
+
+    VkRenderPassBeginInfo RenderPassBeginInfo = Render->RenderPassBeginInfo;
+    RenderPassBeginInfo.renderPass = Phase->RenderPass;
+    vkCmdBeginRenderPass(CommandBuffer, &RenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    if(Render->ArePipelinesReady) {
+        vkCmdSetViewport(CommandBuffer, 0, 1, &Render->Viewport);
+        vkCmdSetScissor(CommandBuffer, 0, 1, &Render->Scissors);
+
+        // NOTE(blackedout): Without lighting, the clustered lights weren't binned and their set isn't bound
+        VkDescriptorSet DefaultSets[] = { Context->Shaders.UniformMatsSets[Render->AcquiredImage.DataIndex], Context->Shaders.TextureTableSets[0], Render->LightingSets[1] };
+        uint32_t DefaultSetCount = Render->IsLit? ArrayCount(DefaultSets) : ArrayCount(DefaultSets) - 1;
+        vkCmdBindDescriptorSets(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Context->GraphicsPipelineLayout, 0, DefaultSetCount, DefaultSets, 0, 0);
+        for(uint32_t I = 0; I < Render->DrawCount; ++I) {
+            DrawStaticMesh(&Render->Frame, Render->Draws + I);
+        }
+    }
+    vkCmdEndRenderPass(CommandBuffer);
+}
+
+static void RecordBuildDepthPyramid(void *Data, VkCommandBuffer CommandBuffer) {
+    frame_render *Render = (frame_render *)Data;
+    BuildDepthPyramid(&Render->Context->OcclusionCuller, &Render->Pyramid, Render->AcquiredImage.Extent, Render->Context->SampleCount, CommandBuffer);
+}
+
 static void ProgramSetdown(context *Context, vulkan_surface_device *Device) {
     VkDevice DeviceHandle = Device->Handle;
-    VulkanDestroyDefaultGraphicsPipeline(Device, Context->GraphicsPipelineLayout, Context->RenderPass, Context->GraphicsPipeline);
+    VulkanPrintPipelineStateCacheStats(&Context->PipelineStates);
+    VulkanPrintDescriptorAllocatorStats(&Context->Descriptors);
+    VulkanPrintMeshRegistryStats(&Context->MeshRegistry);
+    VulkanPrintMemoryStats(Device);
+    VulkanDestroyPipelineCompiler(&Context->PipelineCompiler);
+    DestroyShaderReloader(&Context->ShaderReloader);
+    VulkanDestroyPipelineStateCache(&Context->PipelineStates);
+    for(uint32_t I = 0; I < ArrayCount(Context->FrameGraphs); ++I) {
+        VulkanDestroyFrameGraph(Context->FrameGraphs + I);
+    }
+    DestroyOcclusionCuller(Device, &Context->OcclusionCuller);
+    VulkanDestroyDefaultGraphicsPipeline(Device, Context->GraphicsPipelineLayout, Context->RenderPass, VULKAN_NULL_HANDLE);
+    DestroyClusteredLighting(Device, &Context->ClusteredLighting);
+    DestroyClusterCuller(Device, &Context->ClusterCuller);
     DestroyShaders(Device, &Context->Shaders);
-    VulkanDestroyStaticBuffersAndImages(Device, &Context->StaticBuffers, Context->Images, STATIC_IMAGE_COUNT);
+    VulkanDestroyDescriptorAllocator(&Context->Descriptors);
+    VulkanDestroyStaticImages(Device, Context->Images, STATIC_IMAGE_COUNT);
+    VulkanDestroyMeshRegistry(Device, &Context->MeshRegistry);
+    WorkPoolDestroy(&Context->Workers);
+    for(uint32_t I = 0; I < ArrayCount(Context->ComputeSemaphores); ++I) {
+        vkDestroySemaphore(DeviceHandle, Context->ComputeSemaphores[I], 0);
+    }
+    vkDestroyCommandPool(DeviceHandle, Context->ComputeCommandPool, 0);
     vkDestroyCommandPool(DeviceHandle, Context->GraphicsCommandPool, 0);
+    AssetPackClose(&Context->Assets);
 }
 
 static int ProgramSetup(context *Context, vulkan_surface_device *Device, VkCommandBuffer *OutGraphicsCommandBuffer, VkQueue *OutGraphicsQueue, VkRenderPass *OutRenderPass, VkSampleCountFlagBits *OutSampleCount) {
@@ -211,6 +1133,12 @@ static int ProgramSetup(context *Context, vulkan_surface_device *Device, VkComma
     {
         Context->CamPol = -0.01f;
         Context->CamZoom = 1.0f;
+        Context->LightCount = 1024;
+
+        // NOTE(blackedout): Assets are read directly from the mapped pack. Without it, loose files are loaded instead.
+        if(AssetPackOpen("bin/assets.pack", &Context->Assets)) {
+            printfc(CODE_YELLOW, "Asset pack not available, loading loose files.\n");
+        }
 
         // NOTE(blackedout): Create command pools, buffer and get queue
         VkCommandPoolCreateInfo GraphicsCommandPoolCreateInfo = {
@@ -231,16 +1159,32 @@ static int ProgramSetup(context *Context, vulkan_surface_device *Device, VkComma
         VulkanCheckGoto(vkAllocateCommandBuffers(DeviceHandle, &GraphicsCommandBufferAllocateInfo, &Context->GraphicsCommandBuffer), label_GraphicsCommandPool);
         vkGetDeviceQueue(DeviceHandle, Device->GraphicsQueueFamilyIndex, 0, &Context->GraphicsQueue);
 
-        vulkan_mesh_subbuf MeshSubbufs[] = {
-            {
-                .Vertices = { .Source = PlaneVertices, .ByteCount = sizeof(PlaneVertices), .OffsetPointer = &Context->PlaneVerticesByteOffset },
-                .Indices = { .Source = PlaneIndices, .ByteCount = sizeof(PlaneIndices), .OffsetPointer = &Context->PlaneIndicesByteOffset }
-            },
-            {
-                .Vertices = { .Source = CubeVertices, .ByteCount = sizeof(CubeVertices), .OffsetPointer = &Context->CubeVerticesByteOffset },
-                .Indices = { .Source = CubeIndices, .ByteCount = sizeof(CubeIndices), .OffsetPointer = &Context->CubeIndicesByteOffset }
+        // NOTE(blackedout): Without an async compute queue, all passes of the frame graph are recorded into the graphics command buffer
+        if(Device->HasAsyncCompute) {
+            VkCommandPoolCreateInfo ComputeCommandPoolCreateInfo = GraphicsCommandPoolCreateInfo;
+            ComputeCommandPoolCreateInfo.queueFamilyIndex = Device->ComputeQueueFamilyIndex;
+            VulkanCheckGoto(vkCreateCommandPool(DeviceHandle, &ComputeCommandPoolCreateInfo, 0, &Context->ComputeCommandPool), label_GraphicsCommandPool);
+
+            VkCommandBufferAllocateInfo ComputeCommandBufferAllocateInfo = GraphicsCommandBufferAllocateInfo;
+            ComputeCommandBufferAllocateInfo.commandPool = Context->ComputeCommandPool;
+            VulkanCheckGoto(vkAllocateCommandBuffers(DeviceHandle, &ComputeCommandBufferAllocateInfo, &Context->ComputeCommandBuffer), label_ComputeCommandPool);
+            vkGetDeviceQueue(DeviceHandle, Device->ComputeQueueFamilyIndex, 0, &Context->ComputeQueue);
+
+            VkSemaphoreCreateInfo SemaphoreCreateInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = 0, .flags = 0 };
+            for(uint32_t I = 0; I < ArrayCount(Context->ComputeSemaphores); ++I) {
+                VulkanCheckGoto(vkCreateSemaphore(DeviceHandle, &SemaphoreCreateInfo, 0, Context->ComputeSemaphores + I), label_ComputeCommandPool);
             }
-        };
+        }
+
+        // NOTE(blackedout): Staging data is filled by all cores, the calling thread takes part in every run
+        CheckGoto(WorkPoolCreate(PlatformGetProcessorCount() - 1, &Context->Workers), label_ComputeCommandPool);
+
+        // NOTE(blackedout): The meshes are uploaded with the first frame
+        CheckGoto(VulkanCreateMeshRegistry(Device, &Context->Workers, &Context->MeshRegistry), label_Workers);
+        Context->PlaneMesh.Subbuf = LoadStaticMesh(&Context->Assets, "plane.mesh", PlaneVertices, ArrayCount(PlaneVertices), PlaneIndices, ArrayCount(PlaneIndices), &Context->PlaneMesh);
+        Context->CubeMesh.Subbuf = LoadStaticMesh(&Context->Assets, "cube.mesh", CubeVertices, ArrayCount(CubeVertices), CubeIndices, ArrayCount(CubeIndices), &Context->CubeMesh);
+        CheckGoto(VulkanAddMesh(&Context->MeshRegistry, Context->PlaneMesh.Subbuf, &Context->PlaneMesh.Handle), label_MeshRegistry);
+        CheckGoto(VulkanAddMesh(&Context->MeshRegistry, Context->CubeMesh.Subbuf, &Context->CubeMesh.Handle), label_MeshRegistry);
 
         uint8_t ColorImageBytes[] = {
             0xff, 0x20, 0x20, 0xff,
@@ -257,34 +1201,16 @@ static int ProgramSetup(context *Context, vulkan_surface_device *Device, VkComma
         vulkan_image_description StaticImageTile = { .Type = VK_IMAGE_TYPE_2D, .ViewType = VK_IMAGE_VIEW_TYPE_2D, .Format = VK_FORMAT_R8G8B8A8_SRGB, .Width = 2, .Height = 2, .Depth = 1, .ByteCount = sizeof(TileImageBytes), .Source = TileImageBytes };
         vulkan_image_description ImageDescriptions[STATIC_IMAGE_COUNT];
         SetZero(ImageDescriptions);
+        const char *TileAssetNames[] = { "tile.bc7.ktx2", "tile.astc.ktx2", "tile.ktx2" };
         ImageDescriptions[STATIC_IMAGE_COLOR] = StaticImageColor;
-        ImageDescriptions[STATIC_IMAGE_TILE] = StaticImageTile;
-        CheckGoto(VulkanCreateStaticBuffersAndImages(Device, MeshSubbufs, ArrayCount(MeshSubbufs), ImageDescriptions, ArrayCount(Context->Images), Context->GraphicsCommandPool, Context->GraphicsQueue, &Context->StaticBuffers, Context->Images), label_GraphicsCommandPool);
+        ImageDescriptions[STATIC_IMAGE_TILE] = LoadStaticImage(Device, &Context->Assets, TileAssetNames, ArrayCount(TileAssetNames), StaticImageTile);
+        CheckGoto(VulkanCreateStaticImages(Device, ImageDescriptions, ArrayCount(Context->Images), Context->GraphicsCommandPool, Context->GraphicsQueue, &Context->Workers, Context->Images), label_MeshRegistry);
         Context->ImagesInitialized = 1;
 
-        CheckGoto(LoadShaders(Device, Context->Images, &Context->Shaders), label_StaticBuffersAndImages);
-
-        VkVertexInputBindingDescription VertexInputBindingDescription = {
-            .binding = 0,
-            .stride = sizeof(vertex),
-            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-        };
-
-        VkVertexInputAttributeDescription VertexAttributeDescriptions[] = {
-            { .location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(vertex, Position) },
-            { .location = 1, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(vertex, Normal) },
-            { .location = 2, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(vertex, TexCoord) },
-        };
-
-        VkPipelineVertexInputStateCreateInfo PipelineVertexInputStateCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .vertexBindingDescriptionCount = 1,
-            .pVertexBindingDescriptions = &VertexInputBindingDescription,
-            .vertexAttributeDescriptionCount = ArrayCount(VertexAttributeDescriptions),
-            .pVertexAttributeDescriptions = VertexAttributeDescriptions,
-        };
+        CheckGoto(VulkanCreateDescriptorAllocator(Device, &Context->Descriptors), label_StaticImages);
+        CheckGoto(LoadShaders(Device, &Context->Assets, Context->Images, &Context->Descriptors, &Context->Shaders), label_DescriptorAllocator);
+        CheckGoto(CreateClusterCuller(Device, &Context->Shaders, &Context->ClusterCuller), label_Shaders);
+        CheckGoto(CreateClusteredLighting(Device, &Context->Shaders, &Context->ClusteredLighting), label_ClusterCuller);
 
         VkPushConstantRange PushConstantRange = {
             .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -293,7 +1219,37 @@ static int ProgramSetup(context *Context, vulkan_surface_device *Device, VkComma
         };
 
         VkSampleCountFlagBits SampleCount = Min(Device->MaxSampleCount, VK_SAMPLE_COUNT_4_BIT);
-        CheckGoto(VulkanCreateDefaultGraphicsPipeline(Device, Context->Shaders.Default.Vert, Context->Shaders.Default.Frag, Device->InitialExtent, Device->InitialSurfaceFormat.format, SampleCount, PipelineVertexInputStateCreateInfo, Context->Shaders.DescriptorSetLayouts, ArrayCount(Context->Shaders.DescriptorSetLayouts), PushConstantRange, &Context->GraphicsPipelineLayout, &Context->RenderPass, &Context->GraphicsPipeline), label_Shaders);
+        CheckGoto(VulkanCreateDefaultRenderPassAndLayout(Device, Device->InitialSurfaceFormat.format, SampleCount, Context->Shaders.DescriptorSetLayouts, ArrayCount(Context->Shaders.DescriptorSetLayouts), PushConstantRange, &Context->GraphicsPipelineLayout, &Context->RenderPass), label_ClusteredLighting);
+        Context->SampleCount = SampleCount;
+        CheckGoto(CreateOcclusionCuller(Device, &Context->Shaders, SampleCount, &Context->OcclusionCuller), label_RenderPassAndLayout);
+
+        // NOTE(blackedout): Pipelines are compiled in the background. Only the default pipelines of the used vertex formats are waited for,
+        // so that the first frame isn't empty. Variants of them are looked up in the pipeline state cache while rendering and compiled the
+        // first time they are used.
+        CheckGoto(VulkanCreatePipelineCompiler(Device, PlatformGetProcessorCount()/2, &Context->PipelineCompiler), label_OcclusionCuller);
+        CheckGoto(VulkanCreatePipelineStateCache(&Context->PipelineCompiler, &Context->PipelineStates), label_PipelineCompiler);
+
+        vulkan_graphics_pipeline_description PipelineDescription = VulkanDefaultGraphicsPipelineDescription(Device->InitialSurfaceFormat.format, Device->BestDepthFormat, SampleCount, Context->GraphicsPipelineLayout, Context->RenderPass);
+        PipelineDescription.ModuleFS = Context->Shaders.Default.Frag;
+        PipelineDescription.SpecializationCountFS = 1;
+        PipelineDescription.SpecializationFS[0] = Context->Shaders.TextureTableSize; // NOTE(blackedout): TEXTURE_TABLE_SIZE in default.frag
+        Context->DefaultPipelineDescription = PipelineDescription;
+
+        static_mesh *Meshes[] = { &Context->PlaneMesh, &Context->CubeMesh };
+        for(uint32_t I = 0; I < ArrayCount(Meshes); ++I) {
+            SetPipelineVertexFormat(&PipelineDescription, Meshes[I]->VertexFormat, &Context->Shaders);
+            VkPipeline *DefaultPipeline = VulkanFindOrRequestGraphicsPipeline(&Context->PipelineStates, &PipelineDescription);
+            CheckGoto(DefaultPipeline == 0, label_PipelineCompiler);
+            CheckGoto(VulkanWaitForGraphicsPipeline(&Context->PipelineCompiler, DefaultPipeline), label_PipelineCompiler);
+        }
+
+        // NOTE(blackedout): Hot reloading is a development convenience, so the program also runs without it.
+        if(CreateShaderReloader(Device, &Context->ShaderReloader)) {
+            printfc(CODE_YELLOW, "Shader hot reloading is disabled.\n");
+        }
+        for(uint32_t I = 0; I < ArrayCount(Context->FrameGraphs); ++I) {
+            VulkanCreateFrameGraph(Device, Context->FrameGraphs + I);
+        }
 
         *OutGraphicsCommandBuffer = Context->GraphicsCommandBuffer;
         *OutGraphicsQueue = Context->GraphicsQueue;
@@ -302,25 +1258,77 @@ static int ProgramSetup(context *Context, vulkan_surface_device *Device, VkComma
     }
 
     return 0;
-    
+
+label_PipelineCompiler:
+    VulkanDestroyPipelineCompiler(&Context->PipelineCompiler);
+    VulkanDestroyPipelineStateCache(&Context->PipelineStates);
+label_OcclusionCuller:
+    DestroyOcclusionCuller(Device, &Context->OcclusionCuller);
+label_RenderPassAndLayout:
+    VulkanDestroyDefaultGraphicsPipeline(Device, Context->GraphicsPipelineLayout, Context->RenderPass, VULKAN_NULL_HANDLE);
+label_ClusteredLighting:
+    DestroyClusteredLighting(Device, &Context->ClusteredLighting);
+label_ClusterCuller:
+    DestroyClusterCuller(Device, &Context->ClusterCuller);
 label_Shaders:
     DestroyShaders(Device, &Context->Shaders);
-label_StaticBuffersAndImages:
-    VulkanDestroyStaticBuffersAndImages(Device, &Context->StaticBuffers, Context->Images, STATIC_IMAGE_COUNT);
+label_DescriptorAllocator:
+    VulkanDestroyDescriptorAllocator(&Context->Descriptors);
+label_StaticImages:
+    VulkanDestroyStaticImages(Device, Context->Images, STATIC_IMAGE_COUNT);
+label_MeshRegistry:
+    VulkanDestroyMeshRegistry(Device, &Context->MeshRegistry);
+label_Workers:
+    WorkPoolDestroy(&Context->Workers);
+label_ComputeCommandPool:
+    for(uint32_t I = 0; I < ArrayCount(Context->ComputeSemaphores); ++I) {
+        vkDestroySemaphore(DeviceHandle, Context->ComputeSemaphores[I], 0);
+    }
+    vkDestroyCommandPool(DeviceHandle, Context->ComputeCommandPool, 0);
 label_GraphicsCommandPool:
     vkDestroyCommandPool(DeviceHandle, Context->GraphicsCommandPool, 0);
 label_Error:
+    AssetPackClose(&Context->Assets);
     return 1;
 }
 
 static int ProgramUpdate(context *Context, vulkan_surface_device *Device, double DeltaTime) {
     //Context.CamAzi += 0.1f;
+    Context->Time += (float)DeltaTime;
+
+    // NOTE(blackedout): Frame boundary, swap in reloaded shaders and pipelines that finished compiling
+    PollShaderReloader(&Context->ShaderReloader, &Context->PipelineCompiler, &Context->PipelineStates, &Context->Shaders);
+    cluster_culler *ClusterCuller = &Context->ClusterCuller;
+    occlusion_culler *OcclusionCuller = &Context->OcclusionCuller;
+    UpdateComputePipeline(Device, &Context->PipelineCompiler, ClusterCuller->PipelineLayout, Context->Shaders.CullComp, &ClusterCuller->Pipeline, &ClusterCuller->PipelineModule);
+    UpdateComputePipeline(Device, &Context->PipelineCompiler, OcclusionCuller->PipelineLayout, GetDepthPyramidModule(&Context->Shaders, Context->SampleCount), &OcclusionCuller->Pipeline, &OcclusionCuller->PipelineModule);
+    clustered_lighting *ClusteredLighting = &Context->ClusteredLighting;
+    UpdateComputePipeline(Device, &Context->PipelineCompiler, ClusteredLighting->PipelineLayout, Context->Shaders.LightBinComp, &ClusteredLighting->Pipeline, &ClusteredLighting->PipelineModule);
+    Context->DefaultPipelineDescription.ModuleFS = Context->Shaders.Default.Frag;
+    VulkanPollPipelineCompiler(&Context->PipelineCompiler);
     return 0;
 }
 
-static int ProgramRender(context *Context, vulkan_surface_device *Device, vulkan_acquired_image AcquiredImage) {
+static int ProgramRender(context *Context, vulkan_surface_device *Device, vulkan_acquired_image AcquiredImage, vulkan_semaphore_wait *OutComputeWait) {
     {
+        // NOTE(blackedout): The last frame's compute submission is covered by its in flight fence, because its graphics submission waited for it
         VulkanCheckGoto(vkResetCommandBuffer(Context->GraphicsCommandBuffer, 0), label_Error);
+        if(Context->ComputeCommandBuffer) {
+            VulkanCheckGoto(vkResetCommandBuffer(Context->ComputeCommandBuffer, 0), label_Error);
+        }
+        // NOTE(blackedout): The frame that used this data index before has finished, so its transient descriptor sets can be reused
+        VulkanResetTransientDescriptorSets(&Context->Descriptors, AcquiredImage.DataIndex);
+        VulkanUpdateMemoryBudget(Device);
+        if(Context->ShouldPrintMemoryStats) {
+            VulkanPrintMemoryStats(Device);
+            Context->ShouldPrintMemoryStats = 0;
+        }
+        if(Context->ShouldWriteMemoryStats) {
+            if(VulkanWriteMemoryStatsJson(Device, "memory_stats.json") == 0) {
+                printf("Wrote memory_stats.json.\n");
+            }
+            Context->ShouldWriteMemoryStats = 0;
+        }
         int A = 0;
         VkRect2D RenderArea = {
             .offset = { 0, 0 },
@@ -345,6 +1353,8 @@ static int ProgramRender(context *Context, vulkan_surface_device *Device, vulkan
         };
 
         VulkanCheckGoto(vkBeginCommandBuffer(Context->GraphicsCommandBuffer, &GraphicsCommandBufferBeginInfo), label_Error);
+        // NOTE(blackedout): Meshes added since the last frame are uploaded before anything reads the arenas
+        CheckGoto(VulkanUpdateMeshRegistry(Device, &Context->MeshRegistry, Context->GraphicsCommandBuffer, AcquiredImage.DataIndex), label_Error);
         
         VkRenderPassBeginInfo RenderPassBeginInfo = {
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
@@ -373,70 +1383,305 @@ static int ProgramRender(context *Context, vulkan_surface_device *Device, vulkan
         v3 AxisX = {1.0f, 0.0f, 0.0f};
         v3 AxisY = {0.0f, 1.0f, 0.0f};
         m4 ViewRotation = MultiplyM4M4(TranslationM4(0.0f, 0.0f, -8.0f/Context->CamZoom), MultiplyM4M4(RotationM4(AxisX, -Context->CamPol), RotationM4(AxisY, -Context->CamAzi)));
+        m4 Projection = ProjectionPersp(CAMERA_FOV_Y, Viewport.width/Viewport.height, CAMERA_NEAR, CAMERA_FAR);
         default_uniform_buffer1 DefaultUniformBuffer1 = {
             .V = TransposeM4(ViewRotation),
-            .P = TransposeM4(ProjectionPersp(1.1f, Viewport.width/Viewport.height, 0.01f, 1000.0f)),
+            .P = TransposeM4(Projection),
             .L = { 0.2f, -1.0f, -0.4f, 0.0f }
         };
+        ComputeFrustumPlanes(MultiplyM4M4(Projection, ViewRotation), DefaultUniformBuffer1.FrustumPlanes);
+        // NOTE(blackedout): The view matrix is a rotation followed by a translation, so the camera is at -R^T*t
+        const float *V = ViewRotation.E;
+        for(uint32_t I = 0; I < 3; ++I) {
+            DefaultUniformBuffer1.CameraPosition.E[I] = -(V[I]*V[3] + V[4 + I]*V[7] + V[8 + I]*V[11]);
+        }
+        DefaultUniformBuffer1.CameraPosition.E[3] = 1.0f;
+        // NOTE(blackedout): Maps pixels and view depth to clusters, depth slices are exponential between the near and far plane
+        float SliceScale = (float)CLUSTERED_LIGHTING_GRID_Z/logf(CAMERA_FAR/CAMERA_NEAR);
+        DefaultUniformBuffer1.ClusterScale.E[0] = (float)CLUSTERED_LIGHTING_GRID_X/Viewport.width;
+        DefaultUniformBuffer1.ClusterScale.E[1] = (float)CLUSTERED_LIGHTING_GRID_Y/Viewport.height;
+        DefaultUniformBuffer1.ClusterScale.E[2] = SliceScale;
+        DefaultUniformBuffer1.ClusterScale.E[3] = -SliceScale*logf(CAMERA_NEAR);
 
         *Context->Shaders.UniformMats[AcquiredImage.DataIndex] = DefaultUniformBuffer1;
-        vkCmdBeginRenderPass(Context->GraphicsCommandBuffer, &RenderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(Context->GraphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Context->GraphicsPipeline);
-        vkCmdSetViewport(Context->GraphicsCommandBuffer, 0, 1, &Viewport);
-        vkCmdSetScissor(Context->GraphicsCommandBuffer, 0, 1, &Scissors);
-
-        // Draw plane mesh
-        VkDescriptorSet PlaneSets[] = { Context->Shaders.UniformMatsSets[AcquiredImage.DataIndex], Context->Shaders.DefaultImageTileSet };
-        vkCmdBindDescriptorSets(Context->GraphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Context->GraphicsPipelineLayout, 0, ArrayCount(PlaneSets), PlaneSets, 0, 0);
+        clustered_lighting *Lighting = &Context->ClusteredLighting;
+        PlaceSceneLights(Context->Time, Context->LightCount, (clustered_light *)Lighting->Lights[AcquiredImage.DataIndex].Allocation.Mapped);
+
+        vulkan_graphics_pipeline_description PipelineDescription = Context->DefaultPipelineDescription;
+        switch(Context->PipelineVariant) {
+        case PIPELINE_VARIANT_WIREFRAME:
+            // NOTE(blackedout): Line polygon mode is an optional device feature
+            if(Device->Features.fillModeNonSolid) {
+                PipelineDescription.PolygonMode = VK_POLYGON_MODE_LINE;
+                PipelineDescription.CullMode = VK_CULL_MODE_NONE;
+            }
+            break;
+        case PIPELINE_VARIANT_ALPHA_BLEND:
+            PipelineDescription.DepthWriteEnable = VK_FALSE;
+            PipelineDescription.Blend.blendEnable = VK_TRUE;
+            PipelineDescription.Blend.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            PipelineDescription.Blend.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            PipelineDescription.Blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            PipelineDescription.Blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            break;
+        case PIPELINE_VARIANT_NO_CULL:
+            PipelineDescription.CullMode = VK_CULL_MODE_NONE;
+            break;
+        case PIPELINE_VARIANT_DEPTH_ONLY:
+            PipelineDescription.ModuleFS = VULKAN_NULL_HANDLE;
+            PipelineDescription.Blend.colorWriteMask = 0;
+            break;
+        default:
+            break;
+        }
+
+        // NOTE(blackedout): One pipeline per vertex format that is used by a mesh
+        VkPipeline GraphicsPipelines[MESH_VERTEX_FORMAT_COUNT];
+        SetZero(GraphicsPipelines);
+        static_mesh *Meshes[] = { &Context->PlaneMesh, &Context->CubeMesh };
+        int ArePipelinesReady = 1;
+        for(uint32_t I = 0; I < ArrayCount(Meshes); ++I) {
+            mesh_vertex_format Format = Meshes[I]->VertexFormat;
+            if(GraphicsPipelines[Format] == VULKAN_NULL_HANDLE) {
+                SetPipelineVertexFormat(&PipelineDescription, Format, &Context->Shaders);
+                GraphicsPipelines[Format] = VulkanGetGraphicsPipeline(&Context->PipelineStates, &PipelineDescription);
+                ArePipelinesReady = ArePipelinesReady && GraphicsPipelines[Format] != VULKAN_NULL_HANDLE;
+            }
+        }
+
+        // NOTE(blackedout): Collect the draws first, so that their meshlets can be culled before the render pass
+        static_mesh_draw Draws[4];
+        uint32_t DrawCount = 0;
         float PlaneScale = 16.0f;
-        default_push_constants DefaultPlanePushConstants = {
-            .M = {
-                PlaneScale, 0.0f, 0.0f, 0.0f,
-                0.0f, 1.0f, 0.0f, 0.0f,
-                0.0f, 0.0f, PlaneScale, 0.0f,
-                0.0f, -0.5f, 0.0f, 1.0f
-            },
-            .TexM = {
-                PlaneScale, 0.0f,
-                0.0f, PlaneScale
+        static_mesh_draw PlaneDraw = {
+            .Mesh = &Context->PlaneMesh,
+            .PushConstants = {
+                .M = {
+                    PlaneScale, 0.0f, 0.0f, 0.0f,
+                    0.0f, 1.0f, 0.0f, 0.0f,
+                    0.0f, 0.0f, PlaneScale, 0.0f,
+                    0.0f, -0.5f, 0.0f, 1.0f
+                },
+                .TexM = {
+                    PlaneScale, 0.0f,
+                    0.0f, PlaneScale
+                },
+                .TexT  = { 0.0f, 0.0f },
+                .TextureIndex = STATIC_IMAGE_TILE
             },
-            .TexT  = { 0.0f, 0.0f }
+            .FirstClusterCommand = UINT32_MAX,
         };
-        vkCmdBindVertexBuffers(Context->GraphicsCommandBuffer, 0, 1, &Context->StaticBuffers.VertexHandle, &Context->PlaneVerticesByteOffset);
-        vkCmdBindIndexBuffer(Context->GraphicsCommandBuffer, Context->StaticBuffers.IndexHandle, Context->PlaneIndicesByteOffset, VK_INDEX_TYPE_UINT32);
-        vkCmdPushConstants(Context->GraphicsCommandBuffer, Context->GraphicsPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DefaultPlanePushConstants), &DefaultPlanePushConstants);
-        vkCmdDrawIndexed(Context->GraphicsCommandBuffer, ArrayCount(PlaneIndices), 1, 0, 0, 0);
-
-        // Draw cube meshes
-        VkDescriptorSet CubeSets[] = { Context->Shaders.UniformMatsSets[AcquiredImage.DataIndex], Context->Shaders.DefaultImageColorSet };
-        vkCmdBindDescriptorSets(Context->GraphicsCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Context->GraphicsPipelineLayout, 0, ArrayCount(CubeSets), CubeSets, 0, 0);
-        vkCmdBindVertexBuffers(Context->GraphicsCommandBuffer, 0, 1, &Context->StaticBuffers.VertexHandle, &Context->CubeVerticesByteOffset);
-        vkCmdBindIndexBuffer(Context->GraphicsCommandBuffer, Context->StaticBuffers.IndexHandle, Context->CubeIndicesByteOffset, VK_INDEX_TYPE_UINT32);
-        
+        Draws[DrawCount++] = PlaneDraw;
+
         float CubeTexOffsets[] = { 0.25f, 0.5f, 0.75f };
         v2 CubePositions[] = { { -2.5f, -2.5f }, { -0.5f, -0.5f }, { 2.5f, 2.5f }, };
         float CubeHeights[] = { 1.0f, 2.0f, 3.0f };
         for(uint32_t I = 0; I < 3; ++I) {
-            default_push_constants DefaultCubePushConstants = {
-                .M = {
-                    1.0f, 0.0f, 0.0f, 0.0f,
-                    0.0f, CubeHeights[I], 0.0f, 0.0f,
-                    0.0f, 0.0f, 1.0f, 0.0f,
-                    CubePositions[I].E[0], 0.5f*(CubeHeights[I] - 1.0f), CubePositions[I].E[1], 1.0f
+            static_mesh_draw CubeDraw = {
+                .Mesh = &Context->CubeMesh,
+                .PushConstants = {
+                    .M = {
+                        1.0f, 0.0f, 0.0f, 0.0f,
+                        0.0f, CubeHeights[I], 0.0f, 0.0f,
+                        0.0f, 0.0f, 1.0f, 0.0f,
+                        CubePositions[I].E[0], 0.5f*(CubeHeights[I] - 1.0f), CubePositions[I].E[1], 1.0f
+                    },
+                    .TexM = {
+                        0.0f, 0.0f,
+                        0.0f, 0.0f
+                    },
+                    .TexT  = { CubeTexOffsets[I], 0.0f },
+                    .TextureIndex = STATIC_IMAGE_COLOR
                 },
-                .TexM = {
-                    0.0f, 0.0f,
-                    0.0f, 0.0f
-                },
-                .TexT  = { CubeTexOffsets[I], 0.0f }
+                .FirstClusterCommand = UINT32_MAX,
             };
-            
-            vkCmdPushConstants(Context->GraphicsCommandBuffer, Context->GraphicsPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(DefaultCubePushConstants), &DefaultCubePushConstants);
-            vkCmdDrawIndexed(Context->GraphicsCommandBuffer, ArrayCount(CubeIndices), 1, 0, 0, 0);
+            Draws[DrawCount++] = CubeDraw;
+        }
+
+        // NOTE(blackedout): Meshes that couldn't be placed yet aren't drawn
+        uint32_t ResidentDrawCount = 0;
+        for(uint32_t I = 0; I < DrawCount; ++I) {
+            if(VulkanIsMeshResident(&Context->MeshRegistry, Draws[I].Mesh->Handle)) {
+                Draws[ResidentDrawCount++] = Draws[I];
+            }
+        }
+        DrawCount = ResidentDrawCount;
+
+        cluster_culler *Culler = &Context->ClusterCuller;
+        occlusion_culler *OcclusionCuller = &Context->OcclusionCuller;
+        static_mesh_frame Frame = {
+            .CommandBuffer = Context->GraphicsCommandBuffer,
+            .Layout = Context->GraphicsPipelineLayout,
+            .MeshRegistry = &Context->MeshRegistry,
+            .Pipelines = GraphicsPipelines,
+            .BoundPipeline = VULKAN_NULL_HANDLE,
+            .TextureTableSets = Context->Shaders.TextureTableSets,
+            .TextureTableSize = Context->Shaders.TextureTableSize,
+            .BoundTextureTableSet = VULKAN_NULL_HANDLE,
+            .View = ViewRotation,
+            .PixelsPerUnit = Viewport.height/(2.0f*tanf(0.5f*CAMERA_FOV_Y)),
+            .ClusterCommands = VULKAN_NULL_HANDLE,
+            .MaxDrawIndirectCount = Device->Features.multiDrawIndirect? Device->Properties.limits.maxDrawIndirectCount : 1,
+            .CullingPhase = CLUSTER_CULLING_PHASE_ONLY,
+        };
+        vulkan_frame_graph *Graph = Context->FrameGraphs + AcquiredImage.DataIndex;
+        frame_render Render = {
+            .Context = Context,
+            .Graph = Graph,
+            .AcquiredImage = AcquiredImage,
+            .Frame = Frame,
+            .Draws = Draws,
+            .DrawCount = DrawCount,
+            .ArePipelinesReady = ArePipelinesReady,
+            .IsLit = PipelineDescription.ModuleFS != VULKAN_NULL_HANDLE,
+            .RenderPassBeginInfo = RenderPassBeginInfo,
+            .Viewport = Viewport,
+            .Scissors = Scissors,
+        };
+        GetDepthPyramidSize(AcquiredImage.Extent, &Render.Pyramid);
+
+        // NOTE(blackedout): With occlusion culling, the frame is drawn in two render passes with the depth pyramid built in between,
+        // otherwise in one. Until the pipelines are ready, the frame is only cleared.
+        int IsOcclusionCulled = ArePipelinesReady && OcclusionCuller->IsSupported && Context->IsOcclusionCullingDisabled == 0;
+        frame_render_phase Phases[] = {
+            { .Render = &Render, .Index = 0, .Phase = CLUSTER_CULLING_PHASE_ONLY, .RenderPass = VULKAN_NULL_HANDLE },
+            { .Render = &Render, .Index = 1, .Phase = CLUSTER_CULLING_PHASE_SECOND, .RenderPass = VULKAN_NULL_HANDLE },
+        };
+        uint32_t PhaseCount = 1;
+        if(IsOcclusionCulled) {
+            Phases[0].Phase = CLUSTER_CULLING_PHASE_FIRST;
+            PhaseCount = 2;
+        }
+
+        // NOTE(blackedout): The visibility buffer was last written by the previous frame's second culling phase or its clear
+        VulkanBeginFrameGraph(Graph);
+        uint32_t Visibility = VulkanImportFrameGraphBuffer(Graph, "Visibility", Culler->Visibility.Handle, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+        uint64_t ClusterCommandsByteCount = CLUSTER_CULLING_MAX_COMMAND_COUNT*sizeof(VkDrawIndexedIndirectCommand);
+        Render.ClusterCommands[0] = VulkanCreateFrameGraphBuffer(Graph, "ClusterCommands", ClusterCommandsByteCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        Render.ClusterCommands[1] = VulkanCreateFrameGraphBuffer(Graph, "SecondClusterCommands", ClusterCommandsByteCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+        Render.Clusters = VulkanCreateFrameGraphBuffer(Graph, "Clusters", CLUSTERED_LIGHTING_CLUSTERS_BYTE_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+        Render.LightIndices = VulkanCreateFrameGraphBuffer(Graph, "LightIndices", CLUSTERED_LIGHTING_LIGHT_INDICES_BYTE_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        // NOTE(blackedout): The attachments of the framebuffer. Color and depth were last used by the previous frame, which may still run,
+        // the swapchain image is waited for at VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT by the submission.
+        VkImageAspectFlags DepthAspect = VK_IMAGE_ASPECT_DEPTH_BIT | ((Device->BestDepthFormat == VK_FORMAT_D32_SFLOAT)? 0 : VK_IMAGE_ASPECT_STENCIL_BIT);
+        uint32_t Color = VulkanImportFrameGraphImage(Graph, "Color", AcquiredImage.ColorImage, AcquiredImage.ColorImageView, AcquiredImage.Format, Context->SampleCount, VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        uint32_t Depth = VulkanImportFrameGraphImage(Graph, "Depth", AcquiredImage.DepthImage, AcquiredImage.DepthImageView, Device->BestDepthFormat, Context->SampleCount, DepthAspect,
+                                                     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        uint32_t Swapchain = VulkanImportFrameGraphImage(Graph, "Swapchain", AcquiredImage.Image, AcquiredImage.ImageView, AcquiredImage.Format, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_ASPECT_COLOR_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        uint32_t DepthPyramid = VulkanCreateFrameGraphImage(Graph, "DepthPyramid", VK_FORMAT_R32_SFLOAT, Render.Pyramid.Width, Render.Pyramid.Height, Render.Pyramid.LevelCount, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        if(ArePipelinesReady) {
+            if(Culler->IsVisibilityCleared == 0) {
+                VulkanAddFrameGraphPass(Graph, "ClearVisibility", RecordClearVisibility, &Render, 0);
+                VulkanWriteFrameGraphResource(Graph, Visibility, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+                Culler->IsVisibilityCleared = 1;
+            }
+            // NOTE(blackedout): Both are culled if the fragment shader doesn't read the lights. Light binning only depends on the camera
+            // and the lights, so it runs on the async compute queue while culling and vertex shading of the first render pass run.
+            VulkanAddFrameGraphAsyncComputePass(Graph, "ClearLightCount", RecordClearLightCount, &Render, 0);
+            VulkanWriteFrameGraphResource(Graph, Render.LightIndices, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+            VulkanAddFrameGraphAsyncComputePass(Graph, "BinLights", RecordBinLights, &Render, 0);
+            VulkanWriteFrameGraphResource(Graph, Render.Clusters, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+            VulkanWriteFrameGraphResource(Graph, Render.LightIndices, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
         }
+        const char *CullPassNames[] = { "Cull", "SecondCull" };
+        const char *DrawPassNames[] = { "Draw", "SecondDraw" };
+        for(uint32_t I = 0; I < PhaseCount; ++I) {
+            frame_render_phase *Phase = Phases + I;
+            if(ArePipelinesReady) {
+                VulkanAddFrameGraphPass(Graph, CullPassNames[I], RecordCull, Phase, 0);
+                VulkanWriteFrameGraphResource(Graph, Render.ClusterCommands[I], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+                if(Phase->Phase == CLUSTER_CULLING_PHASE_FIRST) {
+                    VulkanReadFrameGraphResource(Graph, Visibility, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+                } else if(Phase->Phase == CLUSTER_CULLING_PHASE_SECOND) {
+                    VulkanReadFrameGraphResource(Graph, DepthPyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL);
+                    VulkanWriteFrameGraphResource(Graph, Visibility, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+                }
+            }
 
-        vkCmdEndRenderPass(Context->GraphicsCommandBuffer);
+            // NOTE(blackedout): The second render pass continues the first. Only the last resolve is stored, see VulkanCompileFrameGraph.
+            VulkanAddFrameGraphRenderPass(Graph, DrawPassNames[I], RecordDraw, Phase, 1, &Phase->RenderPass);
+            VulkanUseFrameGraphAttachment(Graph, Color, VULKAN_FRAME_GRAPH_ATTACHMENT_COLOR, I > 0);
+            VulkanUseFrameGraphAttachment(Graph, Depth, VULKAN_FRAME_GRAPH_ATTACHMENT_DEPTH, I > 0);
+            VulkanUseFrameGraphAttachment(Graph, Swapchain, VULKAN_FRAME_GRAPH_ATTACHMENT_RESOLVE, 0);
+            if(ArePipelinesReady) {
+                VulkanReadFrameGraphResource(Graph, Render.ClusterCommands[I], VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+            }
+            if(ArePipelinesReady && Render.IsLit) {
+                VulkanReadFrameGraphResource(Graph, Render.Clusters, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+                VulkanReadFrameGraphResource(Graph, Render.LightIndices, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED);
+            }
+
+            if(Phase->Phase == CLUSTER_CULLING_PHASE_FIRST) {
+                VulkanAddFrameGraphPass(Graph, "BuildDepthPyramid", RecordBuildDepthPyramid, &Render, 0);
+                VulkanReadFrameGraphResource(Graph, Depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+                VulkanWriteFrameGraphResource(Graph, DepthPyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+            }
+        }
+        VulkanPresentFrameGraphImage(Graph, Swapchain);
+        CheckGoto(VulkanCompileFrameGraph(Graph), label_Error);
+
+        if(ArePipelinesReady) {
+            for(uint32_t I = 0; I < PhaseCount; ++I) {
+                // NOTE(blackedout): Without the pyramid, any sampled image is bound, cull.comp only reads it in the second phase
+                vulkan_descriptor_binding CullingBindings[] = {
+                    { .Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .Binding = 0, .Buffer = Context->MeshRegistry.Arenas[VULKAN_MESH_ARENA_STORAGE].Buffer.Handle, .Offset = 0, .Range = VK_WHOLE_SIZE },
+                    { .Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .Binding = 1, .Buffer = Graph->Resources[Render.ClusterCommands[I]].Buffer, .Offset = 0, .Range = VK_WHOLE_SIZE },
+                    { .Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .Binding = 2, .Buffer = Culler->Visibility.Handle, .Offset = 0, .Range = VK_WHOLE_SIZE },
+                    { .Type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .Binding = 3, .ImageView = Context->Images[0].ViewHandle, .Sampler = Context->Shaders.DefaultSampler, .ImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+                };
+                if(Phases[I].Phase == CLUSTER_CULLING_PHASE_SECOND) {
+                    CullingBindings[3].ImageView = Graph->Resources[DepthPyramid].View;
+                    CullingBindings[3].Sampler = OcclusionCuller->Sampler;
+                    CullingBindings[3].ImageLayout = VK_IMAGE_LAYOUT_GENERAL;
+                }
+                Render.CullingSets[I][0] = Context->Shaders.UniformMatsSets[AcquiredImage.DataIndex];
+                CheckGoto(VulkanAllocateTransientDescriptorSet(&Context->Descriptors, AcquiredImage.DataIndex, Culler->SetLayout, CullingBindings, ArrayCount(CullingBindings), Render.CullingSets[I] + 1), label_Error);
+            }
+
+            if(Render.IsLit) {
+                vulkan_descriptor_binding LightingBindings[] = {
+                    { .Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .Binding = 0, .Buffer = Lighting->Lights[AcquiredImage.DataIndex].Handle, .Offset = 0, .Range = VK_WHOLE_SIZE },
+                    { .Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .Binding = 1, .Buffer = Graph->Resources[Render.Clusters].Buffer, .Offset = 0, .Range = VK_WHOLE_SIZE },
+                    { .Type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .Binding = 2, .Buffer = Graph->Resources[Render.LightIndices].Buffer, .Offset = 0, .Range = VK_WHOLE_SIZE },
+                };
+                Render.LightingSets[0] = Context->Shaders.UniformMatsSets[AcquiredImage.DataIndex];
+                CheckGoto(VulkanAllocateTransientDescriptorSet(&Context->Descriptors, AcquiredImage.DataIndex, Context->Shaders.DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_CLUSTERED_LIGHTS], LightingBindings, ArrayCount(LightingBindings), Render.LightingSets + 1), label_Error);
+            }
+
+            if(IsOcclusionCulled) {
+                Render.Pyramid.View = Graph->Resources[DepthPyramid].View;
+                Render.Pyramid.LevelViews = Graph->Resources[DepthPyramid].LevelViews;
+                CheckGoto(AllocateDepthPyramidSets(OcclusionCuller, &Context->Descriptors, AcquiredImage, &Render.Pyramid), label_Error);
+            }
+        }
+
+        vulkan_semaphore_wait ComputeWait = { .Semaphore = VULKAN_NULL_HANDLE, .Stages = 0 };
+        if(Graph->AsyncPassCount > 0) {
+            VulkanCheckGoto(vkBeginCommandBuffer(Context->ComputeCommandBuffer, &GraphicsCommandBufferBeginInfo), label_Error);
+        }
+        VulkanExecuteFrameGraph(Graph, Context->GraphicsCommandBuffer, Context->ComputeCommandBuffer);
         VulkanCheckGoto(vkEndCommandBuffer(Context->GraphicsCommandBuffer), label_Error);
+
+        // NOTE(blackedout): Submitted before the graphics command buffer, which waits for the semaphore
+        if(Graph->AsyncPassCount > 0) {
+            VulkanCheckGoto(vkEndCommandBuffer(Context->ComputeCommandBuffer), label_Error);
+            VkSubmitInfo ComputeSubmitInfo = {
+                .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                .pNext = 0,
+                .waitSemaphoreCount = 0,
+                .pWaitSemaphores = 0,
+                .pWaitDstStageMask = 0,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &Context->ComputeCommandBuffer,
+                .signalSemaphoreCount = 1,
+                .pSignalSemaphores = &Context->ComputeSemaphores[AcquiredImage.DataIndex]
+            };
+            VulkanCheckGoto(vkQueueSubmit(Context->ComputeQueue, 1, &ComputeSubmitInfo, VULKAN_NULL_HANDLE), label_Error);
+            ComputeWait.Semaphore = Context->ComputeSemaphores[AcquiredImage.DataIndex];
+            ComputeWait.Stages = Graph->AsyncWaitStages;
+        }
+        *OutComputeWait = ComputeWait;
     }
 
     return 0;
@@ -25,32 +25,97 @@
 
 layout(location=0) in vec3 FragNormal;
 layout(location=1) in vec2 FragTexCoord;
+layout(location=2) in vec3 FragPosition;
 
 layout(location=0) out vec4 Result;
 
+// NOTE(blackedout): shaders.TextureTableSize, at most TEXTURE_TABLE_CAPACITY in program.c
+layout(constant_id=0) const uint TEXTURE_TABLE_SIZE = 1;
+
 layout(set=1, binding=1) uniform sampler Sampler;
-layout(set=1, binding=2) uniform texture2D Tex;
+layout(set=1, binding=2) uniform texture2D Textures[TEXTURE_TABLE_SIZE];
 
 layout(set=0, binding=0) uniform UniformBuffer1 {
     mat4 V;
     mat4 P;
     vec4 L;
+    vec4 FrustumPlanes[6];
+    vec4 CameraPosition;
+    vec4 ClusterScale; // NOTE(blackedout): xy clusters per pixel, zw depth slice scale and bias (slice = log(depth)*z + w)
+};
+
+// NOTE(blackedout): clustered_light
+struct light {
+    vec3 Position;
+    float Range;
+    vec3 Color;
+    float SpotOuterCos; // NOTE(blackedout): -2 for point lights
+    vec3 Direction;
+    float SpotInnerCos;
+};
+
+// NOTE(blackedout): Written by lightbin.comp before the render pass
+layout(set=2, binding=0, std430) readonly buffer LightBuffer {
+    light Lights[];
+};
+
+layout(set=2, binding=1, std430) readonly buffer ClusterBuffer {
+    uvec2 Clusters[]; // NOTE(blackedout): Offset into LightIndices and light count
 };
 
+layout(set=2, binding=2, std430) readonly buffer LightIndexBuffer {
+    uint LightIndexCount;
+    uint LightIndices[];
+};
+
+#define CLUSTERED_LIGHTING_GRID_SIZE uvec3(16, 9, 24) // NOTE(blackedout): Same as in program.c
+
 layout(push_constant, std430) uniform PushConstants {
     mat4 M;
     mat2 TexM;
     vec2 TexT;
+    uint TextureIndex;
 };
 
+vec3 ClusteredLighting(vec3 Normal) {
+    // NOTE(blackedout): Only the lights binned into the fragment's cluster are looped over, so the cost doesn't grow with the light count
+    float Depth = -(V*vec4(FragPosition, 1.0)).z;
+    vec3 ClusterCoord = vec3(gl_FragCoord.xy*ClusterScale.xy, log(max(Depth, 1e-6))*ClusterScale.z + ClusterScale.w);
+    uvec3 Cluster = uvec3(clamp(ivec3(ClusterCoord), ivec3(0), ivec3(CLUSTERED_LIGHTING_GRID_SIZE) - 1));
+    uvec2 Range = Clusters[(Cluster.z*CLUSTERED_LIGHTING_GRID_SIZE.y + Cluster.y)*CLUSTERED_LIGHTING_GRID_SIZE.x + Cluster.x];
+
+    vec3 Result = vec3(0.0);
+    for(uint I = 0; I < Range.y; ++I) {
+        light Light = Lights[LightIndices[Range.x + I]];
+        vec3 ToLight = Light.Position - FragPosition;
+        float Distance = length(ToLight);
+        vec3 LightDir = ToLight/max(Distance, 1e-4);
+
+        // NOTE(blackedout): Inverse square falloff windowed to reach 0 at the light's range, which the binning relies on
+        float Window = clamp(1.0 - pow(Distance/Light.Range, 4.0), 0.0, 1.0);
+        float Attenuation = Window*Window/(1.0 + Distance*Distance);
+        float Spot = smoothstep(Light.SpotOuterCos, Light.SpotInnerCos, dot(-LightDir, Light.Direction));
+        Result += Light.Color*(max(dot(Normal, LightDir), 0.0)*Attenuation*Spot);
+    }
+    return Result;
+}
+
 void main() {
     vec3 LightDir = normalize(-L.xyz);
+    vec3 Normal = normalize(FragNormal);
 
     float Ambient = 0.3;
-    float Diffuse = max(dot(normalize(FragNormal), LightDir), 0.0);
-    float I = Ambient + (1.0 - Ambient)*Diffuse;
+    float Diffuse = max(dot(Normal, LightDir), 0.0);
+    vec3 I = vec3(Ambient + (1.0 - Ambient)*Diffuse) + ClusteredLighting(Normal);
 
-    vec4 TexColor = texture(sampler2D(Tex, Sampler), TexM*FragTexCoord + TexT);
+    // NOTE(blackedout): A table of one texture is only indexed with a constant, which works without dynamic indexing of sampled image arrays
+    vec2 TexCoord = TexM*FragTexCoord + TexT;
+    vec4 TexColor;
+    if(TEXTURE_TABLE_SIZE == 1) {
+        TexColor = texture(sampler2D(Textures[0], Sampler), TexCoord);
+    } else {
+        TexColor = texture(sampler2D(Textures[TextureIndex], Sampler), TexCoord);
+    }
     Result = vec4(I*TexColor.rgb, 1.0);
     //Result = vec4(vec3(TexT.st, 0.0), 1.0);
 }
\ No newline at end of file
@@ -29,6 +29,7 @@ layout(location=2) in vec2 VertTexCoord;
 
 layout(location=0) out vec3 FragNormal;
 layout(location=1) out vec2 FragTexCoord;
+layout(location=2) out vec3 FragPosition; // NOTE(blackedout): World space, for clustered lighting
 
 layout(set=0, binding=0) uniform UniformBuffer1 {
     mat4 V;
@@ -40,10 +41,13 @@ layout(push_constant) uniform PushConstants {
     mat4 M;
     mat2 TexM;
     vec2 TexT;
+    uint TextureIndex;
 };
 
 void main() {
-    gl_Position = P*V*M*vec4(VertPosition, 1.0);
+    vec4 Position = M*vec4(VertPosition, 1.0);
+    gl_Position = P*V*Position;
+    FragPosition = Position.xyz;
     FragNormal = VertNormal;
     FragTexCoord = VertTexCoord;
 }
\ No newline at end of file
@@ -0,0 +1,166 @@
+// Original source in https://github.com/blackedout01/glfw-vk-template
+//
+// zlib License
+//
+// (C) 2024 blackedout01
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+
+
+
+// NOTE(blackedout): KTX2 texture containers (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html). Only textures that can be
+// uploaded as they are, so 2D, not arrays or cube maps and without supercompression, with a format from TextureFormatBlock. Block
+// compressed (BCn, ASTC) files should contain their whole mip chain, because blits can't write compressed formats.
+
+typedef struct {
+    uint8_t Identifier[12];
+    uint32_t VkFormat;
+    uint32_t TypeSize;
+    uint32_t PixelWidth;
+    uint32_t PixelHeight;
+    uint32_t PixelDepth;
+    uint32_t LayerCount;
+    uint32_t FaceCount;
+    uint32_t LevelCount; // NOTE(blackedout): 0 means that the mip chain should be generated after loading level 0
+    uint32_t SupercompressionScheme;
+    uint32_t DfdByteOffset;
+    uint32_t DfdByteLength;
+    uint32_t KvdByteOffset;
+    uint32_t KvdByteLength;
+    uint64_t SgdByteOffset;
+    uint64_t SgdByteLength;
+} texture_ktx2_header;
+
+typedef struct {
+    uint64_t ByteOffset;
+    uint64_t ByteLength;
+    uint64_t UncompressedByteLength;
+} texture_ktx2_level;
+
+typedef struct {
+    uint32_t Width, Height; // NOTE(blackedout): In texels
+    uint32_t ByteCount;
+} texture_format_block;
+
+typedef struct {
+    const uint8_t *Bytes;
+    uint64_t ByteCount;
+    VkFormat Format;
+    uint32_t Width, Height;
+    texture_format_block Block;
+    uint32_t LevelCount; // NOTE(blackedout): Stored levels, 0 if only level 0 is stored and the rest should be generated
+    uint64_t LevelOffsets[VULKAN_MAX_IMAGE_LEVEL_COUNT]; // NOTE(blackedout): From Bytes, level 0 is the largest
+} texture_view;
+
+static int TextureFormatBlock(VkFormat Format, texture_format_block *OutBlock) {
+    // NOTE(blackedout): Only formats that textures are expected to come in, others are rejected instead of guessing their size.
+    texture_format_block Block = { 1, 1, 0 };
+    switch(Format) {
+    case VK_FORMAT_R8_UNORM:
+        Block.ByteCount = 1; break;
+    case VK_FORMAT_R8G8_UNORM:
+        Block.ByteCount = 2; break;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        Block.ByteCount = 4; break;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        Block.ByteCount = 8; break;
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+        Block = (texture_format_block){ 4, 4, 8 }; break;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        Block = (texture_format_block){ 4, 4, 16 }; break;
+    case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+        Block = (texture_format_block){ 6, 6, 16 }; break;
+    case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+        Block = (texture_format_block){ 8, 8, 16 }; break;
+    default:
+        return 1;
+    }
+    *OutBlock = Block;
+    return 0;
+}
+
+static int TextureViewFromKtx2(const uint8_t *Bytes, uint64_t ByteCount, texture_view *OutView) {
+    // NOTE(blackedout): Validates the blob and points into it, nothing is copied.
+    static const uint8_t Identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+    texture_view View;
+    SetZero(View);
+    {
+        AssertMessageGoto(ByteCount >= sizeof(texture_ktx2_header) && ((uintptr_t)Bytes % 8) == 0, label_Error, "Texture is too small or misaligned.\n");
+        const texture_ktx2_header *Header = (const texture_ktx2_header *)Bytes;
+        AssertMessageGoto(memcmp(Header->Identifier, Identifier, sizeof(Identifier)) == 0, label_Error, "Texture is not a KTX2 file.\n");
+
+        // NOTE(blackedout): Basis Universal files have no format (VK_FORMAT_UNDEFINED) and need to be transcoded first
+        AssertMessageGoto(Header->VkFormat != VK_FORMAT_UNDEFINED && Header->SupercompressionScheme == 0, label_Error,
+                          "Texture is supercompressed or needs transcoding (format %d, scheme %d), which isn't supported.\n", Header->VkFormat, Header->SupercompressionScheme);
+        texture_format_block Block;
+        AssertMessageGoto(TextureFormatBlock((VkFormat)Header->VkFormat, &Block) == 0, label_Error, "Texture format %d is not supported.\n", Header->VkFormat);
+        AssertMessageGoto(Header->PixelWidth > 0 && Header->PixelHeight > 0 && Header->PixelDepth == 0 && Header->LayerCount == 0 && Header->FaceCount == 1,
+                          label_Error, "Texture is not a plain 2D texture.\n");
+
+        uint32_t StoredLevelCount = Max(Header->LevelCount, 1);
+        AssertMessageGoto(StoredLevelCount <= VULKAN_MAX_IMAGE_LEVEL_COUNT && (Header->LevelCount == 0 || (Max(Header->PixelWidth, Header->PixelHeight) >> (StoredLevelCount - 1)) > 0),
+                          label_Error, "Texture has too many levels (%d).\n", Header->LevelCount);
+        uint64_t LevelIndexByteCount = (uint64_t)StoredLevelCount*sizeof(texture_ktx2_level);
+        AssertMessageGoto(LevelIndexByteCount <= ByteCount - sizeof(texture_ktx2_header), label_Error, "Texture level index is truncated.\n");
+
+        const texture_ktx2_level *Levels = (const texture_ktx2_level *)(Bytes + sizeof(texture_ktx2_header));
+        for(uint32_t I = 0; I < StoredLevelCount; ++I) {
+            uint32_t Width = Max(Header->PixelWidth >> I, 1), Height = Max(Header->PixelHeight >> I, 1);
+            uint64_t LevelByteCount = (uint64_t)((Width + Block.Width - 1)/Block.Width)*((Height + Block.Height - 1)/Block.Height)*Block.ByteCount;
+            // NOTE(blackedout): Levels are aligned to the block size and 4 in the file, which buffer to image copies also require
+            int IsValid = Levels[I].ByteLength == LevelByteCount && Levels[I].ByteOffset <= ByteCount && LevelByteCount <= ByteCount - Levels[I].ByteOffset &&
+                          (Levels[I].ByteOffset % Block.ByteCount) == 0 && (Levels[I].ByteOffset % 4) == 0;
+            AssertMessageGoto(IsValid, label_Error, "Texture level %d is out of bounds or has the wrong size.\n", I);
+            View.LevelOffsets[I] = Levels[I].ByteOffset;
+        }
+
+        View.Bytes = Bytes;
+        View.ByteCount = ByteCount;
+        View.Format = (VkFormat)Header->VkFormat;
+        View.Width = Header->PixelWidth;
+        View.Height = Header->PixelHeight;
+        View.Block = Block;
+        View.LevelCount = Header->LevelCount;
+    }
+
+    *OutView = View;
+    return 0;
+
+label_Error:
+    return 1;
+}
\ No newline at end of file
@@ -43,6 +43,16 @@
 #define CODE_RESET ""
 #else
 #include <unistd.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
 #define SleepMilliseconds(Value) usleep(1000*(Value))
 #define CODE_YELLOW "\033[0;33m"
 #define CODE_RED "\033[0;31m"
@@ -57,6 +67,8 @@
 
 #define SetZero(Var) memset(&(Var), 0, sizeof(Var))
 
+#define HASH_FNV1A_BASIS 0xcbf29ce484222325ull
+
 #ifndef SIZE_T_MAX
 #define SIZE_T_MAX ((size_t)-1)
 #endif
@@ -248,6 +260,35 @@ static int MallocMultiple(int Count, malloc_multiple_subbuf *Subbufs, void **Out
     return 0;
 }
 
+static uint64_t HashBytesFNV1a(const void *Bytes, uint64_t ByteCount, uint64_t Hash) {
+    // NOTE(blackedout): FNV-1a 64 bit, pass HASH_FNV1A_BASIS as initial hash (or a previous result to continue hashing)
+    const uint8_t *At = (const uint8_t *)Bytes;
+    for(uint64_t I = 0; I < ByteCount; ++I) {
+        Hash ^= At[I];
+        Hash *= 0x100000001b3ull;
+    }
+    return Hash;
+}
+
+static uint32_t HighestBitIndex64(uint64_t X) {
+    // NOTE(blackedout): X must not be 0
+    uint32_t Index = 0;
+    while(X >>= 1) {
+        ++Index;
+    }
+    return Index;
+}
+
+static uint32_t LowestBitIndex64(uint64_t X) {
+    // NOTE(blackedout): X must not be 0
+    uint32_t Index = 0;
+    while((X & 1) == 0) {
+        X >>= 1;
+        ++Index;
+    }
+    return Index;
+}
+
 static int LoadFileContentsCStd(const char *Filepath, uint8_t **OutFileBytes, uint64_t *OutFileByteCount) {
     int Result = 1;
     long int FileByteCount = 0;
@@ -285,4 +326,989 @@ label_FileOpen:
     fclose(File);
 label_Exit:
     return Result;
+}
+
+// NOTE(blackedout): Minimal threading layer (threads, mutexes and condition variables) so that worker code doesn't have to care about the platform.
+#ifdef _WIN32
+typedef HANDLE platform_thread;
+typedef CRITICAL_SECTION platform_mutex;
+typedef CONDITION_VARIABLE platform_condition;
+#else
+typedef pthread_t platform_thread;
+typedef pthread_mutex_t platform_mutex;
+typedef pthread_cond_t platform_condition;
+#endif
+
+typedef void (*platform_thread_proc)(void *Data);
+
+typedef struct {
+    platform_thread_proc Proc;
+    void *Data;
+} platform_thread_start;
+
+#ifdef _WIN32
+static DWORD WINAPI PlatformThreadEntry(LPVOID Parameter) {
+#else
+static void *PlatformThreadEntry(void *Parameter) {
+#endif
+    platform_thread_start Start = *(platform_thread_start *)Parameter;
+    free(Parameter);
+    Start.Proc(Start.Data);
+    return 0;
+}
+
+static int PlatformCreateThread(platform_thread_proc Proc, void *Data, platform_thread *OutThread) {
+    // NOTE(blackedout): The start info is freed by the thread itself, because this function may return before the thread runs.
+    platform_thread_start *Start = (platform_thread_start *)malloc(sizeof(platform_thread_start));
+    AssertMessageGoto(Start, label_Error, "Thread could not be created: out of memory.\n");
+    Start->Proc = Proc;
+    Start->Data = Data;
+
+#ifdef _WIN32
+    HANDLE Thread = CreateThread(0, 0, PlatformThreadEntry, Start, 0, 0);
+    AssertMessageGoto(Thread, label_Start, "CreateThread failed (code %lu).\n", GetLastError());
+    *OutThread = Thread;
+#else
+    int CreateResult = pthread_create(OutThread, 0, PlatformThreadEntry, Start);
+    AssertMessageGoto(CreateResult == 0, label_Start, "pthread_create failed (code %d).\n", CreateResult);
+#endif
+
+    return 0;
+
+label_Start:
+    free(Start);
+label_Error:
+    return 1;
+}
+
+static void PlatformJoinThread(platform_thread Thread) {
+#ifdef _WIN32
+    WaitForSingleObject(Thread, INFINITE);
+    CloseHandle(Thread);
+#else
+    pthread_join(Thread, 0);
+#endif
+}
+
+static void PlatformMutexInit(platform_mutex *Mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(Mutex);
+#else
+    pthread_mutex_init(Mutex, 0);
+#endif
+}
+
+static void PlatformMutexDestroy(platform_mutex *Mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(Mutex);
+#else
+    pthread_mutex_destroy(Mutex);
+#endif
+}
+
+static void PlatformMutexLock(platform_mutex *Mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(Mutex);
+#else
+    pthread_mutex_lock(Mutex);
+#endif
+}
+
+static void PlatformMutexUnlock(platform_mutex *Mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(Mutex);
+#else
+    pthread_mutex_unlock(Mutex);
+#endif
+}
+
+static void PlatformConditionInit(platform_condition *Condition) {
+#ifdef _WIN32
+    InitializeConditionVariable(Condition);
+#else
+    pthread_cond_init(Condition, 0);
+#endif
+}
+
+static void PlatformConditionDestroy(platform_condition *Condition) {
+#ifdef _WIN32
+    // NOTE(blackedout): Windows condition variables don't need to be destroyed.
+#else
+    pthread_cond_destroy(Condition);
+#endif
+}
+
+static void PlatformConditionWait(platform_condition *Condition, platform_mutex *Mutex) {
+#ifdef _WIN32
+    SleepConditionVariableCS(Condition, Mutex, INFINITE);
+#else
+    pthread_cond_wait(Condition, Mutex);
+#endif
+}
+
+static void PlatformConditionSignal(platform_condition *Condition) {
+#ifdef _WIN32
+    WakeConditionVariable(Condition);
+#else
+    pthread_cond_signal(Condition);
+#endif
+}
+
+static void PlatformConditionBroadcast(platform_condition *Condition) {
+#ifdef _WIN32
+    WakeAllConditionVariable(Condition);
+#else
+    pthread_cond_broadcast(Condition);
+#endif
+}
+
+static uint32_t PlatformGetProcessorCount(void) {
+#ifdef _WIN32
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    return (uint32_t)Max(1, (long)SystemInfo.dwNumberOfProcessors);
+#else
+    long Count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (uint32_t)Max(1, Count);
+#endif
+}
+
+// NOTE(blackedout): Work pool that calls a procedure for each index of a range on worker threads, like a parallel for loop. The calling thread
+// takes indices as well and returns once all of them are done. Runs must not overlap, so a pool is only used by one thread at a time.
+#define WORK_POOL_MAX_THREAD_COUNT 16
+
+typedef void (*work_pool_proc)(void *Data, uint32_t Index);
+
+typedef struct {
+    platform_mutex Mutex;
+    platform_condition WorkQueued;
+    platform_condition WorkDone;
+    int ShouldQuit;
+
+    uint32_t ThreadCount;
+    platform_thread Threads[WORK_POOL_MAX_THREAD_COUNT];
+
+    work_pool_proc Proc;
+    void *Data;
+    uint32_t Count;
+    uint32_t NextIndex;
+    uint32_t DoneCount;
+} work_pool;
+
+static void WorkPoolThread(void *Data) {
+    work_pool *Pool = (work_pool *)Data;
+    PlatformMutexLock(&Pool->Mutex);
+    for(;;) {
+        while(Pool->ShouldQuit == 0 && Pool->NextIndex >= Pool->Count) {
+            PlatformConditionWait(&Pool->WorkQueued, &Pool->Mutex);
+        }
+        if(Pool->ShouldQuit) {
+            break;
+        }
+        uint32_t Index = Pool->NextIndex++;
+        work_pool_proc Proc = Pool->Proc;
+        void *ProcData = Pool->Data;
+        PlatformMutexUnlock(&Pool->Mutex);
+
+        Proc(ProcData, Index);
+
+        PlatformMutexLock(&Pool->Mutex);
+        if(++Pool->DoneCount == Pool->Count) {
+            PlatformConditionSignal(&Pool->WorkDone);
+        }
+    }
+    PlatformMutexUnlock(&Pool->Mutex);
+}
+
+static void WorkPoolRun(work_pool *Pool, work_pool_proc Proc, void *Data, uint32_t Count) {
+    PlatformMutexLock(&Pool->Mutex);
+    Pool->Proc = Proc;
+    Pool->Data = Data;
+    Pool->Count = Count;
+    Pool->NextIndex = 0;
+    Pool->DoneCount = 0;
+    if(Count > 1) {
+        PlatformConditionBroadcast(&Pool->WorkQueued);
+    }
+    while(Pool->NextIndex < Pool->Count) {
+        uint32_t Index = Pool->NextIndex++;
+        PlatformMutexUnlock(&Pool->Mutex);
+
+        Proc(Data, Index);
+
+        PlatformMutexLock(&Pool->Mutex);
+        ++Pool->DoneCount;
+    }
+    while(Pool->DoneCount < Pool->Count) {
+        PlatformConditionWait(&Pool->WorkDone, &Pool->Mutex);
+    }
+    // NOTE(blackedout): Workers go back to sleep, nothing is left to take
+    Pool->Count = 0;
+    Pool->NextIndex = 0;
+    PlatformMutexUnlock(&Pool->Mutex);
+}
+
+static void WorkPoolDestroy(work_pool *Pool) {
+    PlatformMutexLock(&Pool->Mutex);
+    Pool->ShouldQuit = 1;
+    PlatformConditionBroadcast(&Pool->WorkQueued);
+    PlatformMutexUnlock(&Pool->Mutex);
+
+    for(uint32_t I = 0; I < Pool->ThreadCount; ++I) {
+        PlatformJoinThread(Pool->Threads[I]);
+    }
+
+    PlatformConditionDestroy(&Pool->WorkDone);
+    PlatformConditionDestroy(&Pool->WorkQueued);
+    PlatformMutexDestroy(&Pool->Mutex);
+    memset(Pool, 0, sizeof(*Pool));
+}
+
+static int WorkPoolCreate(uint32_t ThreadCount, work_pool *Pool) {
+    // NOTE(blackedout): The pool is initialized in place, because its threads keep a pointer to it. With 0 threads, runs are done by the
+    // calling thread alone.
+    memset(Pool, 0, sizeof(*Pool));
+    PlatformMutexInit(&Pool->Mutex);
+    PlatformConditionInit(&Pool->WorkQueued);
+    PlatformConditionInit(&Pool->WorkDone);
+
+    ThreadCount = Min(ThreadCount, WORK_POOL_MAX_THREAD_COUNT);
+    for(; Pool->ThreadCount < ThreadCount; ++Pool->ThreadCount) {
+        CheckGoto(PlatformCreateThread(WorkPoolThread, Pool, Pool->Threads + Pool->ThreadCount), label_Threads);
+    }
+    return 0;
+
+label_Threads:
+    // NOTE(blackedout): Also handles the partially created threads.
+    WorkPoolDestroy(Pool);
+    return 1;
+}
+
+
+// NOTE(blackedout): Directory watching for file changes (e.g. shader sources). Only implemented with inotify for now, other platforms report it as unsupported.
+typedef struct {
+    int Handle;
+} platform_directory_watch;
+
+typedef void (*platform_directory_change_proc)(void *Data, const char *FileName);
+
+static void PlatformDestroyDirectoryWatch(platform_directory_watch *Watch) {
+#ifdef __linux__
+    if(Watch->Handle > 0) {
+        close(Watch->Handle);
+    }
+#endif
+    memset(Watch, 0, sizeof(*Watch));
+}
+
+static int PlatformCreateDirectoryWatch(const char *DirectoryPath, platform_directory_watch *OutWatch) {
+#ifdef __linux__
+    int Handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    AssertMessageGoto(Handle >= 0, label_Error, "inotify_init1 failed.\n");
+    // NOTE(blackedout): Editors either write files in place or write a temporary file and move it over the original, so both are watched.
+    int WatchDescriptor = inotify_add_watch(Handle, DirectoryPath, IN_CLOSE_WRITE | IN_MOVED_TO);
+    AssertMessageGoto(WatchDescriptor >= 0, label_Handle, "Directory '%s' could not be watched.\n", DirectoryPath);
+
+    OutWatch->Handle = Handle;
+    return 0;
+
+label_Handle:
+    close(Handle);
+label_Error:
+    return 1;
+#else
+    printfc(CODE_YELLOW, "Directory watching is not supported on this platform.\n");
+    return 1;
+#endif
+}
+
+static int PlatformWaitDirectoryChanges(platform_directory_watch *Watch, int TimeoutMilliseconds, platform_directory_change_proc Proc, void *Data, uint32_t *OutChangeCount) {
+    // NOTE(blackedout): Blocks for at most TimeoutMilliseconds and calls Proc once for every changed file name (relative to the watched directory).
+    uint32_t ChangeCount = 0;
+#ifdef __linux__
+    struct pollfd PollInfo = { .fd = Watch->Handle, .events = POLLIN, .revents = 0 };
+    int PollResult = poll(&PollInfo, 1, TimeoutMilliseconds);
+    AssertMessageGoto(PollResult >= 0, label_Error, "Polling directory watch failed.\n");
+
+    // NOTE(blackedout): inotify events are variable sized, the buffer has to be aligned like the event struct.
+    union {
+        struct inotify_event Event;
+        char Bytes[4096];
+    } Buffer;
+    for(;;) {
+        ssize_t ReadByteCount = read(Watch->Handle, Buffer.Bytes, sizeof(Buffer.Bytes));
+        if(ReadByteCount <= 0) {
+            break;
+        }
+        for(char *At = Buffer.Bytes; At < Buffer.Bytes + ReadByteCount;) {
+            struct inotify_event *Event = (struct inotify_event *)At;
+            if(Event->len > 0) {
+                Proc(Data, Event->name);
+                ++ChangeCount;
+            }
+            At += sizeof(struct inotify_event) + Event->len;
+        }
+    }
+#else
+    SleepMilliseconds(TimeoutMilliseconds);
+#endif
+
+    *OutChangeCount = ChangeCount;
+    return 0;
+
+#ifdef __linux__
+label_Error:
+    return 1;
+#endif
+}
+
+// NOTE(blackedout): Read only file mappings. Pages are only loaded when touched and can be dropped by the OS at any time, so mapped assets
+// don't count against the heap and don't need to be copied before they are used.
+typedef struct {
+    const uint8_t *Bytes;
+    uint64_t ByteCount;
+#ifdef _WIN32
+    HANDLE File;
+    HANDLE Mapping;
+#endif
+} platform_file_mapping;
+
+static void PlatformUnmapFile(platform_file_mapping *Mapping) {
+#ifdef _WIN32
+    if(Mapping->Bytes) {
+        UnmapViewOfFile(Mapping->Bytes);
+    }
+    if(Mapping->Mapping) {
+        CloseHandle(Mapping->Mapping);
+    }
+    if(Mapping->File && Mapping->File != INVALID_HANDLE_VALUE) {
+        CloseHandle(Mapping->File);
+    }
+#else
+    if(Mapping->Bytes) {
+        munmap((void *)Mapping->Bytes, (size_t)Mapping->ByteCount);
+    }
+#endif
+    memset(Mapping, 0, sizeof(*Mapping));
+}
+
+static int PlatformMapFile(const char *Filepath, platform_file_mapping *OutMapping) {
+    platform_file_mapping Mapping;
+    SetZero(Mapping);
+
+#ifdef _WIN32
+    Mapping.File = CreateFileA(Filepath, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    AssertMessageGoto(Mapping.File != INVALID_HANDLE_VALUE, label_Error, "File '%s' could not be opened (code %lu).\n", Filepath, GetLastError());
+    LARGE_INTEGER FileSize;
+    AssertMessageGoto(GetFileSizeEx(Mapping.File, &FileSize) && FileSize.QuadPart > 0, label_Error, "File '%s' is empty or its size could not be read.\n", Filepath);
+    Mapping.ByteCount = (uint64_t)FileSize.QuadPart;
+    Mapping.Mapping = CreateFileMappingA(Mapping.File, 0, PAGE_READONLY, 0, 0, 0);
+    AssertMessageGoto(Mapping.Mapping, label_Error, "File '%s' could not be mapped (code %lu).\n", Filepath, GetLastError());
+    Mapping.Bytes = (const uint8_t *)MapViewOfFile(Mapping.Mapping, FILE_MAP_READ, 0, 0, 0);
+    AssertMessageGoto(Mapping.Bytes, label_Error, "File '%s' could not be mapped (code %lu).\n", Filepath, GetLastError());
+#else
+    int File = open(Filepath, O_RDONLY);
+    AssertMessageGoto(File >= 0, label_Error, "File '%s' could not be opened (code %d).\n", Filepath, errno);
+    {
+        struct stat FileStat;
+        if(fstat(File, &FileStat) == 0 && FileStat.st_size > 0) {
+            void *Bytes = mmap(0, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+            if(Bytes != MAP_FAILED) {
+                Mapping.Bytes = (const uint8_t *)Bytes;
+                Mapping.ByteCount = (uint64_t)FileStat.st_size;
+            }
+        }
+        // NOTE(blackedout): The mapping stays valid after the file is closed.
+        close(File);
+    }
+    AssertMessageGoto(Mapping.Bytes, label_Error, "File '%s' is empty or could not be mapped.\n", Filepath);
+#endif
+
+    *OutMapping = Mapping;
+    return 0;
+
+label_Error:
+    PlatformUnmapFile(&Mapping);
+    return 1;
+}
+
+// NOTE(blackedout): Asset pack, a single file with a header, an index of named entries and the entry contents, each aligned to ASSET_PACK_ALIGNMENT.
+// It is written by pack.c and mapped as a whole at runtime, so that consumers read directly from the mapping instead of a heap copy.
+// The alignment is enough for SPIR-V (4 bytes) and for memcpys into staging memory to run at full speed.
+#define ASSET_PACK_MAGIC 0x4b505441 // NOTE(blackedout): "ATPK" in little endian
+#define ASSET_PACK_VERSION 1
+#define ASSET_PACK_ALIGNMENT 64
+#define ASSET_PACK_MAX_NAME_LENGTH 40
+
+typedef enum {
+    ASSET_TYPE_BLOB,
+    ASSET_TYPE_SPIRV,
+    ASSET_TYPE_VERTICES,
+    ASSET_TYPE_INDICES,
+    ASSET_TYPE_IMAGE,
+    ASSET_TYPE_MESH,
+    ASSET_TYPE_TEXTURE, // NOTE(blackedout): KTX2
+} asset_type;
+
+typedef struct {
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EntryCount;
+    uint32_t Reserved;
+} asset_pack_header;
+
+typedef struct {
+    char Name[ASSET_PACK_MAX_NAME_LENGTH]; // NOTE(blackedout): Zero terminated
+    uint32_t Type;
+    uint32_t Reserved;
+    uint64_t Offset;
+    uint64_t ByteCount;
+} asset_pack_entry;
+
+typedef struct {
+    platform_file_mapping Mapping;
+    uint32_t EntryCount;
+    const asset_pack_entry *Entries;
+} asset_pack;
+
+static void AssetPackClose(asset_pack *Pack) {
+    PlatformUnmapFile(&Pack->Mapping);
+    memset(Pack, 0, sizeof(*Pack));
+}
+
+static int AssetPackOpen(const char *Filepath, asset_pack *OutPack) {
+    asset_pack Pack;
+    SetZero(Pack);
+    CheckGoto(PlatformMapFile(Filepath, &Pack.Mapping), label_Error);
+    {
+        const uint8_t *Bytes = Pack.Mapping.Bytes;
+        uint64_t ByteCount = Pack.Mapping.ByteCount;
+        AssertMessageGoto(ByteCount >= sizeof(asset_pack_header), label_Mapping, "Asset pack '%s' is too small.\n", Filepath);
+
+        const asset_pack_header *Header = (const asset_pack_header *)Bytes;
+        AssertMessageGoto(Header->Magic == ASSET_PACK_MAGIC && Header->Version == ASSET_PACK_VERSION, label_Mapping, "'%s' is not an asset pack of version %d.\n", Filepath, ASSET_PACK_VERSION);
+        uint64_t IndexByteCount = sizeof(asset_pack_header) + (uint64_t)Header->EntryCount*sizeof(asset_pack_entry);
+        AssertMessageGoto(IndexByteCount <= ByteCount, label_Mapping, "Asset pack '%s' is truncated.\n", Filepath);
+
+        // NOTE(blackedout): Validate once here, so that lookups can trust the index.
+        const asset_pack_entry *Entries = (const asset_pack_entry *)(Bytes + sizeof(asset_pack_header));
+        for(uint32_t I = 0; I < Header->EntryCount; ++I) {
+            const asset_pack_entry *Entry = Entries + I;
+            int IsValid = Entry->Offset <= ByteCount && Entry->ByteCount <= ByteCount - Entry->Offset && (Entry->Offset % ASSET_PACK_ALIGNMENT) == 0 &&
+                          memchr(Entry->Name, 0, sizeof(Entry->Name)) != 0;
+            AssertMessageGoto(IsValid, label_Mapping, "Asset pack '%s' has an invalid entry (%d).\n", Filepath, I);
+        }
+
+        Pack.EntryCount = Header->EntryCount;
+        Pack.Entries = Entries;
+    }
+
+    *OutPack = Pack;
+    return 0;
+
+label_Mapping:
+    PlatformUnmapFile(&Pack.Mapping);
+label_Error:
+    return 1;
+}
+
+static int AssetPackFind(asset_pack *Pack, const char *Name, const uint8_t **OutBytes, uint64_t *OutByteCount) {
+    // NOTE(blackedout): Returns 1 without printing if the asset doesn't exist (or the pack isn't open), so that callers can fall back to loose files.
+    for(uint32_t I = 0; I < Pack->EntryCount; ++I) {
+        const asset_pack_entry *Entry = Pack->Entries + I;
+        if(strcmp(Entry->Name, Name) == 0) {
+            *OutBytes = Pack->Mapping.Bytes + Entry->Offset;
+            *OutByteCount = Entry->ByteCount;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// NOTE(blackedout): Files opened for reading at arbitrary offsets from any thread.
+#ifdef _WIN32
+typedef HANDLE platform_file;
+#define PLATFORM_INVALID_FILE INVALID_HANDLE_VALUE
+#else
+typedef int platform_file;
+#define PLATFORM_INVALID_FILE (-1)
+#endif
+
+static int PlatformOpenFile(const char *Filepath, platform_file *OutFile, uint64_t *OutByteCount) {
+#ifdef _WIN32
+    HANDLE File = CreateFileA(Filepath, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    AssertMessageGoto(File != INVALID_HANDLE_VALUE, label_Error, "File '%s' could not be opened (code %lu).\n", Filepath, GetLastError());
+    LARGE_INTEGER FileSize;
+    if(GetFileSizeEx(File, &FileSize) == 0) {
+        printfc(CODE_RED, "Size of file '%s' could not be read.\n", Filepath);
+        CloseHandle(File);
+        goto label_Error;
+    }
+    *OutByteCount = (uint64_t)FileSize.QuadPart;
+#else
+    int File = open(Filepath, O_RDONLY | O_CLOEXEC);
+    AssertMessageGoto(File >= 0, label_Error, "File '%s' could not be opened (code %d).\n", Filepath, errno);
+    struct stat FileStat;
+    if(fstat(File, &FileStat) != 0) {
+        printfc(CODE_RED, "Size of file '%s' could not be read.\n", Filepath);
+        close(File);
+        goto label_Error;
+    }
+    *OutByteCount = (uint64_t)FileStat.st_size;
+#endif
+
+    *OutFile = File;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void PlatformCloseFile(platform_file File) {
+    if(File == PLATFORM_INVALID_FILE) {
+        return;
+    }
+#ifdef _WIN32
+    CloseHandle(File);
+#else
+    close(File);
+#endif
+}
+
+static int PlatformReadFileAt(platform_file File, uint64_t Offset, void *Destination, uint64_t ByteCount, uint64_t *OutReadByteCount) {
+    // NOTE(blackedout): Blocking positional read that doesn't touch a shared file position, so it can run on many threads at once.
+    // Stops early only at the end of the file.
+    uint64_t ReadByteCount = 0;
+    while(ReadByteCount < ByteCount) {
+        uint64_t ChunkByteCount = Min(ByteCount - ReadByteCount, (uint64_t)1 << 30);
+#ifdef _WIN32
+        OVERLAPPED Overlapped;
+        SetZero(Overlapped);
+        Overlapped.Offset = (DWORD)(Offset + ReadByteCount);
+        Overlapped.OffsetHigh = (DWORD)((Offset + ReadByteCount) >> 32);
+        DWORD ChunkReadByteCount = 0;
+        if(ReadFile(File, (uint8_t *)Destination + ReadByteCount, (DWORD)ChunkByteCount, &ChunkReadByteCount, &Overlapped) == 0) {
+            if(GetLastError() == ERROR_HANDLE_EOF) {
+                break;
+            }
+            return 1;
+        }
+#else
+        ssize_t ChunkReadByteCount = pread(File, (uint8_t *)Destination + ReadByteCount, (size_t)ChunkByteCount, (off_t)(Offset + ReadByteCount));
+        if(ChunkReadByteCount < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+#endif
+        if(ChunkReadByteCount == 0) {
+            break;
+        }
+        ReadByteCount += (uint64_t)ChunkReadByteCount;
+    }
+    *OutReadByteCount = ReadByteCount;
+    return 0;
+}
+
+// NOTE(blackedout): Asynchronous file reads into caller provided memory (e.g. mapped staging buffers). Reads are described by async_file_read
+// structs owned by the caller, which also act as handles: after AsyncFilePoll their State tells whether they are done and the optional
+// callback has been called. There is no limit on the number of reads in flight, reads that don't fit into the backend are queued.
+// On Linux io_uring is used if the kernel supports it, otherwise (and on other platforms) a small thread pool does blocking positional reads.
+// Submit, poll and wait must all be called from the same thread (usually the render thread), callbacks are called on it too.
+#define ASYNC_FILE_RING_ENTRY_COUNT 256
+#define ASYNC_FILE_MAX_THREAD_COUNT 8
+#define ASYNC_FILE_MAX_RING_READ_BYTE_COUNT ((uint64_t)1 << 30)
+
+typedef enum {
+    ASYNC_FILE_READ_PENDING,
+    ASYNC_FILE_READ_DONE,
+    ASYNC_FILE_READ_FAILED,
+} async_file_read_state;
+
+typedef struct async_file_read async_file_read;
+typedef void (*async_file_read_proc)(async_file_read *Read);
+
+struct async_file_read {
+    // NOTE(blackedout): Filled by the caller. The struct must stay at the same address until the read is no longer pending.
+    platform_file File;
+    uint64_t Offset;
+    uint64_t ByteCount;
+    void *Destination;
+    async_file_read_proc Callback; // NOTE(blackedout): Optional
+    void *UserData;
+
+    // NOTE(blackedout): Written by the file system.
+    async_file_read_state State;
+    uint64_t ReadByteCount;
+    async_file_read *Next;
+};
+
+typedef struct {
+    async_file_read *First;
+    async_file_read *Last;
+} async_file_read_list;
+
+typedef struct {
+    int UseRing;
+
+    // NOTE(blackedout): Reads that weren't handed to the backend yet. With the thread pool, workers take reads from here (guarded by the mutex).
+    async_file_read_list Queued;
+    uint32_t InFlightCount;
+
+    // NOTE(blackedout): Thread pool backend
+    platform_mutex Mutex;
+    platform_condition ReadQueued;
+    platform_condition ReadCompleted;
+    int ShouldQuit;
+    uint32_t ThreadCount;
+    platform_thread Threads[ASYNC_FILE_MAX_THREAD_COUNT];
+    async_file_read_list Completed;
+
+#ifdef __linux__
+    // NOTE(blackedout): io_uring backend, only accessed by the submitting thread
+    int RingFile;
+    uint32_t RingEntryCount;
+    uint32_t CompletionEntryCount;
+    void *SubmissionMapping;
+    size_t SubmissionMappingByteCount;
+    void *CompletionMapping;
+    size_t CompletionMappingByteCount;
+    struct io_uring_sqe *SubmissionEntries;
+    uint32_t *SubmissionHead;
+    uint32_t *SubmissionTail;
+    uint32_t *SubmissionMask;
+    uint32_t *SubmissionArray;
+    uint32_t *CompletionHead;
+    uint32_t *CompletionTail;
+    uint32_t *CompletionMask;
+    struct io_uring_cqe *CompletionEntries;
+#endif
+} async_file_system;
+
+static void AsyncFileListPush(async_file_read_list *List, async_file_read *Read) {
+    Read->Next = 0;
+    if(List->Last) {
+        List->Last->Next = Read;
+    } else {
+        List->First = Read;
+    }
+    List->Last = Read;
+}
+
+static void AsyncFileListPushFront(async_file_read_list *List, async_file_read *Read) {
+    Read->Next = List->First;
+    List->First = Read;
+    if(List->Last == 0) {
+        List->Last = Read;
+    }
+}
+
+static async_file_read *AsyncFileListPop(async_file_read_list *List) {
+    async_file_read *Read = List->First;
+    if(Read) {
+        List->First = Read->Next;
+        if(List->First == 0) {
+            List->Last = 0;
+        }
+        Read->Next = 0;
+    }
+    return Read;
+}
+
+static void AsyncFileFinishRead(async_file_read *Read, int IsFailed) {
+    Read->State = IsFailed? ASYNC_FILE_READ_FAILED : ASYNC_FILE_READ_DONE;
+    if(Read->Callback) {
+        Read->Callback(Read);
+    }
+}
+
+static void AsyncFileThread(void *Data) {
+    async_file_system *System = (async_file_system *)Data;
+
+    PlatformMutexLock(&System->Mutex);
+    for(;;) {
+        async_file_read *Read = AsyncFileListPop(&System->Queued);
+        if(Read == 0) {
+            if(System->ShouldQuit) {
+                break;
+            }
+            PlatformConditionWait(&System->ReadQueued, &System->Mutex);
+            continue;
+        }
+        PlatformMutexUnlock(&System->Mutex);
+
+        uint64_t ReadByteCount = 0;
+        int ReadResult = PlatformReadFileAt(Read->File, Read->Offset, Read->Destination, Read->ByteCount, &ReadByteCount);
+
+        PlatformMutexLock(&System->Mutex);
+        // NOTE(blackedout): State is only changed by the polling thread, a short read (end of file) is reported as failure there.
+        Read->ReadByteCount = ReadResult? 0 : ReadByteCount;
+        AsyncFileListPush(&System->Completed, Read);
+        PlatformConditionBroadcast(&System->ReadCompleted);
+    }
+    PlatformMutexUnlock(&System->Mutex);
+}
+
+#ifdef __linux__
+static void AsyncFileSubmitRing(async_file_system *System) {
+    uint32_t Tail = *System->SubmissionTail;
+    uint32_t SubmitCount = 0;
+    while(System->Queued.First && System->InFlightCount < System->CompletionEntryCount) {
+        uint32_t Head = __atomic_load_n(System->SubmissionHead, __ATOMIC_ACQUIRE);
+        if(Tail - Head >= System->RingEntryCount) {
+            break;
+        }
+
+        async_file_read *Read = AsyncFileListPop(&System->Queued);
+        uint32_t Index = Tail & *System->SubmissionMask;
+        struct io_uring_sqe *Entry = System->SubmissionEntries + Index;
+        memset(Entry, 0, sizeof(*Entry));
+        Entry->opcode = IORING_OP_READ;
+        Entry->fd = Read->File;
+        Entry->off = Read->Offset + Read->ReadByteCount;
+        Entry->addr = (uint64_t)(uintptr_t)((uint8_t *)Read->Destination + Read->ReadByteCount);
+        Entry->len = (uint32_t)Min(Read->ByteCount - Read->ReadByteCount, ASYNC_FILE_MAX_RING_READ_BYTE_COUNT);
+        Entry->user_data = (uint64_t)(uintptr_t)Read;
+        System->SubmissionArray[Index] = Index;
+
+        ++Tail;
+        ++SubmitCount;
+        ++System->InFlightCount;
+    }
+
+    if(SubmitCount) {
+        __atomic_store_n(System->SubmissionTail, Tail, __ATOMIC_RELEASE);
+        long EnterResult;
+        do {
+            EnterResult = syscall(__NR_io_uring_enter, System->RingFile, SubmitCount, 0, 0, 0, 0);
+        } while(EnterResult < 0 && errno == EINTR);
+        AssertMessage(EnterResult >= 0, "io_uring_enter failed (code %d).\n", errno);
+    }
+}
+
+static uint32_t AsyncFileReapRing(async_file_system *System) {
+    uint32_t Head = *System->CompletionHead;
+    uint32_t Tail = __atomic_load_n(System->CompletionTail, __ATOMIC_ACQUIRE);
+    uint32_t FinishedCount = 0;
+    for(; Head != Tail; ++Head) {
+        struct io_uring_cqe *Entry = System->CompletionEntries + (Head & *System->CompletionMask);
+        async_file_read *Read = (async_file_read *)(uintptr_t)Entry->user_data;
+        int32_t EntryResult = Entry->res;
+        --System->InFlightCount;
+
+        if(EntryResult > 0 && Read->ReadByteCount + (uint64_t)EntryResult < Read->ByteCount) {
+            // NOTE(blackedout): Short read, the rest is submitted again before anything else.
+            Read->ReadByteCount += (uint64_t)EntryResult;
+            AsyncFileListPushFront(&System->Queued, Read);
+        } else if(EntryResult == -EAGAIN || EntryResult == -EINTR) {
+            AsyncFileListPushFront(&System->Queued, Read);
+        } else {
+            if(EntryResult > 0) {
+                Read->ReadByteCount += (uint64_t)EntryResult;
+            }
+            AsyncFileFinishRead(Read, Read->ReadByteCount != Read->ByteCount);
+            ++FinishedCount;
+        }
+    }
+    __atomic_store_n(System->CompletionHead, Head, __ATOMIC_RELEASE);
+    return FinishedCount;
+}
+
+static void AsyncFileDestroyRing(async_file_system *System) {
+    if(System->SubmissionEntries) {
+        munmap(System->SubmissionEntries, System->RingEntryCount*sizeof(struct io_uring_sqe));
+    }
+    if(System->CompletionMapping && System->CompletionMapping != System->SubmissionMapping) {
+        munmap(System->CompletionMapping, System->CompletionMappingByteCount);
+    }
+    if(System->SubmissionMapping) {
+        munmap(System->SubmissionMapping, System->SubmissionMappingByteCount);
+    }
+    if(System->RingFile > 0) {
+        close(System->RingFile);
+    }
+    System->RingFile = 0;
+    System->SubmissionEntries = 0;
+    System->SubmissionMapping = System->CompletionMapping = 0;
+}
+
+static int AsyncFileCreateRing(async_file_system *System) {
+    // NOTE(blackedout): Set up by hand with the raw system calls, so that there is no dependency on liburing.
+    struct io_uring_params Params;
+    SetZero(Params);
+    long RingFile = syscall(__NR_io_uring_setup, ASYNC_FILE_RING_ENTRY_COUNT, &Params);
+    CheckGoto(RingFile < 0, label_Error);
+    System->RingFile = (int)RingFile;
+    // NOTE(blackedout): IORING_OP_READ was added in the same kernel version as this feature flag.
+    CheckGoto((Params.features & IORING_FEAT_RW_CUR_POS) == 0, label_Ring);
+
+    System->RingEntryCount = Params.sq_entries;
+    System->CompletionEntryCount = Params.cq_entries;
+    System->SubmissionMappingByteCount = Params.sq_off.array + Params.sq_entries*sizeof(uint32_t);
+    System->CompletionMappingByteCount = Params.cq_off.cqes + Params.cq_entries*sizeof(struct io_uring_cqe);
+    int IsSingleMapping = (Params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if(IsSingleMapping) {
+        System->SubmissionMappingByteCount = System->CompletionMappingByteCount = Max(System->SubmissionMappingByteCount, System->CompletionMappingByteCount);
+    }
+
+    void *SubmissionMapping = mmap(0, System->SubmissionMappingByteCount, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, System->RingFile, IORING_OFF_SQ_RING);
+    CheckGoto(SubmissionMapping == MAP_FAILED, label_Ring);
+    System->SubmissionMapping = SubmissionMapping;
+    if(IsSingleMapping) {
+        System->CompletionMapping = SubmissionMapping;
+    } else {
+        void *CompletionMapping = mmap(0, System->CompletionMappingByteCount, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, System->RingFile, IORING_OFF_CQ_RING);
+        CheckGoto(CompletionMapping == MAP_FAILED, label_Ring);
+        System->CompletionMapping = CompletionMapping;
+    }
+    void *SubmissionEntries = mmap(0, Params.sq_entries*sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, System->RingFile, IORING_OFF_SQES);
+    CheckGoto(SubmissionEntries == MAP_FAILED, label_Ring);
+    System->SubmissionEntries = (struct io_uring_sqe *)SubmissionEntries;
+
+    uint8_t *Submission = (uint8_t *)System->SubmissionMapping;
+    uint8_t *Completion = (uint8_t *)System->CompletionMapping;
+    System->SubmissionHead = (uint32_t *)(Submission + Params.sq_off.head);
+    System->SubmissionTail = (uint32_t *)(Submission + Params.sq_off.tail);
+    System->SubmissionMask = (uint32_t *)(Submission + Params.sq_off.ring_mask);
+    System->SubmissionArray = (uint32_t *)(Submission + Params.sq_off.array);
+    System->CompletionHead = (uint32_t *)(Completion + Params.cq_off.head);
+    System->CompletionTail = (uint32_t *)(Completion + Params.cq_off.tail);
+    System->CompletionMask = (uint32_t *)(Completion + Params.cq_off.ring_mask);
+    System->CompletionEntries = (struct io_uring_cqe *)(Completion + Params.cq_off.cqes);
+    return 0;
+
+label_Ring:
+    AsyncFileDestroyRing(System);
+label_Error:
+    return 1;
+}
+#endif
+
+static void AsyncFileSubmit(async_file_system *System, async_file_read *Reads, uint32_t ReadCount) {
+    // NOTE(blackedout): Submits a batch of reads with a single system call (or wakeup) instead of one per read.
+    if(System->UseRing == 0) {
+        PlatformMutexLock(&System->Mutex);
+    }
+    for(uint32_t I = 0; I < ReadCount; ++I) {
+        async_file_read *Read = Reads + I;
+        Read->State = ASYNC_FILE_READ_PENDING;
+        Read->ReadByteCount = 0;
+        AsyncFileListPush(&System->Queued, Read);
+    }
+
+
+#ifdef __linux__
+    if(System->UseRing) {
+        AsyncFileSubmitRing(System);
+        return;
+    }
+#endif
+    // NOTE(blackedout): With the thread pool, reads count as in flight from submission on, because workers take them from the queue.
+    System->InFlightCount += ReadCount;
+    PlatformConditionBroadcast(&System->ReadQueued);
+    PlatformMutexUnlock(&System->Mutex);
+}
+
+static uint32_t AsyncFilePoll(async_file_system *System) {
+    // NOTE(blackedout): Never blocks. Finishes completed reads (calling their callbacks) and submits queued ones, returns the number of finished reads.
+    uint32_t FinishedCount = 0;
+#ifdef __linux__
+    if(System->UseRing) {
+        FinishedCount = AsyncFileReapRing(System);
+        AsyncFileSubmitRing(System);
+        return FinishedCount;
+    }
+#endif
+
+    PlatformMutexLock(&System->Mutex);
+    async_file_read_list Completed = System->Completed;
+    System->Completed.First = System->Completed.Last = 0;
+    PlatformMutexUnlock(&System->Mutex);
+
+    for(async_file_read *Read = Completed.First; Read;) {
+        async_file_read *Next = Read->Next;
+        Read->Next = 0;
+        --System->InFlightCount;
+        AsyncFileFinishRead(Read, Read->ReadByteCount != Read->ByteCount);
+        ++FinishedCount;
+        Read = Next;
+    }
+    return FinishedCount;
+}
+
+static void AsyncFileWait(async_file_system *System, async_file_read *Read) {
+    // NOTE(blackedout): Blocks until the read is done (pass 0 to wait for all reads), meant for loading screens and shutdown.
+    for(;;) {
+        AsyncFilePoll(System);
+        int IsPending = Read? Read->State == ASYNC_FILE_READ_PENDING : (System->InFlightCount > 0 || (System->UseRing && System->Queued.First));
+        if(IsPending == 0) {
+            break;
+        }
+
+#ifdef __linux__
+        if(System->UseRing) {
+            long EnterResult = syscall(__NR_io_uring_enter, System->RingFile, 0, 1, IORING_ENTER_GETEVENTS, 0, 0);
+            if(EnterResult < 0 && errno != EINTR) {
+                printfc(CODE_RED, "io_uring_enter failed (code %d).\n", errno);
+                break;
+            }
+            continue;
+        }
+#endif
+        PlatformMutexLock(&System->Mutex);
+        if(System->Completed.First == 0) {
+            PlatformConditionWait(&System->ReadCompleted, &System->Mutex);
+        }
+        PlatformMutexUnlock(&System->Mutex);
+    }
+}
+
+static void AsyncFileDestroySystem(async_file_system *System) {
+    // NOTE(blackedout): Waits for all reads, so that no destination memory is written after this returns.
+    AsyncFileWait(System, 0);
+#ifdef __linux__
+    if(System->UseRing) {
+        AsyncFileDestroyRing(System);
+        memset(System, 0, sizeof(*System));
+        return;
+    }
+#endif
+
+    PlatformMutexLock(&System->Mutex);
+    System->ShouldQuit = 1;
+    PlatformConditionBroadcast(&System->ReadQueued);
+    PlatformMutexUnlock(&System->Mutex);
+    for(uint32_t I = 0; I < System->ThreadCount; ++I) {
+        PlatformJoinThread(System->Threads[I]);
+    }
+    PlatformConditionDestroy(&System->ReadCompleted);
+    PlatformConditionDestroy(&System->ReadQueued);
+    PlatformMutexDestroy(&System->Mutex);
+    memset(System, 0, sizeof(*System));
+}
+
+static int AsyncFileCreateSystem(uint32_t ThreadCount, async_file_system *System) {
+    // NOTE(blackedout): Initialized in place, because the worker threads keep a pointer to it. ThreadCount is only used by the thread pool backend.
+    memset(System, 0, sizeof(*System));
+#ifdef __linux__
+    if(AsyncFileCreateRing(System) == 0) {
+        System->UseRing = 1;
+        return 0;
+    }
+#endif
+
+    PlatformMutexInit(&System->Mutex);
+    PlatformConditionInit(&System->ReadQueued);
+    PlatformConditionInit(&System->ReadCompleted);
+    ThreadCount = Clamp(ThreadCount, 1, ASYNC_FILE_MAX_THREAD_COUNT);
+    for(; System->ThreadCount < ThreadCount; ++System->ThreadCount) {
+        CheckGoto(PlatformCreateThread(AsyncFileThread, System, System->Threads + System->ThreadCount), label_Threads);
+    }
+    return 0;
+
+label_Threads:
+    // NOTE(blackedout): Also handles the partially created threads.
+    AsyncFileDestroySystem(System);
+    return 1;
 }
\ No newline at end of file
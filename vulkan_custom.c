@@ -21,61 +21,242 @@
 // 3. This notice may not be removed or altered from any source distribution.
 
 // MARK: Shaders
+enum {
+    SHADER_FILE_DEFAULT_VERT,
+    SHADER_FILE_DEFAULT_FRAG,
+    SHADER_FILE_QUANTIZED_VERT,
+    SHADER_FILE_CULL_COMP,
+    SHADER_FILE_DEPTH_PYRAMID_COMP,
+    SHADER_FILE_DEPTH_PYRAMID_SINGLE_SAMPLED_COMP,
+    SHADER_FILE_LIGHT_BIN_COMP,
+
+    SHADER_FILE_COUNT
+};
+
+typedef struct {
+    const char *SourceName; // NOTE(blackedout): Relative to the shaders directory
+    const char *Defines; // NOTE(blackedout): Passed to glslc, variants of the same source only differ in these
+    const char *BinaryPath;
+    const char *AssetName;
+} shader_file;
+
+static shader_file SHADER_FILES[SHADER_FILE_COUNT] = {
+    { "default.vert", "", "bin/shaders/default.vert.spv", "default.vert.spv" },
+    { "default.frag", "", "bin/shaders/default.frag.spv", "default.frag.spv" },
+    { "quantized.vert", "", "bin/shaders/quantized.vert.spv", "quantized.vert.spv" },
+    { "cull.comp", "", "bin/shaders/cull.comp.spv", "cull.comp.spv" },
+    { "depthpyramid.comp", "", "bin/shaders/depthpyramid.comp.spv", "depthpyramid.comp.spv" },
+    { "depthpyramid.comp", "-DSINGLE_SAMPLED", "bin/shaders/depthpyramid_single.comp.spv", "depthpyramid_single.comp.spv" },
+    { "lightbin.comp", "", "bin/shaders/lightbin.comp.spv", "lightbin.comp.spv" },
+};
+
+static VkShaderModule *ShaderFileModule(shaders *Shaders, uint32_t FileIndex) {
+    switch(FileIndex) {
+    case SHADER_FILE_DEFAULT_VERT: return &Shaders->Default.Vert;
+    case SHADER_FILE_DEFAULT_FRAG: return &Shaders->Default.Frag;
+    case SHADER_FILE_QUANTIZED_VERT: return &Shaders->QuantizedVert;
+    case SHADER_FILE_CULL_COMP: return &Shaders->CullComp;
+    case SHADER_FILE_DEPTH_PYRAMID_COMP: return &Shaders->DepthPyramidComp;
+    case SHADER_FILE_DEPTH_PYRAMID_SINGLE_SAMPLED_COMP: return &Shaders->DepthPyramidSingleSampledComp;
+    case SHADER_FILE_LIGHT_BIN_COMP: return &Shaders->LightBinComp;
+    default: return 0;
+    }
+}
+
 static void DestroyShaders(vulkan_surface_device *Device, shaders *Shaders) {
     VkDevice DeviceHandle = Device->Handle;
     vkDestroyDescriptorPool(DeviceHandle, Shaders->DefaultDescriptorPool, 0);
     vkDestroySampler(DeviceHandle, Shaders->DefaultSampler, 0);
 
-    vkDestroyDescriptorPool(DeviceHandle, Shaders->UniformDescriptorPool, 0);
-    vkFreeMemory(DeviceHandle, Shaders->UniformBufferMemory, 0);
     for(uint32_t I = 0; I < ArrayCount(Shaders->UniformMatsBuffers); ++I) {
         vkDestroyBuffer(DeviceHandle, Shaders->UniformMatsBuffers[I], 0);
+        VulkanFreeAllocation(Device, Shaders->UniformMatsAllocations + I);
     }
 
     VulkanDestroyDescriptorSetLayouts(Device, Shaders->DescriptorSetLayouts, ArrayCount(Shaders->DescriptorSetLayouts));
+    vkDestroyShaderModule(DeviceHandle, Shaders->LightBinComp, 0);
+    vkDestroyShaderModule(DeviceHandle, Shaders->DepthPyramidSingleSampledComp, 0);
+    vkDestroyShaderModule(DeviceHandle, Shaders->DepthPyramidComp, 0);
+    vkDestroyShaderModule(DeviceHandle, Shaders->CullComp, 0);
+    vkDestroyShaderModule(DeviceHandle, Shaders->QuantizedVert, 0);
     vkDestroyShaderModule(DeviceHandle, Shaders->Default.Frag, 0);
     vkDestroyShaderModule(DeviceHandle, Shaders->Default.Vert, 0);
 
     memset(Shaders, 0, sizeof(*Shaders));
 }
 
-static int LoadShaders(vulkan_surface_device *Device, vulkan_image *Images, shaders *OutShaders) {
+static int LoadShaderFilesBytes(asset_pack *Assets, const uint8_t **OutBytes, uint64_t *OutByteCounts, uint8_t **OutFileBytes) {
+    // NOTE(blackedout): SPIR-V is read straight from the mapped asset pack. Shaders the pack doesn't contain (e.g. when it wasn't built) are read
+    // from their loose files with one batch of asynchronous reads, into OutFileBytes entries that have to be freed. All arrays have SHADER_FILE_COUNT entries.
+    int Result = 1;
+    platform_file Files[SHADER_FILE_COUNT];
+    async_file_read Reads[SHADER_FILE_COUNT];
+    uint32_t ReadFileIndices[SHADER_FILE_COUNT];
+    uint32_t ReadCount = 0;
+    for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+        Files[I] = PLATFORM_INVALID_FILE;
+        OutFileBytes[I] = 0;
+    }
+    {
+        for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+            shader_file File = SHADER_FILES[I];
+            if(AssetPackFind(Assets, File.AssetName, OutBytes + I, OutByteCounts + I) == 0) {
+                continue;
+            }
+            CheckGoto(PlatformOpenFile(File.BinaryPath, Files + I, OutByteCounts + I), label_Exit);
+            OutFileBytes[I] = (uint8_t *)malloc(OutByteCounts[I]);
+            AssertMessageGoto(OutFileBytes[I], label_Exit, "Failed to allocate %llu bytes for %s.\n", (unsigned long long)OutByteCounts[I], File.BinaryPath);
+            OutBytes[I] = OutFileBytes[I];
+
+            async_file_read Read;
+            SetZero(Read);
+            Read.File = Files[I];
+            Read.Offset = 0;
+            Read.ByteCount = OutByteCounts[I];
+            Read.Destination = OutFileBytes[I];
+            ReadFileIndices[ReadCount] = I;
+            Reads[ReadCount++] = Read;
+        }
+
+        if(ReadCount > 0) {
+            async_file_system FileSystem;
+            CheckGoto(AsyncFileCreateSystem(ReadCount, &FileSystem), label_Exit);
+            AsyncFileSubmit(&FileSystem, Reads, ReadCount);
+            AsyncFileWait(&FileSystem, 0);
+            AsyncFileDestroySystem(&FileSystem);
+            for(uint32_t I = 0; I < ReadCount; ++I) {
+                AssertMessageGoto(Reads[I].State == ASYNC_FILE_READ_DONE, label_Exit, "Failed to read %s.\n", SHADER_FILES[ReadFileIndices[I]].BinaryPath);
+            }
+        }
+        Result = 0;
+    }
+
+label_Exit:
+    for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+        PlatformCloseFile(Files[I]);
+        if(Result) {
+            free(OutFileBytes[I]);
+            OutFileBytes[I] = 0;
+        }
+    }
+    return Result;
+}
+
+static int AddTableTexture(vulkan_surface_device *Device, shaders *Shaders, VkImageView ImageView, uint32_t *OutTextureIndex) {
+    // NOTE(blackedout): Textures are only ever appended. With descriptor indexing, this may happen while the table is bound by a
+    // command buffer that hasn't been submitted yet, otherwise the table must not be in use.
+    uint32_t Capacity = Shaders->TextureTableCount*Shaders->TextureTableSize;
+    AssertMessageGoto(Shaders->TextureCount < Capacity, label_Error, "Texture table is full (%u textures).\n", Capacity);
+    {
+        VkDescriptorImageInfo ImageInfo = {
+            .sampler = VULKAN_NULL_HANDLE,
+            .imageView = ImageView,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        };
+        VkWriteDescriptorSet WriteDescriptorSet = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = 0,
+            .dstSet = Shaders->TextureTableSets[Shaders->TextureCount/Shaders->TextureTableSize],
+            .dstBinding = 2,
+            .dstArrayElement = Shaders->TextureCount%Shaders->TextureTableSize,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            .pImageInfo = &ImageInfo,
+            .pBufferInfo = 0,
+            .pTexelBufferView = 0
+        };
+        vkUpdateDescriptorSets(Device->Handle, 1, &WriteDescriptorSet, 0, 0);
+        *OutTextureIndex = Shaders->TextureCount++;
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int LoadShaders(vulkan_surface_device *Device, asset_pack *Assets, vulkan_image *Images, vulkan_descriptor_allocator *DescriptorAllocator, shaders *OutShaders) {
     VkDevice DeviceHandle = Device->Handle;
     int Result = 1;
-    uint8_t *BytesVS = 0, *BytesFS = 0;
-    uint64_t ByteCountVS, ByteCountFS;
+    uint8_t *FileBytes[SHADER_FILE_COUNT] = {0};
+    const uint8_t *Bytes[SHADER_FILE_COUNT];
+    uint64_t ByteCounts[SHADER_FILE_COUNT];
     shaders Shaders;
     SetZero(Shaders);
     {
-        CheckGoto(LoadFileContentsCStd("bin/shaders/default.vert.spv", &BytesVS, &ByteCountVS), label_Exit);
-        CheckGoto(LoadFileContentsCStd("bin/shaders/default.frag.spv", &BytesFS, &ByteCountFS), label_Exit);
+        CheckGoto(LoadShaderFilesBytes(Assets, Bytes, ByteCounts, FileBytes), label_Exit);
 
-        CheckGoto(VulkanCreateShaderModule(Device, BytesVS, ByteCountVS, &Shaders.Default.Vert), label_Exit);
-        CheckGoto(VulkanCreateShaderModule(Device, BytesFS, ByteCountFS, &Shaders.Default.Frag), label_VS);
+        CheckGoto(VulkanCreateShaderModule(Device, Bytes[SHADER_FILE_DEFAULT_VERT], ByteCounts[SHADER_FILE_DEFAULT_VERT], &Shaders.Default.Vert), label_Exit);
+        CheckGoto(VulkanCreateShaderModule(Device, Bytes[SHADER_FILE_DEFAULT_FRAG], ByteCounts[SHADER_FILE_DEFAULT_FRAG], &Shaders.Default.Frag), label_VS);
+        CheckGoto(VulkanCreateShaderModule(Device, Bytes[SHADER_FILE_QUANTIZED_VERT], ByteCounts[SHADER_FILE_QUANTIZED_VERT], &Shaders.QuantizedVert), label_FS);
+        CheckGoto(VulkanCreateShaderModule(Device, Bytes[SHADER_FILE_CULL_COMP], ByteCounts[SHADER_FILE_CULL_COMP], &Shaders.CullComp), label_QuantizedVS);
+        CheckGoto(VulkanCreateShaderModule(Device, Bytes[SHADER_FILE_DEPTH_PYRAMID_COMP], ByteCounts[SHADER_FILE_DEPTH_PYRAMID_COMP], &Shaders.DepthPyramidComp), label_CullCS);
+        CheckGoto(VulkanCreateShaderModule(Device, Bytes[SHADER_FILE_DEPTH_PYRAMID_SINGLE_SAMPLED_COMP], ByteCounts[SHADER_FILE_DEPTH_PYRAMID_SINGLE_SAMPLED_COMP], &Shaders.DepthPyramidSingleSampledComp), label_DepthPyramidCS);
+        CheckGoto(VulkanCreateShaderModule(Device, Bytes[SHADER_FILE_LIGHT_BIN_COMP], ByteCounts[SHADER_FILE_LIGHT_BIN_COMP], &Shaders.LightBinComp), label_DepthPyramidSingleSampledCS);
 
         // NOTE(blackedout): Create all descriptor set layouts
         VkDescriptorSetLayoutBinding DefaultUniformDescriptorSetLayoutBinding[] = {
-            { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, .pImmutableSamplers = 0 }
+            { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 }
         };
         VkDescriptorSetLayoutBinding DefaultDescriptorSetLayoutBindings[] = {
             { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT, .pImmutableSamplers = 0 },
-            { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT, .pImmutableSamplers = 0 }
+            { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = 0, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT, .pImmutableSamplers = 0 }
+        };
+        // NOTE(blackedout): Written by lightbin.comp and read by default.frag, so the same set is bound to both pipelines
+        VkDescriptorSetLayoutBinding ClusteredLightsDescriptorSetLayoutBindings[] = {
+            { .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+            { .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 },
+            { .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, .pImmutableSamplers = 0 }
+        };
+        // NOTE(blackedout): With descriptor indexing, unused table entries can stay empty and textures can be added while the table is bound,
+        // so it is as large as the device's update after bind limits allow. These also count the other resources of the fragment stage
+        // (the uniform buffer, the clustered lights buffers and the color attachment).
+        // Without it, every entry has to be written before the table is used, so the table only holds the loaded textures.
+        // Without dynamic indexing, default.frag only reads the first entry and every texture gets a table of its own.
+        Shaders.TextureTableCount = 1;
+        if(Device->HasDescriptorIndexing) {
+            VkPhysicalDeviceDescriptorIndexingProperties *Limits = &Device->DescriptorIndexingProperties;
+            uint32_t OtherResourceCount = ArrayCount(DefaultUniformDescriptorSetLayoutBinding) + ArrayCount(ClusteredLightsDescriptorSetLayoutBindings) + 1;
+            AssertMessageGoto(Limits->maxPerStageUpdateAfterBindResources > OtherResourceCount, label_LightBinCS, "Device can't bind a texture table.\n");
+            Shaders.TextureTableSize = Min(TEXTURE_TABLE_CAPACITY, Limits->maxPerStageDescriptorUpdateAfterBindSampledImages);
+            Shaders.TextureTableSize = Min(Shaders.TextureTableSize, Limits->maxDescriptorSetUpdateAfterBindSampledImages);
+            Shaders.TextureTableSize = Min(Shaders.TextureTableSize, Limits->maxPerStageUpdateAfterBindResources - OtherResourceCount);
+        } else if(Device->Features.shaderSampledImageArrayDynamicIndexing) {
+            Shaders.TextureTableSize = STATIC_IMAGE_COUNT;
+        } else {
+            printfc(CODE_YELLOW, "Sampled image arrays can't be indexed dynamically, every texture is bound on its own.\n");
+            Shaders.TextureTableCount = STATIC_IMAGE_COUNT;
+            Shaders.TextureTableSize = 1;
+        }
+        if(Device->HasDescriptorIndexing == 0) {
+            AssertMessageGoto(Shaders.TextureTableSize <= Device->Properties.limits.maxPerStageDescriptorSampledImages && Shaders.TextureTableSize <= Device->Properties.limits.maxDescriptorSetSampledImages,
+                              label_LightBinCS, "Device can't bind a texture table of %u images.\n", Shaders.TextureTableSize);
+        }
+        DefaultDescriptorSetLayoutBindings[1].descriptorCount = Shaders.TextureTableSize;
+        VkDescriptorBindingFlags DefaultDescriptorBindingFlags[] = {
+            0,
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
         };
         // TODO(blackedout): Why does MSVC have to be so annoying ._. I just want to use array index initializers like in C
         vulkan_descriptor_set_layout_description DescriptorSetDescriptionUniform = { .Flags = 0, .Bindings = DefaultUniformDescriptorSetLayoutBinding, .BindingsCount = ArrayCount(DefaultUniformDescriptorSetLayoutBinding) };
         vulkan_descriptor_set_layout_description DescriptorSetDescriptionSamplerImage = { .Flags = 0, .Bindings = DefaultDescriptorSetLayoutBindings, .BindingsCount = ArrayCount(DefaultDescriptorSetLayoutBindings) };
+        vulkan_descriptor_set_layout_description DescriptorSetDescriptionClusteredLights = { .Flags = 0, .Bindings = ClusteredLightsDescriptorSetLayoutBindings, .BindingsCount = ArrayCount(ClusteredLightsDescriptorSetLayoutBindings) };
+        if(Device->HasDescriptorIndexing) {
+            DescriptorSetDescriptionSamplerImage.Flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+            DescriptorSetDescriptionSamplerImage.BindingFlags = DefaultDescriptorBindingFlags;
+        }
         vulkan_descriptor_set_layout_description DescriptorSetDescriptions[DESCRIPTOR_SET_LAYOUT_COUNT];
         SetZero(DescriptorSetDescriptions);
         DescriptorSetDescriptions[DESCRIPTOR_SET_LAYOUT_DEFAULT_UNIFORM] = DescriptorSetDescriptionUniform;
         DescriptorSetDescriptions[DESCRIPTOR_SET_LAYOUT_DEFAULT_SAMPLER_IMAGE] = DescriptorSetDescriptionSamplerImage;            
-        CheckGoto(VulkanCreateDescriptorSetLayouts(Device, DescriptorSetDescriptions, ArrayCount(DescriptorSetDescriptions), Shaders.DescriptorSetLayouts), label_FS);
+        DescriptorSetDescriptions[DESCRIPTOR_SET_LAYOUT_CLUSTERED_LIGHTS] = DescriptorSetDescriptionClusteredLights;
+        CheckGoto(VulkanCreateDescriptorSetLayouts(Device, DescriptorSetDescriptions, ArrayCount(DescriptorSetDescriptions), Shaders.DescriptorSetLayouts), label_LightBinCS);
         
-        // NOTE(blackedout): Create all uniform buffers mapped with unique descriptor set pool and correctly initialized sets
+        // NOTE(blackedout): Create all uniform buffers mapped with correctly initialized sets from the descriptor allocator
         vulkan_shader_uniform_buffers_description UniformBufferDescriptions[] = {
-            { Shaders.UniformMatsBuffers, (void **)Shaders.UniformMats, Shaders.UniformMatsSets, 0, sizeof(default_uniform_buffer1) }
+            { Shaders.UniformMatsBuffers, Shaders.UniformMatsAllocations, (void **)Shaders.UniformMats, Shaders.UniformMatsSets, 0, sizeof(default_uniform_buffer1) }
         };
         CheckGoto(VulkanCreateShaderUniformBuffers(Device, Shaders.DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_UNIFORM], UniformBufferDescriptions,
-                                                    ArrayCount(UniformBufferDescriptions), &Shaders.UniformBufferMemory, &Shaders.UniformDescriptorPool), label_DescriptorSetLayouts);
+                                                    ArrayCount(UniformBufferDescriptions), DescriptorAllocator), label_DescriptorSetLayouts);
         //StaticAssert(ArrayCount(Shaders.UniformBufferDescriptions) == ArrayCount(UniformBufferDescriptions));
         //memcpy(Shaders.UniformBufferDescriptions, UniformBufferDescriptions, sizeof(UniformBufferDescriptions));
 
@@ -84,7 +265,7 @@ static int LoadShaders(vulkan_surface_device *Device, vulkan_image *Images, shad
             .pNext = 0,
             .flags = 0,
             .magFilter = VK_FILTER_NEAREST,
-            .minFilter = VK_FILTER_NEAREST,
+            .minFilter = VK_FILTER_LINEAR, // NOTE(blackedout): Trilinear when minified, so distant texels are averaged instead of aliased
             .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
             .addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
             .addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
@@ -95,79 +276,62 @@ static int LoadShaders(vulkan_surface_device *Device, vulkan_image *Images, shad
             .compareEnable = VK_FALSE,
             .compareOp = VK_COMPARE_OP_ALWAYS,
             .minLod = 0.0f,
-            .maxLod = 0.0f,
+            .maxLod = VK_LOD_CLAMP_NONE, // NOTE(blackedout): Static images have full mip chains (see VulkanGetMipLevelCount)
             .borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK,
             .unnormalizedCoordinates = VK_FALSE
         };
         VulkanCheckGoto(vkCreateSampler(DeviceHandle, &DefaultSamplerCreateInfo, 0, &Shaders.DefaultSampler), label_UniformBuffers);
 
         VkDescriptorPoolSize DescriptorPoolSizes[] = {
-            { .type = VK_DESCRIPTOR_TYPE_SAMPLER, .descriptorCount = 2 },
-            { .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = 2 }
+            { .type = VK_DESCRIPTOR_TYPE_SAMPLER, .descriptorCount = Shaders.TextureTableCount },
+            { .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = Shaders.TextureTableCount*Shaders.TextureTableSize }
         };
         VkDescriptorPoolCreateInfo DescriptorPoolCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
             .pNext = 0,
-            .flags = 0,
-            .maxSets = 2,
+            .flags = Device->HasDescriptorIndexing? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0,
+            .maxSets = Shaders.TextureTableCount,
             .poolSizeCount = ArrayCount(DescriptorPoolSizes),
             .pPoolSizes = DescriptorPoolSizes
         };
         VulkanCheckGoto(vkCreateDescriptorPool(DeviceHandle, &DescriptorPoolCreateInfo, 0, &Shaders.DefaultDescriptorPool), label_Sampler);
-        
-        VkDescriptorSetLayout DescriptorSetLayouts[] = {
-            Shaders.DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_SAMPLER_IMAGE],
-            Shaders.DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_SAMPLER_IMAGE],
-        };
+
+        VkDescriptorSetLayout TextureTableSetLayouts[ArrayCount(Shaders.TextureTableSets)];
+        for(uint32_t I = 0; I < Shaders.TextureTableCount; ++I) {
+            TextureTableSetLayouts[I] = Shaders.DescriptorSetLayouts[DESCRIPTOR_SET_LAYOUT_DEFAULT_SAMPLER_IMAGE];
+        }
         VkDescriptorSetAllocateInfo DescriptorSetAllocateInfo = {
             .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
             .pNext = 0,
             .descriptorPool = Shaders.DefaultDescriptorPool,
-            .descriptorSetCount = ArrayCount(DescriptorSetLayouts),
-            .pSetLayouts = DescriptorSetLayouts
+            .descriptorSetCount = Shaders.TextureTableCount,
+            .pSetLayouts = TextureTableSetLayouts
         };
-        VkDescriptorSet DefaultSets[2];
-        VulkanCheckGoto(vkAllocateDescriptorSets(DeviceHandle, &DescriptorSetAllocateInfo, DefaultSets), label_DefaultDescriptorPool);
-        Shaders.DefaultImageColorSet = DefaultSets[0];
-        Shaders.DefaultImageTileSet = DefaultSets[1];
-
-        VkImageView ImageViews[2] = { Images[0].ViewHandle, Images[1].ViewHandle };
-        for(uint32_t I = 0; I < 2; ++I) {
-            VkDescriptorImageInfo ImageInfo = {
-                .sampler = VULKAN_NULL_HANDLE,
-                .imageView = ImageViews[I],
-                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-            };
-            VkDescriptorImageInfo SamplerInfo = {
-                .sampler = Shaders.DefaultSampler,
-            };
-            VkWriteDescriptorSet WriteDescriptorSets[] = {
-                {
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .pNext = 0,
-                    .dstSet = DefaultSets[I],
-                    .dstBinding = 1,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
-                    .pImageInfo = &SamplerInfo,
-                    .pBufferInfo = 0,
-                    .pTexelBufferView = 0
-                },
-                {
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .pNext = 0,
-                    .dstSet = DefaultSets[I],
-                    .dstBinding = 2,
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
-                    .pImageInfo = &ImageInfo,
-                    .pBufferInfo = 0,
-                    .pTexelBufferView = 0
-                }
+        VulkanCheckGoto(vkAllocateDescriptorSets(DeviceHandle, &DescriptorSetAllocateInfo, Shaders.TextureTableSets), label_DefaultDescriptorPool);
+
+        VkDescriptorImageInfo SamplerInfo = {
+            .sampler = Shaders.DefaultSampler,
+        };
+        for(uint32_t I = 0; I < Shaders.TextureTableCount; ++I) {
+            VkWriteDescriptorSet WriteDescriptorSet = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .pNext = 0,
+                .dstSet = Shaders.TextureTableSets[I],
+                .dstBinding = 1,
+                .dstArrayElement = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER,
+                .pImageInfo = &SamplerInfo,
+                .pBufferInfo = 0,
+                .pTexelBufferView = 0
             };
-            vkUpdateDescriptorSets(DeviceHandle, ArrayCount(WriteDescriptorSets), WriteDescriptorSets, 0, 0);
+            vkUpdateDescriptorSets(DeviceHandle, 1, &WriteDescriptorSet, 0, 0);
+        }
+
+        // NOTE(blackedout): Without descriptor indexing, this writes every entry of every table
+        for(uint32_t I = 0; I < STATIC_IMAGE_COUNT; ++I) {
+            uint32_t TextureIndex;
+            CheckGoto(AddTableTexture(Device, &Shaders, Images[I].ViewHandle, &TextureIndex), label_DefaultDescriptorPool);
         }
 
         *OutShaders = Shaders;
@@ -181,171 +345,280 @@ label_DefaultDescriptorPool:
 label_Sampler:
     vkDestroySampler(DeviceHandle, Shaders.DefaultSampler, 0);
 label_UniformBuffers:
-    vkDestroyDescriptorPool(DeviceHandle, Shaders.UniformDescriptorPool, 0);
-    vkFreeMemory(DeviceHandle, Shaders.UniformBufferMemory, 0);
     for(uint32_t I = 0; I < ArrayCount(Shaders.UniformMatsBuffers); ++I) {
         vkDestroyBuffer(DeviceHandle, Shaders.UniformMatsBuffers[I], 0);
+        VulkanFreeAllocation(Device, Shaders.UniformMatsAllocations + I);
     }
 label_DescriptorSetLayouts:
     VulkanDestroyDescriptorSetLayouts(Device, Shaders.DescriptorSetLayouts, ArrayCount(Shaders.DescriptorSetLayouts));
+label_LightBinCS:
+    vkDestroyShaderModule(DeviceHandle, Shaders.LightBinComp, 0);
+label_DepthPyramidSingleSampledCS:
+    vkDestroyShaderModule(DeviceHandle, Shaders.DepthPyramidSingleSampledComp, 0);
+label_DepthPyramidCS:
+    vkDestroyShaderModule(DeviceHandle, Shaders.DepthPyramidComp, 0);
+label_CullCS:
+    vkDestroyShaderModule(DeviceHandle, Shaders.CullComp, 0);
+label_QuantizedVS:
+    vkDestroyShaderModule(DeviceHandle, Shaders.QuantizedVert, 0);
 label_FS:
     vkDestroyShaderModule(DeviceHandle, Shaders.Default.Frag, 0);
 label_VS:
     vkDestroyShaderModule(DeviceHandle, Shaders.Default.Vert, 0);
 label_Exit:
-    free(BytesVS);
-    free(BytesFS);
+    for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+        free(FileBytes[I]);
+    }
     return Result;
 }
 
-// MARK: Graphics Pipeline
-static void VulkanDestroyDefaultGraphicsPipeline(vulkan_surface_device *Device, VkPipelineLayout PipelineLayout, VkRenderPass RenderPass, VkPipeline Pipeline) {
-    VkDevice DeviceHandle = Device->Handle;
-    vkDestroyPipeline(DeviceHandle, Pipeline, 0);
-    vkDestroyRenderPass(DeviceHandle, RenderPass, 0);
-    vkDestroyPipelineLayout(DeviceHandle, PipelineLayout, 0);
+// MARK: Shader Reloading
+// NOTE(blackedout): Watches the shader sources and recompiles changed files with glslc on a background thread, which also creates the new modules.
+// At the frame boundary (PollShaderReloader) the new modules replace the old ones and every cached pipeline that used them is recompiled
+// by the pipeline compiler, which swaps the pipelines in once they are ready and retires the old ones. Old modules are destroyed as soon as
+// no pending compilation uses them anymore.
+#ifndef SHADER_COMPILER_PATH
+#define SHADER_COMPILER_PATH "glslc"
+#endif
+#define SHADER_RELOADER_DIRECTORY "shaders"
+#define SHADER_RELOADER_SETTLE_MILLISECONDS 100
+#define SHADER_RELOADER_MAX_RETIRED_COUNT 16
+
+typedef struct {
+    vulkan_surface_device *Device;
+    int IsRunning;
+
+    platform_directory_watch Watch;
+    platform_thread Thread;
+    platform_mutex Mutex;
+    int ShouldQuit;
+
+    // NOTE(blackedout): Only accessed by the reloader thread.
+    int IsChanged[SHADER_FILE_COUNT];
+
+    // NOTE(blackedout): Guarded by the mutex, modules that are ready to be swapped in.
+    VkShaderModule PendingModules[SHADER_FILE_COUNT];
+
+    // NOTE(blackedout): Only accessed by the polling thread.
+    uint32_t RetiredCount;
+    VkShaderModule RetiredModules[SHADER_RELOADER_MAX_RETIRED_COUNT];
+} shader_reloader;
+
+static void ShaderReloaderFileChanged(void *Data, const char *FileName) {
+    shader_reloader *Reloader = (shader_reloader *)Data;
+    for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+        if(strcmp(FileName, SHADER_FILES[I].SourceName) == 0) {
+            Reloader->IsChanged[I] = 1;
+        }
+    }
 }
 
-static int VulkanCreateDefaultGraphicsPipeline(vulkan_surface_device *Device, VkShaderModule ModuleVS, VkShaderModule ModuleFS, VkExtent2D InitialExtent, VkFormat SwapchainFormat, VkSampleCountFlagBits SampleCount, VkPipelineVertexInputStateCreateInfo PipelineVertexInputStateCreateInfo, VkDescriptorSetLayout *DescriptorSetLayouts, uint32_t DescriptorSetLayoutCount, VkPushConstantRange PushConstantRange, VkPipelineLayout *OutPipelineLayout, VkRenderPass *OutRenderPass, VkPipeline *OutPipeline) {
-    VkDevice DeviceHandle = Device->Handle;
-
-    VkPipelineLayout PipelineLayout = 0;
-    VkRenderPass RenderPass = 0;
-    VkPipeline Pipeline = 0;
+static int ReloadShaderFile(shader_reloader *Reloader, uint32_t FileIndex) {
+    int Result = 1;
+    shader_file File = SHADER_FILES[FileIndex];
+    uint8_t *Bytes = 0;
+    uint64_t ByteCount;
+    VkShaderModule Module = VULKAN_NULL_HANDLE;
     {
-        VkPipelineShaderStageCreateInfo PipelineStageCreateInfos[] = {
-            {
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .pNext = 0,
-                .flags = 0,
-                .stage = VK_SHADER_STAGE_VERTEX_BIT,
-                .module = ModuleVS,
-                .pName = "main", // NOTE(blackedout): Entry point
-                .pSpecializationInfo = 0
-            },
-            {
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .pNext = 0,
-                .flags = 0,
-                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-                .module = ModuleFS,
-                .pName = "main",
-                .pSpecializationInfo = 0
+        // NOTE(blackedout): Same invocation as in build.sh. glslc prints its own errors, the current module is simply kept in that case.
+        // Only the loose SPIR-V file is updated, build.sh bakes it into the asset pack for the next start.
+        char Command[1024];
+        snprintf(Command, sizeof(Command), "\"%s\" %s %s/%s -o %s", SHADER_COMPILER_PATH, File.Defines, SHADER_RELOADER_DIRECTORY, File.SourceName, File.BinaryPath);
+        printf("Recompiling %s/%s.\n", SHADER_RELOADER_DIRECTORY, File.SourceName);
+        int ExitCode = system(Command);
+        AssertMessageGoto(ExitCode == 0, label_Exit, "Shader %s/%s could not be compiled, keeping the current version.\n", SHADER_RELOADER_DIRECTORY, File.SourceName);
+
+        CheckGoto(LoadFileContentsCStd(File.BinaryPath, &Bytes, &ByteCount), label_Exit);
+        CheckGoto(VulkanCreateShaderModule(Reloader->Device, Bytes, ByteCount, &Module), label_Exit);
+
+        // NOTE(blackedout): A pending module that wasn't swapped in yet was never used by anything, so it can be replaced right away.
+        PlatformMutexLock(&Reloader->Mutex);
+        VkShaderModule ReplacedModule = Reloader->PendingModules[FileIndex];
+        Reloader->PendingModules[FileIndex] = Module;
+        PlatformMutexUnlock(&Reloader->Mutex);
+        vkDestroyShaderModule(Reloader->Device->Handle, ReplacedModule, 0);
+    }
+    Result = 0;
+
+label_Exit:
+    free(Bytes);
+    return Result;
+}
+
+static void ShaderReloaderThread(void *Data) {
+    shader_reloader *Reloader = (shader_reloader *)Data;
+    for(;;) {
+        PlatformMutexLock(&Reloader->Mutex);
+        int ShouldQuit = Reloader->ShouldQuit;
+        PlatformMutexUnlock(&Reloader->Mutex);
+        if(ShouldQuit) {
+            break;
+        }
+
+        uint32_t ChangeCount = 0;
+        if(PlatformWaitDirectoryChanges(&Reloader->Watch, SHADER_RELOADER_SETTLE_MILLISECONDS, ShaderReloaderFileChanged, Reloader, &ChangeCount)) {
+            break;
+        }
+        if(ChangeCount) {
+            // NOTE(blackedout): Editors often save in multiple steps, so only recompile once the directory has been quiet for a moment.
+            continue;
+        }
+
+        for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+            if(Reloader->IsChanged[I]) {
+                Reloader->IsChanged[I] = 0;
+                ReloadShaderFile(Reloader, I);
             }
-        };
+        }
+    }
+}
 
-        VkDynamicState VulkanDynamicStates[] = {
-            VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_SCISSOR,
-        };
+static void PollShaderReloader(shader_reloader *Reloader, vulkan_pipeline_compiler *Compiler, vulkan_pipeline_state_cache *PipelineStates, shaders *Shaders) {
+    // NOTE(blackedout): Must be called at the frame boundary before VulkanPollPipelineCompiler.
+    if(Reloader->IsRunning == 0) {
+        return;
+    }
 
-        VkPipelineDynamicStateCreateInfo PipelineDynamicStateCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .dynamicStateCount = ArrayCount(VulkanDynamicStates),
-            .pDynamicStates = VulkanDynamicStates
-        };
+    for(uint32_t I = 0; I < Reloader->RetiredCount;) {
+        VkShaderModule Module = Reloader->RetiredModules[I];
+        if(VulkanTryReleaseShaderModule(Compiler, Module)) {
+            vkDestroyShaderModule(Reloader->Device->Handle, Module, 0);
+            Reloader->RetiredModules[I] = Reloader->RetiredModules[--Reloader->RetiredCount];
+        } else {
+            ++I;
+        }
+    }
 
-        VkPipelineInputAssemblyStateCreateInfo PipelineInputAssemblyStateCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            .primitiveRestartEnable = VK_FALSE,
-        };
+    // NOTE(blackedout): Every swapped module retires its old one, so only as many are taken as there are free retired slots
+    VkShaderModule NewModules[SHADER_FILE_COUNT];
+    uint32_t ReservedCount = 0;
+    PlatformMutexLock(&Reloader->Mutex);
+    for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+        NewModules[I] = VULKAN_NULL_HANDLE;
+        // NOTE(blackedout): If there is no room to retire the old module, the new one just stays pending until there is.
+        if(Reloader->PendingModules[I] && Reloader->RetiredCount + ReservedCount < ArrayCount(Reloader->RetiredModules)) {
+            NewModules[I] = Reloader->PendingModules[I];
+            Reloader->PendingModules[I] = VULKAN_NULL_HANDLE;
+            ++ReservedCount;
+        }
+    }
+    PlatformMutexUnlock(&Reloader->Mutex);
 
-        VkViewport Viewport = {
-            .x = 0.0f,
-            .y = 0.0f,
-            .width = (float)InitialExtent.width,
-            .height = (float)InitialExtent.height,
-            .minDepth = 0.0f,
-            .maxDepth = 1.0f
-        };
+    for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+        if(NewModules[I] == VULKAN_NULL_HANDLE) {
+            continue;
+        }
+        VkShaderModule *Target = ShaderFileModule(Shaders, I);
+        VkShaderModule OldModule = *Target;
+        *Target = NewModules[I];
+        Reloader->RetiredModules[Reloader->RetiredCount++] = OldModule;
+        VulkanReplacePipelineStateShaderModule(PipelineStates, OldModule, NewModules[I]);
+        printf("Swapped in %s/%s.\n", SHADER_RELOADER_DIRECTORY, SHADER_FILES[I].SourceName);
+    }
+}
 
-        VkRect2D Scissors = {
-            .offset = { 0, 0 },
-            .extent = InitialExtent,
-        };
+static void DestroyShaderReloader(shader_reloader *Reloader) {
+    // NOTE(blackedout): The pipeline compiler must be destroyed before this, because it may still use retired modules.
+    if(Reloader->IsRunning) {
+        PlatformMutexLock(&Reloader->Mutex);
+        Reloader->ShouldQuit = 1;
+        PlatformMutexUnlock(&Reloader->Mutex);
+        PlatformJoinThread(Reloader->Thread);
+        PlatformMutexDestroy(&Reloader->Mutex);
+
+        VkDevice DeviceHandle = Reloader->Device->Handle;
+        for(uint32_t I = 0; I < SHADER_FILE_COUNT; ++I) {
+            vkDestroyShaderModule(DeviceHandle, Reloader->PendingModules[I], 0);
+        }
+        for(uint32_t I = 0; I < Reloader->RetiredCount; ++I) {
+            vkDestroyShaderModule(DeviceHandle, Reloader->RetiredModules[I], 0);
+        }
+    }
+    PlatformDestroyDirectoryWatch(&Reloader->Watch);
+    memset(Reloader, 0, sizeof(*Reloader));
+}
 
-        VkPipelineViewportStateCreateInfo PipelineViewportStateCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .viewportCount = 1,
-            .pViewports = &Viewport,
-            .scissorCount = 1,
-            .pScissors = &Scissors,
-        };
+static int CreateShaderReloader(vulkan_surface_device *Device, shader_reloader *Reloader) {
+    // NOTE(blackedout): Initialized in place, because the reloader thread keeps a pointer to it.
+    memset(Reloader, 0, sizeof(*Reloader));
+    Reloader->Device = Device;
+    {
+        CheckGoto(PlatformCreateDirectoryWatch(SHADER_RELOADER_DIRECTORY, &Reloader->Watch), label_Error);
+        PlatformMutexInit(&Reloader->Mutex);
+        CheckGoto(PlatformCreateThread(ShaderReloaderThread, Reloader, &Reloader->Thread), label_Mutex);
+        Reloader->IsRunning = 1;
+    }
 
-        VkPipelineRasterizationStateCreateInfo PipelineRasterizationStateCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .depthClampEnable = VK_FALSE,
-            .rasterizerDiscardEnable = VK_FALSE,
-            .polygonMode = VK_POLYGON_MODE_FILL,
-            .cullMode = VK_CULL_MODE_BACK_BIT,
-            .frontFace = VK_FRONT_FACE_CLOCKWISE,
-            .depthBiasEnable = VK_FALSE,
-            .depthBiasConstantFactor = 0.0f,
-            .depthBiasClamp = 0.0f,
-            .depthBiasSlopeFactor = 0.0f,
-            .lineWidth = 1.0f,
-        };
+#ifdef VULKAN_INFO_PRINT
+    printf("Watching %s for shader changes.\n", SHADER_RELOADER_DIRECTORY);
+#endif
 
-        VkPipelineMultisampleStateCreateInfo PipelineMultiSampleStateCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .rasterizationSamples = SampleCount,
-            .sampleShadingEnable = VK_FALSE, // TODO(blackedout): Enable this?
-            .minSampleShading = 1.0f,
-            .pSampleMask = 0,
-            .alphaToCoverageEnable = VK_FALSE,
-            .alphaToOneEnable = VK_FALSE
-        };
-        
-        VkStencilOpState EmptyStencilOpState;
-        memset(&EmptyStencilOpState, 0, sizeof(EmptyStencilOpState));
-        VkPipelineDepthStencilStateCreateInfo PipelineDepthStencilStateCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .depthTestEnable = VK_TRUE,
-            .depthWriteEnable = VK_TRUE,
-            .depthCompareOp = VK_COMPARE_OP_LESS,
-            .depthBoundsTestEnable = VK_FALSE,
-            .stencilTestEnable = VK_FALSE,
-            .front = EmptyStencilOpState,
-            .back = EmptyStencilOpState,
-            .minDepthBounds = 0.0f,
-            .maxDepthBounds = 1.0f,
-        };
+    return 0;
 
-        VkPipelineColorBlendAttachmentState PipelineColorBlendAttachmentState = {
-            .blendEnable = VK_FALSE,
-            .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .colorBlendOp = VK_BLEND_OP_ADD,
-            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .alphaBlendOp = VK_BLEND_OP_ADD,
-            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-        };
+label_Mutex:
+    PlatformMutexDestroy(&Reloader->Mutex);
+    PlatformDestroyDirectoryWatch(&Reloader->Watch);
+label_Error:
+    return 1;
+}
 
-        VkPipelineColorBlendStateCreateInfo PipelineColorBlendStateCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-            .pNext = 0,
+// MARK: Graphics Pipeline
+static void VulkanDestroyDefaultGraphicsPipeline(vulkan_surface_device *Device, VkPipelineLayout PipelineLayout, VkRenderPass RenderPass, VkPipeline Pipeline) {
+    VkDevice DeviceHandle = Device->Handle;
+    vkDestroyPipeline(DeviceHandle, Pipeline, 0);
+    vkDestroyRenderPass(DeviceHandle, RenderPass, 0);
+    vkDestroyPipelineLayout(DeviceHandle, PipelineLayout, 0);
+}
+
+static int VulkanCreateDefaultRenderPass(vulkan_surface_device *Device, VkFormat SwapchainFormat, VkSampleCountFlagBits SampleCount, VkRenderPass *OutRenderPass) {
+    // NOTE(blackedout): Pipelines and framebuffers are created with this render pass. The frame graph creates the render passes that are
+    // actually begun from the attachments the passes declare, they are compatible with this one because they have the same attachments.
+    VkAttachmentDescription AttachmentDescriptions[] = {
+        {
             .flags = 0,
-            .logicOpEnable = VK_FALSE,
-            .logicOp = VK_LOGIC_OP_CLEAR,
-            .attachmentCount = 1,
-            .pAttachments = &PipelineColorBlendAttachmentState,
-            .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
-        };
+            .format = SwapchainFormat,
+            .samples = SampleCount,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        },
+        {
+            .flags = 0,
+            .format = Device->BestDepthFormat,
+            .samples = SampleCount,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+            .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+        },
+        {
+            .flags = 0,
+            .format = SwapchainFormat,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        },
+    };
+    vulkan_frame_graph_attachment Attachments[] = { VULKAN_FRAME_GRAPH_ATTACHMENT_COLOR, VULKAN_FRAME_GRAPH_ATTACHMENT_DEPTH, VULKAN_FRAME_GRAPH_ATTACHMENT_RESOLVE };
+    return VulkanCreateAttachmentRenderPass(Device, AttachmentDescriptions, Attachments, ArrayCount(Attachments), OutRenderPass);
+}
+
+static int VulkanCreateDefaultRenderPassAndLayout(vulkan_surface_device *Device, VkFormat SwapchainFormat, VkSampleCountFlagBits SampleCount, VkDescriptorSetLayout *DescriptorSetLayouts, uint32_t DescriptorSetLayoutCount, VkPushConstantRange PushConstantRange, VkPipelineLayout *OutPipelineLayout, VkRenderPass *OutRenderPass) {
+    // NOTE(blackedout): The pipelines themselves are created by the pipeline compiler, using the layout and render pass created here.
+    VkDevice DeviceHandle = Device->Handle;
 
+    VkPipelineLayout PipelineLayout = 0;
+    VkRenderPass RenderPass = 0;
+    {
         VkPipelineLayoutCreateInfo PipelineLayoutCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
             .pNext = 0,
@@ -356,128 +629,14 @@ static int VulkanCreateDefaultGraphicsPipeline(vulkan_surface_device *Device, Vk
             .pPushConstantRanges = &PushConstantRange,
         };
         VulkanCheckGoto(vkCreatePipelineLayout(DeviceHandle, &PipelineLayoutCreateInfo, 0, &PipelineLayout), label_Error);
-
-        VkAttachmentDescription AttachmentDescriptions[] = {
-            {
-                .flags = 0,
-                .format = SwapchainFormat,
-                .samples = SampleCount,
-                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL //,
-            },
-            {
-                .flags = 0,
-                .format = Device->BestDepthFormat,
-                .samples = SampleCount,
-                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-                .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-            },
-            {
-                .flags = 0,
-                .format = SwapchainFormat,
-                .samples = VK_SAMPLE_COUNT_1_BIT,
-                .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-            },
-        };
-
-        VkAttachmentReference AttachmentRefs[] = {
-            {
-                .attachment = 0, // NOTE(blackedout): Fragment shader layout index
-                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            },
-            {
-                .attachment = 1,
-                .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-            },
-            {
-                .attachment = 2,
-                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-            }
-        };
-
-        VkSubpassDescription SubpassDescription = {
-            .flags = 0,
-            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-            .inputAttachmentCount = 0,
-            .pInputAttachments = 0,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = AttachmentRefs + 0,
-            .pResolveAttachments = AttachmentRefs + 2,
-            .pDepthStencilAttachment = AttachmentRefs + 1, // NOTE(blackedout): No count because max one possible
-            .preserveAttachmentCount = 0,
-            .pPreserveAttachments = 0,
-        };
-
-        VkSubpassDependency RenderSubpassDependency = {
-            .srcSubpass = VK_SUBPASS_EXTERNAL,
-            .dstSubpass = 0, // NOTE(blackedout): First subpass index
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
-            .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-            .dependencyFlags = 0,
-        };
-
-        VkRenderPassCreateInfo RenderPassCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .attachmentCount = ArrayCount(AttachmentDescriptions),
-            .pAttachments = AttachmentDescriptions,
-            .subpassCount = 1,
-            .pSubpasses = &SubpassDescription,
-            .dependencyCount = 1,
-            .pDependencies = &RenderSubpassDependency,
-        };
-        
-        VulkanCheckGoto(vkCreateRenderPass(DeviceHandle, &RenderPassCreateInfo, 0, &RenderPass), label_PipelineLayout);
-
-        VkGraphicsPipelineCreateInfo GraphicsPipelineCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .stageCount = ArrayCount(PipelineStageCreateInfos),
-            .pStages = PipelineStageCreateInfos,
-            .pVertexInputState = &PipelineVertexInputStateCreateInfo,
-            .pInputAssemblyState = &PipelineInputAssemblyStateCreateInfo,
-            .pTessellationState = 0,
-            .pViewportState = &PipelineViewportStateCreateInfo,
-            .pRasterizationState = &PipelineRasterizationStateCreateInfo,
-            .pMultisampleState = &PipelineMultiSampleStateCreateInfo,
-            .pDepthStencilState = &PipelineDepthStencilStateCreateInfo,
-            .pColorBlendState = &PipelineColorBlendStateCreateInfo,
-            .pDynamicState = &PipelineDynamicStateCreateInfo,
-            .layout = PipelineLayout,
-            .renderPass = RenderPass,
-            .subpass = 0,
-            .basePipelineHandle = VULKAN_NULL_HANDLE,
-            .basePipelineIndex = -1
-        };
-
-        VulkanCheckGoto(vkCreateGraphicsPipelines(DeviceHandle, VULKAN_NULL_HANDLE, 1, &GraphicsPipelineCreateInfo, 0, &Pipeline), label_RenderPass);
+        CheckGoto(VulkanCreateDefaultRenderPass(Device, SwapchainFormat, SampleCount, &RenderPass), label_PipelineLayout);
 
         *OutPipelineLayout = PipelineLayout;
         *OutRenderPass = RenderPass;
-        *OutPipeline = Pipeline;
     }
 
     return 0;
 
-label_RenderPass:
-    vkDestroyRenderPass(DeviceHandle, RenderPass, 0);
 label_PipelineLayout:
     vkDestroyPipelineLayout(DeviceHandle, PipelineLayout, 0);
 label_Error:
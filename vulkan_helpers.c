@@ -58,15 +58,142 @@ static vma_extension_mapping VmaExtensionMap[] = {
 };
 #endif
 
+// NOTE(blackedout): Device memory is sub-allocated from large blocks (or by vma if available), so that the number of vkAllocateMemory
+// calls stays far below maxMemoryAllocationCount. See the Memory section.
+#define VULKAN_MEMORY_BLOCK_BYTE_COUNT (64ull << 20) // NOTE(blackedout): At most an eighth of the heap
+#define VULKAN_MEMORY_MAX_BLOCK_COUNT 256
+#define VULKAN_MEMORY_GRANULE 256 // NOTE(blackedout): Offsets and sizes of sub-allocations are multiples of this (power of two)
+#define VULKAN_MEMORY_NULL_NODE UINT32_MAX
+#define VULKAN_TLSF_FIRST_LEVEL_COUNT 64
+#define VULKAN_TLSF_SECOND_LEVEL_LOG2 4
+#define VULKAN_TLSF_SECOND_LEVEL_COUNT (1 << VULKAN_TLSF_SECOND_LEVEL_LOG2)
+#define VULKAN_MEMORY_PRESSURE_PERCENT 90 // NOTE(blackedout): A heap is under pressure above this part of its budget
+#define VULKAN_MEMORY_RELIEF_PERCENT 80 // NOTE(blackedout): and stays under pressure until it falls below this part
+#define VULKAN_MEMORY_SMALL_BAR_BYTE_COUNT (256ull << 20) // NOTE(blackedout): Host visible device local heaps up to this size are the fixed BAR window
+
+typedef enum {
+    VULKAN_RESOURCE_KIND_LINEAR, // NOTE(blackedout): Buffers and linear images
+    VULKAN_RESOURCE_KIND_OPTIMAL, // NOTE(blackedout): Optimal tiling images
+    VULKAN_RESOURCE_KIND_COUNT
+} vulkan_resource_kind;
+
+// NOTE(blackedout): What an allocation is used for, only for statistics
+typedef enum {
+    VULKAN_MEMORY_SUBSYSTEM_OTHER,
+    VULKAN_MEMORY_SUBSYSTEM_STATIC_MESHES,
+    VULKAN_MEMORY_SUBSYSTEM_TEXTURES,
+    VULKAN_MEMORY_SUBSYSTEM_UNIFORMS,
+    VULKAN_MEMORY_SUBSYSTEM_SWAPCHAIN_ATTACHMENTS,
+    VULKAN_MEMORY_SUBSYSTEM_STAGING,
+    VULKAN_MEMORY_SUBSYSTEM_FRAME_GRAPH,
+    VULKAN_MEMORY_SUBSYSTEM_COUNT
+} vulkan_memory_subsystem;
+
+static const char *VULKAN_MEMORY_SUBSYSTEM_NAMES[] = {
+    "other", "static_meshes", "textures", "uniforms", "swapchain_attachments", "staging", "frame_graph"
+};
+
+typedef struct {
+    VkDeviceMemory Memory;
+    VkDeviceSize Offset;
+    VkDeviceSize Size;
+    uint8_t *Mapped; // NOTE(blackedout): Only set for host visible memory, which stays mapped
+    uint32_t MemoryTypeIndex;
+    vulkan_memory_subsystem Subsystem;
+#ifdef VULKAN_USE_VMA
+    VmaAllocation VmaHandle;
+#else
+    uint32_t NodeIndex;
+#endif
+} vulkan_allocation;
+
+#ifndef VULKAN_USE_VMA
+// NOTE(blackedout): A used or free range of a block. Neighbouring ranges of the same block are linked, so that freed ranges can be merged.
+typedef struct {
+    VkDeviceSize Offset;
+    VkDeviceSize Size; // NOTE(blackedout): 0 if the node is unused
+    uint32_t BlockIndex;
+    uint32_t PrevPhysical, NextPhysical;
+    uint32_t PrevFree, NextFree; // NOTE(blackedout): Links in the free list of the range size, NextFree also links unused nodes
+    uint32_t IsFree;
+} vulkan_memory_node;
+
+typedef struct {
+    VkDeviceMemory Memory; // NOTE(blackedout): 0 if the block slot is unused
+    VkDeviceSize Size;
+    uint8_t *Mapped;
+    uint32_t PoolIndex;
+    uint32_t IsDedicated; // NOTE(blackedout): Holds a single allocation that was too large for a regular block
+} vulkan_memory_block;
+
+// NOTE(blackedout): Two level segregated fit (TLSF) free lists of all blocks of one memory type and resource kind. Free ranges are
+// found in constant time by scanning the bitmasks of non-empty lists.
+typedef struct {
+    uint64_t FirstLevelBits;
+    uint32_t SecondLevelBits[VULKAN_TLSF_FIRST_LEVEL_COUNT];
+    uint32_t FreeNodes[VULKAN_TLSF_FIRST_LEVEL_COUNT][VULKAN_TLSF_SECOND_LEVEL_COUNT];
+    uint32_t BlockCount;
+    uint32_t AllocationCount;
+    VkDeviceSize BlockByteCount;
+    VkDeviceSize UsedByteCount;
+} vulkan_memory_pool;
+#endif
+
+typedef struct {
+    VkDeviceSize ByteCount;
+    uint32_t AllocationCount;
+} vulkan_memory_counter;
+
+// NOTE(blackedout): Called when a heap comes under memory pressure, so that the caller can give memory back.
+typedef void (*vulkan_memory_pressure_proc)(void *Data, uint32_t HeapIndex, VkDeviceSize Usage, VkDeviceSize Budget);
+
+typedef struct {
+    VkDevice DeviceHandle;
+    VkPhysicalDevice PhysicalDevice;
+    VkPhysicalDeviceMemoryProperties Properties;
+    VkDeviceSize BufferImageGranularity;
+    uint32_t MaxAllocationCount;
+    // NOTE(blackedout): Device local memory can be written by the host (resizable BAR or unified memory), without the heap being just the
+    // small BAR window. Static data may then be written in place instead of through staging buffers.
+    int HasHostVisibleDeviceLocalHeap;
+
+    // NOTE(blackedout): Live statistics of the allocations made through this allocator, per heap they are summed up from the types.
+    vulkan_memory_counter TypeCounters[VK_MAX_MEMORY_TYPES];
+    vulkan_memory_counter SubsystemCounters[VULKAN_MEMORY_SUBSYSTEM_COUNT];
+
+    // NOTE(blackedout): Usage and budget per heap as of the last VulkanUpdateMemoryBudget
+    int HasMemoryBudget; // NOTE(blackedout): VK_EXT_memory_budget is enabled
+    uint32_t FrameIndex;
+    VkDeviceSize HeapUsages[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize HeapBudgets[VK_MAX_MEMORY_HEAPS];
+    uint32_t HeapPressureBits;
+    vulkan_memory_pressure_proc PressureProc;
+    void *PressureData;
+
+#ifdef VULKAN_USE_VMA
+    VmaAllocator Vma;
+#else
+    uint32_t DeviceAllocationCount;
+    vulkan_memory_pool *Pools; // NOTE(blackedout): VK_MAX_MEMORY_TYPES*VULKAN_RESOURCE_KIND_COUNT, indexed by memory type, then kind
+    vulkan_memory_block Blocks[VULKAN_MEMORY_MAX_BLOCK_COUNT];
+    vulkan_memory_node *Nodes;
+    uint32_t NodeCapacity;
+    uint32_t UnusedNode;
+#endif
+} vulkan_memory_allocator;
+
 typedef struct {
     VkDevice Handle;
     VkSurfaceKHR Surface;
 
     VkPhysicalDevice PhysicalDevice;
-    //VkPhysicalDeviceMemoryProperties PhysicalMemoryProperties;
 
     uint32_t GraphicsQueueFamilyIndex;
     uint32_t PresentQueueFamilyIndex;
+    // NOTE(blackedout): A compute queue family without graphics if HasAsyncCompute is set, otherwise the graphics queue family.
+    // Compute work submitted to it can run while the graphics queue rasterizes.
+    uint32_t ComputeQueueFamilyIndex;
+    int HasAsyncCompute;
 
     VkExtent2D InitialExtent;
     VkSurfaceFormatKHR InitialSurfaceFormat;
@@ -77,9 +204,14 @@ typedef struct {
     VkFormat BestDepthFormat;
     VkSampleCountFlagBits MaxSampleCount;
 
-#ifdef VULKAN_USE_VMA
-    VmaAllocator Allocator;
-#endif
+    // NOTE(blackedout): Only set if VK_EXT_graphics_pipeline_library is enabled and linking libraries is fast.
+    int HasGraphicsPipelineLibrary;
+    // NOTE(blackedout): Only set if partially bound and update after bind sampled image descriptors are enabled (Vulkan 1.2 descriptor indexing)
+    // and sampled image arrays can be indexed dynamically. DescriptorIndexingProperties is only valid if it is set.
+    int HasDescriptorIndexing;
+    VkPhysicalDeviceDescriptorIndexingProperties DescriptorIndexingProperties;
+
+    vulkan_memory_allocator Memory;
 } vulkan_surface_device;
 
 typedef struct {
@@ -96,11 +228,11 @@ typedef struct {
 
     VkImage DepthImage;
     VkImageView DepthImageView;
-    VkDeviceMemory DepthImageMemory;
+    vulkan_allocation DepthImageAllocation;
 
     VkImage MultiSampleColorImage;
     VkImageView MultiSampleColorImageView;
-    VkDeviceMemory MultiSampleColorImageMemory;
+    vulkan_allocation MultiSampleColorImageAllocation;
 
     uint32_t AcquiredImageCount;
 } vulkan_swapchain;
@@ -123,27 +255,61 @@ typedef struct {
     VkFence InFlightFences[MAX_ACQUIRED_IMAGE_COUNT];
 } vulkan_swapchain_handler;
 
+// NOTE(blackedout): The framebuffer's attachments are the multisampled color image, the depth image and the swapchain image it is resolved to
 typedef struct {
     VkFramebuffer Framebuffer;
+    VkImage Image;
+    VkImage ColorImage;
+    VkImageView ColorImageView;
+    VkImage DepthImage;
+    VkImageView DepthImageView; // NOTE(blackedout): Sampleable if VulkanIsDepthSampleable
+    VkImageView ImageView;
+    VkFormat Format;
     VkExtent2D Extent;
     uint32_t DataIndex;
 } vulkan_acquired_image;
 
+// NOTE(blackedout): An additional semaphore the final submission waits for, Semaphore is null if there is none
+typedef struct {
+    VkSemaphore Semaphore;
+    VkPipelineStageFlags Stages;
+} vulkan_semaphore_wait;
+
 typedef struct {
     VkShaderModule Vert, Frag;
 } vulkan_shader;
 
 typedef struct {
     VkBuffer Handle;
-    VkDeviceMemory Memory;
+    vulkan_allocation Allocation;
 } vulkan_buffer;
 
 typedef struct {
-    void *Source;
+    const void *Source; // NOTE(blackedout): May point into read only memory, e.g. a mapped asset pack
     uint64_t ByteCount;
     uint64_t *OffsetPointer;
 } vulkan_subbuf;
 
+#define VULKAN_STAGING_FILL_PIECE_BYTE_COUNT (256ull << 10)
+#define VULKAN_STAGING_MAX_FILL_COUNT 64
+
+typedef struct {
+    uint8_t *Destination;
+    const uint8_t *Source;
+    uint64_t ByteCount;
+} vulkan_staging_fill;
+
+typedef struct {
+    work_pool *Workers;
+    uint32_t Count;
+    vulkan_staging_fill Fills[VULKAN_STAGING_MAX_FILL_COUNT]; // NOTE(blackedout): At most VULKAN_STAGING_FILL_PIECE_BYTE_COUNT bytes each
+} vulkan_staging_fills;
+
+#define VULKAN_MAX_IMAGE_LEVEL_COUNT 16
+#define VULKAN_STAGING_IMAGE_ALIGNMENT 16 // NOTE(blackedout): Multiple of 4 and every texel block size, as required for buffer to image copies
+#define VULKAN_IMAGE_STAGING_SLOT_COUNT 2
+#define VULKAN_IMAGE_STAGING_SLOT_BYTE_COUNT (8ull << 20)
+
 typedef struct {
     VkImageType Type;
     VkImageViewType ViewType;
@@ -151,28 +317,122 @@ typedef struct {
     uint32_t Width, Height, Depth;
 
     uint64_t ByteCount;
-    void *Source;
+    const void *Source;
+
+    // NOTE(blackedout): Levels stored in Source, e.g. prebuilt mips of block compressed formats. If 0, Source only contains level 0
+    // (at offset 0) and the remaining levels are generated.
+    uint32_t LevelCount;
+    uint64_t LevelOffsets[VULKAN_MAX_IMAGE_LEVEL_COUNT]; // NOTE(blackedout): From Source
+
+    // NOTE(blackedout): Texel block of the format, so that uploads can be split into rows of blocks. If BlockByteCount is 0, texels are
+    // single blocks of ByteCount/(Width*Height*Depth) bytes.
+    uint32_t BlockWidth, BlockHeight;
+    uint32_t BlockByteCount;
 } vulkan_image_description;
 
 typedef struct {
     VkImage Handle;
     VkImageView ViewHandle;
-    uint64_t Offset;
+    vulkan_allocation Allocation;
+    uint32_t MipLevelCount;
 } vulkan_image;
 
-typedef struct {
-    VkBuffer VertexHandle;
-    VkBuffer IndexHandle;
-
-    uint32_t MemoryCount;
-    VkDeviceMemory MemoryBufs[3];
-} vulkan_static_buffers;
-
 typedef struct {
     vulkan_subbuf Vertices;
     vulkan_subbuf Indices;
+    VkIndexType IndexType; // NOTE(blackedout): Index subbuffers are aligned to their index size within the index buffer
+    vulkan_subbuf Storage;
+    uint32_t StorageStride; // NOTE(blackedout): Storage subbuffers are aligned to this, so that shaders can index them as arrays of one element type
 } vulkan_mesh_subbuf;
 
+#define VULKAN_MESH_REGISTRY_MAX_MESH_COUNT 1024
+#define VULKAN_MESH_ARENA_MIN_BYTE_COUNT (1ull << 20)
+#define VULKAN_MESH_ARENA_MAX_FREE_RANGE_COUNT 256
+#define VULKAN_MESH_VERTEX_ALIGNMENT 16 // NOTE(blackedout): Enough for every vertex attribute format
+#define VULKAN_MESH_UPLOAD_BYTE_COUNT (4ull << 20) // NOTE(blackedout): Uploaded per frame at most, also the size of each staging buffer
+#define VULKAN_MESH_DEFRAG_MAX_MOVE_COUNT 32 // NOTE(blackedout): Per frame
+#define VULKAN_MESH_DEFRAG_BYTE_BUDGET (4ull << 20) // NOTE(blackedout): Per frame
+// NOTE(blackedout): Per data index. Each resident mesh can be removed once per frame, plus the ranges vacated by defragmentation.
+#define VULKAN_MESH_REGISTRY_MAX_RETIRED_RANGE_COUNT (VULKAN_MESH_ARENA_COUNT*VULKAN_MESH_REGISTRY_MAX_MESH_COUNT + VULKAN_MESH_DEFRAG_MAX_MOVE_COUNT)
+
+typedef enum {
+    VULKAN_MESH_ARENA_VERTICES,
+    VULKAN_MESH_ARENA_INDICES,
+    VULKAN_MESH_ARENA_STORAGE,
+    VULKAN_MESH_ARENA_COUNT
+} vulkan_mesh_arena_kind;
+
+static const char *VULKAN_MESH_ARENA_NAMES[] = {
+    "vertices", "indices", "storage"
+};
+
+typedef uint32_t vulkan_mesh_handle; // NOTE(blackedout): Entry index in the low 16 bits, generation in the high 16 bits, 0 is never valid
+
+typedef struct {
+    uint64_t Offset;
+    uint64_t ByteCount;
+} vulkan_arena_range;
+
+typedef struct {
+    vulkan_buffer Buffer;
+    VkBufferUsageFlags Usage;
+    uint64_t ByteCount;
+    uint64_t UsedByteCount;
+    uint32_t FreeRangeCount;
+    vulkan_arena_range FreeRanges[VULKAN_MESH_ARENA_MAX_FREE_RANGE_COUNT]; // NOTE(blackedout): Sorted by offset, neighbours are merged
+    int IsCompact; // NOTE(blackedout): No resident part can move to a lower offset, reset when holes may have opened up
+} vulkan_mesh_arena;
+
+typedef enum {
+    VULKAN_MESH_STATE_UNUSED,
+    VULKAN_MESH_STATE_PENDING, // NOTE(blackedout): Added, but not placed yet
+    VULKAN_MESH_STATE_UPLOADING, // NOTE(blackedout): Placed, its parts are copied in chunks over one or more frames
+    VULKAN_MESH_STATE_RESIDENT,
+} vulkan_mesh_state;
+
+typedef struct {
+    vulkan_mesh_subbuf Subbuf;
+    vulkan_arena_range Ranges[VULKAN_MESH_ARENA_COUNT]; // NOTE(blackedout): Empty for parts without data
+    uint64_t UploadedByteCounts[VULKAN_MESH_ARENA_COUNT];
+    vulkan_mesh_state State;
+    uint32_t Generation;
+    uint32_t NextUnused;
+} vulkan_mesh_entry;
+
+typedef struct {
+    vulkan_mesh_arena_kind Kind;
+    vulkan_arena_range Range;
+    int IsMoved; // NOTE(blackedout): Vacated by defragmentation, rather than by removing the mesh
+} vulkan_retired_range;
+
+typedef struct {
+    vulkan_mesh_arena Arenas[VULKAN_MESH_ARENA_COUNT];
+    // NOTE(blackedout): Resources that belong to the frame of a data index. Arena buffers replaced while recording that frame are kept until it
+    // has finished.
+    vulkan_buffer RetiredBuffers[MAX_ACQUIRED_IMAGE_COUNT][VULKAN_MESH_ARENA_COUNT];
+    vulkan_buffer StagingBuffers[MAX_ACQUIRED_IMAGE_COUNT];
+    // NOTE(blackedout): Ranges of removed and moved meshes, which may still be read. MAX_ACQUIRED_IMAGE_COUNT*VULKAN_MESH_REGISTRY_MAX_RETIRED_RANGE_COUNT,
+    // indexed by data index first.
+    vulkan_retired_range *RetiredRanges;
+    uint32_t RetiredRangeCounts[MAX_ACQUIRED_IMAGE_COUNT];
+    uint32_t RecordingDataIndex; // NOTE(blackedout): Data index of the last VulkanUpdateMeshRegistry
+    work_pool *Workers; // NOTE(blackedout): Fills the staging buffer or the arenas written in place
+
+    vulkan_mesh_entry *Entries; // NOTE(blackedout): VULKAN_MESH_REGISTRY_MAX_MESH_COUNT
+    uint32_t UnusedEntry;
+    uint32_t MeshCount;
+    uint32_t PendingCount;
+    uint32_t PendingEntries[VULKAN_MESH_REGISTRY_MAX_MESH_COUNT]; // NOTE(blackedout): Pending and uploading meshes in the order they were added
+
+    uint64_t DefragByteBudget; // NOTE(blackedout): Bytes moved per frame at most (but at least one part), 0 disables defragmentation
+    uint64_t DefragMovedByteCount;
+    uint64_t DefragReclaimedByteCount; // NOTE(blackedout): Bytes that joined the free space at the end of an arena when a retired range was freed
+} vulkan_mesh_registry;
+
+static uint32_t VulkanIndexTypeByteCount(VkIndexType IndexType) {
+    return (IndexType == VK_INDEX_TYPE_UINT16)? 2 : 4;
+}
+
 // NOTE(blackedout): IncompleteActions: 0: error, 1: warn, 2: ignore
 static int VulkanCheckFun(VkResult VulkanResult, int IncompleteAction, const char *CallString) {
     int Result = 1;
@@ -297,19 +557,93 @@ label_Error:
     return 1;
 }
 
-// MARK: Memory, Buffers
-static int VulkanGetBufferMemoryTypeIndex(vulkan_surface_device *Device, uint32_t MemoryTypeBits, VkMemoryPropertyFlags MemoryPropertyFlags, uint32_t *MemoryTypeIndex) {
-    // TODO(blackedout): Make this part of vulkan_surface_device?
-    VkPhysicalDeviceMemoryProperties PhysicalDeviceMemoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(Device->PhysicalDevice, &PhysicalDeviceMemoryProperties);
+// MARK: Memory
+// NOTE(blackedout): All device memory of the helpers goes through these functions. With vma, it does the sub-allocation. Otherwise each
+// memory type has one TLSF pool per resource kind, which sub-allocates from blocks of VULKAN_MEMORY_BLOCK_BYTE_COUNT bytes (larger
+// allocations get a block of their own). Linear and optimal resources only share pools if bufferImageGranularity doesn't matter, because
+// neighbouring linear and optimal resources would have to be that far apart. Host visible blocks are mapped for their whole lifetime.
+// Not thread safe, device memory is only allocated on the main thread.
+static int VulkanCreateMemoryAllocator(VkPhysicalDevice PhysicalDevice, VkDevice DeviceHandle, VkPhysicalDeviceProperties *Properties, int HasMemoryBudget, vulkan_memory_allocator *OutAllocator) {
+    vulkan_memory_allocator Allocator;
+    SetZero(Allocator);
+    Allocator.DeviceHandle = DeviceHandle;
+    Allocator.PhysicalDevice = PhysicalDevice;
+    Allocator.HasMemoryBudget = HasMemoryBudget;
+    vkGetPhysicalDeviceMemoryProperties(PhysicalDevice, &Allocator.Properties);
+    Allocator.BufferImageGranularity = Properties->limits.bufferImageGranularity;
+    Allocator.MaxAllocationCount = Properties->limits.maxMemoryAllocationCount;
+    for(uint32_t I = 0; I < Allocator.Properties.memoryTypeCount; ++I) {
+        VkMemoryType Type = Allocator.Properties.memoryTypes[I];
+        VkMemoryPropertyFlags Flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        if((Type.propertyFlags & Flags) == Flags && Allocator.Properties.memoryHeaps[Type.heapIndex].size > VULKAN_MEMORY_SMALL_BAR_BYTE_COUNT) {
+            Allocator.HasHostVisibleDeviceLocalHeap = 1;
+        }
+    }
+
+#ifndef VULKAN_USE_VMA
+    uint32_t PoolCount = VK_MAX_MEMORY_TYPES*VULKAN_RESOURCE_KIND_COUNT;
+    Allocator.Pools = (vulkan_memory_pool *)malloc(PoolCount*sizeof(vulkan_memory_pool));
+    AssertMessageGoto(Allocator.Pools, label_Error, "Memory pools could not be allocated.\n");
+    memset(Allocator.Pools, 0, PoolCount*sizeof(vulkan_memory_pool));
+    for(uint32_t I = 0; I < PoolCount; ++I) {
+        memset(Allocator.Pools[I].FreeNodes, 0xff, sizeof(Allocator.Pools[I].FreeNodes)); // NOTE(blackedout): All VULKAN_MEMORY_NULL_NODE
+    }
+    Allocator.UnusedNode = VULKAN_MEMORY_NULL_NODE;
+#endif
+
+    *OutAllocator = Allocator;
+    return 0;
+
+#ifndef VULKAN_USE_VMA
+label_Error:
+    return 1;
+#endif
+}
+
+static void VulkanDestroyMemoryAllocator(vulkan_memory_allocator *Allocator) {
+#ifdef VULKAN_USE_VMA
+    vmaDestroyAllocator(Allocator->Vma);
+#else
+    uint32_t LeakedCount = 0;
+    for(uint32_t I = 0; Allocator->Pools && I < VK_MAX_MEMORY_TYPES*VULKAN_RESOURCE_KIND_COUNT; ++I) {
+        LeakedCount += Allocator->Pools[I].AllocationCount;
+    }
+    AssertMessage(LeakedCount == 0, "%d device memory allocations were not freed.\n", LeakedCount);
+    for(uint32_t I = 0; I < ArrayCount(Allocator->Blocks); ++I) {
+        vkFreeMemory(Allocator->DeviceHandle, Allocator->Blocks[I].Memory, 0);
+    }
+    free(Allocator->Pools);
+    free(Allocator->Nodes);
+#endif
+    memset(Allocator, 0, sizeof(*Allocator));
+}
+
+static int VulkanGetBufferMemoryTypeIndex(vulkan_surface_device *Device, uint32_t MemoryTypeBits, VkMemoryPropertyFlags MemoryPropertyFlags, VkMemoryPropertyFlags PreferredPropertyFlags, uint32_t *MemoryTypeIndex) {
+    // NOTE(blackedout): Of the types with all required flags, the one with the most preferred flags is used. Device local or host visible
+    // types that weren't asked for count against a type, so that e.g. staging buffers don't take up the BAR window. Ties go to the lower
+    // index, because types are ordered by performance.
+    VkPhysicalDeviceMemoryProperties *PhysicalDeviceMemoryProperties = &Device->Memory.Properties;
+    VkMemoryPropertyFlags AvoidedPropertyFlags = (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) & ~(MemoryPropertyFlags | PreferredPropertyFlags);
 
     int HasMemoryType = 0;
+    int BestScore = 0;
     uint32_t BestBufferMemoryTypeIndex;
-    for(uint32_t I = 0; I < PhysicalDeviceMemoryProperties.memoryTypeCount; ++I) {
-        int TypeUsable = (MemoryTypeBits & (1 << I)) &&
-                        (PhysicalDeviceMemoryProperties.memoryTypes[I].propertyFlags & MemoryPropertyFlags) == MemoryPropertyFlags;
-        if(TypeUsable) {
+    for(uint32_t I = 0; I < PhysicalDeviceMemoryProperties->memoryTypeCount; ++I) {
+        VkMemoryPropertyFlags TypeFlags = PhysicalDeviceMemoryProperties->memoryTypes[I].propertyFlags;
+        int TypeUsable = (MemoryTypeBits & (1 << I)) && (TypeFlags & MemoryPropertyFlags) == MemoryPropertyFlags;
+        if(TypeUsable == 0) {
+            continue;
+        }
+        int Score = 0;
+        for(VkMemoryPropertyFlags Bits = TypeFlags & PreferredPropertyFlags; Bits; Bits &= Bits - 1) {
+            Score += 2;
+        }
+        for(VkMemoryPropertyFlags Bits = TypeFlags & AvoidedPropertyFlags; Bits; Bits &= Bits - 1) {
+            Score -= 1;
+        }
+        if(HasMemoryType == 0 || Score > BestScore) {
             HasMemoryType = 1;
+            BestScore = Score;
             BestBufferMemoryTypeIndex = I;
         }
     }
@@ -322,727 +656,4012 @@ static int VulkanGetBufferMemoryTypeIndex(vulkan_surface_device *Device, uint32_
     return 0;
 }
 
-static void VulkanDestroyBuffer(vulkan_surface_device *Device, vulkan_buffer *Buffer) {
-    VkDevice DeviceHandle = Device->Handle;
-    vkDestroyBuffer(DeviceHandle, Buffer->Handle, 0);
-    vkFreeMemory(DeviceHandle, Buffer->Memory, 0);
-    memset(Buffer, 0, sizeof(*Buffer));
+#ifndef VULKAN_USE_VMA
+static void VulkanTlsfMapping(VkDeviceSize Size, uint32_t *OutFirst, uint32_t *OutSecond) {
+    // NOTE(blackedout): The first level is the power of two below the size, the second level splits it linearly. Sizes are at least
+    // VULKAN_MEMORY_GRANULE, so the first level is always larger than the second level bit count.
+    uint32_t First = HighestBitIndex64(Size);
+    *OutFirst = First;
+    *OutSecond = (uint32_t)(Size >> (First - VULKAN_TLSF_SECOND_LEVEL_LOG2)) & (VULKAN_TLSF_SECOND_LEVEL_COUNT - 1);
 }
 
-static int VulkanCreateExclusiveBufferWithMemory(vulkan_surface_device *Device, uint64_t ByteCount, VkBufferUsageFlags UsageFlags, VkMemoryPropertyFlags MemoryPropertyFlags, vulkan_buffer *OutBuffer) {
-    VkDevice DeviceHandle = Device->Handle;
-
-    vulkan_buffer Buffer;
-    SetZero(Buffer);
-    {
-        VkBufferCreateInfo BufferCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .size = ByteCount,
-            .usage = UsageFlags,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE, // NOTE(blackedout): Sharing between queue families
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = 0
-        };
-
-        VulkanCheckGoto(vkCreateBuffer(DeviceHandle, &BufferCreateInfo, 0, &Buffer.Handle), label_Error);
-
-        VkMemoryRequirements BufferMemoryRequirements;
-        vkGetBufferMemoryRequirements(DeviceHandle, Buffer.Handle, &BufferMemoryRequirements);
-
-        uint32_t BufferMemoryTypeIndex;
-        CheckGoto(VulkanGetBufferMemoryTypeIndex(Device, BufferMemoryRequirements.memoryTypeBits, MemoryPropertyFlags, &BufferMemoryTypeIndex), label_Buffer);
+static void VulkanInsertFreeMemoryNode(vulkan_memory_allocator *Allocator, vulkan_memory_pool *Pool, uint32_t NodeIndex) {
+    vulkan_memory_node *Node = Allocator->Nodes + NodeIndex;
+    uint32_t First, Second;
+    VulkanTlsfMapping(Node->Size, &First, &Second);
+
+    uint32_t HeadIndex = Pool->FreeNodes[First][Second];
+    Node->IsFree = 1;
+    Node->PrevFree = VULKAN_MEMORY_NULL_NODE;
+    Node->NextFree = HeadIndex;
+    if(HeadIndex != VULKAN_MEMORY_NULL_NODE) {
+        Allocator->Nodes[HeadIndex].PrevFree = NodeIndex;
+    }
+    Pool->FreeNodes[First][Second] = NodeIndex;
+    Pool->FirstLevelBits |= (1ull << First);
+    Pool->SecondLevelBits[First] |= (1u << Second);
+}
 
-        VkMemoryAllocateInfo MemoryAllocateInfo = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .pNext = 0,
-            .allocationSize = BufferMemoryRequirements.size,
-            .memoryTypeIndex = BufferMemoryTypeIndex
-        };
+static void VulkanRemoveFreeMemoryNode(vulkan_memory_allocator *Allocator, vulkan_memory_pool *Pool, uint32_t NodeIndex) {
+    vulkan_memory_node *Node = Allocator->Nodes + NodeIndex;
+    uint32_t First, Second;
+    VulkanTlsfMapping(Node->Size, &First, &Second);
+
+    if(Node->PrevFree != VULKAN_MEMORY_NULL_NODE) {
+        Allocator->Nodes[Node->PrevFree].NextFree = Node->NextFree;
+    } else {
+        Pool->FreeNodes[First][Second] = Node->NextFree;
+        if(Node->NextFree == VULKAN_MEMORY_NULL_NODE) {
+            Pool->SecondLevelBits[First] &= ~(1u << Second);
+            if(Pool->SecondLevelBits[First] == 0) {
+                Pool->FirstLevelBits &= ~(1ull << First);
+            }
+        }
+    }
+    if(Node->NextFree != VULKAN_MEMORY_NULL_NODE) {
+        Allocator->Nodes[Node->NextFree].PrevFree = Node->PrevFree;
+    }
+    Node->IsFree = 0;
+    Node->PrevFree = VULKAN_MEMORY_NULL_NODE;
+    Node->NextFree = VULKAN_MEMORY_NULL_NODE;
+}
 
-        VulkanCheckGoto(vkAllocateMemory(DeviceHandle, &MemoryAllocateInfo, 0, &Buffer.Memory), label_Buffer);
-        VulkanCheckGoto(vkBindBufferMemory(DeviceHandle, Buffer.Handle, Buffer.Memory, 0), label_Memory);
+static uint32_t VulkanFindFreeMemoryNode(vulkan_memory_pool *Pool, VkDeviceSize Size) {
+    // NOTE(blackedout): The size is rounded up to the next list boundary, so that every range of the list that is found fits.
+    Size += ((VkDeviceSize)1 << (HighestBitIndex64(Size) - VULKAN_TLSF_SECOND_LEVEL_LOG2)) - 1;
+    uint32_t First, Second;
+    VulkanTlsfMapping(Size, &First, &Second);
+
+    uint32_t SecondBits = Pool->SecondLevelBits[First] & (~0u << Second);
+    if(SecondBits == 0) {
+        uint64_t FirstBits = (First + 1 < VULKAN_TLSF_FIRST_LEVEL_COUNT)? (Pool->FirstLevelBits & (~0ull << (First + 1))) : 0;
+        if(FirstBits == 0) {
+            return VULKAN_MEMORY_NULL_NODE;
+        }
+        First = LowestBitIndex64(FirstBits);
+        SecondBits = Pool->SecondLevelBits[First];
+    }
+    Second = LowestBitIndex64(SecondBits);
+    return Pool->FreeNodes[First][Second];
+}
 
-        *OutBuffer = Buffer;
+static int VulkanAcquireMemoryNode(vulkan_memory_allocator *Allocator, uint32_t *OutNodeIndex) {
+    // NOTE(blackedout): Nodes are addressed by index, because the node array moves when it grows.
+    if(Allocator->UnusedNode == VULKAN_MEMORY_NULL_NODE) {
+        uint32_t NewCapacity = Allocator->NodeCapacity? 2*Allocator->NodeCapacity : 256;
+        vulkan_memory_node *Nodes = (vulkan_memory_node *)realloc(Allocator->Nodes, NewCapacity*sizeof(vulkan_memory_node));
+        AssertMessageGoto(Nodes, label_Error, "Memory nodes could not be allocated.\n");
+        for(uint32_t I = Allocator->NodeCapacity; I < NewCapacity; ++I) {
+            memset(Nodes + I, 0, sizeof(*Nodes));
+            Nodes[I].NextFree = (I + 1 < NewCapacity)? (I + 1) : VULKAN_MEMORY_NULL_NODE;
+        }
+        Allocator->UnusedNode = Allocator->NodeCapacity;
+        Allocator->Nodes = Nodes;
+        Allocator->NodeCapacity = NewCapacity;
     }
 
+    uint32_t NodeIndex = Allocator->UnusedNode;
+    Allocator->UnusedNode = Allocator->Nodes[NodeIndex].NextFree;
+    memset(Allocator->Nodes + NodeIndex, 0, sizeof(*Allocator->Nodes));
+    Allocator->Nodes[NodeIndex].PrevPhysical = VULKAN_MEMORY_NULL_NODE;
+    Allocator->Nodes[NodeIndex].NextPhysical = VULKAN_MEMORY_NULL_NODE;
+    Allocator->Nodes[NodeIndex].PrevFree = VULKAN_MEMORY_NULL_NODE;
+    Allocator->Nodes[NodeIndex].NextFree = VULKAN_MEMORY_NULL_NODE;
+    *OutNodeIndex = NodeIndex;
     return 0;
-    
-label_Memory:
-    vkFreeMemory(DeviceHandle, Buffer.Memory, 0);
-    Buffer.Memory = 0;
-label_Buffer:
-    vkDestroyBuffer(DeviceHandle, Buffer.Handle, 0);
-    Buffer.Handle = 0;
+
 label_Error:
     return 1;
 }
 
-static void VulkanDestroyImageWidthMemoryAndView(vulkan_surface_device *Device, VkImage *Image, VkDeviceMemory *ImageMemory, VkImageView *ImageView) {
-    VkDevice DeviceHandle = Device->Handle;
-    vkDestroyImageView(DeviceHandle, *ImageView, 0);
-    *ImageView = 0;
-    vkFreeMemory(DeviceHandle, *ImageMemory, 0);
-    *ImageMemory = 0;
-    vkDestroyImage(DeviceHandle, *Image, 0);
-    *Image = 0;
+static void VulkanReleaseMemoryNode(vulkan_memory_allocator *Allocator, uint32_t NodeIndex) {
+    Allocator->Nodes[NodeIndex].Size = 0;
+    Allocator->Nodes[NodeIndex].NextFree = Allocator->UnusedNode;
+    Allocator->UnusedNode = NodeIndex;
 }
 
-static int VulkanCreateExclusiveImageWithMemoryAndView(vulkan_surface_device *Device, VkImageType Type, VkFormat Format, uint32_t Width, uint32_t Height, uint32_t Depth, VkSampleCountFlagBits SampleCount, VkImageUsageFlags Usage, VkMemoryPropertyFlags MemoryProperties, VkImageViewType ViewType, VkImageAspectFlags ViewAspect, VkImage *OutImage, VkDeviceMemory *OutImageMemory, VkImageView *OutImageView) {
-    VkDevice DeviceHandle = Device->Handle;
+static int VulkanCreateMemoryBlock(vulkan_memory_allocator *Allocator, uint32_t PoolIndex, uint32_t MemoryTypeIndex, VkDeviceSize Size, uint32_t *OutNodeIndex) {
+    // NOTE(blackedout): The whole block becomes one free range, whose node is returned.
+    uint32_t BlockIndex = 0;
+    while(BlockIndex < VULKAN_MEMORY_MAX_BLOCK_COUNT && Allocator->Blocks[BlockIndex].Memory) {
+        ++BlockIndex;
+    }
+    AssertMessageGoto(BlockIndex < VULKAN_MEMORY_MAX_BLOCK_COUNT, label_Error, "Too many memory blocks (%d).\n", VULKAN_MEMORY_MAX_BLOCK_COUNT);
+    AssertMessageGoto(Allocator->DeviceAllocationCount < Allocator->MaxAllocationCount, label_Error, "Too many device memory allocations (%d).\n", Allocator->DeviceAllocationCount);
 
-    VkImage ImageHandle = 0;
-    VkDeviceMemory Memory = 0;
-    VkImageView ViewHandle = 0;
+    uint32_t NodeIndex;
+    CheckGoto(VulkanAcquireMemoryNode(Allocator, &NodeIndex), label_Error);
     {
-        VkImageCreateInfo CreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .imageType = Type,
-            .format = Format,
-            .extent = {
-                .width = Width,
-                .height = Height,
-                .depth = Depth,
-            },
-            .mipLevels = 1,
-            .arrayLayers = 1,
-            .samples = SampleCount,
-            .tiling = VK_IMAGE_TILING_OPTIMAL,
-            .usage = Usage,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = 0,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
-        };
-        
-        VulkanCheckGoto(vkCreateImage(DeviceHandle, &CreateInfo, 0, &ImageHandle), label_Error);
-
-        VkMemoryRequirements MemoryRequirements;
-        vkGetImageMemoryRequirements(DeviceHandle, ImageHandle, &MemoryRequirements);
-
-        uint32_t MemoryTypeIndex;
-        CheckGoto(VulkanGetBufferMemoryTypeIndex(Device, MemoryRequirements.memoryTypeBits, MemoryProperties, &MemoryTypeIndex), label_Image);
+        vulkan_memory_block Block;
+        SetZero(Block);
+        Block.Size = Size;
+        Block.PoolIndex = PoolIndex;
 
         VkMemoryAllocateInfo MemoryAllocateInfo = {
             .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
             .pNext = 0,
-            .allocationSize = MemoryRequirements.size,
+            .allocationSize = Size,
             .memoryTypeIndex = MemoryTypeIndex
         };
-        
-        VulkanCheckGoto(vkAllocateMemory(DeviceHandle, &MemoryAllocateInfo, 0, &Memory), label_Image);
-        VulkanCheckGoto(vkBindImageMemory(DeviceHandle, ImageHandle, Memory, 0), label_Memory);
-
-        VkImageViewCreateInfo ViewCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .image = ImageHandle,
-            .viewType = ViewType,
-            .format = Format,
-            .components = { .r = VK_COMPONENT_SWIZZLE_IDENTITY, .g = VK_COMPONENT_SWIZZLE_IDENTITY, .b = VK_COMPONENT_SWIZZLE_IDENTITY, .a = VK_COMPONENT_SWIZZLE_IDENTITY },
-            .subresourceRange = {
-                .aspectMask = ViewAspect,
-                .baseMipLevel = 0,
-                .levelCount = 1,
-                .baseArrayLayer = 0,
-                .layerCount = 1
+        VulkanCheckGoto(vkAllocateMemory(Allocator->DeviceHandle, &MemoryAllocateInfo, 0, &Block.Memory), label_Node);
+        if(Allocator->Properties.memoryTypes[MemoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+            VkResult MapResult = vkMapMemory(Allocator->DeviceHandle, Block.Memory, 0, VK_WHOLE_SIZE, 0, (void **)&Block.Mapped);
+            if(MapResult != VK_SUCCESS) {
+                vkFreeMemory(Allocator->DeviceHandle, Block.Memory, 0);
+                VulkanCheckGoto(MapResult, label_Node);
             }
-        };
-        
-        VulkanCheckGoto(vkCreateImageView(DeviceHandle, &ViewCreateInfo, 0, &ViewHandle), label_Memory);
-
-        *OutImage = ImageHandle;
-        *OutImageMemory = Memory;
-        *OutImageView = ViewHandle;
+        }
+        Allocator->Blocks[BlockIndex] = Block;
+        ++Allocator->DeviceAllocationCount;
+
+        vulkan_memory_pool *Pool = Allocator->Pools + PoolIndex;
+        ++Pool->BlockCount;
+        Pool->BlockByteCount += Size;
+
+        Allocator->Nodes[NodeIndex].Offset = 0;
+        Allocator->Nodes[NodeIndex].Size = Size;
+        Allocator->Nodes[NodeIndex].BlockIndex = BlockIndex;
+        VulkanInsertFreeMemoryNode(Allocator, Pool, NodeIndex);
+        *OutNodeIndex = NodeIndex;
     }
-
     return 0;
 
-label_Memory:
-    vkFreeMemory(DeviceHandle, Memory, 0);
-    Memory = 0;
-label_Image:
-    vkDestroyImage(DeviceHandle, ImageHandle, 0);
-    ImageHandle = 0;
+label_Node:
+    VulkanReleaseMemoryNode(Allocator, NodeIndex);
 label_Error:
     return 1;
 }
 
-// MARK: Static Buffers
-static void VulkanDestroyStaticBuffersAndImages(vulkan_surface_device *Device, vulkan_static_buffers *StaticBuffers, vulkan_image *Images, uint32_t ImageCount) {
-    VkDevice DeviceHandle = Device->Handle;
+static void VulkanDestroyMemoryBlock(vulkan_memory_allocator *Allocator, uint32_t NodeIndex) {
+    // NOTE(blackedout): Expects the node to be the single free range that covers the block.
+    vulkan_memory_block *Block = Allocator->Blocks + Allocator->Nodes[NodeIndex].BlockIndex;
+    vulkan_memory_pool *Pool = Allocator->Pools + Block->PoolIndex;
+    VulkanRemoveFreeMemoryNode(Allocator, Pool, NodeIndex);
+    VulkanReleaseMemoryNode(Allocator, NodeIndex);
+    --Pool->BlockCount;
+    Pool->BlockByteCount -= Block->Size;
+
+    vkFreeMemory(Allocator->DeviceHandle, Block->Memory, 0);
+    --Allocator->DeviceAllocationCount;
+    memset(Block, 0, sizeof(*Block));
+}
 
-    for(uint32_t I = 0; I < ImageCount; ++I) {
-        vkDestroyImage(DeviceHandle, Images[I].Handle, 0);
-        vkDestroyImageView(DeviceHandle, Images[I].ViewHandle, 0);
-    }
-    for(uint32_t I = 0; I < StaticBuffers->MemoryCount; ++I) {
-        vkFreeMemory(DeviceHandle, StaticBuffers->MemoryBufs[I], 0);
+static int VulkanSplitMemoryNode(vulkan_memory_allocator *Allocator, uint32_t NodeIndex, VkDeviceSize FrontSize, uint32_t *OutBackIndex) {
+    // NOTE(blackedout): Splits a range that isn't in a free list into a front range of FrontSize bytes (NodeIndex) and the rest.
+    uint32_t BackIndex;
+    CheckGoto(VulkanAcquireMemoryNode(Allocator, &BackIndex), label_Error);
+    {
+        vulkan_memory_node *Node = Allocator->Nodes + NodeIndex;
+        vulkan_memory_node *Back = Allocator->Nodes + BackIndex;
+        Back->Offset = Node->Offset + FrontSize;
+        Back->Size = Node->Size - FrontSize;
+        Back->BlockIndex = Node->BlockIndex;
+        Back->PrevPhysical = NodeIndex;
+        Back->NextPhysical = Node->NextPhysical;
+        if(Node->NextPhysical != VULKAN_MEMORY_NULL_NODE) {
+            Allocator->Nodes[Node->NextPhysical].PrevPhysical = BackIndex;
+        }
+        Node->Size = FrontSize;
+        Node->NextPhysical = BackIndex;
+        *OutBackIndex = BackIndex;
     }
-    vkDestroyBuffer(DeviceHandle, StaticBuffers->IndexHandle, 0);
-    vkDestroyBuffer(DeviceHandle, StaticBuffers->VertexHandle, 0);
+    return 0;
 
-    memset(StaticBuffers, 0, sizeof(*StaticBuffers));
-    memset(Images, 0, sizeof(*Images)*ImageCount);
+label_Error:
+    return 1;
 }
 
-static int VulkanCreateStaticBuffersAndImages(vulkan_surface_device *Device, vulkan_mesh_subbuf *MeshSubbufs, uint32_t MeshSubbufCount, vulkan_image_description *ImageDescriptions, uint32_t ImageCount, VkCommandPool TransferCommandPool, VkQueue TransferQueue, vulkan_static_buffers *OutStaticBuffers, vulkan_image *OutImages) {
-    VkDevice DeviceHandle = Device->Handle;
-
-    vulkan_static_buffers StaticBuffers = {0};
-    vulkan_buffer StagingBuffer = {0};
-    uint32_t CreatedImageCount = 0;
-    uint32_t CreatedImageViewCount = 0;
-    VkCommandBuffer TransferCommandBuffer = 0;
-    {
-        uint64_t TotalVertexByteCount = 0;
-        uint64_t TotalIndexByteCount = 0;
-        for(uint32_t I = 0; I < MeshSubbufCount; ++I) {
-            TotalVertexByteCount += MeshSubbufs[I].Vertices.ByteCount;
-            TotalIndexByteCount += MeshSubbufs[I].Indices.ByteCount;
+static void VulkanFreeMemoryNode(vulkan_memory_allocator *Allocator, uint32_t NodeIndex) {
+    // NOTE(blackedout): Merges the range with free neighbours. Empty blocks are given back to the device, except for the last regular
+    // block of a pool, so that allocating and freeing in a loop doesn't allocate device memory every time.
+    vulkan_memory_block *Block = Allocator->Blocks + Allocator->Nodes[NodeIndex].BlockIndex;
+    vulkan_memory_pool *Pool = Allocator->Pools + Block->PoolIndex;
+    --Pool->AllocationCount;
+    Pool->UsedByteCount -= Allocator->Nodes[NodeIndex].Size;
+
+    uint32_t PrevIndex = Allocator->Nodes[NodeIndex].PrevPhysical;
+    if(PrevIndex != VULKAN_MEMORY_NULL_NODE && Allocator->Nodes[PrevIndex].IsFree) {
+        VulkanRemoveFreeMemoryNode(Allocator, Pool, PrevIndex);
+        vulkan_memory_node *Node = Allocator->Nodes + NodeIndex;
+        Allocator->Nodes[PrevIndex].Size += Node->Size;
+        Allocator->Nodes[PrevIndex].NextPhysical = Node->NextPhysical;
+        if(Node->NextPhysical != VULKAN_MEMORY_NULL_NODE) {
+            Allocator->Nodes[Node->NextPhysical].PrevPhysical = PrevIndex;
+        }
+        VulkanReleaseMemoryNode(Allocator, NodeIndex);
+        NodeIndex = PrevIndex;
+    }
+    uint32_t NextIndex = Allocator->Nodes[NodeIndex].NextPhysical;
+    if(NextIndex != VULKAN_MEMORY_NULL_NODE && Allocator->Nodes[NextIndex].IsFree) {
+        VulkanRemoveFreeMemoryNode(Allocator, Pool, NextIndex);
+        vulkan_memory_node *Next = Allocator->Nodes + NextIndex;
+        Allocator->Nodes[NodeIndex].Size += Next->Size;
+        Allocator->Nodes[NodeIndex].NextPhysical = Next->NextPhysical;
+        if(Next->NextPhysical != VULKAN_MEMORY_NULL_NODE) {
+            Allocator->Nodes[Next->NextPhysical].PrevPhysical = NodeIndex;
         }
+        VulkanReleaseMemoryNode(Allocator, NextIndex);
+    }
+    VulkanInsertFreeMemoryNode(Allocator, Pool, NodeIndex);
 
-        // NOTE(blackedout): Create vertex and index buffers using similar create info
-        VkBufferCreateInfo BufferCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .size = TotalVertexByteCount,
-            .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = 0
-        };
-        VulkanCheckGoto(vkCreateBuffer(DeviceHandle, &BufferCreateInfo, 0, &StaticBuffers.VertexHandle), label_Error);
+    int IsBlockEmpty = Allocator->Nodes[NodeIndex].Size == Block->Size;
+    if(IsBlockEmpty && (Block->IsDedicated || Pool->BlockCount > 1)) {
+        VulkanDestroyMemoryBlock(Allocator, NodeIndex);
+    }
+}
 
-        BufferCreateInfo.size = TotalIndexByteCount;
-        BufferCreateInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+static int VulkanAllocateFromPool(vulkan_memory_allocator *Allocator, VkMemoryRequirements Requirements, uint32_t MemoryTypeIndex, vulkan_resource_kind Kind, vulkan_allocation *OutAllocation) {
+    if(Allocator->BufferImageGranularity <= VULKAN_MEMORY_GRANULE) {
+        Kind = VULKAN_RESOURCE_KIND_LINEAR;
+    }
+    uint32_t PoolIndex = MemoryTypeIndex*VULKAN_RESOURCE_KIND_COUNT + Kind;
+    vulkan_memory_pool *Pool = Allocator->Pools + PoolIndex;
+
+    // NOTE(blackedout): Ranges start at multiples of the granule, so only larger alignments need padding in front.
+    VkDeviceSize Alignment = Max(Requirements.alignment, VULKAN_MEMORY_GRANULE);
+    VkDeviceSize Size = AlignAny(Requirements.size, VkDeviceSize, VULKAN_MEMORY_GRANULE);
+    VkDeviceSize SearchSize = Size + Alignment - VULKAN_MEMORY_GRANULE;
+
+    uint32_t NodeIndex = VulkanFindFreeMemoryNode(Pool, SearchSize);
+    if(NodeIndex == VULKAN_MEMORY_NULL_NODE) {
+        VkDeviceSize HeapSize = Allocator->Properties.memoryHeaps[Allocator->Properties.memoryTypes[MemoryTypeIndex].heapIndex].size;
+        VkDeviceSize BlockSize = Min(VULKAN_MEMORY_BLOCK_BYTE_COUNT, AlignAny(HeapSize/8, VkDeviceSize, VULKAN_MEMORY_GRANULE));
+        int IsDedicated = SearchSize > BlockSize/2;
+        if(IsDedicated) {
+            BlockSize = Size; // NOTE(blackedout): Block of its own, the start of a block is aligned to anything
+        }
+        CheckGoto(VulkanCreateMemoryBlock(Allocator, PoolIndex, MemoryTypeIndex, BlockSize, &NodeIndex), label_Error);
+        Allocator->Blocks[Allocator->Nodes[NodeIndex].BlockIndex].IsDedicated = IsDedicated;
+    }
+    VulkanRemoveFreeMemoryNode(Allocator, Pool, NodeIndex);
+
+    VkDeviceSize NodeOffset = Allocator->Nodes[NodeIndex].Offset;
+    VkDeviceSize PaddingSize = AlignAny(NodeOffset, VkDeviceSize, Alignment) - NodeOffset;
+    if(PaddingSize > 0) {
+        uint32_t BackIndex;
+        if(VulkanSplitMemoryNode(Allocator, NodeIndex, PaddingSize, &BackIndex)) {
+            VulkanInsertFreeMemoryNode(Allocator, Pool, NodeIndex);
+            goto label_Error;
+        }
+        VulkanInsertFreeMemoryNode(Allocator, Pool, NodeIndex);
+        NodeIndex = BackIndex;
+    }
+    if(Allocator->Nodes[NodeIndex].Size > Size) {
+        uint32_t BackIndex;
+        // NOTE(blackedout): If the rest can't be split off, it just stays part of the allocation
+        if(VulkanSplitMemoryNode(Allocator, NodeIndex, Size, &BackIndex) == 0) {
+            VulkanInsertFreeMemoryNode(Allocator, Pool, BackIndex);
+        }
+    }
 
-        VulkanCheckGoto(vkCreateBuffer(DeviceHandle, &BufferCreateInfo, 0, &StaticBuffers.IndexHandle), label_VertexBuffer);
+    {
+        vulkan_memory_node *Node = Allocator->Nodes + NodeIndex;
+        vulkan_memory_block *Block = Allocator->Blocks + Node->BlockIndex;
+        ++Pool->AllocationCount;
+        Pool->UsedByteCount += Node->Size;
+
+        vulkan_allocation Allocation = {
+            .Memory = Block->Memory,
+            .Offset = Node->Offset,
+            .Size = Node->Size,
+            .Mapped = Block->Mapped? (Block->Mapped + Node->Offset) : 0,
+            .MemoryTypeIndex = MemoryTypeIndex,
+            .NodeIndex = NodeIndex,
+        };
+        *OutAllocation = Allocation;
+    }
+    return 0;
 
-        // NOTE(blackedout): Allocate and bind uniform memory with joined vertex and index requirements to the respective buffers 
-        VkMemoryRequirements VertexMemoryRequirements, IndexMemoryRequirements;
-        vkGetBufferMemoryRequirements(DeviceHandle, StaticBuffers.VertexHandle, &VertexMemoryRequirements);
-        vkGetBufferMemoryRequirements(DeviceHandle, StaticBuffers.IndexHandle, &IndexMemoryRequirements);
+label_Error:
+    return 1;
+}
+#endif
 
-        // TODO(blackedout): Handle non uniform device memory necessity
-        uint32_t BufferMemoryTypeIndex;
-        CheckGoto(VulkanGetBufferMemoryTypeIndex(Device, VertexMemoryRequirements.memoryTypeBits & IndexMemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &BufferMemoryTypeIndex), label_IndexBuffer);
-        
-        uint64_t VertexByteOffset = 0;
-        uint64_t IndexByteOffset = AlignAny(VertexMemoryRequirements.size, uint64_t, IndexMemoryRequirements.alignment);
-        uint64_t AlignedTotalBuffersByteCount = IndexByteOffset + IndexMemoryRequirements.size;
+static void VulkanCountAllocation(vulkan_memory_allocator *Allocator, vulkan_memory_subsystem Subsystem, vulkan_allocation *Allocation) {
+    Allocation->Subsystem = Subsystem;
+    Allocator->TypeCounters[Allocation->MemoryTypeIndex].ByteCount += Allocation->Size;
+    ++Allocator->TypeCounters[Allocation->MemoryTypeIndex].AllocationCount;
+    Allocator->SubsystemCounters[Subsystem].ByteCount += Allocation->Size;
+    ++Allocator->SubsystemCounters[Subsystem].AllocationCount;
+}
 
-        VkMemoryAllocateInfo MemoryAllocateInfo = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .pNext = 0,
-            .allocationSize = AlignedTotalBuffersByteCount,
-            .memoryTypeIndex = BufferMemoryTypeIndex
+static int VulkanAllocateResourceMemory(vulkan_surface_device *Device, VkBuffer Buffer, VkImage Image, VkMemoryPropertyFlags MemoryPropertyFlags, VkMemoryPropertyFlags PreferredPropertyFlags, vulkan_memory_subsystem Subsystem, vulkan_allocation *OutAllocation) {
+    // NOTE(blackedout): Allocates and binds memory for either the buffer or the (optimal tiling) image. Host visible memory is mapped if it
+    // was required or preferred.
+    vulkan_memory_allocator *Allocator = &Device->Memory;
+    vulkan_allocation Allocation;
+    SetZero(Allocation);
+#ifdef VULKAN_USE_VMA
+    {
+        VmaAllocationCreateInfo AllocationCreateInfo = {
+            .flags = ((MemoryPropertyFlags | PreferredPropertyFlags) & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0,
+            .usage = VMA_MEMORY_USAGE_UNKNOWN,
+            .requiredFlags = MemoryPropertyFlags,
+            .preferredFlags = PreferredPropertyFlags,
+            .memoryTypeBits = 0,
+            .pool = 0,
+            .pUserData = 0,
+            .priority = 0.0f
         };
-        VulkanCheckGoto(vkAllocateMemory(DeviceHandle, &MemoryAllocateInfo, 0, &StaticBuffers.MemoryBufs[0]), label_IndexBuffer);
-        ++StaticBuffers.MemoryCount;
-
-        VulkanCheckGoto(vkBindBufferMemory(DeviceHandle, StaticBuffers.VertexHandle, StaticBuffers.MemoryBufs[0], VertexByteOffset), label_BufferMemory);
-        VulkanCheckGoto(vkBindBufferMemory(DeviceHandle, StaticBuffers.IndexHandle, StaticBuffers.MemoryBufs[0], IndexByteOffset), label_BufferMemory);
+        VmaAllocationInfo AllocationInfo;
+        if(Buffer) {
+            VulkanCheckGoto(vmaAllocateMemoryForBuffer(Allocator->Vma, Buffer, &AllocationCreateInfo, &Allocation.VmaHandle, &AllocationInfo), label_Error);
+            VulkanCheckGoto(vmaBindBufferMemory(Allocator->Vma, Allocation.VmaHandle, Buffer), label_Allocation);
+        } else {
+            VulkanCheckGoto(vmaAllocateMemoryForImage(Allocator->Vma, Image, &AllocationCreateInfo, &Allocation.VmaHandle, &AllocationInfo), label_Error);
+            VulkanCheckGoto(vmaBindImageMemory(Allocator->Vma, Allocation.VmaHandle, Image), label_Allocation);
+        }
+        Allocation.Memory = AllocationInfo.deviceMemory;
+        Allocation.Offset = AllocationInfo.offset;
+        Allocation.Size = AllocationInfo.size;
+        Allocation.Mapped = (uint8_t *)AllocationInfo.pMappedData;
+        Allocation.MemoryTypeIndex = AllocationInfo.memoryType;
+    }
+#else
+    {
+        VkMemoryRequirements MemoryRequirements;
+        vulkan_resource_kind Kind = VULKAN_RESOURCE_KIND_LINEAR;
+        if(Buffer) {
+            vkGetBufferMemoryRequirements(Allocator->DeviceHandle, Buffer, &MemoryRequirements);
+        } else {
+            vkGetImageMemoryRequirements(Allocator->DeviceHandle, Image, &MemoryRequirements);
+            Kind = VULKAN_RESOURCE_KIND_OPTIMAL;
+        }
 
+        uint32_t MemoryTypeIndex;
+        CheckGoto(VulkanGetBufferMemoryTypeIndex(Device, MemoryRequirements.memoryTypeBits, MemoryPropertyFlags, PreferredPropertyFlags, &MemoryTypeIndex), label_Error);
+        if(VulkanAllocateFromPool(Allocator, MemoryRequirements, MemoryTypeIndex, Kind, &Allocation)) {
+            // NOTE(blackedout): The heap of the preferred type may be full, vma falls back the same way
+            uint32_t RequiredTypeIndex;
+            CheckGoto(VulkanGetBufferMemoryTypeIndex(Device, MemoryRequirements.memoryTypeBits, MemoryPropertyFlags, 0, &RequiredTypeIndex), label_Error);
+            AssertMessageGoto(RequiredTypeIndex != MemoryTypeIndex, label_Error, "Memory of type %d could not be allocated.\n", MemoryTypeIndex);
+            printfc(CODE_YELLOW, "Memory of type %d could not be allocated, falling back to type %d.\n", MemoryTypeIndex, RequiredTypeIndex);
+            CheckGoto(VulkanAllocateFromPool(Allocator, MemoryRequirements, RequiredTypeIndex, Kind, &Allocation), label_Error);
+        }
+        if(Buffer) {
+            VulkanCheckGoto(vkBindBufferMemory(Allocator->DeviceHandle, Buffer, Allocation.Memory, Allocation.Offset), label_Allocation);
+        } else {
+            VulkanCheckGoto(vkBindImageMemory(Allocator->DeviceHandle, Image, Allocation.Memory, Allocation.Offset), label_Allocation);
+        }
+    }
+#endif
+
+    VulkanCountAllocation(Allocator, Subsystem, &Allocation);
+    *OutAllocation = Allocation;
+    return 0;
+
+label_Allocation:
+#ifdef VULKAN_USE_VMA
+    vmaFreeMemory(Allocator->Vma, Allocation.VmaHandle);
+#else
+    VulkanFreeMemoryNode(Allocator, Allocation.NodeIndex);
+#endif
+label_Error:
+    return 1;
+}
+
+static int VulkanAllocateBufferMemory(vulkan_surface_device *Device, VkBuffer Buffer, VkMemoryPropertyFlags MemoryPropertyFlags, VkMemoryPropertyFlags PreferredPropertyFlags, vulkan_memory_subsystem Subsystem, vulkan_allocation *OutAllocation) {
+    return VulkanAllocateResourceMemory(Device, Buffer, VULKAN_NULL_HANDLE, MemoryPropertyFlags, PreferredPropertyFlags, Subsystem, OutAllocation);
+}
+
+static int VulkanAllocateImageMemory(vulkan_surface_device *Device, VkImage Image, VkMemoryPropertyFlags MemoryPropertyFlags, vulkan_memory_subsystem Subsystem, vulkan_allocation *OutAllocation) {
+    return VulkanAllocateResourceMemory(Device, VULKAN_NULL_HANDLE, Image, MemoryPropertyFlags, 0, Subsystem, OutAllocation);
+}
+
+static int VulkanAllocateAliasedMemory(vulkan_surface_device *Device, VkMemoryRequirements Requirements, VkMemoryPropertyFlags MemoryPropertyFlags, vulkan_memory_subsystem Subsystem, vulkan_allocation *OutAllocation) {
+    // NOTE(blackedout): Memory that isn't bound to anything yet, for buffers and images that are bound to parts of it themselves. They may
+    // be linear or optimal, so the allocation is padded to bufferImageGranularity to never share a page with neighbouring allocations.
+    vulkan_memory_allocator *Allocator = &Device->Memory;
+    vulkan_allocation Allocation;
+    SetZero(Allocation);
+    Requirements.alignment = Max(Requirements.alignment, Allocator->BufferImageGranularity);
+    Requirements.size = AlignAny(Requirements.size, VkDeviceSize, Requirements.alignment);
+#ifdef VULKAN_USE_VMA
+    {
+        VmaAllocationCreateInfo AllocationCreateInfo = {
+            .flags = 0,
+            .usage = VMA_MEMORY_USAGE_UNKNOWN,
+            .requiredFlags = MemoryPropertyFlags,
+            .preferredFlags = 0,
+            .memoryTypeBits = 0,
+            .pool = 0,
+            .pUserData = 0,
+            .priority = 0.0f
+        };
+        VmaAllocationInfo AllocationInfo;
+        VulkanCheckGoto(vmaAllocateMemory(Allocator->Vma, &Requirements, &AllocationCreateInfo, &Allocation.VmaHandle, &AllocationInfo), label_Error);
+        Allocation.Memory = AllocationInfo.deviceMemory;
+        Allocation.Offset = AllocationInfo.offset;
+        Allocation.Size = AllocationInfo.size;
+        Allocation.MemoryTypeIndex = AllocationInfo.memoryType;
+    }
+#else
+    {
+        uint32_t MemoryTypeIndex;
+        CheckGoto(VulkanGetBufferMemoryTypeIndex(Device, Requirements.memoryTypeBits, MemoryPropertyFlags, 0, &MemoryTypeIndex), label_Error);
+        CheckGoto(VulkanAllocateFromPool(Allocator, Requirements, MemoryTypeIndex, VULKAN_RESOURCE_KIND_OPTIMAL, &Allocation), label_Error);
+    }
+#endif
+
+    VulkanCountAllocation(Allocator, Subsystem, &Allocation);
+    *OutAllocation = Allocation;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void VulkanFreeAllocation(vulkan_surface_device *Device, vulkan_allocation *Allocation) {
+    // NOTE(blackedout): Ignores empty allocations, like the other destroy functions ignore null handles.
+    if(Allocation->Memory) {
+        vulkan_memory_allocator *Allocator = &Device->Memory;
+        Allocator->TypeCounters[Allocation->MemoryTypeIndex].ByteCount -= Allocation->Size;
+        --Allocator->TypeCounters[Allocation->MemoryTypeIndex].AllocationCount;
+        Allocator->SubsystemCounters[Allocation->Subsystem].ByteCount -= Allocation->Size;
+        --Allocator->SubsystemCounters[Allocation->Subsystem].AllocationCount;
+#ifdef VULKAN_USE_VMA
+        vmaFreeMemory(Device->Memory.Vma, Allocation->VmaHandle);
+#else
+        VulkanFreeMemoryNode(&Device->Memory, Allocation->NodeIndex);
+#endif
+    }
+    memset(Allocation, 0, sizeof(*Allocation));
+}
+
+static int VulkanIsAllocationHostCoherent(vulkan_surface_device *Device, vulkan_allocation *Allocation) {
+    // NOTE(blackedout): Host writes to these are visible to the device with the next submit, without flushing
+    VkMemoryPropertyFlags Flags = Device->Memory.Properties.memoryTypes[Allocation->MemoryTypeIndex].propertyFlags;
+    return Allocation->Mapped && (Flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+static VkMemoryPropertyFlags VulkanGetHostWritablePreferredFlags(vulkan_surface_device *Device) {
+    // NOTE(blackedout): Preferred flags for device local data that the host writes, if that doesn't compete for the small BAR window
+    return Device->Memory.HasHostVisibleDeviceLocalHeap? (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) : 0;
+}
+
+static vulkan_memory_counter VulkanGetMemoryHeapCounter(vulkan_memory_allocator *Allocator, uint32_t HeapIndex) {
+    vulkan_memory_counter Counter;
+    SetZero(Counter);
+    for(uint32_t I = 0; I < Allocator->Properties.memoryTypeCount; ++I) {
+        if(Allocator->Properties.memoryTypes[I].heapIndex == HeapIndex) {
+            Counter.ByteCount += Allocator->TypeCounters[I].ByteCount;
+            Counter.AllocationCount += Allocator->TypeCounters[I].AllocationCount;
+        }
+    }
+    return Counter;
+}
+
+static void VulkanPrintMemoryStats(vulkan_surface_device *Device) {
+    // NOTE(blackedout): Fragmentation is the part of the free bytes that is not in the largest free range, i.e. 0% if all free bytes
+    // could be used by a single allocation.
+    vulkan_memory_allocator *Allocator = &Device->Memory;
+#ifdef VULKAN_USE_VMA
+    VmaTotalStatistics Statistics;
+    vmaCalculateStatistics(Allocator->Vma, &Statistics);
+#endif
+    for(uint32_t TypeIndex = 0; TypeIndex < Allocator->Properties.memoryTypeCount; ++TypeIndex) {
+        uint32_t BlockCount = 0, AllocationCount = 0, FreeRangeCount = 0;
+        VkDeviceSize BlockByteCount = 0, UsedByteCount = 0, LargestFreeByteCount = 0;
+#ifdef VULKAN_USE_VMA
+        VmaDetailedStatistics TypeStatistics = Statistics.memoryType[TypeIndex];
+        BlockCount = TypeStatistics.statistics.blockCount;
+        AllocationCount = TypeStatistics.statistics.allocationCount;
+        BlockByteCount = TypeStatistics.statistics.blockBytes;
+        UsedByteCount = TypeStatistics.statistics.allocationBytes;
+        FreeRangeCount = TypeStatistics.unusedRangeCount;
+        LargestFreeByteCount = TypeStatistics.unusedRangeCount? TypeStatistics.unusedRangeSizeMax : 0;
+#else
+        for(uint32_t Kind = 0; Kind < VULKAN_RESOURCE_KIND_COUNT; ++Kind) {
+            vulkan_memory_pool *Pool = Allocator->Pools + TypeIndex*VULKAN_RESOURCE_KIND_COUNT + Kind;
+            BlockCount += Pool->BlockCount;
+            AllocationCount += Pool->AllocationCount;
+            BlockByteCount += Pool->BlockByteCount;
+            UsedByteCount += Pool->UsedByteCount;
+        }
+        for(uint32_t I = 0; I < Allocator->NodeCapacity; ++I) {
+            vulkan_memory_node *Node = Allocator->Nodes + I;
+            if(Node->Size > 0 && Node->IsFree && Allocator->Blocks[Node->BlockIndex].PoolIndex/VULKAN_RESOURCE_KIND_COUNT == TypeIndex) {
+                ++FreeRangeCount;
+                LargestFreeByteCount = Max(LargestFreeByteCount, Node->Size);
+            }
+        }
+#endif
+        if(BlockCount == 0) {
+            continue;
+        }
+        VkDeviceSize FreeByteCount = BlockByteCount - UsedByteCount;
+        double Fragmentation = FreeByteCount? (100.0*(1.0 - (double)LargestFreeByteCount/(double)FreeByteCount)) : 0.0;
+        printf("Memory type %d: %d blocks (%llu bytes), %d allocations (%llu bytes), %d free ranges (largest %llu bytes), %.2f%% fragmentation.\n",
+               TypeIndex, BlockCount, (unsigned long long)BlockByteCount, AllocationCount, (unsigned long long)UsedByteCount,
+               FreeRangeCount, (unsigned long long)LargestFreeByteCount, Fragmentation);
+    }
+    for(uint32_t HeapIndex = 0; HeapIndex < Allocator->Properties.memoryHeapCount; ++HeapIndex) {
+        vulkan_memory_counter HeapCounter = VulkanGetMemoryHeapCounter(Allocator, HeapIndex);
+        printf("Memory heap %d: %d allocations (%llu bytes), usage %llu of budget %llu bytes%s.\n", HeapIndex, HeapCounter.AllocationCount,
+               (unsigned long long)HeapCounter.ByteCount, (unsigned long long)Allocator->HeapUsages[HeapIndex], (unsigned long long)Allocator->HeapBudgets[HeapIndex],
+               (Allocator->HeapPressureBits & (1u << HeapIndex))? " (under pressure)" : "");
+    }
+    for(uint32_t I = 0; I < VULKAN_MEMORY_SUBSYSTEM_COUNT; ++I) {
+        printf("Memory subsystem %s: %d allocations (%llu bytes).\n", VULKAN_MEMORY_SUBSYSTEM_NAMES[I], Allocator->SubsystemCounters[I].AllocationCount,
+               (unsigned long long)Allocator->SubsystemCounters[I].ByteCount);
+    }
+    printf("Host visible device local heap: %s.\n", Allocator->HasHostVisibleDeviceLocalHeap? "true" : "false");
+}
+
+static int VulkanWriteMemoryStatsJson(vulkan_surface_device *Device, const char *Filepath) {
+    // NOTE(blackedout): Same numbers as VulkanPrintMemoryStats (without the free ranges), for tools and for comparing runs.
+    vulkan_memory_allocator *Allocator = &Device->Memory;
+    FILE *File = fopen(Filepath, "wb");
+    AssertMessageGoto(File, label_Error, "Failed to open '%s' for writing.\n", Filepath);
+
+    fprintf(File, "{\n  \"frame\": %u,\n  \"has_memory_budget\": %s,\n  \"has_host_visible_device_local_heap\": %s,\n  \"heaps\": [\n", Allocator->FrameIndex,
+            Allocator->HasMemoryBudget? "true" : "false", Allocator->HasHostVisibleDeviceLocalHeap? "true" : "false");
+    for(uint32_t I = 0; I < Allocator->Properties.memoryHeapCount; ++I) {
+        vulkan_memory_counter HeapCounter = VulkanGetMemoryHeapCounter(Allocator, I);
+        fprintf(File, "    { \"index\": %u, \"size\": %llu, \"device_local\": %s, \"usage\": %llu, \"budget\": %llu, \"under_pressure\": %s, \"allocation_count\": %u, \"allocation_bytes\": %llu }%s\n",
+                I, (unsigned long long)Allocator->Properties.memoryHeaps[I].size, (Allocator->Properties.memoryHeaps[I].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)? "true" : "false",
+                (unsigned long long)Allocator->HeapUsages[I], (unsigned long long)Allocator->HeapBudgets[I], (Allocator->HeapPressureBits & (1u << I))? "true" : "false",
+                HeapCounter.AllocationCount, (unsigned long long)HeapCounter.ByteCount, (I + 1 < Allocator->Properties.memoryHeapCount)? "," : "");
+    }
+    fprintf(File, "  ],\n  \"types\": [\n");
+    for(uint32_t I = 0; I < Allocator->Properties.memoryTypeCount; ++I) {
+        fprintf(File, "    { \"index\": %u, \"heap\": %u, \"property_flags\": %u, \"allocation_count\": %u, \"allocation_bytes\": %llu }%s\n",
+                I, Allocator->Properties.memoryTypes[I].heapIndex, Allocator->Properties.memoryTypes[I].propertyFlags, Allocator->TypeCounters[I].AllocationCount,
+                (unsigned long long)Allocator->TypeCounters[I].ByteCount, (I + 1 < Allocator->Properties.memoryTypeCount)? "," : "");
+    }
+    fprintf(File, "  ],\n  \"subsystems\": {\n");
+    for(uint32_t I = 0; I < VULKAN_MEMORY_SUBSYSTEM_COUNT; ++I) {
+        fprintf(File, "    \"%s\": { \"allocation_count\": %u, \"allocation_bytes\": %llu }%s\n", VULKAN_MEMORY_SUBSYSTEM_NAMES[I],
+                Allocator->SubsystemCounters[I].AllocationCount, (unsigned long long)Allocator->SubsystemCounters[I].ByteCount, (I + 1 < VULKAN_MEMORY_SUBSYSTEM_COUNT)? "," : "");
+    }
+    fprintf(File, "  }\n}\n");
+
+    int HasFailed = ferror(File);
+    fclose(File);
+    AssertMessageGoto(HasFailed == 0, label_Error, "Failed to write '%s'.\n", Filepath);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+// MARK: Memory Budget
+#ifndef VULKAN_USE_VMA
+static void VulkanTrimMemoryPools(vulkan_memory_allocator *Allocator, uint32_t HeapIndex) {
+    // NOTE(blackedout): Gives the empty blocks that the pools keep for reuse back to the device.
+    for(uint32_t I = 0; I < Allocator->NodeCapacity; ++I) {
+        vulkan_memory_node *Node = Allocator->Nodes + I;
+        if(Node->Size == 0 || Node->IsFree == 0) {
+            continue;
+        }
+        vulkan_memory_block *Block = Allocator->Blocks + Node->BlockIndex;
+        uint32_t MemoryTypeIndex = Block->PoolIndex/VULKAN_RESOURCE_KIND_COUNT;
+        if(Node->Size == Block->Size && Allocator->Properties.memoryTypes[MemoryTypeIndex].heapIndex == HeapIndex) {
+            VulkanDestroyMemoryBlock(Allocator, I);
+        }
+    }
+}
+#endif
+
+static void VulkanQueryMemoryBudget(vulkan_memory_allocator *Allocator) {
+    // NOTE(blackedout): Without VK_EXT_memory_budget, the usage is the device memory of this allocator and the budget is 80% of the heap,
+    // like vma estimates it. The driver's numbers also include memory that other processes took from the heap.
+#ifdef VULKAN_USE_VMA
+    VmaBudget Budgets[VK_MAX_MEMORY_HEAPS];
+    vmaSetCurrentFrameIndex(Allocator->Vma, Allocator->FrameIndex);
+    vmaGetHeapBudgets(Allocator->Vma, Budgets);
+    for(uint32_t I = 0; I < Allocator->Properties.memoryHeapCount; ++I) {
+        Allocator->HeapUsages[I] = Budgets[I].usage;
+        Allocator->HeapBudgets[I] = Budgets[I].budget;
+    }
+#else
+    if(Allocator->HasMemoryBudget) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT BudgetProperties;
+        SetZero(BudgetProperties);
+        BudgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 MemoryProperties;
+        SetZero(MemoryProperties);
+        MemoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        MemoryProperties.pNext = &BudgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(Allocator->PhysicalDevice, &MemoryProperties);
+        for(uint32_t I = 0; I < Allocator->Properties.memoryHeapCount; ++I) {
+            Allocator->HeapUsages[I] = BudgetProperties.heapUsage[I];
+            Allocator->HeapBudgets[I] = BudgetProperties.heapBudget[I];
+        }
+    } else {
+        for(uint32_t I = 0; I < Allocator->Properties.memoryHeapCount; ++I) {
+            Allocator->HeapUsages[I] = 0;
+            Allocator->HeapBudgets[I] = Allocator->Properties.memoryHeaps[I].size*8/10;
+        }
+        for(uint32_t I = 0; I < VK_MAX_MEMORY_TYPES*VULKAN_RESOURCE_KIND_COUNT; ++I) {
+            uint32_t HeapIndex = Allocator->Properties.memoryTypes[I/VULKAN_RESOURCE_KIND_COUNT].heapIndex;
+            Allocator->HeapUsages[HeapIndex] += Allocator->Pools[I].BlockByteCount;
+        }
+    }
+#endif
+}
+
+static void VulkanSetMemoryPressureProc(vulkan_surface_device *Device, vulkan_memory_pressure_proc Proc, void *Data) {
+    Device->Memory.PressureProc = Proc;
+    Device->Memory.PressureData = Data;
+}
+
+static void VulkanUpdateMemoryBudget(vulkan_surface_device *Device) {
+    // NOTE(blackedout): Polled once per frame. When a heap comes under pressure, a warning is printed once, the empty blocks are trimmed and
+    // the pressure proc may evict. It only leaves pressure below VULKAN_MEMORY_RELIEF_PERCENT, so that this doesn't repeat every frame.
+    vulkan_memory_allocator *Allocator = &Device->Memory;
+    ++Allocator->FrameIndex;
+    VulkanQueryMemoryBudget(Allocator);
+    for(uint32_t I = 0; I < Allocator->Properties.memoryHeapCount; ++I) {
+        VkDeviceSize Usage = Allocator->HeapUsages[I];
+        VkDeviceSize Budget = Allocator->HeapBudgets[I];
+        uint32_t HeapBit = 1u << I;
+        if((Allocator->HeapPressureBits & HeapBit) == 0 && 100*Usage > VULKAN_MEMORY_PRESSURE_PERCENT*Budget) {
+            Allocator->HeapPressureBits |= HeapBit;
+            printfc(CODE_YELLOW, "Memory heap %d is under pressure, usage %llu of budget %llu bytes.\n", I, (unsigned long long)Usage, (unsigned long long)Budget);
+#ifndef VULKAN_USE_VMA
+            VulkanTrimMemoryPools(Allocator, I);
+#endif
+            if(Allocator->PressureProc) {
+                Allocator->PressureProc(Allocator->PressureData, I, Usage, Budget);
+            }
+        } else if((Allocator->HeapPressureBits & HeapBit) && 100*Usage < VULKAN_MEMORY_RELIEF_PERCENT*Budget) {
+            Allocator->HeapPressureBits &= ~HeapBit;
+        }
+    }
+}
+
+// MARK: Buffers
+static void VulkanDestroyBuffer(vulkan_surface_device *Device, vulkan_buffer *Buffer) {
+    VkDevice DeviceHandle = Device->Handle;
+    vkDestroyBuffer(DeviceHandle, Buffer->Handle, 0);
+    VulkanFreeAllocation(Device, &Buffer->Allocation);
+    memset(Buffer, 0, sizeof(*Buffer));
+}
+
+static int VulkanCreateBufferWithMemory(vulkan_surface_device *Device, uint64_t ByteCount, VkBufferUsageFlags UsageFlags, int IsShared, VkMemoryPropertyFlags MemoryPropertyFlags, VkMemoryPropertyFlags PreferredPropertyFlags, vulkan_memory_subsystem Subsystem, vulkan_buffer *OutBuffer) {
+    // NOTE(blackedout): Shared buffers are concurrent between the graphics and the async compute queue family if the device has one
+    VkDevice DeviceHandle = Device->Handle;
+
+    vulkan_buffer Buffer;
+    SetZero(Buffer);
+    {
+        uint32_t QueueFamilyIndices[] = { Device->GraphicsQueueFamilyIndex, Device->ComputeQueueFamilyIndex };
+        IsShared = IsShared && Device->HasAsyncCompute;
+        VkBufferCreateInfo BufferCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .size = ByteCount,
+            .usage = UsageFlags,
+            .sharingMode = IsShared? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = IsShared? ArrayCount(QueueFamilyIndices) : 0,
+            .pQueueFamilyIndices = IsShared? QueueFamilyIndices : 0
+        };
+
+        VulkanCheckGoto(vkCreateBuffer(DeviceHandle, &BufferCreateInfo, 0, &Buffer.Handle), label_Error);
+        CheckGoto(VulkanAllocateBufferMemory(Device, Buffer.Handle, MemoryPropertyFlags, PreferredPropertyFlags, Subsystem, &Buffer.Allocation), label_Buffer);
+
+        *OutBuffer = Buffer;
+    }
+
+    return 0;
+    
+label_Buffer:
+    vkDestroyBuffer(DeviceHandle, Buffer.Handle, 0);
+    Buffer.Handle = 0;
+label_Error:
+    return 1;
+}
+
+static int VulkanCreateExclusiveBufferWithMemory(vulkan_surface_device *Device, uint64_t ByteCount, VkBufferUsageFlags UsageFlags, VkMemoryPropertyFlags MemoryPropertyFlags, VkMemoryPropertyFlags PreferredPropertyFlags, vulkan_memory_subsystem Subsystem, vulkan_buffer *OutBuffer) {
+    return VulkanCreateBufferWithMemory(Device, ByteCount, UsageFlags, 0, MemoryPropertyFlags, PreferredPropertyFlags, Subsystem, OutBuffer);
+}
+
+static int VulkanCreateSharedBufferWithMemory(vulkan_surface_device *Device, uint64_t ByteCount, VkBufferUsageFlags UsageFlags, VkMemoryPropertyFlags MemoryPropertyFlags, VkMemoryPropertyFlags PreferredPropertyFlags, vulkan_memory_subsystem Subsystem, vulkan_buffer *OutBuffer) {
+    return VulkanCreateBufferWithMemory(Device, ByteCount, UsageFlags, 1, MemoryPropertyFlags, PreferredPropertyFlags, Subsystem, OutBuffer);
+}
+
+static void VulkanDestroyImageWidthMemoryAndView(vulkan_surface_device *Device, VkImage *Image, vulkan_allocation *ImageAllocation, VkImageView *ImageView) {
+    VkDevice DeviceHandle = Device->Handle;
+    vkDestroyImageView(DeviceHandle, *ImageView, 0);
+    *ImageView = 0;
+    vkDestroyImage(DeviceHandle, *Image, 0);
+    VulkanFreeAllocation(Device, ImageAllocation);
+    *Image = 0;
+}
+
+static int VulkanCreateExclusiveImageWithMemoryAndView(vulkan_surface_device *Device, VkImageType Type, VkFormat Format, uint32_t Width, uint32_t Height, uint32_t Depth, VkSampleCountFlagBits SampleCount, VkImageUsageFlags Usage, VkMemoryPropertyFlags MemoryProperties, vulkan_memory_subsystem Subsystem, VkImageViewType ViewType, VkImageAspectFlags ViewAspect, VkImage *OutImage, vulkan_allocation *OutImageAllocation, VkImageView *OutImageView) {
+    VkDevice DeviceHandle = Device->Handle;
+
+    VkImage ImageHandle = 0;
+    vulkan_allocation Allocation;
+    SetZero(Allocation);
+    VkImageView ViewHandle = 0;
+    {
+        VkImageCreateInfo CreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .imageType = Type,
+            .format = Format,
+            .extent = {
+                .width = Width,
+                .height = Height,
+                .depth = Depth,
+            },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = SampleCount,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = Usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = 0,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+        
+        VulkanCheckGoto(vkCreateImage(DeviceHandle, &CreateInfo, 0, &ImageHandle), label_Error);
+        CheckGoto(VulkanAllocateImageMemory(Device, ImageHandle, MemoryProperties, Subsystem, &Allocation), label_Image);
+
+        VkImageViewCreateInfo ViewCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .image = ImageHandle,
+            .viewType = ViewType,
+            .format = Format,
+            .components = { .r = VK_COMPONENT_SWIZZLE_IDENTITY, .g = VK_COMPONENT_SWIZZLE_IDENTITY, .b = VK_COMPONENT_SWIZZLE_IDENTITY, .a = VK_COMPONENT_SWIZZLE_IDENTITY },
+            .subresourceRange = {
+                .aspectMask = ViewAspect,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        
+        VulkanCheckGoto(vkCreateImageView(DeviceHandle, &ViewCreateInfo, 0, &ViewHandle), label_Memory);
+
+        *OutImage = ImageHandle;
+        *OutImageAllocation = Allocation;
+        *OutImageView = ViewHandle;
+    }
+
+    return 0;
+
+label_Memory:
+    VulkanFreeAllocation(Device, &Allocation);
+label_Image:
+    vkDestroyImage(DeviceHandle, ImageHandle, 0);
+    ImageHandle = 0;
+label_Error:
+    return 1;
+}
+
+// MARK: Staging Fills
+// NOTE(blackedout): Host writes into mapped memory (staging buffers, or arenas written in place) are collected while the transfers are recorded
+// and done at once before submitting, split into pieces that the work pool copies in parallel. Recorded commands only read the memory after
+// submission, so the order doesn't matter. Staging memory is host coherent, so nothing needs to be flushed afterwards.
+static uint64_t VulkanGetStagingFillFreeByteCount(vulkan_staging_fills *Fills) {
+    return (VULKAN_STAGING_MAX_FILL_COUNT - Fills->Count)*VULKAN_STAGING_FILL_PIECE_BYTE_COUNT;
+}
+
+static void VulkanPushStagingFill(vulkan_staging_fills *Fills, uint8_t *Destination, const void *Source, uint64_t ByteCount) {
+    // NOTE(blackedout): ByteCount must not exceed VulkanGetStagingFillFreeByteCount
+    const uint8_t *SourceBytes = (const uint8_t *)Source;
+    for(uint64_t Offset = 0; Offset < ByteCount; Offset += VULKAN_STAGING_FILL_PIECE_BYTE_COUNT) {
+        vulkan_staging_fill *Fill = Fills->Fills + Fills->Count++;
+        Fill->Destination = Destination + Offset;
+        Fill->Source = SourceBytes + Offset;
+        Fill->ByteCount = Min(ByteCount - Offset, VULKAN_STAGING_FILL_PIECE_BYTE_COUNT);
+    }
+}
+
+static void VulkanStagingFillProc(void *Data, uint32_t Index) {
+    vulkan_staging_fill *Fill = (vulkan_staging_fill *)Data + Index;
+    memcpy(Fill->Destination, Fill->Source, Fill->ByteCount);
+}
+
+static void VulkanRunStagingFills(vulkan_staging_fills *Fills) {
+    if(Fills->Count > 0) {
+        WorkPoolRun(Fills->Workers, VulkanStagingFillProc, Fills->Fills, Fills->Count);
+    }
+    Fills->Count = 0;
+}
+
+// MARK: Static Images
+static uint32_t VulkanGetMipLevelCount(vulkan_surface_device *Device, VkFormat Format, uint32_t Width, uint32_t Height, uint32_t Depth) {
+    // NOTE(blackedout): Mip levels are generated by linearly filtered blits, so formats that don't support them only get the base level
+    VkFormatProperties FormatProperties;
+    vkGetPhysicalDeviceFormatProperties(Device->PhysicalDevice, Format, &FormatProperties);
+    VkFormatFeatureFlags RequiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if((FormatProperties.optimalTilingFeatures & RequiredFeatures) != RequiredFeatures) {
+        return 1;
+    }
+    uint32_t Size = Max(Width, Max(Height, Depth));
+    uint32_t Count = 1;
+    while(Size > 1) {
+        Size >>= 1;
+        ++Count;
+    }
+    return Count;
+}
+
+static void VulkanCmdGenerateMipLevels(VkCommandBuffer CommandBuffer, vulkan_image *Image, vulkan_image_description *Description) {
+    // NOTE(blackedout): Expects all levels in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL with level 0 written. Each level is blitted from the
+    // previous one, which is then transitioned for sampling. Leaves all levels in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+    VkImageMemoryBarrier Barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = 0,
+        .srcAccessMask = 0,
+        .dstAccessMask = 0,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = Image->Handle,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .baseMipLevel = 0,
+            .levelCount = 1,
+            .baseArrayLayer = 0,
+            .layerCount = 1,
+        }
+    };
+    int32_t Width = (int32_t)Description->Width, Height = (int32_t)Description->Height, Depth = (int32_t)Description->Depth;
+    for(uint32_t Level = 1; Level < Image->MipLevelCount; ++Level) {
+        Barrier.subresourceRange.baseMipLevel = Level - 1;
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &Barrier);
+
+        int32_t NextWidth = Max(Width/2, 1), NextHeight = Max(Height/2, 1), NextDepth = Max(Depth/2, 1);
+        VkImageBlit Blit = {
+            .srcSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = Level - 1, .baseArrayLayer = 0, .layerCount = 1 },
+            .srcOffsets = { { 0, 0, 0 }, { Width, Height, Depth } },
+            .dstSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = Level, .baseArrayLayer = 0, .layerCount = 1 },
+            .dstOffsets = { { 0, 0, 0 }, { NextWidth, NextHeight, NextDepth } },
+        };
+        vkCmdBlitImage(CommandBuffer, Image->Handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Image->Handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Blit, VK_FILTER_LINEAR);
+
+        Barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &Barrier);
+
+        Width = NextWidth;
+        Height = NextHeight;
+        Depth = NextDepth;
+    }
+
+    // NOTE(blackedout): The last level was only written
+    Barrier.subresourceRange.baseMipLevel = Image->MipLevelCount - 1;
+    Barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &Barrier);
+}
+
+static void VulkanCmdBeginStaticImageUploads(VkCommandBuffer CommandBuffer, vulkan_image *Images, uint32_t ImageCount) {
+    // TODO(blackedout): Get a better understanding of access synchronization
+    // https://www.cg.tuwien.ac.at/courses/EinfCG/slides/VulkanLectureSeries/ECG2021_VK05_PipelinesAndStages.pdf
+    // https://themaister.net/blog/2019/08/14/yet-another-blog-explaining-vulkan-synchronization/
+    for(uint32_t I = 0; I < ImageCount; ++I) {
+        VkImageMemoryBarrier ImageMemoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = 0,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = Images[I].Handle,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = Images[I].MipLevelCount,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            }
+        };
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &ImageMemoryBarrier);
+    }
+}
+
+static void VulkanCmdEndStaticImageUploads(VkCommandBuffer CommandBuffer, vulkan_image_description *ImageDescriptions, vulkan_image *Images, uint32_t ImageCount) {
+    // NOTE(blackedout): Barriers also cover the copies of earlier submissions to the same queue
+    for(uint32_t I = 0; I < ImageCount; ++I) {
+        if(ImageDescriptions[I].LevelCount == 0) {
+            VulkanCmdGenerateMipLevels(CommandBuffer, Images + I, ImageDescriptions + I);
+            continue;
+        }
+        VkImageMemoryBarrier ImageMemoryBarrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = 0,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = Images[I].Handle,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = Images[I].MipLevelCount,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            }
+        };
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &ImageMemoryBarrier);
+    }
+}
+
+static int VulkanBeginStagingSlot(VkDevice DeviceHandle, VkCommandBuffer CommandBuffer, VkFence Fence) {
+    // NOTE(blackedout): Waits until the previous copies from the slot have finished, so that it can be refilled
+    VulkanCheckGoto(vkWaitForFences(DeviceHandle, 1, &Fence, VK_TRUE, UINT64_MAX), label_Error);
+    {
+        VkCommandBufferBeginInfo BeginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .pNext = 0,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = 0
+        };
+        VulkanCheckGoto(vkBeginCommandBuffer(CommandBuffer, &BeginInfo), label_Error);
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int VulkanSubmitStagingSlot(VkDevice DeviceHandle, VkQueue Queue, VkCommandBuffer CommandBuffer, VkFence Fence) {
+    VulkanCheckGoto(vkEndCommandBuffer(CommandBuffer), label_Error);
+    VulkanCheckGoto(vkResetFences(DeviceHandle, 1, &Fence), label_Error);
+    {
+        VkSubmitInfo SubmitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = 0,
+            .waitSemaphoreCount = 0,
+            .pWaitSemaphores = 0,
+            .pWaitDstStageMask = 0,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &CommandBuffer,
+            .signalSemaphoreCount = 0,
+            .pSignalSemaphores = 0
+        };
+        VulkanCheckGoto(vkQueueSubmit(Queue, 1, &SubmitInfo, Fence), label_Error);
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void VulkanDestroyStaticImages(vulkan_surface_device *Device, vulkan_image *Images, uint32_t ImageCount) {
+    VkDevice DeviceHandle = Device->Handle;
+
+    for(uint32_t I = 0; I < ImageCount; ++I) {
+        vkDestroyImageView(DeviceHandle, Images[I].ViewHandle, 0);
+        vkDestroyImage(DeviceHandle, Images[I].Handle, 0);
+        VulkanFreeAllocation(Device, &Images[I].Allocation);
+    }
+
+    memset(Images, 0, sizeof(*Images)*ImageCount);
+}
+
+static int VulkanCreateStaticImages(vulkan_surface_device *Device, vulkan_image_description *ImageDescriptions, uint32_t ImageCount, VkCommandPool TransferCommandPool, VkQueue TransferQueue, work_pool *Workers, vulkan_image *OutImages) {
+    // NOTE(blackedout): Meshes aren't static anymore, they are uploaded through the mesh registry.
+    VkDevice DeviceHandle = Device->Handle;
+
+    vulkan_buffer StagingBuffer = {0};
+    uint32_t CreatedImageCount = 0;
+    uint32_t CreatedImageViewCount = 0;
+    VkCommandBuffer TransferCommandBuffers[VULKAN_IMAGE_STAGING_SLOT_COUNT] = {0};
+    VkFence TransferFences[VULKAN_IMAGE_STAGING_SLOT_COUNT] = {0};
+    {
         // NOTE(blackedout): Create image handles, allocate and bind its memory, then create view handles
         uint64_t AlignedTotalImagesByteCount = 0;
-        uint64_t FirstImageAlignment = 0;
-        uint32_t ImageMemoryTypeBits = ~(uint32_t)0;
         for(uint32_t I = 0; I < ImageCount; ++I) {
-            vulkan_image_description ImageDescription = ImageDescriptions[I];
-            VkImageCreateInfo ImageCreateInfo = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            vulkan_image_description ImageDescription = ImageDescriptions[I];
+            SetZero(OutImages[I].Allocation);
+            OutImages[I].MipLevelCount = ImageDescription.LevelCount;
+            if(ImageDescription.LevelCount == 0) {
+                OutImages[I].MipLevelCount = VulkanGetMipLevelCount(Device, ImageDescription.Format, ImageDescription.Width, ImageDescription.Height, ImageDescription.Depth);
+            }
+            VkImageCreateInfo ImageCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .pNext = 0,
+                .flags = 0,
+                .imageType = ImageDescription.Type,
+                .format = ImageDescription.Format,
+                .extent = {
+                    .width = ImageDescription.Width,
+                    .height = ImageDescription.Height,
+                    .depth = ImageDescription.Depth
+                },
+                .mipLevels = OutImages[I].MipLevelCount,
+                .arrayLayers = 1,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .tiling = VK_IMAGE_TILING_OPTIMAL,
+                .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                .queueFamilyIndexCount = 0,
+                .pQueueFamilyIndices = 0,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+            };
+            
+            VulkanCheckGoto(vkCreateImage(DeviceHandle, &ImageCreateInfo, 0, &OutImages[I].Handle), label_Images);
+            ++CreatedImageCount;
+            CheckGoto(VulkanAllocateImageMemory(Device, OutImages[I].Handle, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_SUBSYSTEM_TEXTURES, &OutImages[I].Allocation), label_Images);
+
+            VkMemoryRequirements ImageMemoryRequirements;
+            vkGetImageMemoryRequirements(DeviceHandle, OutImages[I].Handle, &ImageMemoryRequirements);
+            AlignedTotalImagesByteCount += ImageMemoryRequirements.size;
+        }
+        // NOTE(blackedout): A full chain costs a third more memory than the base level, but minified sampling then reads about one texel
+        // per pixel from a level that fits the cache instead of skipping across the base level.
+
+        for(uint32_t I = 0; I < ImageCount; ++I) {
+            vulkan_image_description ImageDescription = ImageDescriptions[I];
+            VkImageViewCreateInfo ImageViewCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .pNext = 0,
+                .flags = 0,
+                .image = OutImages[I].Handle,
+                .viewType = ImageDescription.ViewType,
+                .format = ImageDescription.Format,
+                .components = { .r = VK_COMPONENT_SWIZZLE_IDENTITY, .g = VK_COMPONENT_SWIZZLE_IDENTITY, .b = VK_COMPONENT_SWIZZLE_IDENTITY, .a = VK_COMPONENT_SWIZZLE_IDENTITY },
+                .subresourceRange = {
+                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = OutImages[I].MipLevelCount,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                }
+            };
+
+            VulkanCheckGoto(vkCreateImageView(DeviceHandle, &ImageViewCreateInfo, 0, &OutImages[I].ViewHandle), label_ImageViews);
+            ++CreatedImageViewCount;
+        }
+
+        // NOTE(blackedout): Image data is uploaded in chunks of whole rows of texel blocks through a staging buffer of fixed size, so that
+        // the host visible memory doesn't grow with the images. The buffer is split into slots, one is filled while the copies of the others
+        // execute. Data is staged packed instead of at the image memory offsets, because sources may also contain prebuilt levels or headers.
+        // The chunks of a slot are filled by the work pool right before it is submitted.
+        CheckGoto(VulkanCreateExclusiveBufferWithMemory(Device, VULKAN_IMAGE_STAGING_SLOT_COUNT*VULKAN_IMAGE_STAGING_SLOT_BYTE_COUNT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, VULKAN_MEMORY_SUBSYSTEM_STAGING, &StagingBuffer), label_ImageViews);
+
+        VkCommandBufferAllocateInfo TransferCommandBufferAllocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = 0,
+            .commandPool = TransferCommandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = VULKAN_IMAGE_STAGING_SLOT_COUNT,
+        };
+        VulkanCheckGoto(vkAllocateCommandBuffers(DeviceHandle, &TransferCommandBufferAllocateInfo, TransferCommandBuffers), label_StagingBuffer);
+
+        // NOTE(blackedout): Signaled, so that waiting for a slot that was never submitted returns right away
+        VkFenceCreateInfo FenceCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext = 0,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT
+        };
+        for(uint32_t Slot = 0; Slot < VULKAN_IMAGE_STAGING_SLOT_COUNT; ++Slot) {
+            VulkanCheckGoto(vkCreateFence(DeviceHandle, &FenceCreateInfo, 0, TransferFences + Slot), label_Fences);
+        }
+
+        vulkan_staging_fills Fills;
+        Fills.Workers = Workers;
+        Fills.Count = 0;
+        uint32_t Slot = 0;
+        int IsRecording = 0;
+        uint64_t SlotOffset = 0;
+        uint64_t UploadedByteCount = 0;
+        uint32_t SubmitCount = 0;
+        for(uint32_t I = 0; I < ImageCount; ++I) {
+            vulkan_image_description *ImageDescription = ImageDescriptions + I;
+            uint32_t BlockWidth = Max(ImageDescription->BlockWidth, 1), BlockHeight = Max(ImageDescription->BlockHeight, 1);
+            uint64_t BlockByteCount = ImageDescription->BlockByteCount;
+            if(BlockByteCount == 0) {
+                BlockByteCount = ImageDescription->ByteCount/((uint64_t)ImageDescription->Width*ImageDescription->Height*ImageDescription->Depth);
+            }
+            uint32_t CopyCount = Max(ImageDescription->LevelCount, 1);
+            for(uint32_t Level = 0; Level < CopyCount; ++Level) {
+                uint32_t Width = Max(ImageDescription->Width >> Level, 1), Height = Max(ImageDescription->Height >> Level, 1), Depth = Max(ImageDescription->Depth >> Level, 1);
+                uint32_t RowCount = (Height + BlockHeight - 1)/BlockHeight; // NOTE(blackedout): Per depth slice
+                uint64_t RowByteCount = (uint64_t)((Width + BlockWidth - 1)/BlockWidth)*BlockByteCount;
+                AssertMessageGoto(RowByteCount <= VULKAN_IMAGE_STAGING_SLOT_BYTE_COUNT, label_Upload, "Rows of image %d don't fit into a staging slot.\n", I);
+                const uint8_t *LevelSource = (const uint8_t *)ImageDescription->Source + ImageDescription->LevelOffsets[Level];
+
+                for(uint32_t Z = 0; Z < Depth; ++Z) {
+                    uint32_t Row = 0;
+                    while(Row < RowCount) {
+                        if(IsRecording == 0) {
+                            CheckGoto(VulkanBeginStagingSlot(DeviceHandle, TransferCommandBuffers[Slot], TransferFences[Slot]), label_Upload);
+                            if(SubmitCount == 0) {
+                                VulkanCmdBeginStaticImageUploads(TransferCommandBuffers[Slot], OutImages, ImageCount);
+                            }
+                            IsRecording = 1;
+                            SlotOffset = 0;
+                        }
+
+                        SlotOffset = AlignAny(SlotOffset, uint64_t, VULKAN_STAGING_IMAGE_ALIGNMENT);
+                        uint64_t FreeByteCount = (SlotOffset < VULKAN_IMAGE_STAGING_SLOT_BYTE_COUNT)? (VULKAN_IMAGE_STAGING_SLOT_BYTE_COUNT - SlotOffset) : 0;
+                        FreeByteCount = Min(FreeByteCount, VulkanGetStagingFillFreeByteCount(&Fills));
+                        uint64_t FittingRowCount = FreeByteCount/RowByteCount;
+                        uint32_t ChunkRowCount = (uint32_t)Min((uint64_t)(RowCount - Row), FittingRowCount);
+                        if(ChunkRowCount == 0) {
+                            VulkanRunStagingFills(&Fills);
+                            CheckGoto(VulkanSubmitStagingSlot(DeviceHandle, TransferQueue, TransferCommandBuffers[Slot], TransferFences[Slot]), label_Upload);
+                            ++SubmitCount;
+                            IsRecording = 0;
+                            Slot = (Slot + 1) % VULKAN_IMAGE_STAGING_SLOT_COUNT;
+                            continue;
+                        }
+
+                        uint64_t ChunkByteCount = ChunkRowCount*RowByteCount;
+                        uint64_t StagingOffset = Slot*VULKAN_IMAGE_STAGING_SLOT_BYTE_COUNT + SlotOffset;
+                        VulkanPushStagingFill(&Fills, StagingBuffer.Allocation.Mapped + StagingOffset, LevelSource + ((uint64_t)Z*RowCount + Row)*RowByteCount, ChunkByteCount);
+                        uint32_t ChunkEnd = Min((Row + ChunkRowCount)*BlockHeight, Height);
+                        VkBufferImageCopy BufferImageCopy = {
+                            .bufferOffset = StagingOffset,
+                            .bufferRowLength = 0,
+                            .bufferImageHeight = 0,
+                            .imageSubresource = {
+                                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                .mipLevel = Level,
+                                .baseArrayLayer = 0,
+                                .layerCount = 1,
+                            },
+                            .imageOffset = { 0, (int32_t)(Row*BlockHeight), (int32_t)Z },
+                            .imageExtent = { Width, ChunkEnd - Row*BlockHeight, 1 }
+                        };
+                        vkCmdCopyBufferToImage(TransferCommandBuffers[Slot], StagingBuffer.Handle, OutImages[I].Handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &BufferImageCopy);
+                        SlotOffset += ChunkByteCount;
+                        UploadedByteCount += ChunkByteCount;
+                        Row += ChunkRowCount;
+                    }
+                }
+            }
+        }
+
+        // NOTE(blackedout): Missing mip chains are generated on the device after the last chunk, so only stored levels go through the
+        // staging buffer
+        if(IsRecording == 0) {
+            CheckGoto(VulkanBeginStagingSlot(DeviceHandle, TransferCommandBuffers[Slot], TransferFences[Slot]), label_Upload);
+            if(SubmitCount == 0) {
+                VulkanCmdBeginStaticImageUploads(TransferCommandBuffers[Slot], OutImages, ImageCount);
+            }
+        }
+        VulkanCmdEndStaticImageUploads(TransferCommandBuffers[Slot], ImageDescriptions, OutImages, ImageCount);
+        VulkanRunStagingFills(&Fills);
+        CheckGoto(VulkanSubmitStagingSlot(DeviceHandle, TransferQueue, TransferCommandBuffers[Slot], TransferFences[Slot]), label_Upload);
+        ++SubmitCount;
+        VulkanCheckGoto(vkWaitForFences(DeviceHandle, VULKAN_IMAGE_STAGING_SLOT_COUNT, TransferFences, VK_TRUE, UINT64_MAX), label_Upload);
+        printf("Static images: %llu bytes with mip chains, %llu bytes uploaded in %u submits.\n", (unsigned long long)AlignedTotalImagesByteCount,
+               (unsigned long long)UploadedByteCount, SubmitCount);
+
+        for(uint32_t FenceIndex = 0; FenceIndex < VULKAN_IMAGE_STAGING_SLOT_COUNT; ++FenceIndex) {
+            vkDestroyFence(DeviceHandle, TransferFences[FenceIndex], 0);
+        }
+        vkFreeCommandBuffers(DeviceHandle, TransferCommandPool, VULKAN_IMAGE_STAGING_SLOT_COUNT, TransferCommandBuffers);
+        VulkanDestroyBuffer(Device, &StagingBuffer);
+    }
+
+    return 0;
+
+label_Upload:
+    // NOTE(blackedout): Fences of slots that failed to submit are never signaled
+    vkQueueWaitIdle(TransferQueue);
+label_Fences:
+    for(uint32_t Slot = 0; Slot < VULKAN_IMAGE_STAGING_SLOT_COUNT; ++Slot) {
+        vkDestroyFence(DeviceHandle, TransferFences[Slot], 0);
+    }
+    vkFreeCommandBuffers(DeviceHandle, TransferCommandPool, VULKAN_IMAGE_STAGING_SLOT_COUNT, TransferCommandBuffers);
+label_StagingBuffer:
+    VulkanDestroyBuffer(Device, &StagingBuffer);
+label_ImageViews:
+    for(uint32_t I = 0; I < CreatedImageViewCount; ++I) {
+        vkDestroyImageView(DeviceHandle, OutImages[I].ViewHandle, 0);
+        OutImages[I].ViewHandle = 0;
+    }
+label_Images:
+    for(uint32_t I = 0; I < CreatedImageCount; ++I) {
+        vkDestroyImage(DeviceHandle, OutImages[I].Handle, 0);
+        OutImages[I].Handle = 0;
+        VulkanFreeAllocation(Device, &OutImages[I].Allocation);
+    }
+    return 1;
+}
+
+// MARK: Mesh Registry
+// NOTE(blackedout): Meshes are sub-allocated from one vertex, one index and one storage arena, so that they can be added and removed at
+// runtime without rebuilding buffers. Adding a mesh only queues it. The next VulkanUpdateMeshRegistry places it and records its upload into
+// the command buffers of the following frames, so there is no wait on the queue. Uploads are split into chunks of at most
+// VULKAN_MESH_UPLOAD_BYTE_COUNT per frame, which keeps the staging memory constant however large the meshes are. A mesh is resident once its
+// last chunk is recorded (the sources have to stay valid until then). Offsets are written to the
+// offset pointers of the mesh's subbufs when it is placed and again when the defragmenter moves it. Arena buffers change when an arena grows.
+// Ranges that are given up are retired until the frames that may still read them have finished, so that they can also be written by the
+// host: arenas in host visible device memory (resizable BAR or unified memory) are written in place instead of through a staging buffer.
+static vulkan_subbuf *VulkanGetMeshSubbufPart(vulkan_mesh_subbuf *Subbuf, vulkan_mesh_arena_kind Kind, uint64_t *OutAlignment) {
+    switch(Kind) {
+    case VULKAN_MESH_ARENA_VERTICES:
+        *OutAlignment = VULKAN_MESH_VERTEX_ALIGNMENT;
+        return &Subbuf->Vertices;
+    case VULKAN_MESH_ARENA_INDICES:
+        *OutAlignment = VulkanIndexTypeByteCount(Subbuf->IndexType);
+        return &Subbuf->Indices;
+    default:
+        // NOTE(blackedout): Storage subbuffers are aligned to their stride, so that shaders can index them as arrays of one element type
+        *OutAlignment = Max(Subbuf->StorageStride, 1);
+        return &Subbuf->Storage;
+    }
+}
+
+static int VulkanAllocateArenaRange(vulkan_mesh_arena *Arena, uint64_t ByteCount, uint64_t Alignment, uint64_t *OutOffset) {
+    // NOTE(blackedout): First fit, the parts of the free range in front of and behind the allocation stay free.
+    for(uint32_t I = 0; I < Arena->FreeRangeCount; ++I) {
+        vulkan_arena_range *Range = Arena->FreeRanges + I;
+        uint64_t Offset = AlignAny(Range->Offset, uint64_t, Alignment);
+        uint64_t End = Range->Offset + Range->ByteCount;
+        if(Offset + ByteCount > End) {
+            continue;
+        }
+        uint64_t FrontByteCount = Offset - Range->Offset;
+        uint64_t BackByteCount = End - (Offset + ByteCount);
+        if(FrontByteCount > 0 && BackByteCount > 0) {
+            if(Arena->FreeRangeCount == VULKAN_MESH_ARENA_MAX_FREE_RANGE_COUNT) {
+                continue;
+            }
+            memmove(Arena->FreeRanges + I + 2, Arena->FreeRanges + I + 1, (Arena->FreeRangeCount - I - 1)*sizeof(*Arena->FreeRanges));
+            ++Arena->FreeRangeCount;
+            Arena->FreeRanges[I + 1].Offset = Offset + ByteCount;
+            Arena->FreeRanges[I + 1].ByteCount = BackByteCount;
+            Range->ByteCount = FrontByteCount;
+            Arena->IsCompact = 0;
+        } else if(FrontByteCount > 0) {
+            Range->ByteCount = FrontByteCount;
+            Arena->IsCompact = 0;
+        } else if(BackByteCount > 0) {
+            Range->Offset = Offset + ByteCount;
+            Range->ByteCount = BackByteCount;
+        } else {
+            memmove(Arena->FreeRanges + I, Arena->FreeRanges + I + 1, (Arena->FreeRangeCount - I - 1)*sizeof(*Arena->FreeRanges));
+            --Arena->FreeRangeCount;
+        }
+        *OutOffset = Offset;
+        return 0;
+    }
+    return 1;
+}
+
+static int VulkanFreeArenaRange(vulkan_mesh_arena *Arena, uint64_t Offset, uint64_t ByteCount) {
+    Arena->IsCompact = 0;
+    uint32_t I = 0;
+    while(I < Arena->FreeRangeCount && Arena->FreeRanges[I].Offset < Offset) {
+        ++I;
+    }
+    vulkan_arena_range *Prev = (I > 0)? (Arena->FreeRanges + I - 1) : 0;
+    vulkan_arena_range *Next = (I < Arena->FreeRangeCount)? (Arena->FreeRanges + I) : 0;
+    int MergesPrev = Prev && Prev->Offset + Prev->ByteCount == Offset;
+    int MergesNext = Next && Offset + ByteCount == Next->Offset;
+    if(MergesPrev && MergesNext) {
+        Prev->ByteCount += ByteCount + Next->ByteCount;
+        memmove(Arena->FreeRanges + I, Arena->FreeRanges + I + 1, (Arena->FreeRangeCount - I - 1)*sizeof(*Arena->FreeRanges));
+        --Arena->FreeRangeCount;
+    } else if(MergesPrev) {
+        Prev->ByteCount += ByteCount;
+    } else if(MergesNext) {
+        Next->Offset = Offset;
+        Next->ByteCount += ByteCount;
+    } else {
+        AssertMessageGoto(Arena->FreeRangeCount < VULKAN_MESH_ARENA_MAX_FREE_RANGE_COUNT, label_Error, "Too many free ranges in mesh arena, %llu bytes are lost.\n", (unsigned long long)ByteCount);
+        memmove(Arena->FreeRanges + I + 1, Arena->FreeRanges + I, (Arena->FreeRangeCount - I)*sizeof(*Arena->FreeRanges));
+        ++Arena->FreeRangeCount;
+        Arena->FreeRanges[I].Offset = Offset;
+        Arena->FreeRanges[I].ByteCount = ByteCount;
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static uint64_t VulkanGetArenaTailByteCount(vulkan_mesh_arena *Arena) {
+    // NOTE(blackedout): Size of the free range at the end of the arena
+    if(Arena->FreeRangeCount == 0) {
+        return 0;
+    }
+    vulkan_arena_range *Last = Arena->FreeRanges + Arena->FreeRangeCount - 1;
+    return (Last->Offset + Last->ByteCount == Arena->ByteCount)? Last->ByteCount : 0;
+}
+
+static void VulkanDestroyMeshRegistry(vulkan_surface_device *Device, vulkan_mesh_registry *Registry) {
+    for(uint32_t I = 0; I < MAX_ACQUIRED_IMAGE_COUNT; ++I) {
+        for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+            VulkanDestroyBuffer(Device, &Registry->RetiredBuffers[I][Kind]);
+        }
+        VulkanDestroyBuffer(Device, Registry->StagingBuffers + I);
+    }
+    for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+        VulkanDestroyBuffer(Device, &Registry->Arenas[Kind].Buffer);
+    }
+    free(Registry->Entries);
+    free(Registry->RetiredRanges);
+    memset(Registry, 0, sizeof(*Registry));
+}
+
+static int VulkanCreateMeshRegistry(vulkan_surface_device *Device, work_pool *Workers, vulkan_mesh_registry *Registry) {
+    // NOTE(blackedout): The registry is large, so it is initialized in place.
+    memset(Registry, 0, sizeof(*Registry));
+    Registry->Workers = Workers;
+    {
+        Registry->Entries = (vulkan_mesh_entry *)malloc(VULKAN_MESH_REGISTRY_MAX_MESH_COUNT*sizeof(vulkan_mesh_entry));
+        AssertMessageGoto(Registry->Entries, label_Error, "Mesh entries could not be allocated.\n");
+        memset(Registry->Entries, 0, VULKAN_MESH_REGISTRY_MAX_MESH_COUNT*sizeof(vulkan_mesh_entry));
+        for(uint32_t I = 0; I < VULKAN_MESH_REGISTRY_MAX_MESH_COUNT; ++I) {
+            Registry->Entries[I].NextUnused = I + 1;
+            Registry->Entries[I].Generation = 1;
+        }
+        Registry->UnusedEntry = 0;
+
+        uint64_t RetiredByteCount = MAX_ACQUIRED_IMAGE_COUNT*VULKAN_MESH_REGISTRY_MAX_RETIRED_RANGE_COUNT*sizeof(vulkan_retired_range);
+        Registry->RetiredRanges = (vulkan_retired_range *)malloc(RetiredByteCount);
+        AssertMessageGoto(Registry->RetiredRanges, label_Registry, "Retired mesh ranges could not be allocated.\n");
+        Registry->DefragByteBudget = VULKAN_MESH_DEFRAG_BYTE_BUDGET;
+
+        // NOTE(blackedout): Arenas are also copy sources, for growing and defragmenting them
+        VkBufferUsageFlags ArenaUsages[VULKAN_MESH_ARENA_COUNT] = {
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        };
+        for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+            vulkan_mesh_arena *Arena = Registry->Arenas + Kind;
+            Arena->Usage = ArenaUsages[Kind] | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            Arena->ByteCount = VULKAN_MESH_ARENA_MIN_BYTE_COUNT;
+            Arena->FreeRangeCount = 1;
+            Arena->FreeRanges[0].Offset = 0;
+            Arena->FreeRanges[0].ByteCount = Arena->ByteCount;
+            Arena->IsCompact = 1;
+            CheckGoto(VulkanCreateExclusiveBufferWithMemory(Device, Arena->ByteCount, Arena->Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VulkanGetHostWritablePreferredFlags(Device), VULKAN_MEMORY_SUBSYSTEM_STATIC_MESHES, &Arena->Buffer), label_Registry);
+        }
+    }
+
+    return 0;
+
+label_Registry:
+    VulkanDestroyMeshRegistry(Device, Registry);
+label_Error:
+    return 1;
+}
+
+static vulkan_mesh_entry *VulkanGetMeshEntry(vulkan_mesh_registry *Registry, vulkan_mesh_handle Handle) {
+    // NOTE(blackedout): Returns 0 for handles of removed meshes.
+    uint32_t Index = Handle & 0xffff;
+    if(Handle == 0 || Index >= VULKAN_MESH_REGISTRY_MAX_MESH_COUNT) {
+        return 0;
+    }
+    vulkan_mesh_entry *Entry = Registry->Entries + Index;
+    if(Entry->State == VULKAN_MESH_STATE_UNUSED || Entry->Generation != (Handle >> 16)) {
+        return 0;
+    }
+    return Entry;
+}
+
+static int VulkanIsMeshResident(vulkan_mesh_registry *Registry, vulkan_mesh_handle Handle) {
+    vulkan_mesh_entry *Entry = VulkanGetMeshEntry(Registry, Handle);
+    return Entry && Entry->State == VULKAN_MESH_STATE_RESIDENT;
+}
+
+static int VulkanAddMesh(vulkan_mesh_registry *Registry, vulkan_mesh_subbuf Subbuf, vulkan_mesh_handle *OutHandle) {
+    AssertMessageGoto(Registry->UnusedEntry < VULKAN_MESH_REGISTRY_MAX_MESH_COUNT, label_Error, "Too many meshes (%d).\n", VULKAN_MESH_REGISTRY_MAX_MESH_COUNT);
+    {
+        uint32_t Index = Registry->UnusedEntry;
+        vulkan_mesh_entry *Entry = Registry->Entries + Index;
+        Registry->UnusedEntry = Entry->NextUnused;
+        Entry->Subbuf = Subbuf;
+        SetZero(Entry->Ranges);
+        SetZero(Entry->UploadedByteCounts);
+        Entry->State = VULKAN_MESH_STATE_PENDING;
+        Registry->PendingEntries[Registry->PendingCount++] = Index;
+        ++Registry->MeshCount;
+        *OutHandle = (Entry->Generation << 16) | Index;
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void VulkanRetireArenaRange(vulkan_mesh_registry *Registry, vulkan_mesh_arena_kind Kind, vulkan_arena_range Range, int IsMoved) {
+    // NOTE(blackedout): The range is freed by the next VulkanUpdateMeshRegistry of the recording data index. All frames that may read it have
+    // been recorded by then and they finish no later than the frame of that data index.
+    uint32_t DataIndex = Registry->RecordingDataIndex;
+    vulkan_retired_range *Retired = Registry->RetiredRanges + DataIndex*VULKAN_MESH_REGISTRY_MAX_RETIRED_RANGE_COUNT + Registry->RetiredRangeCounts[DataIndex]++;
+    Retired->Kind = Kind;
+    Retired->Range = Range;
+    Retired->IsMoved = IsMoved;
+}
+
+static void VulkanUnplaceMesh(vulkan_mesh_registry *Registry, vulkan_mesh_entry *Entry) {
+    // NOTE(blackedout): Only for ranges that nothing was written to yet
+    for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+        if(Entry->Ranges[Kind].ByteCount > 0) {
+            Registry->Arenas[Kind].UsedByteCount -= Entry->Ranges[Kind].ByteCount;
+            VulkanFreeArenaRange(Registry->Arenas + Kind, Entry->Ranges[Kind].Offset, Entry->Ranges[Kind].ByteCount);
+        }
+    }
+    SetZero(Entry->Ranges);
+}
+
+static void VulkanRemoveMesh(vulkan_mesh_registry *Registry, vulkan_mesh_handle Handle) {
+    // NOTE(blackedout): Frames in flight may still read the ranges of a resident mesh, so they are retired.
+    vulkan_mesh_entry *Entry = VulkanGetMeshEntry(Registry, Handle);
+    if(Entry == 0) {
+        return;
+    }
+    uint32_t Index = (uint32_t)(Entry - Registry->Entries);
+    if(Entry->State != VULKAN_MESH_STATE_RESIDENT) {
+        for(uint32_t I = 0; I < Registry->PendingCount; ++I) {
+            if(Registry->PendingEntries[I] == Index) {
+                --Registry->PendingCount;
+                memmove(Registry->PendingEntries + I, Registry->PendingEntries + I + 1, (Registry->PendingCount - I)*sizeof(*Registry->PendingEntries));
+                break;
+            }
+        }
+    }
+    if(Entry->State != VULKAN_MESH_STATE_PENDING) {
+        for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+            if(Entry->Ranges[Kind].ByteCount > 0) {
+                VulkanRetireArenaRange(Registry, (vulkan_mesh_arena_kind)Kind, Entry->Ranges[Kind], 0);
+            }
+        }
+    }
+    Entry->State = VULKAN_MESH_STATE_UNUSED;
+    Entry->Generation = (Entry->Generation + 1) & 0xffff;
+    Entry->Generation += (Entry->Generation == 0);
+    Entry->NextUnused = Registry->UnusedEntry;
+    Registry->UnusedEntry = Index;
+    --Registry->MeshCount;
+}
+
+static int VulkanGrowMeshArena(vulkan_surface_device *Device, vulkan_mesh_registry *Registry, vulkan_mesh_arena_kind Kind, uint64_t MinByteCount, VkCommandBuffer CommandBuffer, uint32_t DataIndex) {
+    // NOTE(blackedout): The old contents are copied on the device. Frames in flight still use the old buffer, so it's retired until the frame
+    // of this data index has finished.
+    vulkan_mesh_arena *Arena = Registry->Arenas + Kind;
+    vulkan_buffer *Retired = &Registry->RetiredBuffers[DataIndex][Kind];
+    AssertMessageGoto(Retired->Handle == VULKAN_NULL_HANDLE, label_Error, "Mesh arena %d grew twice in one frame.\n", Kind);
+    {
+        uint64_t NewByteCount = Max(2*Arena->ByteCount, MinByteCount);
+        vulkan_buffer Buffer;
+        CheckGoto(VulkanCreateExclusiveBufferWithMemory(Device, NewByteCount, Arena->Usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VulkanGetHostWritablePreferredFlags(Device), VULKAN_MEMORY_SUBSYSTEM_STATIC_MESHES, &Buffer), label_Error);
+        if(VulkanFreeArenaRange(Arena, Arena->ByteCount, NewByteCount - Arena->ByteCount)) {
+            VulkanDestroyBuffer(Device, &Buffer);
+            goto label_Error;
+        }
+        VkBufferCopy Copy = {
+            .srcOffset = 0,
+            .dstOffset = 0,
+            .size = Arena->ByteCount
+        };
+        vkCmdCopyBuffer(CommandBuffer, Arena->Buffer.Handle, Buffer.Handle, 1, &Copy);
+        *Retired = Arena->Buffer;
+        Arena->Buffer = Buffer;
+        Arena->ByteCount = NewByteCount;
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int VulkanShouldDefragmentMeshArenas(vulkan_mesh_registry *Registry) {
+    if(Registry->DefragByteBudget == 0) {
+        return 0;
+    }
+    for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+        if(Registry->Arenas[Kind].IsCompact == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void VulkanDefragmentMeshArenas(vulkan_mesh_registry *Registry, VkCommandBuffer CommandBuffer) {
+    // NOTE(blackedout): Moves resident parts to the lowest free range in front of them, so that holes close up and the free space collects at
+    // the end of the arenas. Each part moves at most once per call and the moved bytes stay within the budget. Offset pointers are patched right
+    // away, so this frame already reads the new ranges. Frames in flight still read the old ones, so they are retired.
+    uint64_t MovedByteCount = 0;
+    uint32_t MoveCount = 0;
+    int HasBarrier = 0;
+    for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+        vulkan_mesh_arena *Arena = Registry->Arenas + Kind;
+        if(Arena->IsCompact) {
+            continue;
+        }
+        int HasMoved = 0, IsOverBudget = 0;
+        for(uint32_t I = 0; I < VULKAN_MESH_REGISTRY_MAX_MESH_COUNT; ++I) {
+            vulkan_mesh_entry *Entry = Registry->Entries + I;
+            vulkan_arena_range *Range = Entry->Ranges + Kind;
+            if(Entry->State != VULKAN_MESH_STATE_RESIDENT || Range->ByteCount == 0) {
+                continue;
+            }
+            if(MoveCount == VULKAN_MESH_DEFRAG_MAX_MOVE_COUNT ||
+               (MovedByteCount > 0 && MovedByteCount + Range->ByteCount > Registry->DefragByteBudget)) {
+                IsOverBudget = 1;
+                break;
+            }
+
+            // NOTE(blackedout): First fit finds the lowest range, so if that's not in front of the part, no range is. Freeing the
+            // allocation again only merges, so it can't fail.
+            uint64_t Alignment;
+            vulkan_subbuf *Part = VulkanGetMeshSubbufPart(&Entry->Subbuf, (vulkan_mesh_arena_kind)Kind, &Alignment);
+            uint64_t Offset;
+            if(VulkanAllocateArenaRange(Arena, Range->ByteCount, Alignment, &Offset)) {
+                continue;
+            }
+            if(Offset >= Range->Offset) {
+                VulkanFreeArenaRange(Arena, Offset, Range->ByteCount);
+                continue;
+            }
+
+            if(HasBarrier == 0) {
+                // NOTE(blackedout): Moved parts may have been uploaded or grown into place in this frame
+                VkMemoryBarrier Barrier = {
+                    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                    .pNext = 0,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+                };
+                vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &Barrier, 0, 0, 0, 0);
+                HasBarrier = 1;
+            }
+            VkBufferCopy Copy = {
+                .srcOffset = Range->Offset,
+                .dstOffset = Offset,
+                .size = Range->ByteCount
+            };
+            vkCmdCopyBuffer(CommandBuffer, Arena->Buffer.Handle, Arena->Buffer.Handle, 1, &Copy);
+
+            VulkanRetireArenaRange(Registry, (vulkan_mesh_arena_kind)Kind, *Range, 1);
+            Arena->UsedByteCount += Range->ByteCount;
+            MovedByteCount += Range->ByteCount;
+            ++MoveCount;
+            Range->Offset = Offset;
+            *Part->OffsetPointer = Offset;
+            HasMoved = 1;
+        }
+        if(IsOverBudget) {
+            break;
+        }
+        if(HasMoved == 0) {
+            Arena->IsCompact = 1;
+        }
+    }
+    Registry->DefragMovedByteCount += MovedByteCount;
+}
+
+static int VulkanUpdateMeshRegistry(vulkan_surface_device *Device, vulkan_mesh_registry *Registry, VkCommandBuffer CommandBuffer, uint32_t DataIndex) {
+    // NOTE(blackedout): Called once per frame while recording, before meshes are drawn. The previous frame of this data index has finished, so
+    // its retired buffers and ranges and its staging buffer are free. Pending meshes are placed, growing arenas at most once by all pending
+    // bytes. Afterwards, the arenas are defragmented within the budget.
+    for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+        VulkanDestroyBuffer(Device, &Registry->RetiredBuffers[DataIndex][Kind]);
+    }
+    for(uint32_t I = 0; I < Registry->RetiredRangeCounts[DataIndex]; ++I) {
+        vulkan_retired_range *Retired = Registry->RetiredRanges + DataIndex*VULKAN_MESH_REGISTRY_MAX_RETIRED_RANGE_COUNT + I;
+        vulkan_mesh_arena *Arena = Registry->Arenas + Retired->Kind;
+        uint64_t TailByteCount = VulkanGetArenaTailByteCount(Arena);
+        Arena->UsedByteCount -= Retired->Range.ByteCount;
+        VulkanFreeArenaRange(Arena, Retired->Range.Offset, Retired->Range.ByteCount);
+        if(Retired->IsMoved) {
+            Registry->DefragReclaimedByteCount += VulkanGetArenaTailByteCount(Arena) - TailByteCount;
+        }
+    }
+    Registry->RetiredRangeCounts[DataIndex] = 0;
+    Registry->RecordingDataIndex = DataIndex;
+    if(Registry->PendingCount == 0 && VulkanShouldDefragmentMeshArenas(Registry) == 0) {
+        return 0;
+    }
+
+    {
+        uint64_t PendingByteCounts[VULKAN_MESH_ARENA_COUNT] = {0};
+        for(uint32_t I = 0; I < Registry->PendingCount; ++I) {
+            vulkan_mesh_entry *Entry = Registry->Entries + Registry->PendingEntries[I];
+            for(uint32_t Kind = 0; Entry->State == VULKAN_MESH_STATE_PENDING && Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+                uint64_t Alignment;
+                vulkan_subbuf *Part = VulkanGetMeshSubbufPart(&Entry->Subbuf, (vulkan_mesh_arena_kind)Kind, &Alignment);
+                if(Part->Source && Part->ByteCount > 0) {
+                    PendingByteCounts[Kind] += Part->ByteCount + Alignment;
+                }
+            }
+        }
+
+        // NOTE(blackedout): Copies of earlier frames, which aren't known to have finished, may have written the same arena buffers
+        VkMemoryBarrier BeforeBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = 0,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        };
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &BeforeBarrier, 0, 0, 0, 0);
+
+        // NOTE(blackedout): Place all pending meshes first, so that all arena copies are recorded before the uploads
+        int HasGrown = 0;
+        for(uint32_t I = 0; I < Registry->PendingCount; ++I) {
+            vulkan_mesh_entry *Entry = Registry->Entries + Registry->PendingEntries[I];
+            if(Entry->State != VULKAN_MESH_STATE_PENDING) {
+                continue;
+            }
+            uint32_t Kind = 0;
+            for(; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+                uint64_t Alignment;
+                vulkan_subbuf *Part = VulkanGetMeshSubbufPart(&Entry->Subbuf, (vulkan_mesh_arena_kind)Kind, &Alignment);
+                if(Part->Source == 0 || Part->ByteCount == 0) {
+                    continue;
+                }
+                vulkan_mesh_arena *Arena = Registry->Arenas + Kind;
+                uint64_t Offset;
+                if(VulkanAllocateArenaRange(Arena, Part->ByteCount, Alignment, &Offset)) {
+                    if(VulkanGrowMeshArena(Device, Registry, (vulkan_mesh_arena_kind)Kind, Arena->ByteCount + PendingByteCounts[Kind], CommandBuffer, DataIndex) ||
+                       VulkanAllocateArenaRange(Arena, Part->ByteCount, Alignment, &Offset)) {
+                        break;
+                    }
+                    HasGrown = 1;
+                }
+                Arena->UsedByteCount += Part->ByteCount;
+                Entry->Ranges[Kind].Offset = Offset;
+                Entry->Ranges[Kind].ByteCount = Part->ByteCount;
+            }
+            if(Kind < VULKAN_MESH_ARENA_COUNT) {
+                // NOTE(blackedout): Undo the parts that were placed, the mesh stays pending
+                VulkanUnplaceMesh(Registry, Entry);
+                printfc(CODE_RED, "Mesh could not be placed in the mesh arenas.\n");
+                break;
+            }
+            Entry->State = VULKAN_MESH_STATE_UPLOADING;
+        }
+
+        if(HasGrown) {
+            VkMemoryBarrier GrowBarrier = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
                 .pNext = 0,
-                .flags = 0,
-                .imageType = ImageDescription.Type,
-                .format = ImageDescription.Format,
-                .extent = {
-                    .width = ImageDescription.Width,
-                    .height = ImageDescription.Height,
-                    .depth = ImageDescription.Depth
-                },
-                .mipLevels = 1,
-                .arrayLayers = 1,
-                .samples = VK_SAMPLE_COUNT_1_BIT,
-                .tiling = VK_IMAGE_TILING_OPTIMAL,
-                .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-                .queueFamilyIndexCount = 0,
-                .pQueueFamilyIndices = 0,
-                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            };
+            vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &GrowBarrier, 0, 0, 0, 0);
+        }
+
+        // NOTE(blackedout): Arenas in host visible memory are written in place, unless a copy into their buffer may still be pending. Only
+        // the copies of grown arenas write ranges that are free (see VulkanRetireArenaRange), so those go through the staging buffer until the
+        // retired buffer is gone.
+        int IsWrittenInPlace[VULKAN_MESH_ARENA_COUNT];
+        for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+            IsWrittenInPlace[Kind] = VulkanIsAllocationHostCoherent(Device, &Registry->Arenas[Kind].Buffer.Allocation);
+            for(uint32_t I = 0; I < MAX_ACQUIRED_IMAGE_COUNT; ++I) {
+                IsWrittenInPlace[Kind] = IsWrittenInPlace[Kind] && Registry->RetiredBuffers[I][Kind].Handle == VULKAN_NULL_HANDLE;
+            }
+        }
+        int NeedsStaging = 0;
+        for(uint32_t I = 0; I < Registry->PendingCount; ++I) {
+            vulkan_mesh_entry *Entry = Registry->Entries + Registry->PendingEntries[I];
+            for(uint32_t Kind = 0; Entry->State == VULKAN_MESH_STATE_UPLOADING && Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+                NeedsStaging |= !IsWrittenInPlace[Kind] && Entry->UploadedByteCounts[Kind] < Entry->Ranges[Kind].ByteCount;
+            }
+        }
+        vulkan_buffer *StagingBuffer = Registry->StagingBuffers + DataIndex;
+        if(NeedsStaging && StagingBuffer->Handle == VULKAN_NULL_HANDLE) {
+            // NOTE(blackedout): Placed meshes stay uploading if this fails and are retried with the next frame
+            CheckGoto(VulkanCreateExclusiveBufferWithMemory(Device, VULKAN_MESH_UPLOAD_BYTE_COUNT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, VULKAN_MEMORY_SUBSYSTEM_STAGING, StagingBuffer), label_Error);
+        }
+
+        // NOTE(blackedout): Meshes are uploaded in the order they were added, the first one that doesn't fit into the budget anymore gets a
+        // chunk of the rest. In place writes count against the budget as well, to bound the time spent copying on the host.
+        uint64_t BudgetByteCount = VULKAN_MESH_UPLOAD_BYTE_COUNT;
+        uint64_t StagingOffset = 0;
+        vulkan_staging_fills Fills;
+        Fills.Workers = Registry->Workers;
+        Fills.Count = 0;
+        uint32_t KeptCount = 0;
+        for(uint32_t I = 0; I < Registry->PendingCount; ++I) {
+            vulkan_mesh_entry *Entry = Registry->Entries + Registry->PendingEntries[I];
+            int IsUploaded = Entry->State == VULKAN_MESH_STATE_UPLOADING;
+            for(uint32_t Kind = 0; Entry->State == VULKAN_MESH_STATE_UPLOADING && Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+                uint64_t Alignment;
+                vulkan_subbuf *Part = VulkanGetMeshSubbufPart(&Entry->Subbuf, (vulkan_mesh_arena_kind)Kind, &Alignment);
+                vulkan_arena_range Range = Entry->Ranges[Kind];
+                uint64_t UploadedByteCount = Entry->UploadedByteCounts[Kind];
+                uint64_t ChunkByteCount = Min(Range.ByteCount - UploadedByteCount, BudgetByteCount);
+                ChunkByteCount = Min(ChunkByteCount, VulkanGetStagingFillFreeByteCount(&Fills));
+                if(ChunkByteCount > 0) {
+                    vulkan_mesh_arena *Arena = Registry->Arenas + Kind;
+                    const uint8_t *Source = (const uint8_t *)Part->Source + UploadedByteCount;
+                    if(IsWrittenInPlace[Kind]) {
+                        VulkanPushStagingFill(&Fills, Arena->Buffer.Allocation.Mapped + Range.Offset + UploadedByteCount, Source, ChunkByteCount);
+                    } else {
+                        VulkanPushStagingFill(&Fills, StagingBuffer->Allocation.Mapped + StagingOffset, Source, ChunkByteCount);
+                        VkBufferCopy Copy = {
+                            .srcOffset = StagingOffset,
+                            .dstOffset = Range.Offset + UploadedByteCount,
+                            .size = ChunkByteCount
+                        };
+                        vkCmdCopyBuffer(CommandBuffer, StagingBuffer->Handle, Arena->Buffer.Handle, 1, &Copy);
+                        StagingOffset += ChunkByteCount;
+                    }
+                    Entry->UploadedByteCounts[Kind] += ChunkByteCount;
+                    BudgetByteCount -= ChunkByteCount;
+                }
+                IsUploaded = IsUploaded && Entry->UploadedByteCounts[Kind] == Range.ByteCount;
+            }
+            if(IsUploaded) {
+                for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+                    uint64_t Alignment;
+                    vulkan_subbuf *Part = VulkanGetMeshSubbufPart(&Entry->Subbuf, (vulkan_mesh_arena_kind)Kind, &Alignment);
+                    *Part->OffsetPointer = Entry->Ranges[Kind].Offset;
+                    Part->Source = 0;
+                }
+                Entry->State = VULKAN_MESH_STATE_RESIDENT;
+            } else {
+                Registry->PendingEntries[KeptCount++] = Registry->PendingEntries[I];
+            }
+        }
+        Registry->PendingCount = KeptCount;
+        VulkanRunStagingFills(&Fills);
+
+        if(VulkanShouldDefragmentMeshArenas(Registry)) {
+            VulkanDefragmentMeshArenas(Registry, CommandBuffer);
+        }
+
+        VkMemoryBarrier AfterBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = 0,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &AfterBarrier, 0, 0, 0, 0);
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void VulkanPrintMeshRegistryStats(vulkan_mesh_registry *Registry) {
+    printf("Mesh registry: %u meshes (%u pending), defragmentation moved %llu bytes and reclaimed %llu bytes.\n", Registry->MeshCount,
+           Registry->PendingCount, (unsigned long long)Registry->DefragMovedByteCount, (unsigned long long)Registry->DefragReclaimedByteCount);
+    for(uint32_t Kind = 0; Kind < VULKAN_MESH_ARENA_COUNT; ++Kind) {
+        vulkan_mesh_arena *Arena = Registry->Arenas + Kind;
+        printf("Mesh arena %s: %llu/%llu bytes used, %u free ranges, %llu bytes free at the end%s.\n", VULKAN_MESH_ARENA_NAMES[Kind],
+               (unsigned long long)Arena->UsedByteCount, (unsigned long long)Arena->ByteCount, Arena->FreeRangeCount,
+               (unsigned long long)VulkanGetArenaTailByteCount(Arena), Arena->IsCompact? ", compact" : "");
+    }
+}
+
+// MARK: Shaders
+static int VulkanCreateShaderModule(vulkan_surface_device *Device, const uint8_t *Bytes, uint64_t ByteCount, VkShaderModule *OutModule) {
+    VkDevice DeviceHandle = Device->Handle;
+
+    {
+        AssertMessageGoto(ByteCount < (uint64_t)SIZE_T_MAX, label_Error, "Too many bytes in shader code.\n");
+        VkShaderModuleCreateInfo CreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .codeSize = (size_t)ByteCount,
+            .pCode = (uint32_t *)Bytes
+        };
+        
+        VulkanCheckGoto(vkCreateShaderModule(DeviceHandle, &CreateInfo, 0, OutModule), label_Error);
+    }
+
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+typedef struct {
+    VkDescriptorSetLayoutCreateFlags Flags;
+    VkDescriptorSetLayoutBinding *Bindings;
+    uint32_t BindingsCount;
+    const VkDescriptorBindingFlags *BindingFlags; // NOTE(blackedout): Optional, BindingsCount elements (needs descriptor indexing)
+} vulkan_descriptor_set_layout_description;
+
+static void VulkanDestroyDescriptorSetLayouts(vulkan_surface_device *Device, VkDescriptorSetLayout *DescriptorSetLayouts, uint32_t Count) {
+    VkDevice DeviceHandle = Device->Handle;
+    for(uint32_t I = 0; I < Count; ++I) {
+        vkDestroyDescriptorSetLayout(DeviceHandle, DescriptorSetLayouts[I], 0);
+        DescriptorSetLayouts[I] = 0;
+    }
+}
+
+static int VulkanCreateDescriptorSetLayouts(vulkan_surface_device *Device, vulkan_descriptor_set_layout_description *Descriptions, uint32_t Count, VkDescriptorSetLayout *DescriptorSetLayouts) {
+    VkDevice DeviceHandle = Device->Handle;
+
+    uint32_t CreatedCount = 0;
+    {
+        VkDescriptorSetLayoutCreateInfo DescriptorSetLayoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .bindingCount = 0,
+            .pBindings = 0
+        };
+        
+        for(; CreatedCount < Count; ++CreatedCount) {
+            vulkan_descriptor_set_layout_description Description = Descriptions[CreatedCount];
+            VkDescriptorSetLayoutBindingFlagsCreateInfo BindingFlagsCreateInfo = {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+                .pNext = 0,
+                .bindingCount = Description.BindingsCount,
+                .pBindingFlags = Description.BindingFlags
             };
+            DescriptorSetLayoutCreateInfo.pNext = Description.BindingFlags? &BindingFlagsCreateInfo : 0;
+            DescriptorSetLayoutCreateInfo.flags = Description.Flags;
+            DescriptorSetLayoutCreateInfo.bindingCount = Description.BindingsCount;
+            DescriptorSetLayoutCreateInfo.pBindings = Description.Bindings;
             
-            VulkanCheckGoto(vkCreateImage(DeviceHandle, &ImageCreateInfo, 0, &OutImages[I].Handle), label_Images);
-            ++CreatedImageCount;
+            VulkanCheckGoto(vkCreateDescriptorSetLayout(DeviceHandle, &DescriptorSetLayoutCreateInfo, 0, DescriptorSetLayouts + CreatedCount), label_Error);
+        }
+    }
+
+    return 0;
+
+label_Error:
+    VulkanDestroyDescriptorSetLayouts(Device, DescriptorSetLayouts, CreatedCount);
+    return 1;
+}
+
+// MARK: Descriptor Allocator
+// NOTE(blackedout): Descriptor sets come from chains of pools that grow when a pool runs out. Sets are never freed individually,
+// pools are only reset as a whole:
+// - Transient sets live for one frame. Every acquired image data index has its own chain, which is reset once the frame that used
+//   it has finished (its in flight fence was waited for before the index is handed out again).
+// - Persistent sets live as long as the allocator. They are cached by layout and bindings, so asking for the same set twice
+//   returns the set that was written the first time. The resources a cached set refers to must not be destroyed while it is used.
+#define VULKAN_DESCRIPTOR_POOL_CHAIN_CAPACITY 16
+#define VULKAN_DESCRIPTOR_POOL_MIN_SET_COUNT 32 // NOTE(blackedout): Every new pool of a chain holds twice as many sets as the one before
+#define VULKAN_DESCRIPTOR_POOL_MAX_SET_COUNT 4096
+#define VULKAN_DESCRIPTOR_SET_CACHE_CAPACITY 256 // NOTE(blackedout): Must be a power of two
+#define VULKAN_DESCRIPTOR_SET_MAX_BINDING_COUNT 8
+
+// NOTE(blackedout): Descriptors per set of each type, pools are sized for the average set. If a pool runs out of one type early, the
+// next pool is used.
+static VkDescriptorPoolSize VULKAN_DESCRIPTOR_POOL_SIZES[] = {
+    { VK_DESCRIPTOR_TYPE_SAMPLER, 1 },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+};
+
+// NOTE(blackedout): One descriptor of a set. Only the members of the descriptor type are used, the others must be zero, because bindings
+// are hashed and compared as bytes (there is no implicit padding).
+typedef struct {
+    VkDescriptorType Type;
+    uint32_t Binding;
+    VkBuffer Buffer;
+    VkDeviceSize Offset;
+    VkDeviceSize Range;
+    VkImageView ImageView;
+    VkSampler Sampler;
+    VkImageLayout ImageLayout;
+    uint32_t Padding;
+} vulkan_descriptor_binding;
+
+typedef struct {
+    VkDescriptorPool Pools[VULKAN_DESCRIPTOR_POOL_CHAIN_CAPACITY];
+    uint32_t PoolCount;
+    uint32_t ActivePoolIndex; // NOTE(blackedout): The pools before this one ran out since the last reset, PoolCount if all of them did
+} vulkan_descriptor_pool_chain;
+
+typedef struct {
+    uint64_t Hash;
+    int IsUsed;
+    VkDescriptorSet Set;
+    VkDescriptorSetLayout Layout;
+    uint32_t BindingCount;
+    vulkan_descriptor_binding Bindings[VULKAN_DESCRIPTOR_SET_MAX_BINDING_COUNT];
+} vulkan_descriptor_set_cache_entry;
+
+typedef struct {
+    VkDevice DeviceHandle;
+    vulkan_descriptor_pool_chain PersistentPools;
+    vulkan_descriptor_pool_chain TransientPools[MAX_ACQUIRED_IMAGE_COUNT];
+    uint32_t CachedSetCount;
+    uint64_t HitCount;
+    uint64_t MissCount;
+    vulkan_descriptor_set_cache_entry *CachedSets;
+} vulkan_descriptor_allocator;
+
+static void VulkanDestroyDescriptorPoolChain(VkDevice DeviceHandle, vulkan_descriptor_pool_chain *Chain) {
+    for(uint32_t I = 0; I < Chain->PoolCount; ++I) {
+        vkDestroyDescriptorPool(DeviceHandle, Chain->Pools[I], 0);
+    }
+    memset(Chain, 0, sizeof(*Chain));
+}
+
+static int VulkanPushDescriptorPool(VkDevice DeviceHandle, vulkan_descriptor_pool_chain *Chain) {
+    AssertMessageGoto(Chain->PoolCount < VULKAN_DESCRIPTOR_POOL_CHAIN_CAPACITY, label_Error, "Descriptor pool chain is full (%d pools).\n", Chain->PoolCount);
+    {
+        uint32_t SetCount = VULKAN_DESCRIPTOR_POOL_MIN_SET_COUNT << Chain->PoolCount;
+        SetCount = Min(SetCount, VULKAN_DESCRIPTOR_POOL_MAX_SET_COUNT);
+
+        VkDescriptorPoolSize PoolSizes[ArrayCount(VULKAN_DESCRIPTOR_POOL_SIZES)];
+        for(uint32_t I = 0; I < ArrayCount(PoolSizes); ++I) {
+            PoolSizes[I].type = VULKAN_DESCRIPTOR_POOL_SIZES[I].type;
+            PoolSizes[I].descriptorCount = SetCount*VULKAN_DESCRIPTOR_POOL_SIZES[I].descriptorCount;
+        }
+        VkDescriptorPoolCreateInfo DescriptorPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .maxSets = SetCount,
+            .poolSizeCount = ArrayCount(PoolSizes),
+            .pPoolSizes = PoolSizes
+        };
+        VulkanCheckGoto(vkCreateDescriptorPool(DeviceHandle, &DescriptorPoolCreateInfo, 0, Chain->Pools + Chain->PoolCount), label_Error);
+        ++Chain->PoolCount;
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static int VulkanAllocateDescriptorSetFromChain(VkDevice DeviceHandle, vulkan_descriptor_pool_chain *Chain, VkDescriptorSetLayout Layout, VkDescriptorSet *OutSet) {
+    // NOTE(blackedout): When the active pool runs out, the next one becomes active. If there is none, a larger pool is pushed.
+    for(;;) {
+        int IsNewPool = 0;
+        if(Chain->ActivePoolIndex == Chain->PoolCount) {
+            CheckGoto(VulkanPushDescriptorPool(DeviceHandle, Chain), label_Error);
+            IsNewPool = 1;
+        }
+
+        VkDescriptorSetAllocateInfo DescriptorSetAllocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = 0,
+            .descriptorPool = Chain->Pools[Chain->ActivePoolIndex],
+            .descriptorSetCount = 1,
+            .pSetLayouts = &Layout
+        };
+        VkResult Result = vkAllocateDescriptorSets(DeviceHandle, &DescriptorSetAllocateInfo, OutSet);
+        if(Result == VK_ERROR_OUT_OF_POOL_MEMORY || Result == VK_ERROR_FRAGMENTED_POOL) {
+            AssertMessageGoto(IsNewPool == 0, label_Error, "Descriptor set layout needs more descriptors than an empty pool has.\n");
+            ++Chain->ActivePoolIndex;
+            continue;
+        }
+        VulkanCheckGoto(Result, label_Error);
+        return 0;
+    }
+
+label_Error:
+    return 1;
+}
+
+static void VulkanResetDescriptorPoolChain(VkDevice DeviceHandle, vulkan_descriptor_pool_chain *Chain) {
+    // NOTE(blackedout): Only the pools up to the active one have sets allocated from them.
+    for(uint32_t I = 0; I <= Chain->ActivePoolIndex && I < Chain->PoolCount; ++I) {
+        vkResetDescriptorPool(DeviceHandle, Chain->Pools[I], 0);
+    }
+    Chain->ActivePoolIndex = 0;
+}
+
+static void VulkanWriteDescriptorSet(VkDevice DeviceHandle, VkDescriptorSet Set, const vulkan_descriptor_binding *Bindings, uint32_t BindingCount) {
+    VkDescriptorBufferInfo BufferInfos[VULKAN_DESCRIPTOR_SET_MAX_BINDING_COUNT];
+    VkDescriptorImageInfo ImageInfos[VULKAN_DESCRIPTOR_SET_MAX_BINDING_COUNT];
+    VkWriteDescriptorSet WriteDescriptorSets[VULKAN_DESCRIPTOR_SET_MAX_BINDING_COUNT];
+    for(uint32_t I = 0; I < BindingCount; ++I) {
+        vulkan_descriptor_binding Binding = Bindings[I];
+        VkWriteDescriptorSet WriteDescriptorSet = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = 0,
+            .dstSet = Set,
+            .dstBinding = Binding.Binding,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = Binding.Type,
+            .pImageInfo = 0,
+            .pBufferInfo = 0,
+            .pTexelBufferView = 0
+        };
+        switch(Binding.Type) {
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: {
+            VkDescriptorBufferInfo BufferInfo = { .buffer = Binding.Buffer, .offset = Binding.Offset, .range = Binding.Range };
+            BufferInfos[I] = BufferInfo;
+            WriteDescriptorSet.pBufferInfo = BufferInfos + I;
+        } break;
+        default: {
+            VkDescriptorImageInfo ImageInfo = { .sampler = Binding.Sampler, .imageView = Binding.ImageView, .imageLayout = Binding.ImageLayout };
+            ImageInfos[I] = ImageInfo;
+            WriteDescriptorSet.pImageInfo = ImageInfos + I;
+        } break;
+        }
+        WriteDescriptorSets[I] = WriteDescriptorSet;
+    }
+    vkUpdateDescriptorSets(DeviceHandle, BindingCount, WriteDescriptorSets, 0, 0);
+}
+
+static void VulkanDestroyDescriptorAllocator(vulkan_descriptor_allocator *Allocator) {
+    VulkanDestroyDescriptorPoolChain(Allocator->DeviceHandle, &Allocator->PersistentPools);
+    for(uint32_t I = 0; I < ArrayCount(Allocator->TransientPools); ++I) {
+        VulkanDestroyDescriptorPoolChain(Allocator->DeviceHandle, Allocator->TransientPools + I);
+    }
+    free(Allocator->CachedSets);
+    memset(Allocator, 0, sizeof(*Allocator));
+}
+
+static int VulkanCreateDescriptorAllocator(vulkan_surface_device *Device, vulkan_descriptor_allocator *OutAllocator) {
+    vulkan_descriptor_allocator Allocator;
+    SetZero(Allocator);
+    Allocator.DeviceHandle = Device->Handle;
+
+    uint64_t CachedSetsByteCount = VULKAN_DESCRIPTOR_SET_CACHE_CAPACITY*sizeof(vulkan_descriptor_set_cache_entry);
+    Allocator.CachedSets = (vulkan_descriptor_set_cache_entry *)malloc(CachedSetsByteCount);
+    AssertMessageGoto(Allocator.CachedSets, label_Error, "Descriptor set cache could not be allocated.\n");
+    memset(Allocator.CachedSets, 0, CachedSetsByteCount);
+
+    *OutAllocator = Allocator;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void VulkanResetTransientDescriptorSets(vulkan_descriptor_allocator *Allocator, uint32_t DataIndex) {
+    // NOTE(blackedout): The frame that last used DataIndex must have finished.
+    VulkanResetDescriptorPoolChain(Allocator->DeviceHandle, Allocator->TransientPools + DataIndex);
+}
+
+static int VulkanAllocateTransientDescriptorSet(vulkan_descriptor_allocator *Allocator, uint32_t DataIndex, VkDescriptorSetLayout Layout, const vulkan_descriptor_binding *Bindings, uint32_t BindingCount, VkDescriptorSet *OutSet) {
+    AssertMessageGoto(BindingCount <= VULKAN_DESCRIPTOR_SET_MAX_BINDING_COUNT, label_Error, "Too many descriptor bindings (%d).\n", BindingCount);
+    CheckGoto(VulkanAllocateDescriptorSetFromChain(Allocator->DeviceHandle, Allocator->TransientPools + DataIndex, Layout, OutSet), label_Error);
+    VulkanWriteDescriptorSet(Allocator->DeviceHandle, *OutSet, Bindings, BindingCount);
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static vulkan_descriptor_set_cache_entry *VulkanFindCachedDescriptorSet(vulkan_descriptor_allocator *Allocator, VkDescriptorSetLayout Layout, const vulkan_descriptor_binding *Bindings, uint32_t BindingCount, uint64_t Hash) {
+    // NOTE(blackedout): Returns either the matching entry or the free entry where it would have to be inserted (0 if the table is full).
+    uint32_t Mask = VULKAN_DESCRIPTOR_SET_CACHE_CAPACITY - 1;
+    for(uint32_t Probe = 0; Probe < VULKAN_DESCRIPTOR_SET_CACHE_CAPACITY; ++Probe) {
+        vulkan_descriptor_set_cache_entry *Entry = Allocator->CachedSets + ((Hash + Probe) & Mask);
+        if(Entry->IsUsed == 0 || (Entry->Hash == Hash && Entry->Layout == Layout && Entry->BindingCount == BindingCount &&
+                                  memcmp(Entry->Bindings, Bindings, BindingCount*sizeof(*Bindings)) == 0)) {
+            return Entry;
+        }
+    }
+    return 0;
+}
+
+static int VulkanGetPersistentDescriptorSet(vulkan_descriptor_allocator *Allocator, VkDescriptorSetLayout Layout, const vulkan_descriptor_binding *Bindings, uint32_t BindingCount, VkDescriptorSet *OutSet) {
+    AssertMessageGoto(BindingCount <= VULKAN_DESCRIPTOR_SET_MAX_BINDING_COUNT, label_Error, "Too many descriptor bindings (%d).\n", BindingCount);
+    {
+        uint64_t Hash = HashBytesFNV1a(&Layout, sizeof(Layout), HASH_FNV1A_BASIS);
+        Hash = HashBytesFNV1a(Bindings, BindingCount*sizeof(*Bindings), Hash);
+        vulkan_descriptor_set_cache_entry *Entry = VulkanFindCachedDescriptorSet(Allocator, Layout, Bindings, BindingCount, Hash);
+        if(Entry && Entry->IsUsed) {
+            ++Allocator->HitCount;
+            *OutSet = Entry->Set;
+            return 0;
+        }
+        AssertMessageGoto(Entry && Allocator->CachedSetCount + 1 < VULKAN_DESCRIPTOR_SET_CACHE_CAPACITY, label_Error, "Descriptor set cache is full (%d sets).\n", Allocator->CachedSetCount);
+
+        ++Allocator->MissCount;
+        VkDescriptorSet Set;
+        CheckGoto(VulkanAllocateDescriptorSetFromChain(Allocator->DeviceHandle, &Allocator->PersistentPools, Layout, &Set), label_Error);
+        VulkanWriteDescriptorSet(Allocator->DeviceHandle, Set, Bindings, BindingCount);
+
+        Entry->Hash = Hash;
+        Entry->IsUsed = 1;
+        Entry->Set = Set;
+        Entry->Layout = Layout;
+        Entry->BindingCount = BindingCount;
+        memcpy(Entry->Bindings, Bindings, BindingCount*sizeof(*Bindings));
+        ++Allocator->CachedSetCount;
+        *OutSet = Set;
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void VulkanPrintDescriptorAllocatorStats(vulkan_descriptor_allocator *Allocator) {
+    uint32_t TransientPoolCount = 0;
+    for(uint32_t I = 0; I < ArrayCount(Allocator->TransientPools); ++I) {
+        TransientPoolCount += Allocator->TransientPools[I].PoolCount;
+    }
+    printf("Descriptor allocator: %d persistent pools, %d transient pools, %d cached sets, %llu hits, %llu misses.\n", Allocator->PersistentPools.PoolCount,
+           TransientPoolCount, Allocator->CachedSetCount, (unsigned long long)Allocator->HitCount, (unsigned long long)Allocator->MissCount);
+}
+
+typedef struct {
+    VkBuffer *Buffers;
+    vulkan_allocation *Allocations;
+    void **MappedBuffers;
+    VkDescriptorSet *DescriptorSets;
+    uint32_t BindingIndex;
+    VkDeviceSize Size;
+} vulkan_shader_uniform_buffers_description;
+
+static void VulkanDestroyShaderUniformBuffers(vulkan_surface_device *Device, vulkan_shader_uniform_buffers_description *Descriptions, uint32_t Count) {
+    for(uint32_t I = 0; I < Count; ++I) {
+        vulkan_shader_uniform_buffers_description Description = Descriptions[I];
+        for(uint32_t J = 0; J < MAX_ACQUIRED_IMAGE_COUNT; ++J) {
+            vkDestroyBuffer(Device->Handle, Description.Buffers[J], 0);
+            VulkanFreeAllocation(Device, Description.Allocations + J);
+            Description.Buffers[J] = 0;
+            Description.MappedBuffers[J] = 0;
+        }
+    }
+}
+
+static int VulkanCreateShaderUniformBuffers(vulkan_surface_device *Device, VkDescriptorSetLayout DescriptorSetLayout, vulkan_shader_uniform_buffers_description *Descriptions, uint32_t Count, vulkan_descriptor_allocator *DescriptorAllocator) {
+    // NOTE(blackedout): Every buffer is sub-allocated on its own from host visible memory, which stays mapped. Expects the description arrays
+    // to be zeroed, so that partially created buffers can be destroyed on failure. The sets are also bound by async compute passes, so the
+    // buffers are concurrent between the graphics and the async compute queue family if the device has one.
+    VkDevice DeviceHandle = Device->Handle;
+
+    {
+        uint32_t QueueFamilyIndices[] = { Device->GraphicsQueueFamilyIndex, Device->ComputeQueueFamilyIndex };
+        VkBufferCreateInfo BufferCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .size = 0,
+            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+            .sharingMode = Device->HasAsyncCompute? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = Device->HasAsyncCompute? ArrayCount(QueueFamilyIndices) : 0,
+            .pQueueFamilyIndices = Device->HasAsyncCompute? QueueFamilyIndices : 0
+        };
+        
+        for(uint32_t I = 0; I < Count; ++I) {
+            vulkan_shader_uniform_buffers_description Description = Descriptions[I];
+            BufferCreateInfo.size = Description.Size;
+            
+            for(uint32_t J = 0; J < MAX_ACQUIRED_IMAGE_COUNT; ++J) {
+                VulkanCheckGoto(vkCreateBuffer(DeviceHandle, &BufferCreateInfo, 0, Description.Buffers + J), label_Buffers);
+                // NOTE(blackedout): Written by the host every frame, so device local memory is only preferred. The buffers are small enough
+                // for the BAR window.
+                CheckGoto(VulkanAllocateBufferMemory(Device, Description.Buffers[J], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_SUBSYSTEM_UNIFORMS, Description.Allocations + J), label_Buffers);
+                Description.MappedBuffers[J] = Description.Allocations[J].Mapped;
+
+                // NOTE(blackedout): Sets are persistent, they refer to the same buffer for the whole program
+                vulkan_descriptor_binding Binding = {
+                    .Type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                    .Binding = Description.BindingIndex,
+                    .Buffer = Description.Buffers[J],
+                    .Offset = 0,
+                    .Range = Description.Size
+                };
+                CheckGoto(VulkanGetPersistentDescriptorSet(DescriptorAllocator, DescriptorSetLayout, &Binding, 1, Description.DescriptorSets + J), label_Buffers);
+            }
+        }
+    }
+    
+    return 0;
+
+label_Buffers:
+    VulkanDestroyShaderUniformBuffers(Device, Descriptions, Count);
+    return 1;
+}
+
+// MARK: Frame Graph
+// NOTE(blackedout): The passes of a frame are declared every frame, together with the resources each of them reads and writes, in the
+// order they are recorded. Compiling the graph
+// - culls passes whose writes are never read, unless they have side effects or write an imported resource,
+// - creates the transient resources of the remaining passes, where resources that aren't used at the same time share memory.
+// Executing it records the passes in order, with all barriers a pass needs batched into one vkCmdPipelineBarrier in front of it.
+// Render passes declare their attachments as uses too. Compiling creates a render pass for each of them (cached by its attachments), which
+// loads an attachment if its use reads it and stores it if the next use after it reads it. Attachments stay in the layout of their use, so
+// all layout transitions and synchronization of attachments are barriers of the graph and the render passes have no subpass dependencies.
+// Imported images are in VK_IMAGE_LAYOUT_UNDEFINED at their first use in every frame, their contents aren't kept between frames.
+// Transient resources are only recreated when their descriptions or lifetimes change, so a graph must not be used by two frames in flight.
+// Compute and transfer passes can be allowed to run on the async compute queue. They are moved there if the device has one and they only
+// use transient resources that no earlier pass on the graphics queue used, otherwise they stay on the graphics queue. The graphics queue
+// waits for them with one semaphore at the stages of its uses of their resources, which are shared by both queue families and not aliased.
+// Async passes may also read resources that aren't in the graph through their descriptor sets, like uniform buffers written by the host.
+// Those have to be created with VK_SHARING_MODE_CONCURRENT over both queue families (see VulkanCreateSharedBufferWithMemory), because
+// there are no queue family ownership transfers for them.
+#define VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT 32
+#define VULKAN_FRAME_GRAPH_MAX_PASS_COUNT 32
+#define VULKAN_FRAME_GRAPH_MAX_USE_COUNT 128
+#define VULKAN_FRAME_GRAPH_MAX_MEMORY_COUNT 4 // NOTE(blackedout): Resources with disjoint memory type bits can't share an allocation
+#define VULKAN_FRAME_GRAPH_MAX_LEVEL_COUNT 16
+#define VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT 4
+#define VULKAN_FRAME_GRAPH_MAX_RENDER_PASS_COUNT 8
+#define VULKAN_FRAME_GRAPH_WRITE_ACCESSES (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | \
+                                           VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT)
+
+typedef void (*vulkan_frame_graph_record_proc)(void *Data, VkCommandBuffer CommandBuffer);
+
+typedef enum {
+    VULKAN_FRAME_GRAPH_ATTACHMENT_NONE,
+    VULKAN_FRAME_GRAPH_ATTACHMENT_COLOR,
+    VULKAN_FRAME_GRAPH_ATTACHMENT_DEPTH,
+    VULKAN_FRAME_GRAPH_ATTACHMENT_RESOLVE, // NOTE(blackedout): Of the color attachment at the same position among the color attachments
+} vulkan_frame_graph_attachment;
+
+static int VulkanCreateAttachmentRenderPass(vulkan_surface_device *Device, const VkAttachmentDescription *Descriptions, const vulkan_frame_graph_attachment *Attachments, uint32_t AttachmentCount, VkRenderPass *OutRenderPass) {
+    // NOTE(blackedout): One subpass that uses the attachments in the framebuffer order they are given in. Render passes created by this are
+    // compatible if their attachments have the same types, formats and sample counts. There are no subpass dependencies, so the attachments
+    // have to be synchronized by barriers outside of the render pass.
+    VkAttachmentReference ColorRefs[VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT];
+    VkAttachmentReference ResolveRefs[VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT];
+    VkAttachmentReference DepthRef;
+    uint32_t ColorCount = 0, ResolveCount = 0, DepthCount = 0;
+    AssertMessageGoto(AttachmentCount <= VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT, label_Error, "Render pass has more than %d attachments.\n", VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT);
+    for(uint32_t I = 0; I < AttachmentCount; ++I) {
+        VkAttachmentReference Ref = { .attachment = I, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        switch(Attachments[I]) {
+        case VULKAN_FRAME_GRAPH_ATTACHMENT_COLOR: ColorRefs[ColorCount++] = Ref; break;
+        case VULKAN_FRAME_GRAPH_ATTACHMENT_RESOLVE: ResolveRefs[ResolveCount++] = Ref; break;
+        case VULKAN_FRAME_GRAPH_ATTACHMENT_DEPTH:
+            Ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            DepthRef = Ref;
+            ++DepthCount;
+            break;
+        default: break;
+        }
+    }
+    AssertMessageGoto(DepthCount <= 1 && (ResolveCount == 0 || ResolveCount == ColorCount), label_Error,
+                      "Render pass needs at most one depth attachment and a resolve attachment for every color attachment or none.\n");
+    {
+        VkSubpassDescription SubpassDescription = {
+            .flags = 0,
+            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+            .inputAttachmentCount = 0,
+            .pInputAttachments = 0,
+            .colorAttachmentCount = ColorCount,
+            .pColorAttachments = ColorRefs,
+            .pResolveAttachments = ResolveCount? ResolveRefs : 0,
+            .pDepthStencilAttachment = DepthCount? &DepthRef : 0,
+            .preserveAttachmentCount = 0,
+            .pPreserveAttachments = 0,
+        };
+        VkRenderPassCreateInfo RenderPassCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .attachmentCount = AttachmentCount,
+            .pAttachments = Descriptions,
+            .subpassCount = 1,
+            .pSubpasses = &SubpassDescription,
+            .dependencyCount = 0,
+            .pDependencies = 0,
+        };
+        VulkanCheckGoto(vkCreateRenderPass(Device->Handle, &RenderPassCreateInfo, 0, OutRenderPass), label_Error);
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+typedef enum {
+    VULKAN_FRAME_GRAPH_RESOURCE_TYPE_BUFFER,
+    VULKAN_FRAME_GRAPH_RESOURCE_TYPE_IMAGE,
+} vulkan_frame_graph_resource_type;
+
+// NOTE(blackedout): Everything a transient resource is created from, compared as bytes to notice changes (there is no implicit padding)
+typedef struct {
+    vulkan_frame_graph_resource_type Type;
+    VkFormat Format;
+    VkDeviceSize ByteCount;
+    uint32_t Width, Height;
+    uint32_t LevelCount;
+    VkImageAspectFlags Aspect;
+    VkFlags Usage; // NOTE(blackedout): VkBufferUsageFlags or VkImageUsageFlags
+    uint32_t FirstPass, LastPass; // NOTE(blackedout): Passes that aren't culled, FirstPass is UINT32_MAX if there are none
+    uint32_t IsShared; // NOTE(blackedout): Used on the async compute queue, concurrent sharing and alive for the whole frame
+} vulkan_frame_graph_transient;
+
+typedef struct {
+    vulkan_frame_graph_transient Transient;
+    VkBuffer Buffer;
+    VkImage Image;
+    VkImageView View;
+    VkImageView LevelViews[VULKAN_FRAME_GRAPH_MAX_LEVEL_COUNT];
+    VkMemoryRequirements Requirements;
+    uint32_t MemoryIndex; // NOTE(blackedout): UINT32_MAX if the resource wasn't created
+    VkDeviceSize MemoryOffset;
+} vulkan_frame_graph_physical;
+
+typedef struct {
+    const char *Name;
+    int IsImported;
+    vulkan_frame_graph_transient Transient;
+    uint32_t PhysicalIndex;
+    // NOTE(blackedout): Only valid after compiling, null for transient resources that no pass uses that isn't culled
+    VkBuffer Buffer;
+    VkImage Image;
+    VkImageView View; // NOTE(blackedout): All levels
+    const VkImageView *LevelViews;
+
+    // NOTE(blackedout): Synchronization state while executing
+    int IsStarted;
+    VkPipelineStageFlags WriteStages;
+    VkAccessFlags WriteAccesses;
+    VkPipelineStageFlags ReadStages; // NOTE(blackedout): Since the last write
+    VkPipelineStageFlags VisibleStages; // NOTE(blackedout): The last write was made visible to these stages and accesses
+    VkAccessFlags VisibleAccesses;
+    VkImageLayout Layout;
+    int IsOnAsyncQueue; // NOTE(blackedout): Last used on the async compute queue, the semaphore makes this visible to the graphics queue
+    VkSampleCountFlagBits SampleCount; // NOTE(blackedout): Only imported images can be multisampled
+} vulkan_frame_graph_resource;
+
+// NOTE(blackedout): A write whose accesses include reads is a read-modify-write, which needs the previous contents
+typedef struct {
+    uint32_t Resource;
+    int IsWrite;
+    VkPipelineStageFlags Stages;
+    VkAccessFlags Accesses;
+    VkImageLayout Layout; // NOTE(blackedout): Only for images
+    vulkan_frame_graph_attachment Attachment; // NOTE(blackedout): Only for uses by render passes
+} vulkan_frame_graph_use;
+
+typedef struct {
+    const char *Name;
+    vulkan_frame_graph_record_proc Record;
+    void *Data;
+    int HasSideEffects;
+    int IsAsyncAllowed;
+    int IsCulled;
+    int IsAsync; // NOTE(blackedout): Recorded into the async compute command buffer
+    uint32_t FirstUse;
+    uint32_t UseCount;
+    VkRenderPass *OutRenderPass; // NOTE(blackedout): Null if the pass isn't a render pass
+} vulkan_frame_graph_pass;
+
+// NOTE(blackedout): The key is everything but the handle, padding is never compared
+typedef struct {
+    uint32_t AttachmentCount;
+    vulkan_frame_graph_attachment Attachments[VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT];
+    VkAttachmentDescription Descriptions[VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT];
+    VkRenderPass Handle;
+} vulkan_frame_graph_render_pass;
+
+typedef struct {
+    vulkan_surface_device *Device;
+    int HasOverflowed; // NOTE(blackedout): Declaring more than fits is reported by VulkanCompileFrameGraph
+    vulkan_frame_graph_resource Resources[VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT];
+    uint32_t ResourceCount;
+    vulkan_frame_graph_pass Passes[VULKAN_FRAME_GRAPH_MAX_PASS_COUNT];
+    uint32_t PassCount;
+    vulkan_frame_graph_use Uses[VULKAN_FRAME_GRAPH_MAX_USE_COUNT];
+    uint32_t UseCount;
+
+    // NOTE(blackedout): Transient resources in the order they were declared, kept between frames
+    vulkan_frame_graph_physical Physicals[VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT];
+    uint32_t PhysicalCount;
+    vulkan_allocation Memories[VULKAN_FRAME_GRAPH_MAX_MEMORY_COUNT];
+    uint32_t MemoryCount;
+
+    // NOTE(blackedout): Render passes of the passes that are render passes, kept between frames
+    vulkan_frame_graph_render_pass RenderPasses[VULKAN_FRAME_GRAPH_MAX_RENDER_PASS_COUNT];
+    uint32_t RenderPassCount;
+
+    // NOTE(blackedout): Set by compiling. The graphics submission waits for the async compute submission at AsyncWaitStages.
+    uint32_t AsyncPassCount;
+    VkPipelineStageFlags AsyncWaitStages;
+
+    uint32_t CulledPassCount;
+    uint32_t BarrierCount; // NOTE(blackedout): vkCmdPipelineBarrier calls of the last execution
+    uint32_t ResourceBarrierCount; // NOTE(blackedout): Buffer and image barriers in them
+    uint32_t RecreateCount;
+    VkDeviceSize TransientByteCount; // NOTE(blackedout): Without aliasing
+    VkDeviceSize AllocatedByteCount;
+} vulkan_frame_graph;
+
+static void VulkanCreateFrameGraph(vulkan_surface_device *Device, vulkan_frame_graph *Graph) {
+    memset(Graph, 0, sizeof(*Graph));
+    Graph->Device = Device;
+}
+
+static void VulkanDestroyFrameGraphTransients(vulkan_frame_graph *Graph) {
+    vulkan_surface_device *Device = Graph->Device;
+    VkDevice DeviceHandle = Device->Handle;
+    for(uint32_t I = 0; I < Graph->PhysicalCount; ++I) {
+        vulkan_frame_graph_physical *Physical = Graph->Physicals + I;
+        for(uint32_t Level = 0; Level < ArrayCount(Physical->LevelViews); ++Level) {
+            vkDestroyImageView(DeviceHandle, Physical->LevelViews[Level], 0);
+        }
+        vkDestroyImageView(DeviceHandle, Physical->View, 0);
+        vkDestroyImage(DeviceHandle, Physical->Image, 0);
+        vkDestroyBuffer(DeviceHandle, Physical->Buffer, 0);
+    }
+    for(uint32_t I = 0; I < Graph->MemoryCount; ++I) {
+        VulkanFreeAllocation(Device, Graph->Memories + I);
+    }
+    memset(Graph->Physicals, 0, sizeof(Graph->Physicals));
+    Graph->PhysicalCount = 0;
+    Graph->MemoryCount = 0;
+    Graph->TransientByteCount = 0;
+    Graph->AllocatedByteCount = 0;
+}
+
+static void VulkanDestroyFrameGraph(vulkan_frame_graph *Graph) {
+    if(Graph->Device) {
+        VulkanDestroyFrameGraphTransients(Graph);
+        for(uint32_t I = 0; I < Graph->RenderPassCount; ++I) {
+            vkDestroyRenderPass(Graph->Device->Handle, Graph->RenderPasses[I].Handle, 0);
+        }
+    }
+    memset(Graph, 0, sizeof(*Graph));
+}
+
+static void VulkanBeginFrameGraph(vulkan_frame_graph *Graph) {
+    Graph->HasOverflowed = 0;
+    Graph->ResourceCount = 0;
+    Graph->PassCount = 0;
+    Graph->UseCount = 0;
+}
+
+static uint32_t VulkanAddFrameGraphResource(vulkan_frame_graph *Graph, const char *Name, int IsImported, vulkan_frame_graph_transient Transient) {
+    if(Graph->ResourceCount >= ArrayCount(Graph->Resources)) {
+        Graph->HasOverflowed = 1;
+        return 0;
+    }
+    uint32_t Index = Graph->ResourceCount++;
+    vulkan_frame_graph_resource *Resource = Graph->Resources + Index;
+    memset(Resource, 0, sizeof(*Resource));
+    Resource->Name = Name;
+    Resource->IsImported = IsImported;
+    Resource->Transient = Transient;
+    Resource->Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Resource->SampleCount = VK_SAMPLE_COUNT_1_BIT;
+    return Index;
+}
+
+static uint32_t VulkanImportFrameGraphBuffer(vulkan_frame_graph *Graph, const char *Name, VkBuffer Buffer, VkPipelineStageFlags LastWriteStages, VkAccessFlags LastWriteAccesses) {
+    // NOTE(blackedout): The last writes may come from earlier frames, the first use in this frame waits for them
+    vulkan_frame_graph_transient Transient;
+    SetZero(Transient);
+    uint32_t Index = VulkanAddFrameGraphResource(Graph, Name, 1, Transient);
+    vulkan_frame_graph_resource *Resource = Graph->Resources + Index;
+    if(Graph->HasOverflowed == 0) {
+        Resource->Buffer = Buffer;
+        Resource->WriteStages = LastWriteStages;
+        Resource->WriteAccesses = LastWriteAccesses;
+    }
+    return Index;
+}
+
+static uint32_t VulkanImportFrameGraphImage(vulkan_frame_graph *Graph, const char *Name, VkImage Image, VkImageView View, VkFormat Format, VkSampleCountFlagBits SampleCount, VkImageAspectFlags Aspect, VkPipelineStageFlags LastUseStages) {
+    // NOTE(blackedout): A single level image. The first use in this frame waits for LastUseStages, where the previous frame last used it
+    // or where the submission waits for it to be acquired.
+    vulkan_frame_graph_transient Transient;
+    SetZero(Transient);
+    Transient.Type = VULKAN_FRAME_GRAPH_RESOURCE_TYPE_IMAGE;
+    Transient.Format = Format;
+    Transient.LevelCount = 1;
+    Transient.Aspect = Aspect;
+    uint32_t Index = VulkanAddFrameGraphResource(Graph, Name, 1, Transient);
+    vulkan_frame_graph_resource *Resource = Graph->Resources + Index;
+    if(Graph->HasOverflowed == 0) {
+        Resource->Image = Image;
+        Resource->View = View;
+        Resource->WriteStages = LastUseStages;
+        Resource->SampleCount = SampleCount;
+    }
+    return Index;
+}
+
+static uint32_t VulkanCreateFrameGraphBuffer(vulkan_frame_graph *Graph, const char *Name, VkDeviceSize ByteCount, VkBufferUsageFlags Usage) {
+    // NOTE(blackedout): The contents are undefined at the first use in every frame
+    vulkan_frame_graph_transient Transient;
+    SetZero(Transient);
+    Transient.Type = VULKAN_FRAME_GRAPH_RESOURCE_TYPE_BUFFER;
+    Transient.ByteCount = ByteCount;
+    Transient.Usage = Usage;
+    return VulkanAddFrameGraphResource(Graph, Name, 0, Transient);
+}
+
+static uint32_t VulkanCreateFrameGraphImage(vulkan_frame_graph *Graph, const char *Name, VkFormat Format, uint32_t Width, uint32_t Height, uint32_t LevelCount, VkImageUsageFlags Usage, VkImageAspectFlags Aspect) {
+    // NOTE(blackedout): 2D image with optimal tiling, in VK_IMAGE_LAYOUT_UNDEFINED at the first use in every frame
+    vulkan_frame_graph_transient Transient;
+    SetZero(Transient);
+    Transient.Type = VULKAN_FRAME_GRAPH_RESOURCE_TYPE_IMAGE;
+    Transient.Format = Format;
+    Transient.Width = Width;
+    Transient.Height = Height;
+    Transient.LevelCount = Min(LevelCount, VULKAN_FRAME_GRAPH_MAX_LEVEL_COUNT);
+    Transient.Aspect = Aspect;
+    Transient.Usage = Usage;
+    return VulkanAddFrameGraphResource(Graph, Name, 0, Transient);
+}
+
+static void VulkanAddFrameGraphPass(vulkan_frame_graph *Graph, const char *Name, vulkan_frame_graph_record_proc Record, void *Data, int HasSideEffects) {
+    // NOTE(blackedout): The uses of a pass are declared right after it. Data must live until the graph was executed.
+    if(Graph->PassCount >= ArrayCount(Graph->Passes)) {
+        Graph->HasOverflowed = 1;
+        return;
+    }
+    vulkan_frame_graph_pass Pass = {
+        .Name = Name,
+        .Record = Record,
+        .Data = Data,
+        .HasSideEffects = HasSideEffects,
+        .IsAsyncAllowed = 0,
+        .IsCulled = 0,
+        .IsAsync = 0,
+        .FirstUse = Graph->UseCount,
+        .UseCount = 0,
+        .OutRenderPass = 0,
+    };
+    Graph->Passes[Graph->PassCount++] = Pass;
+}
+
+static void VulkanAddFrameGraphRenderPass(vulkan_frame_graph *Graph, const char *Name, vulkan_frame_graph_record_proc Record, void *Data, int HasSideEffects, VkRenderPass *OutRenderPass) {
+    // NOTE(blackedout): Its attachments are declared with VulkanUseFrameGraphAttachment in framebuffer order. Compiling sets *OutRenderPass,
+    // which Record begins and ends.
+    VulkanAddFrameGraphPass(Graph, Name, Record, Data, HasSideEffects);
+    if(Graph->HasOverflowed == 0) {
+        Graph->Passes[Graph->PassCount - 1].OutRenderPass = OutRenderPass;
+    }
+}
+
+static void VulkanAddFrameGraphAsyncComputePass(vulkan_frame_graph *Graph, const char *Name, vulkan_frame_graph_record_proc Record, void *Data, int HasSideEffects) {
+    // NOTE(blackedout): Record may only record compute and transfer commands, it doesn't know which queue it is recorded for. Resources
+    // that aren't in the graph may only be read by it, and only if they are concurrent over both queue families.
+    VulkanAddFrameGraphPass(Graph, Name, Record, Data, HasSideEffects);
+    if(Graph->HasOverflowed == 0) {
+        Graph->Passes[Graph->PassCount - 1].IsAsyncAllowed = 1;
+    }
+}
+
+static void VulkanAddFrameGraphUse(vulkan_frame_graph *Graph, uint32_t Resource, int IsWrite, VkPipelineStageFlags Stages, VkAccessFlags Accesses, VkImageLayout Layout) {
+    if(Graph->PassCount == 0 || Graph->UseCount >= ArrayCount(Graph->Uses) || Resource >= Graph->ResourceCount) {
+        Graph->HasOverflowed = 1;
+        return;
+    }
+    vulkan_frame_graph_use Use = {
+        .Resource = Resource,
+        .IsWrite = IsWrite,
+        .Stages = Stages,
+        .Accesses = Accesses,
+        .Layout = Layout,
+        .Attachment = VULKAN_FRAME_GRAPH_ATTACHMENT_NONE,
+    };
+    Graph->Uses[Graph->UseCount++] = Use;
+    ++Graph->Passes[Graph->PassCount - 1].UseCount;
+}
+
+static void VulkanReadFrameGraphResource(vulkan_frame_graph *Graph, uint32_t Resource, VkPipelineStageFlags Stages, VkAccessFlags Accesses, VkImageLayout Layout) {
+    VulkanAddFrameGraphUse(Graph, Resource, 0, Stages, Accesses, Layout);
+}
+
+static void VulkanWriteFrameGraphResource(vulkan_frame_graph *Graph, uint32_t Resource, VkPipelineStageFlags Stages, VkAccessFlags Accesses, VkImageLayout Layout) {
+    VulkanAddFrameGraphUse(Graph, Resource, 1, Stages, Accesses, Layout);
+}
+
+static void VulkanUseFrameGraphAttachment(vulkan_frame_graph *Graph, uint32_t Resource, vulkan_frame_graph_attachment Attachment, int IsLoaded) {
+    // NOTE(blackedout): An attachment that isn't loaded is cleared, except for resolve attachments, which are always overwritten
+    VkPipelineStageFlags Stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkAccessFlags Accesses = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (IsLoaded? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0);
+    VkImageLayout Layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    if(Attachment == VULKAN_FRAME_GRAPH_ATTACHMENT_DEPTH) {
+        Stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        Accesses = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | (IsLoaded? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT : 0);
+        Layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+    VulkanAddFrameGraphUse(Graph, Resource, 1, Stages, Accesses, Layout);
+    if(Graph->HasOverflowed == 0) {
+        Graph->Uses[Graph->UseCount - 1].Attachment = Attachment;
+    }
+}
+
+static void VulkanPresentFrameGraphImage(vulkan_frame_graph *Graph, uint32_t Resource) {
+    // NOTE(blackedout): A pass without commands that transitions a swapchain image for presentation after everything that wrote it
+    VulkanAddFrameGraphPass(Graph, "Present", 0, 0, 1);
+    VulkanReadFrameGraphResource(Graph, Resource, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+}
+
+static int VulkanIsFrameGraphContentNeeded(vulkan_frame_graph *Graph, uint32_t PassIndex, uint32_t Resource) {
+    // NOTE(blackedout): Whether the first pass after PassIndex that uses the resource and isn't culled needs its previous contents
+    for(uint32_t I = PassIndex + 1; I < Graph->PassCount; ++I) {
+        vulkan_frame_graph_pass *Pass = Graph->Passes + I;
+        for(uint32_t J = 0; J < Pass->UseCount && Pass->IsCulled == 0; ++J) {
+            const vulkan_frame_graph_use *Use = Graph->Uses + Pass->FirstUse + J;
+            if(Use->Resource == Resource) {
+                return Use->IsWrite == 0 || (Use->Accesses & ~VULKAN_FRAME_GRAPH_WRITE_ACCESSES) != 0;
+            }
+        }
+    }
+    return 0;
+}
+
+static int VulkanGetFrameGraphRenderPass(vulkan_frame_graph *Graph, uint32_t PassIndex, VkRenderPass *OutRenderPass) {
+    vulkan_frame_graph_pass *Pass = Graph->Passes + PassIndex;
+    vulkan_frame_graph_render_pass Key;
+    SetZero(Key);
+    for(uint32_t I = 0; I < Pass->UseCount; ++I) {
+        const vulkan_frame_graph_use *Use = Graph->Uses + Pass->FirstUse + I;
+        if(Use->Attachment == VULKAN_FRAME_GRAPH_ATTACHMENT_NONE) {
+            continue;
+        }
+        AssertMessageGoto(Key.AttachmentCount < VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT, label_Error, "Render pass %s has more than %d attachments.\n", Pass->Name, VULKAN_FRAME_GRAPH_MAX_ATTACHMENT_COUNT);
+        vulkan_frame_graph_resource *Resource = Graph->Resources + Use->Resource;
+        VkAttachmentLoadOp LoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        if(Use->Attachment == VULKAN_FRAME_GRAPH_ATTACHMENT_RESOLVE) {
+            LoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        } else if(Use->Accesses & (VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT)) {
+            LoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        }
+        VkAttachmentDescription Description = {
+            .flags = 0,
+            .format = Resource->Transient.Format,
+            .samples = Resource->SampleCount,
+            .loadOp = LoadOp,
+            .storeOp = VulkanIsFrameGraphContentNeeded(Graph, PassIndex, Use->Resource)? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = Use->Layout,
+            .finalLayout = Use->Layout,
+        };
+        Key.Attachments[Key.AttachmentCount] = Use->Attachment;
+        Key.Descriptions[Key.AttachmentCount++] = Description;
+    }
+
+    for(uint32_t I = 0; I < Graph->RenderPassCount; ++I) {
+        vulkan_frame_graph_render_pass *RenderPass = Graph->RenderPasses + I;
+        if(RenderPass->AttachmentCount == Key.AttachmentCount && memcmp(RenderPass->Attachments, Key.Attachments, sizeof(Key.Attachments)) == 0 &&
+           memcmp(RenderPass->Descriptions, Key.Descriptions, sizeof(Key.Descriptions)) == 0) {
+            *OutRenderPass = RenderPass->Handle;
+            return 0;
+        }
+    }
+    AssertMessageGoto(Graph->RenderPassCount < VULKAN_FRAME_GRAPH_MAX_RENDER_PASS_COUNT, label_Error, "Frame graph needs more than %d different render passes.\n", VULKAN_FRAME_GRAPH_MAX_RENDER_PASS_COUNT);
+    CheckGoto(VulkanCreateAttachmentRenderPass(Graph->Device, Key.Descriptions, Key.Attachments, Key.AttachmentCount, &Key.Handle), label_Error);
+    Graph->RenderPasses[Graph->RenderPassCount++] = Key;
+    *OutRenderPass = Key.Handle;
+    return 0;
+
+label_Error:
+    return 1;
+}
 
-            VkMemoryRequirements ImageMemoryRequirements;
-            vkGetImageMemoryRequirements(DeviceHandle, OutImages[I].Handle, &ImageMemoryRequirements);
+static int VulkanAreFrameGraphLifetimesOverlapping(const vulkan_frame_graph_transient *A, const vulkan_frame_graph_transient *B) {
+    return A->FirstPass <= B->LastPass && B->FirstPass <= A->LastPass;
+}
+
+static int VulkanAreFrameGraphPhysicalsOverlapping(const vulkan_frame_graph_physical *A, const vulkan_frame_graph_physical *B) {
+    return A->MemoryIndex == B->MemoryIndex && A->MemoryOffset < B->MemoryOffset + B->Requirements.size && B->MemoryOffset < A->MemoryOffset + A->Requirements.size;
+}
 
-            uint64_t ByteOffset = AlignAny(AlignedTotalImagesByteCount, uint64_t, ImageMemoryRequirements.alignment);
-            AlignedTotalImagesByteCount = ByteOffset + ImageMemoryRequirements.size;
-            OutImages[I].Offset = ByteOffset;
+static int VulkanCreateFrameGraphTransients(vulkan_frame_graph *Graph) {
+    // NOTE(blackedout): Resources are placed from largest to smallest, each at the lowest offset where it doesn't overlap a resource that is
+    // alive at the same time, so that the offsets only depend on the descriptions. All offsets are aligned to bufferImageGranularity,
+    // because buffers and optimal images are placed next to each other. Everything that was created is destroyed on failure.
+    vulkan_surface_device *Device = Graph->Device;
+    VkDevice DeviceHandle = Device->Handle;
+    {
+        uint32_t Order[VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT];
+        uint32_t OrderCount = 0;
+        for(uint32_t I = 0; I < Graph->ResourceCount; ++I) {
+            vulkan_frame_graph_resource *Resource = Graph->Resources + I;
+            if(Resource->IsImported) {
+                continue;
+            }
+            vulkan_frame_graph_physical *Physical = Graph->Physicals + Graph->PhysicalCount++;
+            Physical->Transient = Resource->Transient;
+            Physical->MemoryIndex = UINT32_MAX;
+            if(Physical->Transient.FirstPass == UINT32_MAX) {
+                continue;
+            }
 
-            // TODO(blackedout): Handle this getting too restrictive
-            ImageMemoryTypeBits &= ImageMemoryRequirements.memoryTypeBits;
+            // NOTE(blackedout): Concurrent sharing instead of queue family ownership transfers between the two queues
+            uint32_t QueueFamilyIndices[] = { Device->GraphicsQueueFamilyIndex, Device->ComputeQueueFamilyIndex };
+            VkSharingMode SharingMode = Physical->Transient.IsShared? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+            uint32_t QueueFamilyIndexCount = Physical->Transient.IsShared? ArrayCount(QueueFamilyIndices) : 0;
+
+            if(Physical->Transient.Type == VULKAN_FRAME_GRAPH_RESOURCE_TYPE_BUFFER) {
+                VkBufferCreateInfo CreateInfo = {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+                    .pNext = 0,
+                    .flags = 0,
+                    .size = Physical->Transient.ByteCount,
+                    .usage = Physical->Transient.Usage,
+                    .sharingMode = SharingMode,
+                    .queueFamilyIndexCount = QueueFamilyIndexCount,
+                    .pQueueFamilyIndices = QueueFamilyIndices
+                };
+                VulkanCheckGoto(vkCreateBuffer(DeviceHandle, &CreateInfo, 0, &Physical->Buffer), label_Error);
+                vkGetBufferMemoryRequirements(DeviceHandle, Physical->Buffer, &Physical->Requirements);
+            } else {
+                VkImageCreateInfo CreateInfo = {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                    .pNext = 0,
+                    .flags = 0,
+                    .imageType = VK_IMAGE_TYPE_2D,
+                    .format = Physical->Transient.Format,
+                    .extent = { .width = Physical->Transient.Width, .height = Physical->Transient.Height, .depth = 1 },
+                    .mipLevels = Physical->Transient.LevelCount,
+                    .arrayLayers = 1,
+                    .samples = VK_SAMPLE_COUNT_1_BIT,
+                    .tiling = VK_IMAGE_TILING_OPTIMAL,
+                    .usage = Physical->Transient.Usage,
+                    .sharingMode = SharingMode,
+                    .queueFamilyIndexCount = QueueFamilyIndexCount,
+                    .pQueueFamilyIndices = QueueFamilyIndices,
+                    .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+                };
+                VulkanCheckGoto(vkCreateImage(DeviceHandle, &CreateInfo, 0, &Physical->Image), label_Error);
+                vkGetImageMemoryRequirements(DeviceHandle, Physical->Image, &Physical->Requirements);
+            }
+            Graph->TransientByteCount += Physical->Requirements.size;
 
-            if(I == 0) {
-                FirstImageAlignment = ImageMemoryRequirements.alignment;
+            uint32_t OrderIndex = OrderCount++;
+            for(; OrderIndex > 0 && Graph->Physicals[Order[OrderIndex - 1]].Requirements.size < Physical->Requirements.size; --OrderIndex) {
+                Order[OrderIndex] = Order[OrderIndex - 1];
             }
+            Order[OrderIndex] = Graph->PhysicalCount - 1;
         }
-        uint32_t ImageMemoryTypeIndex;
-        CheckGoto(VulkanGetBufferMemoryTypeIndex(Device, ImageMemoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &ImageMemoryTypeIndex), label_Images);
-        VkMemoryAllocateInfo ImageMemoryAllocateInfo = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .pNext = 0,
-            .allocationSize = AlignedTotalImagesByteCount,
-            .memoryTypeIndex = ImageMemoryTypeIndex
-        };
-        VulkanCheckGoto(vkAllocateMemory(DeviceHandle, &ImageMemoryAllocateInfo, 0, &StaticBuffers.MemoryBufs[1]), label_Images);
-        ++StaticBuffers.MemoryCount;
-        for(uint32_t I = 0; I < ImageCount; ++I) {
-            VulkanCheckGoto(vkBindImageMemory(DeviceHandle, OutImages[I].Handle, StaticBuffers.MemoryBufs[1], OutImages[I].Offset), label_Images);
+
+        uint32_t MemoryTypeBits[VULKAN_FRAME_GRAPH_MAX_MEMORY_COUNT];
+        VkDeviceSize MemorySizes[VULKAN_FRAME_GRAPH_MAX_MEMORY_COUNT];
+        VkDeviceSize MemoryAlignments[VULKAN_FRAME_GRAPH_MAX_MEMORY_COUNT];
+        uint32_t MemoryCount = 0;
+        for(uint32_t I = 0; I < OrderCount; ++I) {
+            vulkan_frame_graph_physical *Physical = Graph->Physicals + Order[I];
+            VkMemoryRequirements Requirements = Physical->Requirements;
+            VkDeviceSize Alignment = Max(Requirements.alignment, Device->Memory.BufferImageGranularity);
+            for(uint32_t MemoryIndex = 0; MemoryIndex < MemoryCount && Physical->MemoryIndex == UINT32_MAX; ++MemoryIndex) {
+                if((MemoryTypeBits[MemoryIndex] & Requirements.memoryTypeBits) == 0) {
+                    continue;
+                }
+                // NOTE(blackedout): Candidates are the start of the memory and the ends of resources that are alive at the same time.
+                // One of them always fits, the end of the last one.
+                VkDeviceSize BestOffset = UINT64_MAX;
+                for(uint32_t Candidate = 0; Candidate <= I; ++Candidate) {
+                    VkDeviceSize Offset = 0;
+                    if(Candidate < I) {
+                        vulkan_frame_graph_physical *Other = Graph->Physicals + Order[Candidate];
+                        if(Other->MemoryIndex != MemoryIndex || VulkanAreFrameGraphLifetimesOverlapping(&Other->Transient, &Physical->Transient) == 0) {
+                            continue;
+                        }
+                        Offset = AlignAny(Other->MemoryOffset + Other->Requirements.size, VkDeviceSize, Alignment);
+                    }
+                    Physical->MemoryIndex = MemoryIndex;
+                    Physical->MemoryOffset = Offset;
+                    int IsColliding = 0;
+                    for(uint32_t J = 0; J < I && IsColliding == 0; ++J) {
+                        vulkan_frame_graph_physical *Other = Graph->Physicals + Order[J];
+                        IsColliding = VulkanAreFrameGraphLifetimesOverlapping(&Other->Transient, &Physical->Transient) && VulkanAreFrameGraphPhysicalsOverlapping(Other, Physical);
+                    }
+                    if(IsColliding == 0) {
+                        BestOffset = Min(BestOffset, Offset);
+                    }
+                }
+                Physical->MemoryOffset = BestOffset;
+                MemoryTypeBits[MemoryIndex] &= Requirements.memoryTypeBits;
+                MemorySizes[MemoryIndex] = Max(MemorySizes[MemoryIndex], BestOffset + Requirements.size);
+                MemoryAlignments[MemoryIndex] = Max(MemoryAlignments[MemoryIndex], Alignment);
+            }
+            if(Physical->MemoryIndex == UINT32_MAX) {
+                AssertMessageGoto(MemoryCount < VULKAN_FRAME_GRAPH_MAX_MEMORY_COUNT, label_Error, "Frame graph resources need more than %d allocations.\n", VULKAN_FRAME_GRAPH_MAX_MEMORY_COUNT);
+                Physical->MemoryIndex = MemoryCount++;
+                Physical->MemoryOffset = 0;
+                MemoryTypeBits[Physical->MemoryIndex] = Requirements.memoryTypeBits;
+                MemorySizes[Physical->MemoryIndex] = Requirements.size;
+                MemoryAlignments[Physical->MemoryIndex] = Alignment;
+            }
         }
 
-        for(uint32_t I = 0; I < ImageCount; ++I) {
-            vulkan_image_description ImageDescription = ImageDescriptions[I];
-            VkImageViewCreateInfo ImageViewCreateInfo = {
+        for(uint32_t I = 0; I < MemoryCount; ++I) {
+            VkMemoryRequirements Requirements = {
+                .size = MemorySizes[I],
+                .alignment = MemoryAlignments[I],
+                .memoryTypeBits = MemoryTypeBits[I],
+            };
+            CheckGoto(VulkanAllocateAliasedMemory(Device, Requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_SUBSYSTEM_FRAME_GRAPH, Graph->Memories + I), label_Error);
+            Graph->MemoryCount = I + 1;
+            Graph->AllocatedByteCount += MemorySizes[I];
+        }
+
+        for(uint32_t I = 0; I < OrderCount; ++I) {
+            vulkan_frame_graph_physical *Physical = Graph->Physicals + Order[I];
+            vulkan_allocation *Memory = Graph->Memories + Physical->MemoryIndex;
+            VkDeviceSize Offset = Memory->Offset + Physical->MemoryOffset;
+            if(Physical->Buffer) {
+                VulkanCheckGoto(vkBindBufferMemory(DeviceHandle, Physical->Buffer, Memory->Memory, Offset), label_Error);
+                continue;
+            }
+            VulkanCheckGoto(vkBindImageMemory(DeviceHandle, Physical->Image, Memory->Memory, Offset), label_Error);
+
+            VkImageViewCreateInfo ViewCreateInfo = {
                 .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
                 .pNext = 0,
                 .flags = 0,
-                .image = OutImages[I].Handle,
-                .viewType = ImageDescription.ViewType,
-                .format = ImageDescription.Format,
+                .image = Physical->Image,
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = Physical->Transient.Format,
                 .components = { .r = VK_COMPONENT_SWIZZLE_IDENTITY, .g = VK_COMPONENT_SWIZZLE_IDENTITY, .b = VK_COMPONENT_SWIZZLE_IDENTITY, .a = VK_COMPONENT_SWIZZLE_IDENTITY },
-                .subresourceRange = {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .baseMipLevel = 0,
-                    .levelCount = 1,
-                    .baseArrayLayer = 0,
-                    .layerCount = 1,
-                }
+                .subresourceRange = { .aspectMask = Physical->Transient.Aspect, .baseMipLevel = 0, .levelCount = Physical->Transient.LevelCount, .baseArrayLayer = 0, .layerCount = 1 }
             };
+            VulkanCheckGoto(vkCreateImageView(DeviceHandle, &ViewCreateInfo, 0, &Physical->View), label_Error);
+            for(uint32_t Level = 0; Level < Physical->Transient.LevelCount; ++Level) {
+                ViewCreateInfo.subresourceRange.baseMipLevel = Level;
+                ViewCreateInfo.subresourceRange.levelCount = 1;
+                VulkanCheckGoto(vkCreateImageView(DeviceHandle, &ViewCreateInfo, 0, Physical->LevelViews + Level), label_Error);
+            }
+        }
+    }
+    return 0;
 
-            VulkanCheckGoto(vkCreateImageView(DeviceHandle, &ImageViewCreateInfo, 0, &OutImages[I].ViewHandle), label_ImageViews);
-            ++CreatedImageViewCount;
+label_Error:
+    VulkanDestroyFrameGraphTransients(Graph);
+    return 1;
+}
+
+static int VulkanCompileFrameGraph(vulkan_frame_graph *Graph) {
+    {
+        AssertMessageGoto(Graph->HasOverflowed == 0, label_Error, "Frame graph exceeds %d resources, %d passes or %d uses, or declares a use without a pass.\n",
+                          VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT, VULKAN_FRAME_GRAPH_MAX_PASS_COUNT, VULKAN_FRAME_GRAPH_MAX_USE_COUNT);
+
+        // NOTE(blackedout): Passes are visited from last to first. A pass is kept if it has side effects or writes a resource that is
+        // imported or read by a later pass that is kept.
+        int IsNeeded[VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT];
+        SetZero(IsNeeded);
+        Graph->CulledPassCount = 0;
+        for(uint32_t I = Graph->PassCount; I-- > 0;) {
+            vulkan_frame_graph_pass *Pass = Graph->Passes + I;
+            const vulkan_frame_graph_use *Uses = Graph->Uses + Pass->FirstUse;
+            int IsKept = Pass->HasSideEffects;
+            for(uint32_t J = 0; J < Pass->UseCount && IsKept == 0; ++J) {
+                IsKept = Uses[J].IsWrite && (Graph->Resources[Uses[J].Resource].IsImported || IsNeeded[Uses[J].Resource]);
+            }
+            Pass->IsCulled = IsKept == 0;
+            Graph->CulledPassCount += Pass->IsCulled;
+            for(uint32_t J = 0; J < Pass->UseCount && IsKept; ++J) {
+                if(Uses[J].IsWrite == 0 || (Uses[J].Accesses & ~VULKAN_FRAME_GRAPH_WRITE_ACCESSES)) {
+                    IsNeeded[Uses[J].Resource] = 1;
+                }
+            }
         }
 
-        // NOTE(blackedout): Create and fill staging buffer
-        // Staging buffer sections are created with alignments of destination buffers, because I'm not sure
-        // what alignment rules apply to transfer operations.
-        AlignedTotalBuffersByteCount = AlignAny(AlignedTotalBuffersByteCount, uint64_t, FirstImageAlignment);
-        CheckGoto(VulkanCreateExclusiveBufferWithMemory(Device, AlignedTotalBuffersByteCount + AlignedTotalImagesByteCount, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &StagingBuffer), label_Images);
+        // NOTE(blackedout): Passes are moved to the async compute queue in order, so that they never wait for the graphics queue
+        int IsOnGraphicsQueue[VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT];
+        SetZero(IsOnGraphicsQueue);
+        for(uint32_t I = 0; I < Graph->ResourceCount; ++I) {
+            Graph->Resources[I].Transient.IsShared = 0;
+        }
+        Graph->AsyncPassCount = 0;
+        Graph->AsyncWaitStages = 0;
+        for(uint32_t I = 0; I < Graph->PassCount; ++I) {
+            vulkan_frame_graph_pass *Pass = Graph->Passes + I;
+            if(Pass->IsCulled) {
+                continue;
+            }
+            const vulkan_frame_graph_use *Uses = Graph->Uses + Pass->FirstUse;
+            Pass->IsAsync = Pass->IsAsyncAllowed && Graph->Device->HasAsyncCompute;
+            for(uint32_t J = 0; J < Pass->UseCount && Pass->IsAsync; ++J) {
+                Pass->IsAsync = Graph->Resources[Uses[J].Resource].IsImported == 0 && IsOnGraphicsQueue[Uses[J].Resource] == 0 &&
+                                (Uses[J].Stages & ~(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT)) == 0;
+            }
+            Graph->AsyncPassCount += Pass->IsAsync;
+            for(uint32_t J = 0; J < Pass->UseCount; ++J) {
+                vulkan_frame_graph_transient *Transient = &Graph->Resources[Uses[J].Resource].Transient;
+                if(Pass->IsAsync) {
+                    Transient->IsShared = 1;
+                    continue;
+                }
+                IsOnGraphicsQueue[Uses[J].Resource] = 1;
+                if(Transient->IsShared) {
+                    Graph->AsyncWaitStages |= Uses[J].Stages;
+                }
+            }
+        }
+        // NOTE(blackedout): The semaphore also has to be waited for if nothing on the graphics queue uses the results, so that the
+        // in flight fence of the graphics submission covers the async compute submission
+        if(Graph->AsyncPassCount > 0 && Graph->AsyncWaitStages == 0) {
+            Graph->AsyncWaitStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        }
 
-        uint8_t *MappedStagingBuffer;
-        VulkanCheckGoto(vkMapMemory(DeviceHandle, StagingBuffer.Memory, 0, AlignedTotalBuffersByteCount + AlignedTotalImagesByteCount, 0, (void **)&MappedStagingBuffer), label_StagingBuffer);
-        uint64_t VertexOffset = 0, IndexOffset = 0;
-        for(uint32_t I = 0; I < MeshSubbufCount; ++I) {
-            vulkan_mesh_subbuf Subbuf = MeshSubbufs[I];
-            if(Subbuf.Vertices.Source && Subbuf.Vertices.ByteCount > 0) {
-                memcpy(MappedStagingBuffer + VertexOffset, Subbuf.Vertices.Source, Subbuf.Vertices.ByteCount);
-                *Subbuf.Vertices.OffsetPointer = VertexOffset;
-                VertexOffset += Subbuf.Vertices.ByteCount;
+        for(uint32_t I = 0; I < Graph->ResourceCount; ++I) {
+            Graph->Resources[I].Transient.FirstPass = UINT32_MAX;
+            Graph->Resources[I].Transient.LastPass = 0;
+        }
+        for(uint32_t I = 0; I < Graph->PassCount; ++I) {
+            vulkan_frame_graph_pass *Pass = Graph->Passes + I;
+            for(uint32_t J = 0; J < Pass->UseCount && Pass->IsCulled == 0; ++J) {
+                vulkan_frame_graph_transient *Transient = &Graph->Resources[Graph->Uses[Pass->FirstUse + J].Resource].Transient;
+                Transient->FirstPass = Min(Transient->FirstPass, I);
+                Transient->LastPass = Max(Transient->LastPass, I);
             }
-            if(Subbuf.Indices.Source && Subbuf.Indices.ByteCount > 0) {
-                memcpy(MappedStagingBuffer + IndexByteOffset + IndexOffset, Subbuf.Indices.Source, Subbuf.Indices.ByteCount);
-                *Subbuf.Indices.OffsetPointer = IndexOffset;
-                IndexOffset += Subbuf.Indices.ByteCount;
+        }
+        // NOTE(blackedout): The two queues don't run in the order of the passes, so shared resources don't alias anything
+        for(uint32_t I = 0; I < Graph->ResourceCount; ++I) {
+            vulkan_frame_graph_transient *Transient = &Graph->Resources[I].Transient;
+            if(Transient->IsShared) {
+                Transient->FirstPass = 0;
+                Transient->LastPass = Graph->PassCount - 1;
             }
         }
-        for(uint32_t I = 0; I < ImageCount; ++I) {
-            vulkan_image_description ImageDescription = ImageDescriptions[I];
-            memcpy(MappedStagingBuffer + AlignedTotalBuffersByteCount + OutImages[I].Offset, ImageDescription.Source, ImageDescription.ByteCount);
+
+        // NOTE(blackedout): The graph is usually the same every frame, then the transient resources of the last compile are reused
+        uint32_t TransientCount = 0;
+        int IsUnchanged = 1;
+        for(uint32_t I = 0; I < Graph->ResourceCount; ++I) {
+            vulkan_frame_graph_resource *Resource = Graph->Resources + I;
+            if(Resource->IsImported == 0) {
+                Resource->PhysicalIndex = TransientCount++;
+                IsUnchanged = IsUnchanged && Resource->PhysicalIndex < Graph->PhysicalCount &&
+                              memcmp(&Graph->Physicals[Resource->PhysicalIndex].Transient, &Resource->Transient, sizeof(Resource->Transient)) == 0;
+            }
+        }
+        if(IsUnchanged == 0 || TransientCount != Graph->PhysicalCount) {
+            VulkanDestroyFrameGraphTransients(Graph);
+            CheckGoto(VulkanCreateFrameGraphTransients(Graph), label_Error);
+            ++Graph->RecreateCount;
         }
-        vkUnmapMemory(DeviceHandle, StagingBuffer.Memory);
 
-        // NOTE(blackedout): Allocate transfer command buffer, record transfer of data, submit and wait for completion
-        VkCommandBufferAllocateInfo TransferCommandBufferAllocateInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        for(uint32_t I = 0; I < Graph->ResourceCount; ++I) {
+            vulkan_frame_graph_resource *Resource = Graph->Resources + I;
+            if(Resource->IsImported == 0) {
+                vulkan_frame_graph_physical *Physical = Graph->Physicals + Resource->PhysicalIndex;
+                Resource->Buffer = Physical->Buffer;
+                Resource->Image = Physical->Image;
+                Resource->View = Physical->View;
+                Resource->LevelViews = Physical->LevelViews;
+            }
+        }
+
+        for(uint32_t I = 0; I < Graph->PassCount; ++I) {
+            vulkan_frame_graph_pass *Pass = Graph->Passes + I;
+            if(Pass->IsCulled == 0 && Pass->OutRenderPass) {
+                CheckGoto(VulkanGetFrameGraphRenderPass(Graph, I, Pass->OutRenderPass), label_Error);
+            }
+        }
+    }
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static void VulkanExecuteFrameGraph(vulkan_frame_graph *Graph, VkCommandBuffer GraphicsCommandBuffer, VkCommandBuffer AsyncCommandBuffer) {
+    // NOTE(blackedout): Writes wait for all earlier reads and writes, reads only for the last write, and only if it wasn't made visible
+    // to their stages and accesses yet. Layout transitions count as writes. A transient resource's first use also waits for the last uses
+    // of the resources that were in its memory before.
+    // AsyncCommandBuffer is only used if the compiled graph has async passes. Its submission has to signal a semaphore that the submission
+    // of GraphicsCommandBuffer waits for at AsyncWaitStages.
+    Graph->BarrierCount = 0;
+    Graph->ResourceBarrierCount = 0;
+    for(uint32_t I = 0; I < Graph->PassCount; ++I) {
+        vulkan_frame_graph_pass *Pass = Graph->Passes + I;
+        if(Pass->IsCulled) {
+            continue;
+        }
+        VkCommandBuffer CommandBuffer = Pass->IsAsync? AsyncCommandBuffer : GraphicsCommandBuffer;
+        VkBufferMemoryBarrier BufferBarriers[VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT];
+        VkImageMemoryBarrier ImageBarriers[VULKAN_FRAME_GRAPH_MAX_RESOURCE_COUNT];
+        uint32_t BufferBarrierCount = 0, ImageBarrierCount = 0;
+        VkPipelineStageFlags SrcStages = 0, DstStages = 0;
+        for(uint32_t J = 0; J < Pass->UseCount; ++J) {
+            const vulkan_frame_graph_use *Use = Graph->Uses + Pass->FirstUse + J;
+            vulkan_frame_graph_resource *Resource = Graph->Resources + Use->Resource;
+            if(Resource->IsImported == 0 && Resource->IsStarted == 0) {
+                vulkan_frame_graph_physical *Physical = Graph->Physicals + Resource->PhysicalIndex;
+                for(uint32_t K = 0; K < Graph->ResourceCount; ++K) {
+                    vulkan_frame_graph_resource *Other = Graph->Resources + K;
+                    if(Other->IsImported == 0 && Other->IsStarted && VulkanAreFrameGraphPhysicalsOverlapping(Graph->Physicals + Other->PhysicalIndex, Physical)) {
+                        Resource->WriteStages |= Other->WriteStages | Other->ReadStages;
+                        Resource->WriteAccesses |= Other->WriteAccesses;
+                    }
+                }
+                Resource->IsStarted = 1;
+            }
+            if(Resource->IsOnAsyncQueue && Pass->IsAsync == 0) {
+                Resource->WriteStages = 0;
+                Resource->WriteAccesses = 0;
+                Resource->ReadStages = 0;
+            }
+            Resource->IsOnAsyncQueue = Pass->IsAsync;
+
+            int IsImage = Resource->Image != VULKAN_NULL_HANDLE;
+            int IsTransition = IsImage && Resource->Layout != Use->Layout;
+            VkPipelineStageFlags WaitStages = 0;
+            VkAccessFlags WaitAccesses = 0;
+            int IsBarrierNeeded = 0;
+            if(Use->IsWrite || IsTransition) {
+                WaitStages = Resource->WriteStages | Resource->ReadStages;
+                WaitAccesses = Resource->WriteAccesses;
+                IsBarrierNeeded = WaitStages != 0 || IsTransition;
+            } else if(Resource->WriteStages) {
+                WaitStages = Resource->WriteStages;
+                WaitAccesses = Resource->WriteAccesses;
+                IsBarrierNeeded = (Use->Stages & ~Resource->VisibleStages) || (Use->Accesses & ~Resource->VisibleAccesses);
+            }
+
+            if(IsBarrierNeeded && IsImage) {
+                VkImageMemoryBarrier Barrier = {
+                    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                    .pNext = 0,
+                    .srcAccessMask = WaitAccesses,
+                    .dstAccessMask = Use->Accesses,
+                    .oldLayout = Resource->Layout,
+                    .newLayout = Use->Layout,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .image = Resource->Image,
+                    .subresourceRange = { .aspectMask = Resource->Transient.Aspect, .baseMipLevel = 0, .levelCount = VK_REMAINING_MIP_LEVELS, .baseArrayLayer = 0, .layerCount = 1 }
+                };
+                ImageBarriers[ImageBarrierCount++] = Barrier;
+            } else if(IsBarrierNeeded) {
+                VkBufferMemoryBarrier Barrier = {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .pNext = 0,
+                    .srcAccessMask = WaitAccesses,
+                    .dstAccessMask = Use->Accesses,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer = Resource->Buffer,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE,
+                };
+                BufferBarriers[BufferBarrierCount++] = Barrier;
+            }
+            if(IsBarrierNeeded) {
+                SrcStages |= WaitStages;
+                DstStages |= Use->Stages;
+            }
+
+            if(Use->IsWrite) {
+                Resource->WriteStages = Use->Stages;
+                Resource->WriteAccesses = Use->Accesses & VULKAN_FRAME_GRAPH_WRITE_ACCESSES;
+                Resource->ReadStages = 0;
+                Resource->VisibleStages = 0;
+                Resource->VisibleAccesses = 0;
+            } else if(IsTransition) {
+                // NOTE(blackedout): Later uses in other stages wait for the transition, which happened before these stages
+                Resource->WriteStages = Use->Stages;
+                Resource->WriteAccesses = 0;
+                Resource->ReadStages = Use->Stages;
+                Resource->VisibleStages = Use->Stages;
+                Resource->VisibleAccesses = Use->Accesses;
+            } else {
+                Resource->ReadStages |= Use->Stages;
+                if(IsBarrierNeeded) {
+                    Resource->VisibleStages |= Use->Stages;
+                    Resource->VisibleAccesses |= Use->Accesses;
+                }
+            }
+            Resource->Layout = IsImage? Use->Layout : Resource->Layout;
+        }
+
+        if(BufferBarrierCount + ImageBarrierCount > 0) {
+            SrcStages = SrcStages? SrcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            vkCmdPipelineBarrier(CommandBuffer, SrcStages, DstStages, 0, 0, 0, BufferBarrierCount, BufferBarriers, ImageBarrierCount, ImageBarriers);
+            ++Graph->BarrierCount;
+            Graph->ResourceBarrierCount += BufferBarrierCount + ImageBarrierCount;
+        }
+        if(Pass->Record) {
+            Pass->Record(Pass->Data, CommandBuffer);
+        }
+    }
+}
+
+static void VulkanPrintFrameGraphStats(vulkan_frame_graph *Graph) {
+    printf("Frame graph: %u passes (%u culled, %u async compute), %u resources, %u barriers (%u buffer and image barriers), recreated %u times.\n", Graph->PassCount,
+           Graph->CulledPassCount, Graph->AsyncPassCount, Graph->ResourceCount, Graph->BarrierCount, Graph->ResourceBarrierCount, Graph->RecreateCount);
+    printf("Frame graph transients: %u resources (%llu bytes) in %u allocations (%llu bytes), %u render passes.\n", Graph->PhysicalCount,
+           (unsigned long long)Graph->TransientByteCount, Graph->MemoryCount, (unsigned long long)Graph->AllocatedByteCount, Graph->RenderPassCount);
+    for(uint32_t I = 0; I < Graph->PassCount; ++I) {
+        vulkan_frame_graph_pass *Pass = Graph->Passes + I;
+        printf("[%u] %s%s\n", I, Pass->Name, Pass->IsCulled? " (culled)" : (Pass->IsAsync? " (async compute)" : ""));
+    }
+}
+
+// MARK: Pipelines
+#define VULKAN_MAX_VERTEX_BINDINGS 4
+#define VULKAN_MAX_VERTEX_ATTRIBUTES 8
+#define VULKAN_MAX_SPECIALIZATION_CONSTANTS 4
+
+// NOTE(blackedout): Everything that is needed to create a graphics pipeline, stored by value so that it can be handed to other threads.
+// Always SetZero (or use VulkanDefaultGraphicsPipelineDescription) before filling, because descriptions are hashed and compared bytewise.
+// ModuleFS may be null for depth only pipelines. The attachment formats must match the render pass, they are part of the description
+// so that pipelines for different attachment setups never collide.
+typedef struct {
+    VkShaderModule ModuleVS, ModuleFS;
+    uint32_t SpecializationCountFS;
+    uint32_t SpecializationFS[VULKAN_MAX_SPECIALIZATION_CONSTANTS]; // NOTE(blackedout): 32 bit value of constant_id I of ModuleFS
+
+    uint32_t VertexBindingCount;
+    uint32_t VertexAttributeCount;
+    VkVertexInputBindingDescription VertexBindings[VULKAN_MAX_VERTEX_BINDINGS];
+    VkVertexInputAttributeDescription VertexAttributes[VULKAN_MAX_VERTEX_ATTRIBUTES];
+    VkPrimitiveTopology Topology;
+
+    VkPolygonMode PolygonMode;
+    VkCullModeFlags CullMode;
+    VkFrontFace FrontFace;
+
+    VkBool32 DepthTestEnable;
+    VkBool32 DepthWriteEnable;
+    VkCompareOp DepthCompareOp;
+
+    VkPipelineColorBlendAttachmentState Blend;
+
+    VkFormat ColorFormat;
+    VkFormat DepthFormat;
+    VkSampleCountFlagBits SampleCount;
+
+    VkPipelineLayout Layout;
+    VkRenderPass RenderPass;
+} vulkan_graphics_pipeline_description;
+
+static vulkan_graphics_pipeline_description VulkanDefaultGraphicsPipelineDescription(VkFormat ColorFormat, VkFormat DepthFormat, VkSampleCountFlagBits SampleCount, VkPipelineLayout Layout, VkRenderPass RenderPass) {
+    // NOTE(blackedout): Opaque, back face culled, depth tested and written. Shaders and vertex layout still have to be set.
+    vulkan_graphics_pipeline_description Result;
+    SetZero(Result);
+    Result.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    Result.PolygonMode = VK_POLYGON_MODE_FILL;
+    Result.CullMode = VK_CULL_MODE_BACK_BIT;
+    Result.FrontFace = VK_FRONT_FACE_CLOCKWISE;
+    Result.DepthTestEnable = VK_TRUE;
+    Result.DepthWriteEnable = VK_TRUE;
+    Result.DepthCompareOp = VK_COMPARE_OP_LESS;
+    Result.Blend.blendEnable = VK_FALSE;
+    Result.Blend.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+    Result.Blend.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+    Result.Blend.colorBlendOp = VK_BLEND_OP_ADD;
+    Result.Blend.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    Result.Blend.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    Result.Blend.alphaBlendOp = VK_BLEND_OP_ADD;
+    Result.Blend.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    Result.ColorFormat = ColorFormat;
+    Result.DepthFormat = DepthFormat;
+    Result.SampleCount = SampleCount;
+    Result.Layout = Layout;
+    Result.RenderPass = RenderPass;
+    return Result;
+}
+
+// NOTE(blackedout): Creates a complete pipeline if Parts is 0. Otherwise creates a pipeline library (VK_EXT_graphics_pipeline_library) that only contains the state of the given parts.
+static int VulkanCreateGraphicsPipelineParts(VkDevice DeviceHandle, VkPipelineCache Cache, vulkan_graphics_pipeline_description *Description, VkGraphicsPipelineLibraryFlagsEXT Parts, VkPipeline *OutPipeline) {
+    int IsLibrary = Parts != 0;
+    int HasVertexInput = !IsLibrary || (Parts & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT);
+    int HasPreRasterization = !IsLibrary || (Parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+    int HasFragmentShader = !IsLibrary || (Parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+    int HasFragmentOutput = !IsLibrary || (Parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT);
+
+    {
+        VkPipelineShaderStageCreateInfo PipelineStageCreateInfos[2];
+        uint32_t PipelineStageCount = 0;
+        VkPipelineShaderStageCreateInfo PipelineStageCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .pNext = 0,
-            .commandPool = TransferCommandPool,
-            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = 1,
+            .flags = 0,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = Description->ModuleVS,
+            .pName = "main", // NOTE(blackedout): Entry point
+            .pSpecializationInfo = 0
         };
-        VulkanCheckGoto(vkAllocateCommandBuffers(DeviceHandle, &TransferCommandBufferAllocateInfo, &TransferCommandBuffer), label_StagingBuffer);
+        if(HasPreRasterization) {
+            PipelineStageCreateInfos[PipelineStageCount++] = PipelineStageCreateInfo;
+        }
+        VkSpecializationMapEntry SpecializationMapEntries[VULKAN_MAX_SPECIALIZATION_CONSTANTS];
+        for(uint32_t I = 0; I < Description->SpecializationCountFS; ++I) {
+            VkSpecializationMapEntry MapEntry = { .constantID = I, .offset = I*sizeof(uint32_t), .size = sizeof(uint32_t) };
+            SpecializationMapEntries[I] = MapEntry;
+        }
+        VkSpecializationInfo SpecializationInfoFS = {
+            .mapEntryCount = Description->SpecializationCountFS,
+            .pMapEntries = SpecializationMapEntries,
+            .dataSize = Description->SpecializationCountFS*sizeof(uint32_t),
+            .pData = Description->SpecializationFS
+        };
+        if(HasFragmentShader && Description->ModuleFS) {
+            PipelineStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            PipelineStageCreateInfo.module = Description->ModuleFS;
+            PipelineStageCreateInfo.pSpecializationInfo = (Description->SpecializationCountFS > 0)? &SpecializationInfoFS : 0;
+            PipelineStageCreateInfos[PipelineStageCount++] = PipelineStageCreateInfo;
+        }
 
-        VkCommandBufferBeginInfo TransferBeginInfo = {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        VkPipelineVertexInputStateCreateInfo PipelineVertexInputStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
             .pNext = 0,
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-            .pInheritanceInfo = 0
+            .flags = 0,
+            .vertexBindingDescriptionCount = Description->VertexBindingCount,
+            .pVertexBindingDescriptions = Description->VertexBindings,
+            .vertexAttributeDescriptionCount = Description->VertexAttributeCount,
+            .pVertexAttributeDescriptions = Description->VertexAttributes,
         };
-        VulkanCheckGoto(vkBeginCommandBuffer(TransferCommandBuffer, &TransferBeginInfo), label_CommandBuffer);
-        VkBufferCopy VertexBufferCopy = {
-            .srcOffset = VertexByteOffset,
-            .dstOffset = 0,
-            .size = TotalVertexByteCount
+
+        VkDynamicState VulkanDynamicStates[] = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR,
         };
-        VkBufferCopy IndexBufferCopy = {
-            .srcOffset = IndexByteOffset,
-            .dstOffset = 0,
-            .size = TotalIndexByteCount
+
+        VkPipelineDynamicStateCreateInfo PipelineDynamicStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .dynamicStateCount = ArrayCount(VulkanDynamicStates),
+            .pDynamicStates = VulkanDynamicStates
         };
-        vkCmdCopyBuffer(TransferCommandBuffer, StagingBuffer.Handle, StaticBuffers.VertexHandle, 1, &VertexBufferCopy);
-        vkCmdCopyBuffer(TransferCommandBuffer, StagingBuffer.Handle, StaticBuffers.IndexHandle, 1, &IndexBufferCopy);
 
-        // TODO(blackedout): Get a better understanding of access synchronization
-        // https://www.cg.tuwien.ac.at/courses/EinfCG/slides/VulkanLectureSeries/ECG2021_VK05_PipelinesAndStages.pdf
-        // https://themaister.net/blog/2019/08/14/yet-another-blog-explaining-vulkan-synchronization/
-        for(uint32_t I = 0; I < ImageCount; ++I) {
-            VkImageMemoryBarrier ImageMemoryBarrier = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .pNext = 0,
-                .srcAccessMask = 0,
-                .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .image = OutImages[I].Handle,
-                .subresourceRange = {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .baseMipLevel = 0,
-                    .levelCount = 1,
-                    .baseArrayLayer = 0,
-                    .layerCount = 1
-                }
-            };
-            vkCmdPipelineBarrier(TransferCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &ImageMemoryBarrier);
-        }
+        VkPipelineInputAssemblyStateCreateInfo PipelineInputAssemblyStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .topology = Description->Topology,
+            .primitiveRestartEnable = VK_FALSE,
+        };
+
+        // NOTE(blackedout): Viewport and scissor are dynamic, so only the counts matter here.
+        VkPipelineViewportStateCreateInfo PipelineViewportStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .viewportCount = 1,
+            .pViewports = 0,
+            .scissorCount = 1,
+            .pScissors = 0,
+        };
+
+        VkPipelineRasterizationStateCreateInfo PipelineRasterizationStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .depthClampEnable = VK_FALSE,
+            .rasterizerDiscardEnable = VK_FALSE,
+            .polygonMode = Description->PolygonMode,
+            .cullMode = Description->CullMode,
+            .frontFace = Description->FrontFace,
+            .depthBiasEnable = VK_FALSE,
+            .depthBiasConstantFactor = 0.0f,
+            .depthBiasClamp = 0.0f,
+            .depthBiasSlopeFactor = 0.0f,
+            .lineWidth = 1.0f,
+        };
+
+        VkPipelineMultisampleStateCreateInfo PipelineMultiSampleStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .rasterizationSamples = Description->SampleCount,
+            .sampleShadingEnable = VK_FALSE, // TODO(blackedout): Enable this?
+            .minSampleShading = 1.0f,
+            .pSampleMask = 0,
+            .alphaToCoverageEnable = VK_FALSE,
+            .alphaToOneEnable = VK_FALSE
+        };
         
-        for(uint32_t I = 0; I < ImageCount; ++I) {
-            VkBufferImageCopy BufferImageCopy = {
-                .bufferOffset = AlignedTotalBuffersByteCount + OutImages[I].Offset,
-                .bufferRowLength = 0,
-                .bufferImageHeight = 0,
-                .imageSubresource = {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .mipLevel = 0,
-                    .baseArrayLayer = 0,
-                    .layerCount = 1,
-                },
-                .imageOffset = { 0, 0, 0 },
-                .imageExtent = { ImageDescriptions[I].Width, ImageDescriptions[I].Height, ImageDescriptions[I].Depth } // TODO
-            };
-            vkCmdCopyBufferToImage(TransferCommandBuffer, StagingBuffer.Handle, OutImages[I].Handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &BufferImageCopy);
-        }
-        for(uint32_t I = 0; I < ImageCount; ++I) {
-            VkImageMemoryBarrier ImageMemoryBarrier = {
-                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-                .pNext = 0,
-                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-                .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .image = OutImages[I].Handle,
-                .subresourceRange = {
-                    .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                    .baseMipLevel = 0,
-                    .levelCount = 1,
-                    .baseArrayLayer = 0,
-                    .layerCount = 1,
-                }
-            };
-            vkCmdPipelineBarrier(TransferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &ImageMemoryBarrier);
-        }
-        VulkanCheckGoto(vkEndCommandBuffer(TransferCommandBuffer), label_CommandBuffer);
+        VkStencilOpState EmptyStencilOpState;
+        memset(&EmptyStencilOpState, 0, sizeof(EmptyStencilOpState));
+        VkPipelineDepthStencilStateCreateInfo PipelineDepthStencilStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+            .pNext = 0,
+            .flags = 0,
+            .depthTestEnable = Description->DepthTestEnable,
+            .depthWriteEnable = Description->DepthWriteEnable,
+            .depthCompareOp = Description->DepthCompareOp,
+            .depthBoundsTestEnable = VK_FALSE,
+            .stencilTestEnable = VK_FALSE,
+            .front = EmptyStencilOpState,
+            .back = EmptyStencilOpState,
+            .minDepthBounds = 0.0f,
+            .maxDepthBounds = 1.0f,
+        };
 
-        VkSubmitInfo TransferSubmitInfo = {
-            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        VkPipelineColorBlendStateCreateInfo PipelineColorBlendStateCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
             .pNext = 0,
-            .waitSemaphoreCount = 0,
-            .pWaitSemaphores = 0,
-            .pWaitDstStageMask = 0,
-            .commandBufferCount = 1,
-            .pCommandBuffers = &TransferCommandBuffer,
-            .signalSemaphoreCount = 0,
-            .pSignalSemaphores = 0
+            .flags = 0,
+            .logicOpEnable = VK_FALSE,
+            .logicOp = VK_LOGIC_OP_CLEAR,
+            .attachmentCount = 1,
+            .pAttachments = &Description->Blend,
+            .blendConstants = {0.0f, 0.0f, 0.0f, 0.0f}
+        };
+
+        VkGraphicsPipelineLibraryCreateInfoEXT PipelineLibraryCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+            .pNext = 0,
+            .flags = Parts
+        };
+
+        // NOTE(blackedout): Each library only gets the state that belongs to its parts (the rest is ignored or even invalid).
+        // Libraries retain link time optimization info so that an optimized pipeline can be linked from them later.
+        VkGraphicsPipelineCreateInfo GraphicsPipelineCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .pNext = IsLibrary? &PipelineLibraryCreateInfo : 0,
+            .flags = IsLibrary? (VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT) : 0,
+            .stageCount = PipelineStageCount,
+            .pStages = PipelineStageCount? PipelineStageCreateInfos : 0,
+            .pVertexInputState = HasVertexInput? &PipelineVertexInputStateCreateInfo : 0,
+            .pInputAssemblyState = HasVertexInput? &PipelineInputAssemblyStateCreateInfo : 0,
+            .pTessellationState = 0,
+            .pViewportState = HasPreRasterization? &PipelineViewportStateCreateInfo : 0,
+            .pRasterizationState = HasPreRasterization? &PipelineRasterizationStateCreateInfo : 0,
+            .pMultisampleState = (HasFragmentShader || HasFragmentOutput)? &PipelineMultiSampleStateCreateInfo : 0,
+            .pDepthStencilState = HasFragmentShader? &PipelineDepthStencilStateCreateInfo : 0,
+            .pColorBlendState = HasFragmentOutput? &PipelineColorBlendStateCreateInfo : 0,
+            .pDynamicState = HasPreRasterization? &PipelineDynamicStateCreateInfo : 0,
+            .layout = (HasPreRasterization || HasFragmentShader)? Description->Layout : VULKAN_NULL_HANDLE,
+            .renderPass = (HasPreRasterization || HasFragmentShader || HasFragmentOutput)? Description->RenderPass : VULKAN_NULL_HANDLE,
+            .subpass = 0,
+            .basePipelineHandle = VULKAN_NULL_HANDLE,
+            .basePipelineIndex = -1
+        };
+
+        VulkanCheckGoto(vkCreateGraphicsPipelines(DeviceHandle, Cache, 1, &GraphicsPipelineCreateInfo, 0, OutPipeline), label_Error);
+    }
+
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+// NOTE(blackedout): Links complete pipeline libraries into an executable pipeline. Not optimizing is meant to be fast enough to do at any time.
+static int VulkanLinkGraphicsPipeline(VkDevice DeviceHandle, VkPipelineCache Cache, VkPipelineLayout Layout, VkPipeline *Libraries, uint32_t LibraryCount, int Optimize, VkPipeline *OutPipeline) {
+    {
+        VkPipelineLibraryCreateInfoKHR PipelineLibraryCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+            .pNext = 0,
+            .libraryCount = LibraryCount,
+            .pLibraries = Libraries
+        };
+
+        VkGraphicsPipelineCreateInfo GraphicsPipelineCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .pNext = &PipelineLibraryCreateInfo,
+            .flags = Optimize? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0,
+            .stageCount = 0,
+            .pStages = 0,
+            .layout = Layout,
+            .renderPass = VULKAN_NULL_HANDLE,
+            .subpass = 0,
+            .basePipelineHandle = VULKAN_NULL_HANDLE,
+            .basePipelineIndex = -1
         };
 
-        VulkanCheckGoto(vkQueueSubmit(TransferQueue, 1, &TransferSubmitInfo, VULKAN_NULL_HANDLE), label_CommandBuffer);
-        VulkanCheckGoto(vkQueueWaitIdle(TransferQueue), label_CommandBuffer);
+        VulkanCheckGoto(vkCreateGraphicsPipelines(DeviceHandle, Cache, 1, &GraphicsPipelineCreateInfo, 0, OutPipeline), label_Error);
+    }
+
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+// MARK: Pipeline Compiler
+// NOTE(blackedout): The pipeline compiler creates graphics pipelines on worker threads, so that requesting a new pipeline never stalls a frame.
+// If graphics pipeline libraries are available, the four library parts are created (or reused) first and quickly linked into an unoptimized
+// pipeline, which is published right away. The link time optimized pipeline is then swapped in once it is ready.
+// Requested pipelines are written into a target VkPipeline owned by the caller, but only during VulkanPollPipelineCompiler (frame boundary).
+// Pipelines that are replaced this way are retired and destroyed a few polls later, when the GPU can't be using them anymore.
+#define PIPELINE_COMPILER_MAX_THREAD_COUNT 4
+#define PIPELINE_COMPILER_MAX_JOB_COUNT 32
+#define PIPELINE_COMPILER_MAX_LIBRARY_COUNT 128
+#define PIPELINE_COMPILER_MAX_RETIRED_COUNT 64
+#define PIPELINE_COMPILER_RETIRE_POLL_COUNT (MAX_ACQUIRED_IMAGE_COUNT + 1)
+
+typedef enum {
+    PIPELINE_JOB_FREE,
+    PIPELINE_JOB_QUEUED,
+    PIPELINE_JOB_COMPILING,
+    PIPELINE_JOB_DONE,
+    PIPELINE_JOB_FAILED
+} vulkan_pipeline_job_state;
 
-        *OutStaticBuffers = StaticBuffers;
+typedef struct {
+    vulkan_pipeline_job_state State;
+    uint64_t Sequence;
+    int IsSuperseded;
+    int IsFastPublished;
+
+    vulkan_graphics_pipeline_description Description;
+    VkPipeline *Target;
+
+    VkPipeline FastPipeline;
+    VkPipeline Pipeline;
+} vulkan_pipeline_job;
+
+typedef struct {
+    VkGraphicsPipelineLibraryFlagsEXT Part;
+    vulkan_graphics_pipeline_description Key;
+    VkPipeline Library;
+} vulkan_pipeline_library;
+
+typedef struct {
+    VkPipeline Pipeline;
+    uint32_t PollsLeft;
+} vulkan_retired_pipeline;
+
+typedef struct {
+    VkDevice DeviceHandle;
+    VkPipelineCache Cache;
+    int UseLibraries;
+
+    platform_mutex Mutex;
+    platform_condition JobQueued;
+    platform_condition JobProgressed;
+    int ShouldQuit;
+
+    uint32_t ThreadCount;
+    platform_thread Threads[PIPELINE_COMPILER_MAX_THREAD_COUNT];
+
+    uint64_t NextSequence;
+    vulkan_pipeline_job Jobs[PIPELINE_COMPILER_MAX_JOB_COUNT];
+
+    uint32_t LibraryCount;
+    vulkan_pipeline_library Libraries[PIPELINE_COMPILER_MAX_LIBRARY_COUNT];
+
+    // NOTE(blackedout): Only accessed by the polling thread.
+    uint32_t RetiredCount;
+    vulkan_retired_pipeline Retired[PIPELINE_COMPILER_MAX_RETIRED_COUNT];
+} vulkan_pipeline_compiler;
+
+static VkGraphicsPipelineLibraryFlagsEXT VULKAN_PIPELINE_LIBRARY_PARTS[] = {
+    VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+    VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+};
+
+static vulkan_graphics_pipeline_description VulkanPipelineLibraryKey(vulkan_graphics_pipeline_description *Description, VkGraphicsPipelineLibraryFlagsEXT Part) {
+    // NOTE(blackedout): Only the members that go into a library part are copied, so that e.g. all pipelines with the same vertex layout share one vertex input library.
+    vulkan_graphics_pipeline_description Key;
+    SetZero(Key);
+    switch(Part) {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+        Key.VertexBindingCount = Description->VertexBindingCount;
+        Key.VertexAttributeCount = Description->VertexAttributeCount;
+        memcpy(Key.VertexBindings, Description->VertexBindings, Description->VertexBindingCount*sizeof(*Key.VertexBindings));
+        memcpy(Key.VertexAttributes, Description->VertexAttributes, Description->VertexAttributeCount*sizeof(*Key.VertexAttributes));
+        Key.Topology = Description->Topology;
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+        Key.ModuleVS = Description->ModuleVS;
+        Key.PolygonMode = Description->PolygonMode;
+        Key.CullMode = Description->CullMode;
+        Key.FrontFace = Description->FrontFace;
+        Key.Layout = Description->Layout;
+        Key.RenderPass = Description->RenderPass;
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+        Key.ModuleFS = Description->ModuleFS;
+        Key.SpecializationCountFS = Description->SpecializationCountFS;
+        memcpy(Key.SpecializationFS, Description->SpecializationFS, Description->SpecializationCountFS*sizeof(*Key.SpecializationFS));
+        Key.DepthTestEnable = Description->DepthTestEnable;
+        Key.DepthWriteEnable = Description->DepthWriteEnable;
+        Key.DepthCompareOp = Description->DepthCompareOp;
+        Key.DepthFormat = Description->DepthFormat;
+        Key.SampleCount = Description->SampleCount;
+        Key.Layout = Description->Layout;
+        Key.RenderPass = Description->RenderPass;
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+        Key.Blend = Description->Blend;
+        Key.ColorFormat = Description->ColorFormat;
+        Key.DepthFormat = Description->DepthFormat;
+        Key.SampleCount = Description->SampleCount;
+        Key.RenderPass = Description->RenderPass;
+        break;
+    default:
+        break;
+    }
+    return Key;
+}
+
+static int VulkanGetPipelineLibrary(vulkan_pipeline_compiler *Compiler, vulkan_graphics_pipeline_description *Description, VkGraphicsPipelineLibraryFlagsEXT Part, VkPipeline *OutLibrary) {
+    vulkan_graphics_pipeline_description Key = VulkanPipelineLibraryKey(Description, Part);
+    VkPipeline Library = VULKAN_NULL_HANDLE;
+
+    PlatformMutexLock(&Compiler->Mutex);
+    for(uint32_t I = 0; I < Compiler->LibraryCount; ++I) {
+        vulkan_pipeline_library *Entry = Compiler->Libraries + I;
+        if(Entry->Part == Part && memcmp(&Entry->Key, &Key, sizeof(Key)) == 0) {
+            Library = Entry->Library;
+            break;
+        }
+    }
+    PlatformMutexUnlock(&Compiler->Mutex);
+
+    if(Library == VULKAN_NULL_HANDLE) {
+        CheckGoto(VulkanCreateGraphicsPipelineParts(Compiler->DeviceHandle, Compiler->Cache, &Key, Part, &Library), label_Error);
+
+        // NOTE(blackedout): Another thread may have created the same library in the meantime, in which case the new one is thrown away.
+        VkPipeline DuplicateLibrary = VULKAN_NULL_HANDLE;
+        PlatformMutexLock(&Compiler->Mutex);
+        for(uint32_t I = 0; I < Compiler->LibraryCount; ++I) {
+            vulkan_pipeline_library *Entry = Compiler->Libraries + I;
+            if(Entry->Part == Part && memcmp(&Entry->Key, &Key, sizeof(Key)) == 0) {
+                DuplicateLibrary = Library;
+                Library = Entry->Library;
+                break;
+            }
+        }
+        int IsFull = DuplicateLibrary == VULKAN_NULL_HANDLE && Compiler->LibraryCount >= ArrayCount(Compiler->Libraries);
+        if(DuplicateLibrary == VULKAN_NULL_HANDLE && IsFull == 0) {
+            vulkan_pipeline_library Entry = { .Part = Part, .Key = Key, .Library = Library };
+            Compiler->Libraries[Compiler->LibraryCount++] = Entry;
+        }
+        PlatformMutexUnlock(&Compiler->Mutex);
 
-        vkFreeCommandBuffers(DeviceHandle, TransferCommandPool, 1, &TransferCommandBuffer);
-        TransferCommandBuffer = 0;
-        VulkanDestroyBuffer(Device, &StagingBuffer);
+        vkDestroyPipeline(Compiler->DeviceHandle, DuplicateLibrary, 0);
+        if(IsFull) {
+            printfc(CODE_RED, "Pipeline library cache is full (%d libraries).\n", Compiler->LibraryCount);
+            vkDestroyPipeline(Compiler->DeviceHandle, Library, 0);
+            goto label_Error;
+        }
     }
 
+    *OutLibrary = Library;
     return 0;
 
-label_CommandBuffer:
-    vkFreeCommandBuffers(DeviceHandle, TransferCommandPool, 1, &TransferCommandBuffer);
-    TransferCommandBuffer = 0;
-label_StagingBuffer:
-    VulkanDestroyBuffer(Device, &StagingBuffer);
-label_ImageViews:
-    for(uint32_t I = 0; I < CreatedImageViewCount; ++I) {
-        vkDestroyImageView(DeviceHandle, OutImages[I].ViewHandle, 0);
-        OutImages[I].ViewHandle = 0;
-    }
-label_Images:
-    for(uint32_t I = 0; I < CreatedImageCount; ++I) {
-        vkDestroyImage(DeviceHandle, OutImages[I].Handle, 0);
-        OutImages[I].Handle = 0;
-    }
-label_BufferMemory:
-    for(uint32_t I = 0; I < StaticBuffers.MemoryCount; ++I) {
-        vkFreeMemory(DeviceHandle, StaticBuffers.MemoryBufs[I], 0);
-        StaticBuffers.MemoryBufs[I] = 0;
-    }
-label_IndexBuffer:
-    vkDestroyBuffer(DeviceHandle, StaticBuffers.IndexHandle, 0);
-    StaticBuffers.IndexHandle = 0;
-label_VertexBuffer:
-    vkDestroyBuffer(DeviceHandle, StaticBuffers.VertexHandle, 0);
-    StaticBuffers.VertexHandle = 0;
 label_Error:
     return 1;
 }
 
-// MARK: Shaders
-static int VulkanCreateShaderModule(vulkan_surface_device *Device, const uint8_t *Bytes, uint64_t ByteCount, VkShaderModule *OutModule) {
-    VkDevice DeviceHandle = Device->Handle;
+static int VulkanCompileGraphicsPipeline(vulkan_pipeline_compiler *Compiler, vulkan_pipeline_job *Job, vulkan_graphics_pipeline_description *Description, VkPipeline *OutPipeline) {
+    // NOTE(blackedout): Called without holding the mutex, only Job->FastPipeline is written while holding it.
+    VkDevice DeviceHandle = Compiler->DeviceHandle;
+    if(Compiler->UseLibraries == 0) {
+        return VulkanCreateGraphicsPipelineParts(DeviceHandle, Compiler->Cache, Description, 0, OutPipeline);
+    }
 
-    {
-        AssertMessageGoto(ByteCount < (uint64_t)SIZE_T_MAX, label_Error, "Too many bytes in shader code.\n");
-        VkShaderModuleCreateInfo CreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .codeSize = (size_t)ByteCount,
-            .pCode = (uint32_t *)Bytes
-        };
-        
-        VulkanCheckGoto(vkCreateShaderModule(DeviceHandle, &CreateInfo, 0, OutModule), label_Error);
+    VkPipeline Libraries[ArrayCount(VULKAN_PIPELINE_LIBRARY_PARTS)];
+    for(uint32_t I = 0; I < ArrayCount(VULKAN_PIPELINE_LIBRARY_PARTS); ++I) {
+        CheckGoto(VulkanGetPipelineLibrary(Compiler, Description, VULKAN_PIPELINE_LIBRARY_PARTS[I], Libraries + I), label_Error);
     }
 
+    VkPipeline FastPipeline;
+    CheckGoto(VulkanLinkGraphicsPipeline(DeviceHandle, Compiler->Cache, Description->Layout, Libraries, ArrayCount(Libraries), 0, &FastPipeline), label_Error);
+    PlatformMutexLock(&Compiler->Mutex);
+    Job->FastPipeline = FastPipeline;
+    PlatformConditionBroadcast(&Compiler->JobProgressed);
+    PlatformMutexUnlock(&Compiler->Mutex);
+
+    CheckGoto(VulkanLinkGraphicsPipeline(DeviceHandle, Compiler->Cache, Description->Layout, Libraries, ArrayCount(Libraries), 1, OutPipeline), label_Error);
+
     return 0;
 
 label_Error:
     return 1;
 }
 
-typedef struct {
-    VkDescriptorSetLayoutCreateFlags Flags;
-    VkDescriptorSetLayoutBinding *Bindings;
-    uint32_t BindingsCount;
-} vulkan_descriptor_set_layout_description;
+static void VulkanPipelineCompilerThread(void *Data) {
+    vulkan_pipeline_compiler *Compiler = (vulkan_pipeline_compiler *)Data;
+
+    PlatformMutexLock(&Compiler->Mutex);
+    for(;;) {
+        // NOTE(blackedout): Pick the oldest queued job, so that pipelines are compiled in request order.
+        vulkan_pipeline_job *Job = 0;
+        for(uint32_t I = 0; I < ArrayCount(Compiler->Jobs); ++I) {
+            vulkan_pipeline_job *Candidate = Compiler->Jobs + I;
+            if(Candidate->State == PIPELINE_JOB_QUEUED && (Job == 0 || Candidate->Sequence < Job->Sequence)) {
+                Job = Candidate;
+            }
+        }
 
-static void VulkanDestroyDescriptorSetLayouts(vulkan_surface_device *Device, VkDescriptorSetLayout *DescriptorSetLayouts, uint32_t Count) {
-    VkDevice DeviceHandle = Device->Handle;
-    for(uint32_t I = 0; I < Count; ++I) {
-        vkDestroyDescriptorSetLayout(DeviceHandle, DescriptorSetLayouts[I], 0);
-        DescriptorSetLayouts[I] = 0;
+        if(Job == 0) {
+            if(Compiler->ShouldQuit) {
+                break;
+            }
+            PlatformConditionWait(&Compiler->JobQueued, &Compiler->Mutex);
+            continue;
+        }
+
+        Job->State = PIPELINE_JOB_COMPILING;
+        vulkan_graphics_pipeline_description Description = Job->Description;
+        PlatformMutexUnlock(&Compiler->Mutex);
+
+        VkPipeline Pipeline = VULKAN_NULL_HANDLE;
+        int CompileResult = VulkanCompileGraphicsPipeline(Compiler, Job, &Description, &Pipeline);
+
+        PlatformMutexLock(&Compiler->Mutex);
+        Job->Pipeline = Pipeline;
+        Job->State = CompileResult? PIPELINE_JOB_FAILED : PIPELINE_JOB_DONE;
+        PlatformConditionBroadcast(&Compiler->JobProgressed);
     }
+    PlatformMutexUnlock(&Compiler->Mutex);
 }
 
-static int VulkanCreateDescriptorSetLayouts(vulkan_surface_device *Device, vulkan_descriptor_set_layout_description *Descriptions, uint32_t Count, VkDescriptorSetLayout *DescriptorSetLayouts) {
-    VkDevice DeviceHandle = Device->Handle;
-
-    uint32_t CreatedCount = 0;
-    {
-        VkDescriptorSetLayoutCreateInfo DescriptorSetLayoutCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .bindingCount = 0,
-            .pBindings = 0
-        };
-        
-        for(; CreatedCount < Count; ++CreatedCount) {
-            vulkan_descriptor_set_layout_description Description = Descriptions[CreatedCount];
-            DescriptorSetLayoutCreateInfo.flags = Description.Flags;
-            DescriptorSetLayoutCreateInfo.bindingCount = Description.BindingsCount;
-            DescriptorSetLayoutCreateInfo.pBindings = Description.Bindings;
-            
-            VulkanCheckGoto(vkCreateDescriptorSetLayout(DeviceHandle, &DescriptorSetLayoutCreateInfo, 0, DescriptorSetLayouts + CreatedCount), label_Error);
+static void VulkanRetirePipeline(vulkan_pipeline_compiler *Compiler, VkPipeline Pipeline) {
+    if(Pipeline == VULKAN_NULL_HANDLE) {
+        return;
+    }
+    if(Compiler->RetiredCount >= ArrayCount(Compiler->Retired)) {
+        // NOTE(blackedout): This should basically never happen, so just stall instead of growing.
+        printfc(CODE_YELLOW, "Too many retired pipelines, waiting for device idle.\n");
+        vkDeviceWaitIdle(Compiler->DeviceHandle);
+        for(uint32_t I = 0; I < Compiler->RetiredCount; ++I) {
+            vkDestroyPipeline(Compiler->DeviceHandle, Compiler->Retired[I].Pipeline, 0);
         }
+        Compiler->RetiredCount = 0;
     }
+    vulkan_retired_pipeline Retired = { .Pipeline = Pipeline, .PollsLeft = PIPELINE_COMPILER_RETIRE_POLL_COUNT };
+    Compiler->Retired[Compiler->RetiredCount++] = Retired;
+}
 
-    return 0;
-
-label_Error:
-    VulkanDestroyDescriptorSetLayouts(Device, DescriptorSetLayouts, CreatedCount);
-    return 1;
+static void VulkanPublishPipeline(vulkan_pipeline_compiler *Compiler, VkPipeline *Target, VkPipeline Pipeline) {
+    VulkanRetirePipeline(Compiler, *Target);
+    *Target = Pipeline;
 }
 
-typedef struct {
-    VkBuffer *Buffers;
-    void **MappedBuffers;
-    VkDescriptorSet *DescriptorSets;
-    uint32_t BindingIndex;
-    VkDeviceSize Size;
-} vulkan_shader_uniform_buffers_description;
+static void VulkanPollPipelineCompiler(vulkan_pipeline_compiler *Compiler) {
+    // NOTE(blackedout): Must be called between frames on the thread that records command buffers, because this is where targets are changed.
+    VkDevice DeviceHandle = Compiler->DeviceHandle;
+
+    for(uint32_t I = 0; I < Compiler->RetiredCount;) {
+        vulkan_retired_pipeline *Retired = Compiler->Retired + I;
+        if(--Retired->PollsLeft == 0) {
+            vkDestroyPipeline(DeviceHandle, Retired->Pipeline, 0);
+            *Retired = Compiler->Retired[--Compiler->RetiredCount];
+        } else {
+            ++I;
+        }
+    }
 
-static int VulkanCreateShaderUniformBuffers(vulkan_surface_device *Device, VkDescriptorSetLayout DescriptorSetLayout, vulkan_shader_uniform_buffers_description *Descriptions, uint32_t Count, VkDeviceMemory *OutBufferMemory, VkDescriptorPool *OutDescriptorPool) {
-    VkDevice DeviceHandle = Device->Handle;
+    PlatformMutexLock(&Compiler->Mutex);
+    for(uint32_t I = 0; I < ArrayCount(Compiler->Jobs); ++I) {
+        vulkan_pipeline_job *Job = Compiler->Jobs + I;
+        if(Job->State == PIPELINE_JOB_FREE) {
+            continue;
+        }
+
+        if(Job->FastPipeline && Job->IsFastPublished == 0) {
+            if(Job->IsSuperseded) {
+                VulkanRetirePipeline(Compiler, Job->FastPipeline);
+            } else {
+                VulkanPublishPipeline(Compiler, Job->Target, Job->FastPipeline);
+            }
+            Job->IsFastPublished = 1;
+        }
 
-    VkDeviceMemory Memory = 0;
-    VkDescriptorPool DescriptorPool = 0;
+        if(Job->State == PIPELINE_JOB_DONE || Job->State == PIPELINE_JOB_FAILED) {
+            if(Job->State == PIPELINE_JOB_FAILED) {
+                printfc(CODE_RED, "Pipeline compilation failed.\n");
+            }
+            if(Job->IsSuperseded) {
+                VulkanRetirePipeline(Compiler, Job->Pipeline);
+            } else if(Job->Pipeline) {
+                VulkanPublishPipeline(Compiler, Job->Target, Job->Pipeline);
+            }
+            memset(Job, 0, sizeof(*Job));
+        }
+    }
+    PlatformMutexUnlock(&Compiler->Mutex);
+}
+
+static int VulkanTryReleaseShaderModule(vulkan_pipeline_compiler *Compiler, VkShaderModule Module) {
+    // NOTE(blackedout): Returns 1 if no pending job uses the module anymore. In that case all libraries that were built from it are retired,
+    // so that a new module that happens to get the same handle value can never match them, and the module can be destroyed by the caller.
+    // Must be called on the polling thread.
+    int IsReleased = 1;
+    PlatformMutexLock(&Compiler->Mutex);
+    for(uint32_t I = 0; I < ArrayCount(Compiler->Jobs); ++I) {
+        vulkan_pipeline_job *Job = Compiler->Jobs + I;
+        int IsPending = Job->State == PIPELINE_JOB_QUEUED || Job->State == PIPELINE_JOB_COMPILING;
+        if(IsPending && (Job->Description.ModuleVS == Module || Job->Description.ModuleFS == Module)) {
+            IsReleased = 0;
+        }
+    }
+    if(IsReleased) {
+        for(uint32_t I = 0; I < Compiler->LibraryCount;) {
+            vulkan_pipeline_library *Entry = Compiler->Libraries + I;
+            if(Entry->Key.ModuleVS == Module || Entry->Key.ModuleFS == Module) {
+                VulkanRetirePipeline(Compiler, Entry->Library);
+                *Entry = Compiler->Libraries[--Compiler->LibraryCount];
+            } else {
+                ++I;
+            }
+        }
+    }
+    PlatformMutexUnlock(&Compiler->Mutex);
+    return IsReleased;
+}
 
-    uint32_t CreatedBufferCount = 0;
+static int VulkanRequestGraphicsPipeline(vulkan_pipeline_compiler *Compiler, vulkan_graphics_pipeline_description *Description, VkPipeline *Target) {
+    // NOTE(blackedout): Target keeps its current pipeline until a new one is published by VulkanPollPipelineCompiler.
+    // Pending jobs for the same target are superseded, so that an older pipeline never overwrites a newer one.
+    int Result = 1;
+    PlatformMutexLock(&Compiler->Mutex);
     {
-        VkBufferCreateInfo BufferCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-            .pNext = 0,
-            .flags = 0,
-            .size = 0,
-            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-            .queueFamilyIndexCount = 0,
-            .pQueueFamilyIndices = 0
-        };
-        
-        VkDeviceSize TotalByteCount = 0;
-        uint32_t CommonMemoryTypeBits = ~(uint32_t)0; // TODO(blackedout): Do multiple allocations if needed.
-        for(uint32_t I = 0; I < Count; ++I) {
-            vulkan_shader_uniform_buffers_description Description = Descriptions[I];
-            BufferCreateInfo.size = Description.Size;
-            
-            for(uint32_t J = 0; J < MAX_ACQUIRED_IMAGE_COUNT; ++J) {
-                VkBuffer Buffer;
-                VulkanCheckGoto(vkCreateBuffer(DeviceHandle, &BufferCreateInfo, 0, &Buffer), label_Buffers);
-                Description.Buffers[J] = Buffer;
-                ++CreatedBufferCount;
+        vulkan_pipeline_job *FreeJob = 0;
+        for(uint32_t I = 0; I < ArrayCount(Compiler->Jobs); ++I) {
+            vulkan_pipeline_job *Job = Compiler->Jobs + I;
+            if(Job->State == PIPELINE_JOB_FREE) {
+                if(FreeJob == 0) {
+                    FreeJob = Job;
+                }
+            } else if(Job->Target == Target) {
+                Job->IsSuperseded = 1;
             }
+        }
+        AssertMessageGoto(FreeJob, label_Unlock, "Pipeline compiler job queue is full (%d jobs).\n", (int)ArrayCount(Compiler->Jobs));
 
-            VkMemoryRequirements MemoryRequirements;
-            vkGetBufferMemoryRequirements(DeviceHandle, Description.Buffers[0], &MemoryRequirements);
+        vulkan_pipeline_job Job;
+        SetZero(Job);
+        Job.State = PIPELINE_JOB_QUEUED;
+        Job.Sequence = Compiler->NextSequence++;
+        Job.Description = *Description;
+        Job.Target = Target;
+        *FreeJob = Job;
 
-            CommonMemoryTypeBits &= MemoryRequirements.memoryTypeBits;
+        PlatformConditionSignal(&Compiler->JobQueued);
+    }
+    Result = 0;
 
-            for(uint32_t J = 0; J < MAX_ACQUIRED_IMAGE_COUNT; ++J) {
-                uint64_t UniformBufferOffset = AlignAny(TotalByteCount, uint64_t, MemoryRequirements.alignment);
-                TotalByteCount = UniformBufferOffset + MemoryRequirements.size;
+label_Unlock:
+    PlatformMutexUnlock(&Compiler->Mutex);
+    return Result;
+}
 
-                // NOTE(blackedout): First, just store offset in pointer. Later, add base address
-                Description.MappedBuffers[J] = (void *)UniformBufferOffset;
+static int VulkanWaitForGraphicsPipeline(vulkan_pipeline_compiler *Compiler, VkPipeline *Target) {
+    // NOTE(blackedout): Blocks until the target has a usable (not necessarily optimized) pipeline. Only meant for loading screens and startup.
+    PlatformMutexLock(&Compiler->Mutex);
+    for(;;) {
+        int IsPending = 0;
+        for(uint32_t I = 0; I < ArrayCount(Compiler->Jobs); ++I) {
+            vulkan_pipeline_job *Job = Compiler->Jobs + I;
+            if(Job->Target == Target && Job->IsSuperseded == 0 && (Job->State == PIPELINE_JOB_QUEUED || Job->State == PIPELINE_JOB_COMPILING) && Job->FastPipeline == VULKAN_NULL_HANDLE) {
+                IsPending = 1;
             }
         }
+        if(IsPending == 0) {
+            break;
+        }
+        PlatformConditionWait(&Compiler->JobProgressed, &Compiler->Mutex);
+    }
+    PlatformMutexUnlock(&Compiler->Mutex);
 
-        uint32_t MemoryTypeIndex;
-        CheckGoto(VulkanGetBufferMemoryTypeIndex(Device, CommonMemoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &MemoryTypeIndex), label_Buffers);
+    VulkanPollPipelineCompiler(Compiler);
+    AssertMessageGoto(*Target != VULKAN_NULL_HANDLE, label_Error, "Waited for pipeline, but none was created.\n");
+    return 0;
 
-        VkMemoryAllocateInfo MemoryAllocateInfo = {
-            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-            .pNext = 0,
-            .allocationSize = TotalByteCount,
-            .memoryTypeIndex = MemoryTypeIndex
-        };
-        
-        VulkanCheckGoto(vkAllocateMemory(DeviceHandle, &MemoryAllocateInfo, 0, &Memory), label_Buffers);
+label_Error:
+    return 1;
+}
 
-        // TODO(blackedout): Map whole buffer or individual chunks?
-        uint8_t *MappedMemory;
-        VulkanCheckGoto(vkMapMemory(DeviceHandle, Memory, 0, TotalByteCount, 0, (void **)&MappedMemory), label_Memory);
+static void VulkanDestroyPipelineCompiler(vulkan_pipeline_compiler *Compiler) {
+    // NOTE(blackedout): Waits for running compilations. Pipelines that were already published belong to their targets and are not destroyed.
+    VkDevice DeviceHandle = Compiler->DeviceHandle;
 
-        for(uint32_t I = 0; I < Count; ++I) {
-            for(uint32_t J = 0; J < MAX_ACQUIRED_IMAGE_COUNT; ++J) {
-                vulkan_shader_uniform_buffers_description Description = Descriptions[I];
+    PlatformMutexLock(&Compiler->Mutex);
+    Compiler->ShouldQuit = 1;
+    for(uint32_t I = 0; I < ArrayCount(Compiler->Jobs); ++I) {
+        if(Compiler->Jobs[I].State == PIPELINE_JOB_QUEUED) {
+            Compiler->Jobs[I].State = PIPELINE_JOB_FREE;
+        }
+    }
+    PlatformConditionBroadcast(&Compiler->JobQueued);
+    PlatformMutexUnlock(&Compiler->Mutex);
 
-                uint64_t Offset = (uint64_t)Description.MappedBuffers[J];
-                VulkanCheckGoto(vkBindBufferMemory(DeviceHandle, Description.Buffers[J], Memory, Offset), label_Memory);
-                Description.MappedBuffers[J] = (void *)(MappedMemory + Offset);
+    for(uint32_t I = 0; I < Compiler->ThreadCount; ++I) {
+        PlatformJoinThread(Compiler->Threads[I]);
+    }
+
+    for(uint32_t I = 0; I < ArrayCount(Compiler->Jobs); ++I) {
+        vulkan_pipeline_job *Job = Compiler->Jobs + I;
+        if(Job->State != PIPELINE_JOB_FREE) {
+            if(Job->IsFastPublished == 0) {
+                vkDestroyPipeline(DeviceHandle, Job->FastPipeline, 0);
             }
+            vkDestroyPipeline(DeviceHandle, Job->Pipeline, 0);
         }
+    }
+    for(uint32_t I = 0; I < Compiler->RetiredCount; ++I) {
+        vkDestroyPipeline(DeviceHandle, Compiler->Retired[I].Pipeline, 0);
+    }
+    for(uint32_t I = 0; I < Compiler->LibraryCount; ++I) {
+        vkDestroyPipeline(DeviceHandle, Compiler->Libraries[I].Library, 0);
+    }
+    vkDestroyPipelineCache(DeviceHandle, Compiler->Cache, 0);
 
-        // NOTE(blackedout): Create uniform descriptor pool and sets
-        uint32_t TotalBufferCount = Count*MAX_ACQUIRED_IMAGE_COUNT;
-        VkDescriptorPoolSize DescriptorPoolSizes[] = {
-            {
-                .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                // NOTE(blackedout): This seems to be the total number per pool, not per set
-                .descriptorCount = TotalBufferCount
-            },
-        };
+    PlatformConditionDestroy(&Compiler->JobProgressed);
+    PlatformConditionDestroy(&Compiler->JobQueued);
+    PlatformMutexDestroy(&Compiler->Mutex);
+    memset(Compiler, 0, sizeof(*Compiler));
+}
 
-        VkDescriptorPoolCreateInfo DescriptorPoolCreateInfo = {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+static int VulkanCreatePipelineCompiler(vulkan_surface_device *Device, uint32_t ThreadCount, vulkan_pipeline_compiler *Compiler) {
+    // NOTE(blackedout): The compiler is initialized in place, because its threads keep a pointer to it.
+    VkDevice DeviceHandle = Device->Handle;
+    memset(Compiler, 0, sizeof(*Compiler));
+    Compiler->DeviceHandle = DeviceHandle;
+    Compiler->UseLibraries = Device->HasGraphicsPipelineLibrary;
+    {
+        // NOTE(blackedout): Pipeline caches are internally synchronized, so all threads can share this one.
+        VkPipelineCacheCreateInfo PipelineCacheCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
             .pNext = 0,
             .flags = 0,
-            .maxSets = TotalBufferCount,
-            .poolSizeCount = ArrayCount(DescriptorPoolSizes),
-            .pPoolSizes = DescriptorPoolSizes
+            .initialDataSize = 0,
+            .pInitialData = 0
         };
-        
-        VulkanCheckGoto(vkCreateDescriptorPool(DeviceHandle, &DescriptorPoolCreateInfo, 0, &DescriptorPool), label_Memory);    
-        
-        VkDescriptorSetLayout DescriptorSetLayouts[MAX_ACQUIRED_IMAGE_COUNT];
-        for(uint32_t J = 0; J < ArrayCount(DescriptorSetLayouts); ++J) {
-            DescriptorSetLayouts[J] = DescriptorSetLayout;
+        VulkanCheckGoto(vkCreatePipelineCache(DeviceHandle, &PipelineCacheCreateInfo, 0, &Compiler->Cache), label_Error);
+
+        PlatformMutexInit(&Compiler->Mutex);
+        PlatformConditionInit(&Compiler->JobQueued);
+        PlatformConditionInit(&Compiler->JobProgressed);
+
+        ThreadCount = Clamp(ThreadCount, 1, PIPELINE_COMPILER_MAX_THREAD_COUNT);
+        for(; Compiler->ThreadCount < ThreadCount; ++Compiler->ThreadCount) {
+            CheckGoto(PlatformCreateThread(VulkanPipelineCompilerThread, Compiler, Compiler->Threads + Compiler->ThreadCount), label_Threads);
         }
-        for(uint32_t I = 0; I < Count; ++I) {
-            vulkan_shader_uniform_buffers_description Description = Descriptions[I];
+    }
 
-            VkDescriptorSetAllocateInfo DescriptorSetAllocateInfo = {
-                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-                .pNext = 0,
-                .descriptorPool = DescriptorPool,
-                .descriptorSetCount = ArrayCount(DescriptorSetLayouts),
-                .pSetLayouts = DescriptorSetLayouts
-            };
+#ifdef VULKAN_INFO_PRINT
+    printf("Pipeline compiler started with %d threads%s.\n", Compiler->ThreadCount, Compiler->UseLibraries? " (using graphics pipeline libraries)" : "");
+#endif
 
-            // NOTE(blackedout): The length of Description.DescriptorSets must be ArrayCount(DescriptorSetLayouts)
-            VulkanCheckGoto(vkAllocateDescriptorSets(DeviceHandle, &DescriptorSetAllocateInfo, Description.DescriptorSets), label_DescriptorPool);
+    return 0;
 
-            VkDescriptorBufferInfo BufferInfos[ArrayCount(DescriptorSetLayouts)];
-            VkWriteDescriptorSet WriteDescriptorSets[ArrayCount(DescriptorSetLayouts)];
-            for(uint32_t J = 0; J < ArrayCount(DescriptorSetLayouts); ++J) {
-                VkDescriptorBufferInfo BufferInfo = {
-                    .buffer = Description.Buffers[J],
-                    .offset = 0,
-                    .range = Description.Size
-                };
+label_Threads:
+    // NOTE(blackedout): Also handles the partially created threads.
+    VulkanDestroyPipelineCompiler(Compiler);
+    return 1;
+label_Error:
+    return 1;
+}
 
-                VkWriteDescriptorSet WriteDescriptorSet = {
-                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                    .pNext = 0,
-                    .dstSet = Description.DescriptorSets[J],
-                    .dstBinding = Description.BindingIndex, // NOTE(blackedout): Uniform binding index (?)
-                    .dstArrayElement = 0,
-                    .descriptorCount = 1,
-                    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                    .pImageInfo = 0,
-                    .pBufferInfo = BufferInfos + J,
-                    .pTexelBufferView = 0
-                };
+// MARK: Pipeline States
+// NOTE(blackedout): Hash table from pipeline descriptions to pipelines. Missing pipelines are requested from the pipeline compiler the first time
+// they are looked up, so any variant can be asked for while recording and is created only once. The pipelines live in a separate array that
+// never moves, because its elements are the targets the compiler publishes into. Only the table itself is rebuilt when descriptions change.
+#define PIPELINE_STATE_CACHE_CAPACITY 256 // NOTE(blackedout): Must be a power of two
 
-                BufferInfos[J] = BufferInfo;
-                WriteDescriptorSets[J] = WriteDescriptorSet;
-            }
-            vkUpdateDescriptorSets(DeviceHandle, ArrayCount(WriteDescriptorSets), WriteDescriptorSets, 0, 0);
+typedef struct {
+    uint64_t Hash;
+    int IsUsed;
+    uint32_t PipelineIndex;
+    vulkan_graphics_pipeline_description Description;
+} vulkan_pipeline_state;
+
+typedef struct {
+    vulkan_pipeline_compiler *Compiler;
+    uint32_t Count;
+    uint64_t HitCount;
+    uint64_t MissCount;
+    vulkan_pipeline_state *States;
+    VkPipeline *Pipelines;
+} vulkan_pipeline_state_cache;
+
+static void VulkanDestroyPipelineStateCache(vulkan_pipeline_state_cache *Cache) {
+    // NOTE(blackedout): The compiler must be destroyed (or idle) before this, so that nothing is published into the freed pipelines.
+    for(uint32_t I = 0; I < Cache->Count; ++I) {
+        vkDestroyPipeline(Cache->Compiler->DeviceHandle, Cache->Pipelines[I], 0);
+    }
+    free(Cache->States); // NOTE(blackedout): States and pipelines share one allocation
+    memset(Cache, 0, sizeof(*Cache));
+}
+
+static int VulkanCreatePipelineStateCache(vulkan_pipeline_compiler *Compiler, vulkan_pipeline_state_cache *OutCache) {
+    vulkan_pipeline_state_cache Cache;
+    SetZero(Cache);
+    Cache.Compiler = Compiler;
+
+    malloc_multiple_subbuf Subbufs[] = {
+        { &Cache.States, PIPELINE_STATE_CACHE_CAPACITY*sizeof(vulkan_pipeline_state) },
+        { &Cache.Pipelines, PIPELINE_STATE_CACHE_CAPACITY*sizeof(VkPipeline) },
+    };
+    void *Memory = 0;
+    CheckGoto(MallocMultiple(ArrayCount(Subbufs), Subbufs, &Memory), label_Error);
+    memset(Cache.States, 0, PIPELINE_STATE_CACHE_CAPACITY*sizeof(vulkan_pipeline_state));
+    memset(Cache.Pipelines, 0, PIPELINE_STATE_CACHE_CAPACITY*sizeof(VkPipeline));
+
+    *OutCache = Cache;
+    return 0;
+
+label_Error:
+    return 1;
+}
+
+static vulkan_pipeline_state *VulkanFindPipelineState(vulkan_pipeline_state_cache *Cache, vulkan_graphics_pipeline_description *Description, uint64_t Hash) {
+    // NOTE(blackedout): Returns either the matching state or the free state where it would have to be inserted (0 if the table is full).
+    uint32_t Mask = PIPELINE_STATE_CACHE_CAPACITY - 1;
+    for(uint32_t Probe = 0; Probe < PIPELINE_STATE_CACHE_CAPACITY; ++Probe) {
+        vulkan_pipeline_state *State = Cache->States + ((Hash + Probe) & Mask);
+        if(State->IsUsed == 0 || (State->Hash == Hash && memcmp(&State->Description, Description, sizeof(*Description)) == 0)) {
+            return State;
         }
+    }
+    return 0;
+}
 
-        *OutBufferMemory = Memory;
-        *OutDescriptorPool = DescriptorPool;
+static VkPipeline *VulkanFindOrRequestGraphicsPipeline(vulkan_pipeline_state_cache *Cache, vulkan_graphics_pipeline_description *Description) {
+    // NOTE(blackedout): Returns the slot that holds (or will hold) the pipeline, or 0 if the table is full or the request failed.
+    uint64_t Hash = HashBytesFNV1a(Description, sizeof(*Description), HASH_FNV1A_BASIS);
+    vulkan_pipeline_state *State = VulkanFindPipelineState(Cache, Description, Hash);
+    if(State && State->IsUsed) {
+        ++Cache->HitCount;
+        return Cache->Pipelines + State->PipelineIndex;
     }
-    
+    AssertMessageGoto(State && Cache->Count + 1 < PIPELINE_STATE_CACHE_CAPACITY, label_Error, "Pipeline state cache is full (%d pipelines).\n", Cache->Count);
+
+    ++Cache->MissCount;
+    VkPipeline *Pipeline = Cache->Pipelines + Cache->Count;
+    CheckGoto(VulkanRequestGraphicsPipeline(Cache->Compiler, Description, Pipeline), label_Error);
+    State->Hash = Hash;
+    State->IsUsed = 1;
+    State->PipelineIndex = Cache->Count++;
+    State->Description = *Description;
+    return Pipeline;
+
+label_Error:
     return 0;
+}
 
-label_DescriptorPool:
-    vkDestroyDescriptorPool(DeviceHandle, DescriptorPool, 0);
-    DescriptorPool = 0;
-label_Memory:
-    vkFreeMemory(DeviceHandle, Memory, 0);
-    Memory = 0;
-label_Buffers:
-    for(uint32_t I = 0; I < CreatedBufferCount; ++I) {
-        vulkan_shader_uniform_buffers_description Description = Descriptions[I / MAX_ACQUIRED_IMAGE_COUNT];
-        uint32_t BufferIndex = (I % MAX_ACQUIRED_IMAGE_COUNT);
+static VkPipeline VulkanGetGraphicsPipeline(vulkan_pipeline_state_cache *Cache, vulkan_graphics_pipeline_description *Description) {
+    // NOTE(blackedout): Null while the pipeline is still being compiled, the caller should skip its draws in that case.
+    VkPipeline *Slot = VulkanFindOrRequestGraphicsPipeline(Cache, Description);
+    return Slot? *Slot : VULKAN_NULL_HANDLE;
+}
 
-        vkDestroyBuffer(DeviceHandle, Description.Buffers[BufferIndex], 0);
-        Description.Buffers[BufferIndex] = 0;
-        Description.MappedBuffers[BufferIndex] = 0;
+static int VulkanReplacePipelineStateShaderModule(vulkan_pipeline_state_cache *Cache, VkShaderModule OldModule, VkShaderModule NewModule) {
+    // NOTE(blackedout): Every pipeline that uses the old module is recompiled with the new one in the background. Until then (and if that fails)
+    // the old pipelines stay in their slots, so drawing never stalls. The table is rebuilt, because the hashes of the changed descriptions change.
+    int Result = 1;
+    uint32_t RequestFailedCount = 0;
+    vulkan_pipeline_state *OldStates = (vulkan_pipeline_state *)malloc(PIPELINE_STATE_CACHE_CAPACITY*sizeof(vulkan_pipeline_state));
+    AssertMessageGoto(OldStates, label_Exit, "Pipeline states could not be rebuilt: out of memory.\n");
+    memcpy(OldStates, Cache->States, PIPELINE_STATE_CACHE_CAPACITY*sizeof(vulkan_pipeline_state));
+    memset(Cache->States, 0, PIPELINE_STATE_CACHE_CAPACITY*sizeof(vulkan_pipeline_state));
+
+    for(uint32_t I = 0; I < PIPELINE_STATE_CACHE_CAPACITY; ++I) {
+        vulkan_pipeline_state OldState = OldStates[I];
+        if(OldState.IsUsed == 0) {
+            continue;
+        }
+
+        int IsChanged = 0;
+        if(OldState.Description.ModuleVS == OldModule) {
+            OldState.Description.ModuleVS = NewModule;
+            IsChanged = 1;
+        }
+        if(OldState.Description.ModuleFS == OldModule) {
+            OldState.Description.ModuleFS = NewModule;
+            IsChanged = 1;
+        }
+        if(IsChanged) {
+            OldState.Hash = HashBytesFNV1a(&OldState.Description, sizeof(OldState.Description), HASH_FNV1A_BASIS);
+            if(VulkanRequestGraphicsPipeline(Cache->Compiler, &OldState.Description, Cache->Pipelines + OldState.PipelineIndex)) {
+                ++RequestFailedCount;
+            }
+        }
+
+        // NOTE(blackedout): Can't fail, the table holds exactly as many states as before.
+        vulkan_pipeline_state *State = VulkanFindPipelineState(Cache, &OldState.Description, OldState.Hash);
+        *State = OldState;
     }
-    return 1;
+    free(OldStates);
+
+    AssertMessageGoto(RequestFailedCount == 0, label_Exit, "%d pipelines could not be recompiled with the new shader module.\n", RequestFailedCount);
+    Result = 0;
+
+label_Exit:
+    return Result;
+}
+
+static void VulkanPrintPipelineStateCacheStats(vulkan_pipeline_state_cache *Cache) {
+    uint64_t LookupCount = Cache->HitCount + Cache->MissCount;
+    double HitRate = LookupCount? (100.0*(double)Cache->HitCount/(double)LookupCount) : 0.0;
+    printf("Pipeline state cache: %d pipelines, %llu hits, %llu misses (%.2f%% hit rate).\n", Cache->Count,
+           (unsigned long long)Cache->HitCount, (unsigned long long)Cache->MissCount, HitRate);
 }
 
 // MARK: Instace
@@ -1150,9 +4769,7 @@ label_Error:
 
 // MARK: Surface Device
 static void VulkanDestroySurfaceDevice(VkInstance Instance, vulkan_surface_device *Device) {
-#ifdef VULKAN_USE_VMA
-    vmaDestroyAllocator(Device->Allocator);
-#endif
+    VulkanDestroyMemoryAllocator(&Device->Memory);
     vkDestroySurfaceKHR(Instance, Device->Surface, 0);
     vkDestroyDevice(Device->Handle, 0);
 }
@@ -1163,6 +4780,8 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
     // The physical device is picked by scoring its type, available surface formats and present modes.
 
     VkDevice DeviceHandle = VULKAN_NULL_HANDLE;
+    vulkan_memory_allocator MemoryAllocator;
+    SetZero(MemoryAllocator);
     {
         VkPhysicalDevice PhysicalDevices[16];
         uint32_t PhysicalDeviceScores[ArrayCount(PhysicalDevices)];
@@ -1172,11 +4791,17 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
 
         uint32_t BestPhysicalDeviceGraphicsQueueIndex;
         uint32_t BestPhysicalDeviceSurfaceQueueIndex;
+        uint32_t BestPhysicalDeviceComputeQueueIndex;
+        int BestPhysicalDeviceHasAsyncCompute;
         int BestPhysicalDeviceHasPortabilitySubsetExtension;
         VkSurfaceFormatKHR BestPhysicalDeviceInitialSurfaceFormat;
         VkPhysicalDeviceProperties BestPhysicalDeviceProperties;
         VkPhysicalDeviceFeatures2 BestPhysicalDeviceFeatures;
         VkFormat BestPhysicalDeviceDepthFormat;
+        int BestPhysicalDeviceHasGraphicsPipelineLibrary;
+        int BestPhysicalDeviceHasDescriptorIndexing;
+        VkPhysicalDeviceDescriptorIndexingProperties BestPhysicalDeviceDescriptorIndexingProperties;
+        int BestPhysicalDeviceHasMemoryBudget;
 #ifdef VULKAN_USE_VMA
         VmaAllocationCreateFlags BestPhysicalDeviceVmaCreateFlags;
 #endif
@@ -1206,11 +4831,12 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
             
             int IsUsable = 1;
 
-            int HasGraphicsQueue = 0, HasSurfaceQueue = 0;
-            uint32_t UsableQueueGraphicsIndex, UsableQueueSurfaceIndex;
+            int HasGraphicsQueue = 0, HasSurfaceQueue = 0, HasAsyncComputeQueue = 0;
+            uint32_t UsableQueueGraphicsIndex, UsableQueueSurfaceIndex, UsableQueueComputeIndex;
             for(uint32_t J = 0; J < DeviceQueueFamilyPropertyCount; ++J) {
                 VkQueueFamilyProperties QueueFamilyProps = DeviceQueueFamilyProperties[J];
                 int IsGraphics = (QueueFamilyProps.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+                int IsCompute = (QueueFamilyProps.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
                 
                 VkBool32 IsSurfaceSupported;
                 VulkanCheckGoto(vkGetPhysicalDeviceSurfaceSupportKHR(PhysicalDevice, J, Surface, &IsSurfaceSupported), label_Error);
@@ -1223,11 +4849,19 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
                     UsableQueueSurfaceIndex = J;
                     HasSurfaceQueue = 1;
                 }
+                // NOTE(blackedout): Only a family without graphics is scheduled independently of the graphics queue, the first one is taken
+                if(IsCompute && IsGraphics == 0 && HasAsyncComputeQueue == 0) {
+                    UsableQueueComputeIndex = J;
+                    HasAsyncComputeQueue = 1;
+                }
             }
             IsUsable = IsUsable || (HasGraphicsQueue && HasSurfaceQueue);
 
             int HasSwapchainExtension = 0;
             int HasPortabilitySubsetExtension = 0;
+            int HasPipelineLibraryExtension = 0;
+            int HasGraphicsPipelineLibraryExtension = 0;
+            int HasMemoryBudgetExtension = 0;
 #ifdef VULKAN_USE_VMA
             VmaAllocatorCreateFlags VmaCreateFlags = 0;
 #endif
@@ -1242,6 +4876,16 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
                     HasPortabilitySubsetExtension = 1;
                 }
 
+                if(strcmp(ExtensionName, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) == 0) {
+                    HasPipelineLibraryExtension = 1;
+                }
+                if(strcmp(ExtensionName, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) == 0) {
+                    HasGraphicsPipelineLibraryExtension = 1;
+                }
+                if(strcmp(ExtensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+                    HasMemoryBudgetExtension = 1;
+                }
+
 #ifdef VULKAN_USE_VMA
                 // NOTE(blackedout): Check if extension is part of the vma extensions, so that vma can be told that it will be enabled
                 for(uint32_t K = 0; K < ArrayCount(VmaExtensionMap); ++K) {
@@ -1253,6 +4897,57 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
             }
             IsUsable = IsUsable && HasSwapchainExtension;
 
+            // NOTE(blackedout): Graphics pipeline libraries are only worth it if linking is fast, otherwise a full compile is just as good.
+            // The feature and property structs may only be queried if the extension is actually supported.
+            int HasGraphicsPipelineLibrary = 0;
+            if(HasPipelineLibraryExtension && HasGraphicsPipelineLibraryExtension) {
+                VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT GraphicsPipelineLibraryFeatures;
+                SetZero(GraphicsPipelineLibraryFeatures);
+                GraphicsPipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+                VkPhysicalDeviceFeatures2 LibraryFeatures;
+                SetZero(LibraryFeatures);
+                LibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                LibraryFeatures.pNext = &GraphicsPipelineLibraryFeatures;
+                vkGetPhysicalDeviceFeatures2(PhysicalDevice, &LibraryFeatures);
+
+                VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT GraphicsPipelineLibraryProperties;
+                SetZero(GraphicsPipelineLibraryProperties);
+                GraphicsPipelineLibraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT;
+                VkPhysicalDeviceProperties2 LibraryProperties;
+                SetZero(LibraryProperties);
+                LibraryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+                LibraryProperties.pNext = &GraphicsPipelineLibraryProperties;
+                vkGetPhysicalDeviceProperties2(PhysicalDevice, &LibraryProperties);
+
+                HasGraphicsPipelineLibrary = GraphicsPipelineLibraryFeatures.graphicsPipelineLibrary && GraphicsPipelineLibraryProperties.graphicsPipelineLibraryFastLinking;
+            }
+
+            // NOTE(blackedout): Descriptor indexing is core since Vulkan 1.2, only the features needed for the bindless texture table are used.
+            // Materials index the table with a push constant, without dynamic indexing every texture gets its own table instead (see LoadShaders).
+            int HasDescriptorIndexing = 0;
+            VkPhysicalDeviceDescriptorIndexingProperties DescriptorIndexingProperties;
+            SetZero(DescriptorIndexingProperties);
+            DescriptorIndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+            if(ApiVersion >= VK_API_VERSION_1_2 && Props.apiVersion >= VK_API_VERSION_1_2 && Features.features.shaderSampledImageArrayDynamicIndexing) {
+                VkPhysicalDeviceDescriptorIndexingFeatures DescriptorIndexingFeatures;
+                SetZero(DescriptorIndexingFeatures);
+                DescriptorIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+                VkPhysicalDeviceFeatures2 IndexingFeatures;
+                SetZero(IndexingFeatures);
+                IndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                IndexingFeatures.pNext = &DescriptorIndexingFeatures;
+                vkGetPhysicalDeviceFeatures2(PhysicalDevice, &IndexingFeatures);
+
+                HasDescriptorIndexing = DescriptorIndexingFeatures.descriptorBindingPartiallyBound && DescriptorIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind;
+
+                VkPhysicalDeviceProperties2 IndexingProperties;
+                SetZero(IndexingProperties);
+                IndexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+                IndexingProperties.pNext = &DescriptorIndexingProperties;
+                vkGetPhysicalDeviceProperties2(PhysicalDevice, &IndexingProperties);
+                DescriptorIndexingProperties.pNext = 0;
+            }
+
             uint32_t DeviceTypeScore;
             switch(Props.deviceType) {
             case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
@@ -1301,12 +4996,18 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
 
                     BestPhysicalDeviceGraphicsQueueIndex = UsableQueueGraphicsIndex;
                     BestPhysicalDeviceSurfaceQueueIndex = UsableQueueSurfaceIndex;
+                    BestPhysicalDeviceComputeQueueIndex = HasAsyncComputeQueue? UsableQueueComputeIndex : UsableQueueGraphicsIndex;
+                    BestPhysicalDeviceHasAsyncCompute = HasAsyncComputeQueue;
                     BestPhysicalDeviceHasPortabilitySubsetExtension = HasPortabilitySubsetExtension;
                     BestPhysicalDeviceInitialSurfaceFormat = BestSurfaceFormat;
 
                     BestPhysicalDeviceProperties = Props;
                     BestPhysicalDeviceFeatures = Features;
                     BestPhysicalDeviceDepthFormat = BestDepthFormat;
+                    BestPhysicalDeviceHasGraphicsPipelineLibrary = HasGraphicsPipelineLibrary;
+                    BestPhysicalDeviceHasDescriptorIndexing = HasDescriptorIndexing;
+                    BestPhysicalDeviceDescriptorIndexingProperties = DescriptorIndexingProperties;
+                    BestPhysicalDeviceHasMemoryBudget = HasMemoryBudgetExtension;
 
 #ifdef VULKAN_USE_VMA
                     BestPhysicalDeviceVmaCreateFlags = VmaCreateFlags;
@@ -1319,7 +5020,7 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
         AssertMessageGoto(BestPhysicalDeviceScore > 0, label_Error, "No usable physical device found.\n");
 
         float DeviceQueuePriorities[] = { 1.0f };
-        VkDeviceQueueCreateInfo DeviceQueueCreateInfos[2] = {
+        VkDeviceQueueCreateInfo DeviceQueueCreateInfos[3] = {
             {
                 .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
                 .pNext = 0,
@@ -1336,6 +5037,12 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
             DeviceQueueCreateInfos[1].queueFamilyIndex = BestPhysicalDeviceSurfaceQueueIndex;
             DeviceQueueCreateInfoCount = 2;
         }
+        // NOTE(blackedout): The async compute family has no graphics, so it can only equal the present family
+        if(BestPhysicalDeviceHasAsyncCompute && BestPhysicalDeviceComputeQueueIndex != BestPhysicalDeviceSurfaceQueueIndex) {
+            DeviceQueueCreateInfos[DeviceQueueCreateInfoCount] = DeviceQueueCreateInfos[0];
+            DeviceQueueCreateInfos[DeviceQueueCreateInfoCount].queueFamilyIndex = BestPhysicalDeviceComputeQueueIndex;
+            ++DeviceQueueCreateInfoCount;
+        }
 
         const char *ExtensionNames[] = {
             VK_KHR_SWAPCHAIN_EXTENSION_NAME,
@@ -1347,38 +5054,70 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
             ExtensionNameCount -= 1;
         }
 
+        // NOTE(blackedout): Required extensions first, then optional ones (ExtensionNameCount marks the end of the required ones), then vma ones.
+        // The buffer is large enough to hold all of them.
+        const char *FinalExtensionNames[32];
         uint32_t FinalExtensionNameCount = 0;
+        for(uint32_t I = 0; I < ExtensionNameCount; ++I) {
+            FinalExtensionNames[FinalExtensionNameCount++] = ExtensionNames[I];
+        }
 
         // NOTE(blackedout): Disable all features by default first, then enable using supported features
+        // Extension feature structs are appended to the chain through FeaturesNext.
         VkPhysicalDeviceFeatures2 PhysicalDeviceFeatures;
         SetZero(PhysicalDeviceFeatures);
         PhysicalDeviceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
         PhysicalDeviceFeatures.features.samplerAnisotropy = BestPhysicalDeviceFeatures.features.samplerAnisotropy;
+        PhysicalDeviceFeatures.features.fillModeNonSolid = BestPhysicalDeviceFeatures.features.fillModeNonSolid;
+        PhysicalDeviceFeatures.features.multiDrawIndirect = BestPhysicalDeviceFeatures.features.multiDrawIndirect;
+        PhysicalDeviceFeatures.features.shaderSampledImageArrayDynamicIndexing = BestPhysicalDeviceFeatures.features.shaderSampledImageArrayDynamicIndexing;
+        void **FeaturesNext = &PhysicalDeviceFeatures.pNext;
+
+        VkPhysicalDeviceDescriptorIndexingFeatures FeatureDescriptorIndexing;
+        SetZero(FeatureDescriptorIndexing);
+        FeatureDescriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+        FeatureDescriptorIndexing.descriptorBindingPartiallyBound = VK_TRUE;
+        FeatureDescriptorIndexing.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        if(BestPhysicalDeviceHasDescriptorIndexing) {
+            *FeaturesNext = &FeatureDescriptorIndexing;
+            FeaturesNext = &FeatureDescriptorIndexing.pNext;
+        }
 
-#ifdef VULKAN_USE_VMA
-        const char *FinalExtensionNames[ArrayCount(ExtensionNames) + ArrayCount(VmaExtensionMap)];
-        for(uint32_t I = 0; I < ExtensionNameCount; ++I, ++FinalExtensionNameCount) {
-            FinalExtensionNames[I] = ExtensionNames[I];
+        VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT FeatureGraphicsPipelineLibrary = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+            .pNext = 0,
+            .graphicsPipelineLibrary = VK_TRUE
+        };
+        if(BestPhysicalDeviceHasGraphicsPipelineLibrary) {
+            FinalExtensionNames[FinalExtensionNameCount++] = VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME;
+            FinalExtensionNames[FinalExtensionNameCount++] = VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME;
+            *FeaturesNext = &FeatureGraphicsPipelineLibrary;
+            FeaturesNext = &FeatureGraphicsPipelineLibrary.pNext;
+        }
+        // NOTE(blackedout): The budget is polled every frame (also by vma, which then gets VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT)
+        if(BestPhysicalDeviceHasMemoryBudget) {
+            FinalExtensionNames[FinalExtensionNameCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
         }
+        uint32_t OptionalExtensionNameEnd = FinalExtensionNameCount;
+
+#ifdef VULKAN_USE_VMA
         for(uint32_t I = 0; I < ArrayCount(VmaExtensionMap); ++I) {
-            if(BestPhysicalDeviceVmaCreateFlags & VmaExtensionMap[I].VmaBit) {
+            if((BestPhysicalDeviceVmaCreateFlags & VmaExtensionMap[I].VmaBit) && VmaExtensionMap[I].VmaBit != VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT) {
                 FinalExtensionNames[FinalExtensionNameCount++] = VmaExtensionMap[I].VulkanName;
             }
         }
 
+        VkPhysicalDeviceBufferDeviceAddressFeaturesKHR FeatureBufferDeviceAddress = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR,
+            .pNext = 0,
+            .bufferDeviceAddress = VK_TRUE,
+            .bufferDeviceAddressCaptureReplay = VK_FALSE,
+            .bufferDeviceAddressMultiDevice = VK_FALSE,
+        };
         if(BestPhysicalDeviceVmaCreateFlags & VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT) {
-                VkPhysicalDeviceBufferDeviceAddressFeaturesKHR FeatureBufferDeviceAddress = {
-                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES_KHR,
-                .pNext = 0,
-                .bufferDeviceAddress = VK_TRUE,
-                .bufferDeviceAddressCaptureReplay = VK_FALSE,
-                .bufferDeviceAddressMultiDevice = VK_FALSE,
-            };
-            PhysicalDeviceFeatures.pNext = &FeatureBufferDeviceAddress;
+            *FeaturesNext = &FeatureBufferDeviceAddress;
+            FeaturesNext = &FeatureBufferDeviceAddress.pNext;
         }
-#else
-        const char **FinalExtensionNames = ExtensionNames;
-        FinalExtensionNameCount = ExtensionNameCount;
 #endif
 
         VkDeviceCreateInfo DeviceCreateInfo = {
@@ -1407,7 +5146,7 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
 
         printf("Vulkan enabled device extensions (%d):\n", DeviceCreateInfo.enabledExtensionCount);
         for(uint32_t I = 0; I < DeviceCreateInfo.enabledExtensionCount; ++I) {
-            const char *InfoString = (I >= ExtensionNameCount)? " (vma)" : "";
+            const char *InfoString = (I >= OptionalExtensionNameEnd)? " (vma)" : ((I >= ExtensionNameCount)? " (optional)" : "");
             printf("[%d] %s%s\n", I, DeviceCreateInfo.ppEnabledExtensionNames[I], InfoString);
         }
 #endif
@@ -1426,6 +5165,8 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
             }
         }
 
+        CheckGoto(VulkanCreateMemoryAllocator(BestPhysicalDevice, DeviceHandle, &BestPhysicalDeviceProperties, BestPhysicalDeviceHasMemoryBudget, &MemoryAllocator), label_Device);
+
 #ifdef VULKAN_USE_VMA
         VmaAllocatorCreateInfo AllocatorCreateInfo = {
             .flags = BestPhysicalDeviceVmaCreateFlags,
@@ -1439,8 +5180,7 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
             .instance = Instance,
             .vulkanApiVersion = ApiVersion
         };
-        VmaAllocator Allocator;
-        VulkanCheckGoto(vmaCreateAllocator(&AllocatorCreateInfo, &Allocator), label_Device);
+        VulkanCheckGoto(vmaCreateAllocator(&AllocatorCreateInfo, &MemoryAllocator.Vma), label_MemoryAllocator);
 #endif
 
         vulkan_surface_device SurfaceDevice = {
@@ -1450,6 +5190,8 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
             
             .GraphicsQueueFamilyIndex = BestPhysicalDeviceGraphicsQueueIndex,
             .PresentQueueFamilyIndex = BestPhysicalDeviceSurfaceQueueIndex,
+            .ComputeQueueFamilyIndex = BestPhysicalDeviceComputeQueueIndex,
+            .HasAsyncCompute = BestPhysicalDeviceHasAsyncCompute,
 
             .InitialExtent = BestPhysicalDeviceSurfaceCapabilities.currentExtent,
             .InitialSurfaceFormat = BestPhysicalDeviceInitialSurfaceFormat,
@@ -1460,9 +5202,11 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
             .BestDepthFormat = BestPhysicalDeviceDepthFormat,
             .MaxSampleCount = MaxPhysicalDeviceSampleCount,
 
-#ifdef VULKAN_USE_VMA
-            .Allocator = Allocator
-#endif
+            .HasGraphicsPipelineLibrary = BestPhysicalDeviceHasGraphicsPipelineLibrary,
+            .HasDescriptorIndexing = BestPhysicalDeviceHasDescriptorIndexing,
+            .DescriptorIndexingProperties = BestPhysicalDeviceDescriptorIndexingProperties,
+
+            .Memory = MemoryAllocator
         };
 
         *OutDevice = SurfaceDevice;
@@ -1471,9 +5215,11 @@ static int VulkanCreateSurfaceDevice(VkInstance Instance, VkSurfaceKHR Surface,
     return 0;
 
 #ifdef VULKAN_USE_VMA
+label_MemoryAllocator:
+    VulkanDestroyMemoryAllocator(&MemoryAllocator);
+#endif
 label_Device:
     vkDestroyDevice(DeviceHandle, 0);
-#endif
 label_Error:
     vkDestroySurfaceKHR(Instance, Surface, 0);
     Surface = 0;
@@ -1481,14 +5227,21 @@ label_Error:
 }
 
 // MARK: Swapchain
+static int VulkanIsDepthSampleable(vulkan_surface_device *Device) {
+    // NOTE(blackedout): The depth attachment can then also be read by shaders between render passes (e.g. to build a depth pyramid)
+    VkFormatProperties FormatProperties;
+    vkGetPhysicalDeviceFormatProperties(Device->PhysicalDevice, Device->BestDepthFormat, &FormatProperties);
+    return (FormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
 static void VulkanDestroySwapchain(vulkan_surface_device *Device, vulkan_swapchain *Swapchain) {
     VkDevice DeviceHandle = Device->Handle;
 
     // NOTE(blackedout): Only destructible if none of its images are acquired.
     AssertMessage(Swapchain->AcquiredImageCount == 0, "Swapchain can't be destroyed because at least one of its imagess is still in use.\n");
 
-    VulkanDestroyImageWidthMemoryAndView(Device, &Swapchain->MultiSampleColorImage, &Swapchain->MultiSampleColorImageMemory, &Swapchain->MultiSampleColorImageView);
-    VulkanDestroyImageWidthMemoryAndView(Device, &Swapchain->DepthImage, &Swapchain->DepthImageMemory, &Swapchain->DepthImageView);
+    VulkanDestroyImageWidthMemoryAndView(Device, &Swapchain->MultiSampleColorImage, &Swapchain->MultiSampleColorImageAllocation, &Swapchain->MultiSampleColorImageView);
+    VulkanDestroyImageWidthMemoryAndView(Device, &Swapchain->DepthImage, &Swapchain->DepthImageAllocation, &Swapchain->DepthImageView);
 
     for(uint32_t I = 0; I < Swapchain->ImageCount; ++I) {
         vkDestroyFramebuffer(DeviceHandle, Swapchain->Framebuffers[I], 0);
@@ -1604,14 +5357,15 @@ static int VulkanCreateSwapchain(vulkan_surface_device *Device, VkExtent2D Exten
         }
 
         VkSampleCountFlagBits UsedSampleCount = SampleCount;
+        VkImageUsageFlags DepthUsage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (VulkanIsDepthSampleable(Device)? VK_IMAGE_USAGE_SAMPLED_BIT : 0);
         CheckGoto(VulkanCreateExclusiveImageWithMemoryAndView(Device, VK_IMAGE_TYPE_2D, Device->BestDepthFormat, ClampedImageExtent.width, ClampedImageExtent.height, 1,
-                                                            UsedSampleCount, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                                            VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT,
-                                                            &Swapchain.DepthImage, &Swapchain.DepthImageMemory, &Swapchain.DepthImageView), label_ImageViews);
+                                                            UsedSampleCount, DepthUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                                            VULKAN_MEMORY_SUBSYSTEM_SWAPCHAIN_ATTACHMENTS, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT,
+                                                            &Swapchain.DepthImage, &Swapchain.DepthImageAllocation, &Swapchain.DepthImageView), label_ImageViews);
         CheckGoto(VulkanCreateExclusiveImageWithMemoryAndView(Device, VK_IMAGE_TYPE_2D, SurfaceFormat.format, ClampedImageExtent.width, ClampedImageExtent.height, 1,
                                                             UsedSampleCount, VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT,
-                                                            &Swapchain.MultiSampleColorImage, &Swapchain.MultiSampleColorImageMemory, &Swapchain.MultiSampleColorImageView), label_DepthImage);
+                                                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_MEMORY_SUBSYSTEM_SWAPCHAIN_ATTACHMENTS, VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT,
+                                                            &Swapchain.MultiSampleColorImage, &Swapchain.MultiSampleColorImageAllocation, &Swapchain.MultiSampleColorImageView), label_DepthImage);
 
         
         for(; CreatedFramebufferCount < Swapchain.ImageCount; ++CreatedFramebufferCount) {
@@ -1641,9 +5395,9 @@ label_Framebuffers:
         vkDestroyFramebuffer(DeviceHandle, Swapchain.Framebuffers[I], 0);
         Swapchain.Framebuffers[I] = 0;
     }
-    VulkanDestroyImageWidthMemoryAndView(Device, &Swapchain.MultiSampleColorImage, &Swapchain.MultiSampleColorImageMemory, &Swapchain.MultiSampleColorImageView);
+    VulkanDestroyImageWidthMemoryAndView(Device, &Swapchain.MultiSampleColorImage, &Swapchain.MultiSampleColorImageAllocation, &Swapchain.MultiSampleColorImageView);
 label_DepthImage:
-    VulkanDestroyImageWidthMemoryAndView(Device, &Swapchain.DepthImage, &Swapchain.DepthImageMemory, &Swapchain.DepthImageView);
+    VulkanDestroyImageWidthMemoryAndView(Device, &Swapchain.DepthImage, &Swapchain.DepthImageAllocation, &Swapchain.DepthImageView);
 label_ImageViews:
     for(uint32_t I = 0; I < CreatedImageViewCount; ++I) {
         vkDestroyImageView(DeviceHandle, Swapchain.ImageViews[I], 0);
@@ -1808,6 +5562,13 @@ static int VulkanAcquireNextImage(vulkan_surface_device *Device, vulkan_swapchai
 
         vulkan_acquired_image AcquiredImage = {
             .Framebuffer = Swapchain.Framebuffers[SwapchainImageIndex],
+            .Image = Swapchain.Images[SwapchainImageIndex],
+            .ColorImage = Swapchain.MultiSampleColorImage,
+            .ColorImageView = Swapchain.MultiSampleColorImageView,
+            .DepthImage = Swapchain.DepthImage,
+            .DepthImageView = Swapchain.DepthImageView,
+            .ImageView = Swapchain.ImageViews[SwapchainImageIndex],
+            .Format = Swapchain.Format,
             .Extent = Swapchain.ImageExtent,
             .DataIndex = AcquiredImageDataIndex
         };
@@ -1823,7 +5584,7 @@ label_Error:
     return 1;
 }
 
-static int VulkanSubmitFinalAndPresent(vulkan_surface_device *Device, vulkan_swapchain_handler *SwapchainHandler, VkQueue GraphicsQueue, VkCommandBuffer GraphicsCommandBuffer, VkExtent2D FramebufferExtent) {
+static int VulkanSubmitFinalAndPresent(vulkan_surface_device *Device, vulkan_swapchain_handler *SwapchainHandler, VkQueue GraphicsQueue, VkCommandBuffer GraphicsCommandBuffer, vulkan_semaphore_wait Wait, VkExtent2D FramebufferExtent) {
     VkDevice DeviceHandle = Device->Handle;
 
     {
@@ -1832,12 +5593,13 @@ static int VulkanSubmitFinalAndPresent(vulkan_surface_device *Device, vulkan_swa
         uint32_t SwapchainIndex = Handler.SwapchainIndexLastAcquired;
         uint32_t AcquiredImageDataIndex = IndicesCircularHead(&Handler.AcquiredImageDataIndices);
 
-        VkPipelineStageFlags WaitDstStageMasks[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+        VkSemaphore WaitSemaphores[] = { Handler.ImageAvailableSemaphores[AcquiredImageDataIndex], Wait.Semaphore };
+        VkPipelineStageFlags WaitDstStageMasks[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, Wait.Stages };
         VkSubmitInfo GraphicsSubmitInfo = {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
             .pNext = 0,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &Handler.ImageAvailableSemaphores[AcquiredImageDataIndex],
+            .waitSemaphoreCount = (Wait.Semaphore != VULKAN_NULL_HANDLE)? 2 : 1,
+            .pWaitSemaphores = WaitSemaphores,
             .pWaitDstStageMask = WaitDstStageMasks,
             .commandBufferCount = 1,
             .pCommandBuffers = &GraphicsCommandBuffer,